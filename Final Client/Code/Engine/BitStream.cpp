@@ -0,0 +1,192 @@
+#include "BitStream.hpp"
+#include "NewMacroDef.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+BitWriter::BitWriter( unsigned char* buffer, int bufferSizeBytes )
+	: m_buffer( buffer )
+	, m_bufferSizeBytes( bufferSizeBytes )
+	, m_numBytesWritten( 0 )
+	, m_scratch( 0 )
+	, m_numScratchBits( 0 )
+	, m_hasOverflowed( false )
+{
+
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void BitWriter::WriteBits( unsigned int value, int numBits )
+{
+	if( numBits < 32 )
+		value &= ( 1u << numBits ) - 1u;
+
+	m_scratch |= (unsigned long long) value << m_numScratchBits;
+	m_numScratchBits += numBits;
+
+	while( m_numScratchBits >= 8 )
+	{
+		if( m_numBytesWritten < m_bufferSizeBytes )
+			m_buffer[ m_numBytesWritten ] = (unsigned char) ( m_scratch & 0xFF );
+		else
+			m_hasOverflowed = true;
+
+		++m_numBytesWritten;
+		m_scratch >>= 8;
+		m_numScratchBits -= 8;
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void BitWriter::WriteBool( bool value )
+{
+	WriteBits( value ? 1 : 0, 1 );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// 7 value bits per group with a continue bit, so small numbers cost one byte.
+void BitWriter::WriteVarUInt( unsigned int value )
+{
+	WriteVarUInt64( value );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void BitWriter::WriteVarUInt64( unsigned long long value )
+{
+	while( value >= 0x80 )
+	{
+		WriteBits( (unsigned int) ( value & 0x7F ) | 0x80, 8 );
+		value >>= 7;
+	}
+
+	WriteBits( (unsigned int) value, 8 );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void BitWriter::AlignToByte()
+{
+	if( m_numScratchBits > 0 )
+		WriteBits( 0, 8 - m_numScratchBits );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+int BitWriter::GetNumBytesWritten() const
+{
+	return m_numBytesWritten + ( ( m_numScratchBits > 0 ) ? 1 : 0 );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+int BitWriter::GetNumBitsWritten() const
+{
+	return ( m_numBytesWritten * 8 ) + m_numScratchBits;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool BitWriter::HasOverflowed() const
+{
+	return m_hasOverflowed || GetNumBytesWritten() > m_bufferSizeBytes;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+BitReader::BitReader( const unsigned char* buffer, int bufferSizeBytes )
+	: m_buffer( buffer )
+	, m_bufferSizeBytes( bufferSizeBytes )
+	, m_numBytesRead( 0 )
+	, m_scratch( 0 )
+	, m_numScratchBits( 0 )
+	, m_hasOverflowed( false )
+{
+
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int BitReader::ReadBits( int numBits )
+{
+	while( m_numScratchBits < numBits )
+	{
+		if( m_numBytesRead >= m_bufferSizeBytes )
+		{
+			m_hasOverflowed = true;
+			return 0;
+		}
+
+		m_scratch |= (unsigned long long) m_buffer[ m_numBytesRead ] << m_numScratchBits;
+		++m_numBytesRead;
+		m_numScratchBits += 8;
+	}
+
+	unsigned long long mask = ( (unsigned long long) 1 << numBits ) - 1;
+	unsigned int value = (unsigned int) ( m_scratch & mask );
+	m_scratch >>= numBits;
+	m_numScratchBits -= numBits;
+	return value;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool BitReader::ReadBool()
+{
+	return ReadBits( 1 ) != 0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int BitReader::ReadVarUInt()
+{
+	return (unsigned int) ReadVarUInt64();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned long long BitReader::ReadVarUInt64()
+{
+	unsigned long long value = 0;
+	for( int shift = 0; shift < 64; shift += 7 )
+	{
+		unsigned int group = ReadBits( 8 );
+		value |= (unsigned long long) ( group & 0x7F ) << shift;
+		if( ( group & 0x80 ) == 0 || m_hasOverflowed )
+			break;
+	}
+
+	return value;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void BitReader::AlignToByte()
+{
+	int numPaddingBits = m_numScratchBits % 8;
+	m_scratch >>= numPaddingBits;
+	m_numScratchBits -= numPaddingBits;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+int BitReader::GetNumBytesRead() const
+{
+	return m_numBytesRead - ( m_numScratchBits / 8 );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+int BitReader::GetNumBytesRemaining() const
+{
+	return m_bufferSizeBytes - GetNumBytesRead();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool BitReader::HasOverflowed() const
+{
+	return m_hasOverflowed;
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+#ifndef include_BitStream
+#define include_BitStream
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+// Packs values LSB-first into a caller-owned byte buffer.
+class BitWriter
+{
+public:
+	BitWriter( unsigned char* buffer, int bufferSizeBytes );
+	void WriteBits( unsigned int value, int numBits );
+	void WriteBool( bool value );
+	void WriteVarUInt( unsigned int value );
+	void WriteVarUInt64( unsigned long long value );
+	void AlignToByte();
+	int GetNumBytesWritten() const;
+	int GetNumBitsWritten() const;
+	bool HasOverflowed() const;
+
+private:
+	unsigned char*		m_buffer;
+	int					m_bufferSizeBytes;
+	int					m_numBytesWritten;
+	unsigned long long	m_scratch;
+	int					m_numScratchBits;
+	bool				m_hasOverflowed;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+// Reads values written by BitWriter. Reading past the end returns zeros and sets HasOverflowed().
+class BitReader
+{
+public:
+	BitReader( const unsigned char* buffer, int bufferSizeBytes );
+	unsigned int ReadBits( int numBits );
+	bool ReadBool();
+	unsigned int ReadVarUInt();
+	unsigned long long ReadVarUInt64();
+	void AlignToByte();
+	int GetNumBytesRead() const;
+	int GetNumBytesRemaining() const;
+	bool HasOverflowed() const;
+
+private:
+	const unsigned char*	m_buffer;
+	int						m_bufferSizeBytes;
+	int						m_numBytesRead;
+	unsigned long long		m_scratch;
+	int						m_numScratchBits;
+	bool					m_hasOverflowed;
+};
+
+
+#endif // include_BitStream
\ No newline at end of file
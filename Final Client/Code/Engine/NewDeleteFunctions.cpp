@@ -1,24 +1,88 @@
 #include "NewDeleteFunctions.hpp"
 #include <malloc.h>
+#if defined( _WIN32 )
 #include "EngineCommon.hpp"
 #include "MemoryManager.hpp"
 #include "ErrorWarningAssertions.hpp"
+#endif
 
 
 //-----------------------------------------------------------------------------------------------
 #undef new
 #define UNUSED(x) (void)(x);
+
+// The pool allocator reports leaks through the Win32 debugger output; the headless server build
+// falls back to the CRT heap.
+#if defined( _WIN32 )
 #define USING_MEMORY_MANAGER
+#endif
 
 
 //-----------------------------------------------------------------------------------------------
-void* operator new( size_t size )
-{
 #ifdef USING_MEMORY_MANAGER
+// The pool is not thread-safe on its own, and job threads and headless bot threads allocate from
+// it too. The lock's state is a plain zero-initialized LONG, so it is valid before any constructor
+// runs; whichever comes first of the library-segment initializer below and the first allocation
+// creates the lock, and anything racing it waits until it is ready.
+static const LONG MEMORY_MANAGER_LOCK_UNINITIALIZED = 0;
+static const LONG MEMORY_MANAGER_LOCK_INITIALIZING = 1;
+static const LONG MEMORY_MANAGER_LOCK_READY = 2;
+static CRITICAL_SECTION s_memoryManagerLock;
+static volatile LONG s_memoryManagerLockState = MEMORY_MANAGER_LOCK_UNINITIALIZED;
+
+static void InitializeMemoryManagerLock()
+{
+	LONG previousState = InterlockedCompareExchange( &s_memoryManagerLockState, MEMORY_MANAGER_LOCK_INITIALIZING, MEMORY_MANAGER_LOCK_UNINITIALIZED );
+	if( previousState == MEMORY_MANAGER_LOCK_UNINITIALIZED )
+	{
+		InitializeCriticalSection( &s_memoryManagerLock );
+		InterlockedExchange( &s_memoryManagerLockState, MEMORY_MANAGER_LOCK_READY );
+		return;
+	}
+
+	while( InterlockedCompareExchange( &s_memoryManagerLockState, MEMORY_MANAGER_LOCK_READY, MEMORY_MANAGER_LOCK_READY ) != MEMORY_MANAGER_LOCK_READY )
+	{
+		Sleep( 0 );
+	}
+}
+
+// Library-segment initializers run before every user-segment one, so the lock exists before any
+// of the game's static constructors can start a thread.
+#pragma warning( disable : 4073 )
+#pragma init_seg( lib )
+struct MemoryManagerLockInitializer
+{
+	MemoryManagerLockInitializer() { InitializeMemoryManagerLock(); }
+};
+static MemoryManagerLockInitializer s_memoryManagerLockInitializer;
+
+static void LockMemoryManager()
+{
+	if( s_memoryManagerLockState != MEMORY_MANAGER_LOCK_READY )
+		InitializeMemoryManagerLock();
+
+	EnterCriticalSection( &s_memoryManagerLock );
 	if( !MemoryManager::IsMemoryManagerAvailable() )
 		MemoryManager::Initialize( POOL_MEMORY_IN_BYTES );
-		
+}
+
+static void UnlockMemoryManager()
+{
+	LeaveCriticalSection( &s_memoryManagerLock );
+}
+#else
+static size_t s_numAllocationsMade = 0;
+#endif
+
+
+//-----------------------------------------------------------------------------------------------
+void* operator new( size_t size )
+{
+#ifdef USING_MEMORY_MANAGER
+	LockMemoryManager();
 	void* data = MemoryManager::AllocateMemory( size );
+	UnlockMemoryManager();
+
 	if( data == nullptr )
 	{
 		static const std::bad_alloc nomem;
@@ -27,6 +91,7 @@ void* operator new( size_t size )
 
 	return data;
 #else
+	__sync_fetch_and_add( &s_numAllocationsMade, 1 );
 	return malloc( size );
 #endif
 }
@@ -36,7 +101,9 @@ void* operator new( size_t size )
 void operator delete( void* data )
 {
 #ifdef USING_MEMORY_MANAGER
+	LockMemoryManager();
 	MemoryManager::FreeMemory( data );
+	UnlockMemoryManager();
 #else
 	free( data );
 #endif
@@ -61,10 +128,10 @@ void operator delete[]( void* data )
 void* operator new( size_t size, const char* file, unsigned int line )
 {
 #ifdef USING_MEMORY_MANAGER
-	if( !MemoryManager::IsMemoryManagerAvailable() )
-		MemoryManager::Initialize( POOL_MEMORY_IN_BYTES );
-
+	LockMemoryManager();
 	void* data = MemoryManager::AllocateMemory( size, file, line );
+	UnlockMemoryManager();
+
 	if( data == nullptr )
 	{
 		static const std::bad_alloc nomem;
@@ -75,6 +142,7 @@ void* operator new( size_t size, const char* file, unsigned int line )
 #else
 	UNUSED( file );
 	UNUSED( line );
+	__sync_fetch_and_add( &s_numAllocationsMade, 1 );
 	return malloc( size );
 #endif
 }
@@ -98,4 +166,20 @@ void* operator new[]( size_t size, const char* file, unsigned int line )
 void operator delete[]( void* data, const char*, unsigned int )
 {
 	operator delete( data );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Every allocation through the operators above, from every thread, since startup. Benchmarks take
+// the difference across the code they measure.
+size_t GetNumAllocationsMade()
+{
+#ifdef USING_MEMORY_MANAGER
+	LockMemoryManager();
+	size_t numAllocationsMade = MemoryManager::GetNumberOfAllocationRequest();
+	UnlockMemoryManager();
+	return numAllocationsMade;
+#else
+	return __sync_fetch_and_add( &s_numAllocationsMade, 0 );
+#endif
 }
\ No newline at end of file
@@ -2,6 +2,11 @@
 #define include_NewDeleteFunctions
 #pragma once
 
+//-----------------------------------------------------------------------------------------------
+#include <new>
+#include <stddef.h>
+
+
 //-----------------------------------------------------------------------------------------------
 void* operator new( size_t size );
 void operator delete( void* data );
@@ -11,6 +16,7 @@ void* operator new( size_t size, const char* file, unsigned int line );
 void operator delete( void* data, const char* file, unsigned int line );
 void* operator new[]( size_t size, const char* file, unsigned int line );
 void operator delete[]( void* data, const char* file, unsigned int line );
+size_t GetNumAllocationsMade();
 
 
 #endif // include_NewDeleteFunctions
\ No newline at end of file
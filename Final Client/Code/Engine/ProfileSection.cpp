@@ -15,21 +15,14 @@ STATIC std::map< std::string, ProfileSectionInfo* > ProfileSection::s_profileSec
 ProfileSection::ProfileSection( const std::string& profileName )
 	: m_profileStartTime( 0.0 )
 {
-	std::map< std::string, ProfileSectionInfo* >::iterator mapIter = s_profileSections.find( profileName );
-	if( mapIter != s_profileSections.end() )
-		m_profileInfo = mapIter->second;
-	else
-	{
-		m_profileInfo = new ProfileSectionInfo();
-		s_profileSections[ profileName ] = m_profileInfo;
-	}
+	m_profileInfo = FindOrCreateProfileInfo( profileName );
 }
 
 
 //-----------------------------------------------------------------------------------------------
 void ProfileSection::StartProfiling()
 {
-	m_profileStartTime = GetCurrentTimeSeconds();
+	m_profileStartTime = GetWallClockTimeSeconds();
 }
 
 
@@ -39,7 +32,7 @@ void ProfileSection::StopProfiling()
 	if( m_profileStartTime == 0.0 )
 		return;
 
-	double profileStopTime = GetCurrentTimeSeconds();
+	double profileStopTime = GetWallClockTimeSeconds();
 	double profileSeconds = profileStopTime - m_profileStartTime;
 	m_profileInfo->m_lastProfileSeconds = profileSeconds;
 	m_profileInfo->m_totalSeconds += profileSeconds;
@@ -49,6 +42,41 @@ void ProfileSection::StopProfiling()
 }
 
 
+//-----------------------------------------------------------------------------------------------
+// For durations measured elsewhere, e.g. an interval the game picked rather than code it timed.
+STATIC void ProfileSection::RecordSample( const std::string& profileName, double sampleSeconds )
+{
+	ProfileSectionInfo* profileInfo = FindOrCreateProfileInfo( profileName );
+	profileInfo->m_lastProfileSeconds = sampleSeconds;
+	profileInfo->m_totalSeconds += sampleSeconds;
+	profileInfo->m_totalNumProfiles += 1;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC const ProfileSectionInfo* ProfileSection::FindProfileInfo( const std::string& profileName )
+{
+	std::map< std::string, ProfileSectionInfo* >::const_iterator mapIter = s_profileSections.find( profileName );
+	if( mapIter != s_profileSections.end() )
+		return mapIter->second;
+
+	return nullptr;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC ProfileSectionInfo* ProfileSection::FindOrCreateProfileInfo( const std::string& profileName )
+{
+	std::map< std::string, ProfileSectionInfo* >::iterator mapIter = s_profileSections.find( profileName );
+	if( mapIter != s_profileSections.end() )
+		return mapIter->second;
+
+	ProfileSectionInfo* profileInfo = new ProfileSectionInfo();
+	s_profileSections[ profileName ] = profileInfo;
+	return profileInfo;
+}
+
+
 //-----------------------------------------------------------------------------------------------
 STATIC void ProfileSection::RenderProfileInfo( const Vector2& windowDimensions )
 {
@@ -94,23 +122,15 @@ STATIC void ProfileSection::RenderProfileInfo( const Vector2& windowDimensions )
 //-----------------------------------------------------------------------------------------------
 ScopedProfileSection::ScopedProfileSection( const std::string& profileName )
 {
-	m_profileStartTime = GetCurrentTimeSeconds();
-
-	std::map< std::string, ProfileSectionInfo* >::iterator mapIter = s_profileSections.find( profileName );
-	if( mapIter != s_profileSections.end() )
-		m_profileInfo = mapIter->second;
-	else
-	{
-		m_profileInfo = new ProfileSectionInfo();
-		s_profileSections[ profileName ] = m_profileInfo;
-	}
+	m_profileStartTime = GetWallClockTimeSeconds();
+	m_profileInfo = FindOrCreateProfileInfo( profileName );
 }
 
 
 //-----------------------------------------------------------------------------------------------
 ScopedProfileSection::~ScopedProfileSection()
 {
-	double profileStopTime = GetCurrentTimeSeconds();
+	double profileStopTime = GetWallClockTimeSeconds();
 	double profileSeconds = profileStopTime - m_profileStartTime;
 	m_profileInfo->m_lastProfileSeconds = profileSeconds;
 	m_profileInfo->m_totalSeconds += profileSeconds;
@@ -32,10 +32,13 @@ public:
 	ProfileSection( const std::string& profileName );
 	virtual void StartProfiling();
 	virtual void StopProfiling();
+	static void RecordSample( const std::string& profileName, double sampleSeconds );
+	static const ProfileSectionInfo* FindProfileInfo( const std::string& profileName );
 	static void RenderProfileInfo( const Vector2& windowDimensions );
 
 protected:
 	ProfileSection() {}
+	static ProfileSectionInfo* FindOrCreateProfileInfo( const std::string& profileName );
 
 	static std::map< std::string, ProfileSectionInfo* >	s_profileSections;
 
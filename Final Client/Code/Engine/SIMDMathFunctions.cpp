@@ -0,0 +1,121 @@
+#include "SIMDMathFunctions.hpp"
+#ifdef SIMD_MATH_HAS_SSE
+#include <xmmintrin.h>
+#endif
+#ifdef SIMD_MATH_HAS_AVX
+#include <immintrin.h>
+#endif
+#include "NewMacroDef.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+// Targeting FMA (-march=native) lets gcc and clang fuse a multiply and an add into one rounding,
+// and they do it in some kernels and not others, so masks near the edge of a circle disagree.
+// Contraction is off for the whole file to keep every version rounding each operation separately.
+#if defined( _MSC_VER )
+#pragma fp_contract( off )
+#elif defined( __clang__ )
+#pragma STDC FP_CONTRACT OFF
+#elif defined( __GNUC__ )
+#pragma GCC optimize( "fp-contract=off" )
+#endif
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int GetRayCircleHitMask( const float* xCenters, const float* yCenters, int numCircles, const Vector2& rayOrigin, const Vector2& rayDirection, float radius )
+{
+#if defined( SIMD_MATH_HAS_AVX )
+	return GetRayCircleHitMaskAVX( xCenters, yCenters, numCircles, rayOrigin, rayDirection, radius );
+#elif defined( SIMD_MATH_HAS_SSE )
+	return GetRayCircleHitMaskSSE( xCenters, yCenters, numCircles, rayOrigin, rayDirection, radius );
+#else
+	return GetRayCircleHitMaskScalar( xCenters, yCenters, numCircles, rayOrigin, rayDirection, radius );
+#endif
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// The distance from the circle's centre to the line, squared, is what is left of the squared
+// distance to the centre once the part along the ray is taken out. Centres behind the origin
+// only count if the origin is inside the circle.
+unsigned int GetRayCircleHitMaskScalar( const float* xCenters, const float* yCenters, int numCircles, const Vector2& rayOrigin, const Vector2& rayDirection, float radius )
+{
+	float squaredRadius = radius * radius;
+	unsigned int hitMask = 0;
+	for( int circleIndex = 0; circleIndex < numCircles; ++circleIndex )
+	{
+		float toCenterX = xCenters[ circleIndex ] - rayOrigin.x;
+		float toCenterY = yCenters[ circleIndex ] - rayOrigin.y;
+		float squaredDistanceToCenter = ( toCenterX * toCenterX ) + ( toCenterY * toCenterY );
+		float distanceAlongRay = ( toCenterX * rayDirection.x ) + ( toCenterY * rayDirection.y );
+		float squaredDistanceFromRay = squaredDistanceToCenter - ( distanceAlongRay * distanceAlongRay );
+
+		if( squaredDistanceToCenter <= squaredRadius || ( distanceAlongRay >= 0.f && squaredDistanceFromRay <= squaredRadius ) )
+			hitMask |= 1u << circleIndex;
+	}
+
+	return hitMask;
+}
+
+
+#ifdef SIMD_MATH_HAS_SSE
+//-----------------------------------------------------------------------------------------------
+// Four circles per iteration, with the same operations in the same order as the scalar version,
+// so with contraction off the masks match it bit for bit.
+unsigned int GetRayCircleHitMaskSSE( const float* xCenters, const float* yCenters, int numCircles, const Vector2& rayOrigin, const Vector2& rayDirection, float radius )
+{
+	__m128 originX = _mm_set1_ps( rayOrigin.x );
+	__m128 originY = _mm_set1_ps( rayOrigin.y );
+	__m128 directionX = _mm_set1_ps( rayDirection.x );
+	__m128 directionY = _mm_set1_ps( rayDirection.y );
+	__m128 squaredRadius = _mm_set1_ps( radius * radius );
+	__m128 zero = _mm_setzero_ps();
+
+	unsigned int hitMask = 0;
+	for( int circleIndex = 0; circleIndex < numCircles; circleIndex += 4 )
+	{
+		__m128 toCenterX = _mm_sub_ps( _mm_loadu_ps( xCenters + circleIndex ), originX );
+		__m128 toCenterY = _mm_sub_ps( _mm_loadu_ps( yCenters + circleIndex ), originY );
+		__m128 squaredDistanceToCenter = _mm_add_ps( _mm_mul_ps( toCenterX, toCenterX ), _mm_mul_ps( toCenterY, toCenterY ) );
+		__m128 distanceAlongRay = _mm_add_ps( _mm_mul_ps( toCenterX, directionX ), _mm_mul_ps( toCenterY, directionY ) );
+		__m128 squaredDistanceFromRay = _mm_sub_ps( squaredDistanceToCenter, _mm_mul_ps( distanceAlongRay, distanceAlongRay ) );
+
+		__m128 isInside = _mm_cmple_ps( squaredDistanceToCenter, squaredRadius );
+		__m128 isAheadAndNear = _mm_and_ps( _mm_cmpge_ps( distanceAlongRay, zero ), _mm_cmple_ps( squaredDistanceFromRay, squaredRadius ) );
+		hitMask |= (unsigned int) _mm_movemask_ps( _mm_or_ps( isInside, isAheadAndNear ) ) << circleIndex;
+	}
+
+	return hitMask;
+}
+#endif
+
+
+#ifdef SIMD_MATH_HAS_AVX
+//-----------------------------------------------------------------------------------------------
+// Eight circles per iteration. The ordered, non-signalling compares match the scalar ones.
+unsigned int GetRayCircleHitMaskAVX( const float* xCenters, const float* yCenters, int numCircles, const Vector2& rayOrigin, const Vector2& rayDirection, float radius )
+{
+	__m256 originX = _mm256_set1_ps( rayOrigin.x );
+	__m256 originY = _mm256_set1_ps( rayOrigin.y );
+	__m256 directionX = _mm256_set1_ps( rayDirection.x );
+	__m256 directionY = _mm256_set1_ps( rayDirection.y );
+	__m256 squaredRadius = _mm256_set1_ps( radius * radius );
+	__m256 zero = _mm256_setzero_ps();
+
+	unsigned int hitMask = 0;
+	for( int circleIndex = 0; circleIndex < numCircles; circleIndex += 8 )
+	{
+		__m256 toCenterX = _mm256_sub_ps( _mm256_loadu_ps( xCenters + circleIndex ), originX );
+		__m256 toCenterY = _mm256_sub_ps( _mm256_loadu_ps( yCenters + circleIndex ), originY );
+		__m256 squaredDistanceToCenter = _mm256_add_ps( _mm256_mul_ps( toCenterX, toCenterX ), _mm256_mul_ps( toCenterY, toCenterY ) );
+		__m256 distanceAlongRay = _mm256_add_ps( _mm256_mul_ps( toCenterX, directionX ), _mm256_mul_ps( toCenterY, directionY ) );
+		__m256 squaredDistanceFromRay = _mm256_sub_ps( squaredDistanceToCenter, _mm256_mul_ps( distanceAlongRay, distanceAlongRay ) );
+
+		__m256 isInside = _mm256_cmp_ps( squaredDistanceToCenter, squaredRadius, _CMP_LE_OQ );
+		__m256 isAheadAndNear = _mm256_and_ps( _mm256_cmp_ps( distanceAlongRay, zero, _CMP_GE_OQ ), _mm256_cmp_ps( squaredDistanceFromRay, squaredRadius, _CMP_LE_OQ ) );
+		hitMask |= (unsigned int) _mm256_movemask_ps( _mm256_or_ps( isInside, isAheadAndNear ) ) << circleIndex;
+	}
+
+	return hitMask;
+}
+#endif
\ No newline at end of file
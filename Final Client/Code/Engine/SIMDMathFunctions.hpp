@@ -0,0 +1,41 @@
+#ifndef include_SIMDMathFunctions
+#define include_SIMDMathFunctions
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include "Vector2.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+// SSE is there on every x86 target MSVC builds for; gcc and clang say when it is. AVX is only
+// used when the whole build targets it (/arch:AVX, -mavx, -march=native), since a CPU without it
+// faults on the first instruction.
+#if defined( _M_IX86 ) || defined( _M_X64 ) || defined( __SSE__ )
+#define SIMD_MATH_HAS_SSE
+#endif
+
+#if defined( __AVX__ )
+#define SIMD_MATH_HAS_AVX
+#endif
+
+const int RAY_CIRCLE_BATCH_SIZE = 8;
+const int RAY_CIRCLE_MAX_CIRCLES = 32;
+
+
+//-----------------------------------------------------------------------------------------------
+// One ray against many circles of the same radius, laid out structure-of-arrays: x of every centre,
+// then y of every centre. Bit n of the result is set if the infinite ray from rayOrigin along
+// rayDirection (unit length) touches circle n, or starts inside it. numCircles must be a multiple of
+// RAY_CIRCLE_BATCH_SIZE, no more than RAY_CIRCLE_MAX_CIRCLES; the arrays need no alignment.
+// The versions give identical masks; GetRayCircleHitMask picks the widest the build targets.
+unsigned int GetRayCircleHitMask( const float* xCenters, const float* yCenters, int numCircles, const Vector2& rayOrigin, const Vector2& rayDirection, float radius );
+unsigned int GetRayCircleHitMaskScalar( const float* xCenters, const float* yCenters, int numCircles, const Vector2& rayOrigin, const Vector2& rayDirection, float radius );
+#ifdef SIMD_MATH_HAS_SSE
+unsigned int GetRayCircleHitMaskSSE( const float* xCenters, const float* yCenters, int numCircles, const Vector2& rayOrigin, const Vector2& rayDirection, float radius );
+#endif
+#ifdef SIMD_MATH_HAS_AVX
+unsigned int GetRayCircleHitMaskAVX( const float* xCenters, const float* yCenters, int numCircles, const Vector2& rayOrigin, const Vector2& rayDirection, float radius );
+#endif
+
+
+#endif // include_SIMDMathFunctions
\ No newline at end of file
@@ -0,0 +1,149 @@
+#ifndef include_SPSCQueue
+#define include_SPSCQueue
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include "Threading.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+const int SPSC_CACHE_LINE_SIZE_BYTES = 64;
+
+
+//-----------------------------------------------------------------------------------------------
+// Lock-free ring between exactly one producer thread and one consumer thread. CAPACITY must be a
+// power of two. Each side owns one count and only reads the other's, so a push is a slot write and
+// a release store, and a pop is an acquire load and a slot read. A side reads its own count plainly,
+// as no other thread writes it. Slots are reached in place through Get*Slot / Commit*, so batched
+// socket calls can fill or drain them without a copy. The indices sit on separate cache lines so
+// the two threads do not contend for one.
+template< typename T, unsigned int CAPACITY >
+class SPSCQueue
+{
+public:
+	SPSCQueue();
+	~SPSCQueue();
+
+	// Producer thread only
+	unsigned int GetNumFreeSlots() const;
+	T& GetWriteSlot( unsigned int offset );
+	void CommitWrites( unsigned int numWritten );
+	bool TryPush( const T& item );
+
+	// Consumer thread only
+	unsigned int GetNumReadableSlots() const;
+	T& GetReadSlot( unsigned int offset );
+	void CommitReads( unsigned int numRead );
+	bool TryPop( T& out_item );
+
+private:
+	SPSCQueue( const SPSCQueue& );
+	SPSCQueue& operator=( const SPSCQueue& );
+
+	T*				m_slots;
+	volatile int	m_writeCount;
+	char			m_writeCountPadding[ SPSC_CACHE_LINE_SIZE_BYTES ];
+	volatile int	m_readCount;
+	char			m_readCountPadding[ SPSC_CACHE_LINE_SIZE_BYTES ];
+};
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T, unsigned int CAPACITY >
+inline SPSCQueue< T, CAPACITY >::SPSCQueue()
+	: m_slots( new T[ CAPACITY ] )
+	, m_writeCount( 0 )
+	, m_readCount( 0 )
+{
+	static_assert( CAPACITY > 0 && ( CAPACITY & ( CAPACITY - 1 ) ) == 0, "SPSCQueue capacity must be a power of two" );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T, unsigned int CAPACITY >
+inline SPSCQueue< T, CAPACITY >::~SPSCQueue()
+{
+	delete[] m_slots;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// The counts run freely and wrap; their unsigned difference is still the number of items held.
+template< typename T, unsigned int CAPACITY >
+inline unsigned int SPSCQueue< T, CAPACITY >::GetNumFreeSlots() const
+{
+	unsigned int writeCount = (unsigned int) m_writeCount;
+	unsigned int readCount = (unsigned int) AtomicLoad( m_readCount );
+	return CAPACITY - ( writeCount - readCount );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T, unsigned int CAPACITY >
+inline T& SPSCQueue< T, CAPACITY >::GetWriteSlot( unsigned int offset )
+{
+	return m_slots[ ( (unsigned int) m_writeCount + offset ) & ( CAPACITY - 1 ) ];
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T, unsigned int CAPACITY >
+inline void SPSCQueue< T, CAPACITY >::CommitWrites( unsigned int numWritten )
+{
+	AtomicStore( m_writeCount, (int) ( (unsigned int) m_writeCount + numWritten ) );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T, unsigned int CAPACITY >
+inline bool SPSCQueue< T, CAPACITY >::TryPush( const T& item )
+{
+	if( GetNumFreeSlots() == 0 )
+		return false;
+
+	GetWriteSlot( 0 ) = item;
+	CommitWrites( 1 );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T, unsigned int CAPACITY >
+inline unsigned int SPSCQueue< T, CAPACITY >::GetNumReadableSlots() const
+{
+	unsigned int readCount = (unsigned int) m_readCount;
+	unsigned int writeCount = (unsigned int) AtomicLoad( m_writeCount );
+	return writeCount - readCount;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T, unsigned int CAPACITY >
+inline T& SPSCQueue< T, CAPACITY >::GetReadSlot( unsigned int offset )
+{
+	return m_slots[ ( (unsigned int) m_readCount + offset ) & ( CAPACITY - 1 ) ];
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T, unsigned int CAPACITY >
+inline void SPSCQueue< T, CAPACITY >::CommitReads( unsigned int numRead )
+{
+	AtomicStore( m_readCount, (int) ( (unsigned int) m_readCount + numRead ) );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T, unsigned int CAPACITY >
+inline bool SPSCQueue< T, CAPACITY >::TryPop( T& out_item )
+{
+	if( GetNumReadableSlots() == 0 )
+		return false;
+
+	out_item = GetReadSlot( 0 );
+	CommitReads( 1 );
+	return true;
+}
+
+
+#endif // include_SPSCQueue
\ No newline at end of file
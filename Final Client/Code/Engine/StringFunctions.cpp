@@ -46,35 +46,45 @@ std::string GetUppercaseString( const std::string& str )
 //-----------------------------------------------------------------------------------------------
 std::string ConvertNumberToString( int number )
 {
-	return static_cast< std::ostringstream* >( &( std::ostringstream() << number ) )->str();
+	std::ostringstream stringStream;
+	stringStream << number;
+	return stringStream.str();
 }
 
 
 //-----------------------------------------------------------------------------------------------
 std::string ConvertNumberToString( size_t number )
 {
-	return static_cast< std::ostringstream* >( &( std::ostringstream() << number ) )->str();
+	std::ostringstream stringStream;
+	stringStream << number;
+	return stringStream.str();
 }
 
 
 //-----------------------------------------------------------------------------------------------
 std::string ConvertNumberToString( float number )
 {
-	return static_cast< std::ostringstream* >( &( std::ostringstream() << number ) )->str();
+	std::ostringstream stringStream;
+	stringStream << number;
+	return stringStream.str();
 }
 
 
 //-----------------------------------------------------------------------------------------------
 std::string ConvertNumberToString( double number )
 {
-	return static_cast< std::ostringstream* >( &( std::ostringstream() << number ) )->str();
+	std::ostringstream stringStream;
+	stringStream << number;
+	return stringStream.str();
 }
 
 
 //-----------------------------------------------------------------------------------------------
 std::string ConvertAddressToString( void* ptr )
 {
-	return  "0x" + static_cast< std::ostringstream* >( &( std::ostringstream() << ptr ) )->str();
+	std::ostringstream stringStream;
+	stringStream << ptr;
+	return "0x" + stringStream.str();
 }
 
 
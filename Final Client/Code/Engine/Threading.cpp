@@ -0,0 +1,276 @@
+#include "Threading.hpp"
+#include <math.h>
+#if defined( _WIN32 )
+#include <process.h>
+#else
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#endif
+#include "NewMacroDef.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+Thread::Thread()
+	: m_entryFunc( nullptr )
+	, m_data( nullptr )
+	, m_isRunning( false )
+{
+
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// A thread still running when its object goes away is joined rather than left pointing at freed memory.
+Thread::~Thread()
+{
+	Join();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool Thread::Start( ThreadEntryFunc entryFunc, void* data )
+{
+	if( m_isRunning )
+		return false;
+
+	m_entryFunc = entryFunc;
+	m_data = data;
+
+#if defined( _WIN32 )
+	m_handle = (HANDLE) _beginthreadex( nullptr, 0, ThreadEntryTrampoline, this, 0, nullptr );
+	m_isRunning = ( m_handle != 0 );
+#else
+	m_isRunning = ( pthread_create( &m_handle, nullptr, ThreadEntryTrampoline, this ) == 0 );
+#endif
+	return m_isRunning;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void Thread::Join()
+{
+	if( !m_isRunning )
+		return;
+
+#if defined( _WIN32 )
+	WaitForSingleObject( m_handle, INFINITE );
+	CloseHandle( m_handle );
+#else
+	pthread_join( m_handle, nullptr );
+#endif
+	m_isRunning = false;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool Thread::IsRunning() const
+{
+	return m_isRunning;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+#if defined( _WIN32 )
+STATIC unsigned int __stdcall Thread::ThreadEntryTrampoline( void* thread )
+{
+	Thread* startedThread = static_cast< Thread* >( thread );
+	startedThread->m_entryFunc( startedThread->m_data );
+	return 0;
+}
+#else
+void* Thread::ThreadEntryTrampoline( void* thread )
+{
+	Thread* startedThread = static_cast< Thread* >( thread );
+	startedThread->m_entryFunc( startedThread->m_data );
+	return nullptr;
+}
+#endif
+
+
+//-----------------------------------------------------------------------------------------------
+CriticalSection::CriticalSection()
+{
+#if defined( _WIN32 )
+	InitializeCriticalSection( &m_criticalSection );
+#else
+	pthread_mutex_init( &m_mutex, nullptr );
+#endif
+}
+
+
+//-----------------------------------------------------------------------------------------------
+CriticalSection::~CriticalSection()
+{
+#if defined( _WIN32 )
+	DeleteCriticalSection( &m_criticalSection );
+#else
+	pthread_mutex_destroy( &m_mutex );
+#endif
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void CriticalSection::Enter()
+{
+#if defined( _WIN32 )
+	EnterCriticalSection( &m_criticalSection );
+#else
+	pthread_mutex_lock( &m_mutex );
+#endif
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void CriticalSection::Leave()
+{
+#if defined( _WIN32 )
+	LeaveCriticalSection( &m_criticalSection );
+#else
+	pthread_mutex_unlock( &m_mutex );
+#endif
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// The pthread version waits on the monotonic clock, so a wall clock change cannot stretch a wait.
+WakeEvent::WakeEvent()
+{
+#if defined( _WIN32 )
+	m_event = CreateEvent( nullptr, FALSE, FALSE, nullptr );
+#else
+	pthread_condattr_t conditionAttributes;
+	pthread_condattr_init( &conditionAttributes );
+	pthread_condattr_setclock( &conditionAttributes, CLOCK_MONOTONIC );
+	pthread_cond_init( &m_condition, &conditionAttributes );
+	pthread_condattr_destroy( &conditionAttributes );
+	pthread_mutex_init( &m_mutex, nullptr );
+	m_isSignaled = false;
+#endif
+}
+
+
+//-----------------------------------------------------------------------------------------------
+WakeEvent::~WakeEvent()
+{
+#if defined( _WIN32 )
+	CloseHandle( m_event );
+#else
+	pthread_cond_destroy( &m_condition );
+	pthread_mutex_destroy( &m_mutex );
+#endif
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void WakeEvent::Signal()
+{
+#if defined( _WIN32 )
+	SetEvent( m_event );
+#else
+	pthread_mutex_lock( &m_mutex );
+	m_isSignaled = true;
+	pthread_cond_signal( &m_condition );
+	pthread_mutex_unlock( &m_mutex );
+#endif
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Returns true if woken by Signal, false if maxSeconds ran out first.
+bool WakeEvent::Wait( double maxSeconds )
+{
+	if( maxSeconds < 0.0 )
+		maxSeconds = 0.0;
+
+#if defined( _WIN32 )
+	return WaitForSingleObject( m_event, (DWORD) ceil( maxSeconds * 1000.0 ) ) == WAIT_OBJECT_0;
+#else
+	struct timespec deadline;
+	clock_gettime( CLOCK_MONOTONIC, &deadline );
+	double wholeSeconds = floor( maxSeconds );
+	deadline.tv_sec += (time_t) wholeSeconds;
+	deadline.tv_nsec += (long) ( ( maxSeconds - wholeSeconds ) * 1000000000.0 );
+	if( deadline.tv_nsec >= 1000000000L )
+	{
+		deadline.tv_nsec -= 1000000000L;
+		++deadline.tv_sec;
+	}
+
+	pthread_mutex_lock( &m_mutex );
+	while( !m_isSignaled )
+	{
+		if( pthread_cond_timedwait( &m_condition, &m_mutex, &deadline ) == ETIMEDOUT )
+			break;
+	}
+
+	bool wasSignaled = m_isSignaled;
+	m_isSignaled = false;
+	pthread_mutex_unlock( &m_mutex );
+	return wasSignaled;
+#endif
+}
+
+
+//-----------------------------------------------------------------------------------------------
+int AtomicLoad( const volatile int& value )
+{
+#if defined( _WIN32 )
+	return (int) InterlockedCompareExchange( (volatile LONG*) &value, 0, 0 );
+#else
+	return __atomic_load_n( &value, __ATOMIC_ACQUIRE );
+#endif
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void AtomicStore( volatile int& value, int newValue )
+{
+#if defined( _WIN32 )
+	InterlockedExchange( (volatile LONG*) &value, newValue );
+#else
+	__atomic_store_n( &value, newValue, __ATOMIC_RELEASE );
+#endif
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Returns the value after the add.
+int AtomicAdd( volatile int& value, int amount )
+{
+#if defined( _WIN32 )
+	return (int) InterlockedExchangeAdd( (volatile LONG*) &value, amount ) + amount;
+#else
+	return __atomic_add_fetch( &value, amount, __ATOMIC_SEQ_CST );
+#endif
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Zero gives up the rest of the time slice.
+void SleepThread( double seconds )
+{
+#if defined( _WIN32 )
+	Sleep( (DWORD) ( seconds * 1000.0 ) );
+#else
+	struct timespec duration;
+	duration.tv_sec = (time_t) seconds;
+	duration.tv_nsec = (long) ( ( seconds - (double) duration.tv_sec ) * 1000000000.0 );
+	nanosleep( &duration, nullptr );
+#endif
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Never less than one, even where the count cannot be read.
+int GetNumHardwareThreads()
+{
+#if defined( _WIN32 )
+	SYSTEM_INFO systemInfo;
+	GetSystemInfo( &systemInfo );
+	int numHardwareThreads = (int) systemInfo.dwNumberOfProcessors;
+#else
+	int numHardwareThreads = (int) sysconf( _SC_NPROCESSORS_ONLN );
+#endif
+	return ( numHardwareThreads > 0 ) ? numHardwareThreads : 1;
+}
\ No newline at end of file
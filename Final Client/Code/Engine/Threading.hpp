@@ -0,0 +1,105 @@
+#ifndef include_Threading
+#define include_Threading
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#if defined( _WIN32 )
+#include "EngineCommon.hpp"
+#else
+#include <pthread.h>
+#endif
+
+
+//-----------------------------------------------------------------------------------------------
+// The toolset the client is built with has no <thread>, <mutex> or <atomic>, so code shared with
+// the Linux server threads through these instead: _beginthreadex, critical sections, events and
+// Interlocked* on Win32; pthreads and gcc's __atomic builtins elsewhere.
+// Entry functions have the same shape as the job system's worker entry functions.
+typedef void ( *ThreadEntryFunc )( void* data );
+
+
+//-----------------------------------------------------------------------------------------------
+// A joinable thread. The object must stay put while the thread runs, as the thread reads its
+// entry function and data from it.
+class Thread
+{
+public:
+	Thread();
+	~Thread();
+	bool Start( ThreadEntryFunc entryFunc, void* data );
+	void Join();
+	bool IsRunning() const;
+
+private:
+	Thread( const Thread& );
+	void operator=( const Thread& );
+
+#if defined( _WIN32 )
+	static unsigned int __stdcall ThreadEntryTrampoline( void* thread );
+	HANDLE				m_handle;
+#else
+	static void* ThreadEntryTrampoline( void* thread );
+	pthread_t			m_handle;
+#endif
+	ThreadEntryFunc		m_entryFunc;
+	void*				m_data;
+	bool				m_isRunning;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+class CriticalSection
+{
+public:
+	CriticalSection();
+	~CriticalSection();
+	void Enter();
+	void Leave();
+
+private:
+	CriticalSection( const CriticalSection& );
+	void operator=( const CriticalSection& );
+
+#if defined( _WIN32 )
+	CRITICAL_SECTION	m_criticalSection;
+#else
+	pthread_mutex_t		m_mutex;
+#endif
+};
+
+
+//-----------------------------------------------------------------------------------------------
+// Auto-reset: a Signal with nobody waiting is kept until the next Wait, so a waiter that checks its
+// condition and then waits can never miss the wake-up.
+class WakeEvent
+{
+public:
+	WakeEvent();
+	~WakeEvent();
+	void Signal();
+	bool Wait( double maxSeconds );
+
+private:
+	WakeEvent( const WakeEvent& );
+	void operator=( const WakeEvent& );
+
+#if defined( _WIN32 )
+	HANDLE				m_event;
+#else
+	pthread_mutex_t		m_mutex;
+	pthread_cond_t		m_condition;
+	bool				m_isSignaled;
+#endif
+};
+
+
+//-----------------------------------------------------------------------------------------------
+// Loads acquire, stores release and adds are full barriers.
+int AtomicLoad( const volatile int& value );
+void AtomicStore( volatile int& value, int newValue );
+int AtomicAdd( volatile int& value, int amount );
+void SleepThread( double seconds );
+int GetNumHardwareThreads();
+
+
+#endif // include_Threading
\ No newline at end of file
@@ -1,11 +1,17 @@
 #include <assert.h>
 #include "Time.hpp"
+#if defined( _WIN32 )
 #include "EngineCommon.hpp"
+#else
+#include <time.h>
+#endif
 #include "NewMacroDef.hpp"
 
 
 //-----------------------------------------------------------------------------------------------
 static double g_secondsPerCount = 0.0;
+static bool g_isUsingVirtualTime = false;
+static double g_virtualTimeSeconds = 0.0;
 
 
 //-----------------------------------------------------------------------------------------------
@@ -13,21 +19,61 @@ void InitializeTime()
 {
 	if( g_secondsPerCount == 0.0 )
 	{
+#if defined( _WIN32 )
 		LARGE_INTEGER countsPerSecond;
 		QueryPerformanceFrequency( &countsPerSecond );
 		g_secondsPerCount = 1.0 / static_cast< double >( countsPerSecond.QuadPart );
+#else
+		g_secondsPerCount = 1.0 / 1000000000.0;
+#endif
 	}
 }
 
 
 //-----------------------------------------------------------------------------------------------
+// Game time. Replays pin it to the recorded frame times, so everything timed against it (timeouts,
+// resends, dead reckoning) plays out as recorded no matter how fast the replay runs.
 double GetCurrentTimeSeconds()
+{
+	if( g_isUsingVirtualTime )
+		return g_virtualTimeSeconds;
+
+	return GetWallClockTimeSeconds();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Always the real clock, for measuring how long code takes.
+double GetWallClockTimeSeconds()
 {
 	assert( g_secondsPerCount != 0.0 );
 
+#if defined( _WIN32 )
 	LARGE_INTEGER performanceCount;
 	QueryPerformanceCounter(  &performanceCount );
 
 	double currentSeconds = static_cast< double >( performanceCount.QuadPart ) * g_secondsPerCount;
+#else
+	struct timespec monotonicTime;
+	clock_gettime( CLOCK_MONOTONIC, &monotonicTime );
+
+	double currentSeconds = static_cast< double >( monotonicTime.tv_sec ) + ( static_cast< double >( monotonicTime.tv_nsec ) * g_secondsPerCount );
+#endif
 	return currentSeconds;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Not synchronized: only set virtual time while a single thread is reading the clock.
+void SetVirtualTimeSeconds( double virtualTimeSeconds )
+{
+	g_virtualTimeSeconds = virtualTimeSeconds;
+	g_isUsingVirtualTime = true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void ClearVirtualTime()
+{
+	g_isUsingVirtualTime = false;
 }
\ No newline at end of file
@@ -5,6 +5,9 @@
 //-----------------------------------------------------------------------------------------------
 void InitializeTime();
 double GetCurrentTimeSeconds();
+double GetWallClockTimeSeconds();
+void SetVirtualTimeSeconds( double virtualTimeSeconds );
+void ClearVirtualTime();
 
 
 #endif // include_Time
\ No newline at end of file
@@ -0,0 +1,242 @@
+#include "BotLauncher.hpp"
+#include <algorithm>
+#include "World.hpp"
+#include "TankInput.hpp"
+#include "RoomServer.hpp"
+#include "../Engine/Time.hpp"
+#include "../Engine/Threading.hpp"
+#include "../Engine/StringFunctions.hpp"
+#include "../Engine/NewMacroDef.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+struct Bot
+{
+	World*			m_world;
+	BotTankInput*	m_input;
+	bool			m_hasEnteredGame;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+// One bot thread's share of the bots, and what it reports back.
+struct BotThreadJob
+{
+	Bot*			m_bots;
+	int				m_numBots;
+	double			m_endTimeSeconds;
+	int				m_numFrames;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+BotLaunchSettings::BotLaunchSettings()
+	: m_numBots( DEFAULT_NUM_BOTS )
+	, m_numThreads( DEFAULT_NUM_BOT_THREADS )
+	, m_runSeconds( DEFAULT_BOT_RUN_SECONDS )
+	, m_serverIPAddress( IP_ADDRESS )
+	, m_serverPortNumber( DEFAULT_SERVER_PORT_NUMBER )
+	, m_useNetworkThreads( false )
+{
+
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Steps every bot once per frame until the run ends. A thread with more bots than it can step in
+// BOT_SECONDS_PER_FRAME just falls behind, which the frame count in the summary shows.
+static void StepBots( void* data )
+{
+	BotThreadJob& job = *static_cast< BotThreadJob* >( data );
+	int numFrames = 0;
+	double timeOfLastFrame = GetCurrentTimeSeconds();
+	while( true )
+	{
+		double frameStartTime = GetCurrentTimeSeconds();
+		if( frameStartTime >= job.m_endTimeSeconds )
+			break;
+
+		float deltaSeconds = (float) ( frameStartTime - timeOfLastFrame );
+		timeOfLastFrame = frameStartTime;
+
+		for( int botIndex = 0; botIndex < job.m_numBots; ++botIndex )
+		{
+			Bot& bot = job.m_bots[ botIndex ];
+			bot.m_world->Update( deltaSeconds, *bot.m_input );
+			if( bot.m_world->IsInGame() )
+				bot.m_hasEnteredGame = true;
+		}
+
+		++numFrames;
+
+		double secondsUntilNextFrame = frameStartTime + BOT_SECONDS_PER_FRAME - GetCurrentTimeSeconds();
+		if( secondsUntilNextFrame > 0.0 )
+			SleepThread( secondsUntilNextFrame );
+	}
+
+	job.m_numFrames = numFrames;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Server packet numbers are consecutive per connection, so numbers we never saw were lost.
+static double GetIncomingLossPercentage( const WorldTrafficStats& stats )
+{
+	if( !stats.m_hasReceivedAnyPacket )
+		return 0.0;
+
+	int numPacketsSent = (int) (PacketNumber) ( stats.m_newestReceivedNumber - stats.m_firstReceivedNumber ) + 1;
+	if( stats.m_numPacketsReceived >= numPacketsSent )
+		return 0.0;
+
+	return 100.0 * ( numPacketsSent - stats.m_numPacketsReceived ) / numPacketsSent;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static double GetPercentile( const std::vector< double >& sortedValues, double percentile )
+{
+	if( sortedValues.empty() )
+		return 0.0;
+
+	unsigned int index = (unsigned int) ( percentile * ( sortedValues.size() - 1 ) + 0.5 );
+	return sortedValues[ index ];
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Worlds are created and destroyed on this thread: their lobby buttons join the global widget list.
+void RunBots( const BotLaunchSettings& settings, std::vector< std::string >& out_resultLines )
+{
+	int numBots = settings.m_numBots > 0 ? settings.m_numBots : 1;
+	int numThreads = settings.m_numThreads > 0 ? settings.m_numThreads : 1;
+	if( numThreads > numBots )
+		numThreads = numBots;
+
+	Bot* bots = new Bot[ numBots ];
+	for( int botIndex = 0; botIndex < numBots; ++botIndex )
+	{
+		Bot& bot = bots[ botIndex ];
+		bot.m_world = new World( ARENA_FLOOR_SIZE_X, ARENA_FLOOR_SIZE_Y, true );
+		bot.m_world->SetCompactWireFormat( true );
+		bot.m_world->Initialize();
+
+		// Initialize only queues the lobby Join, so retargeting here still sends it to our server
+		bot.m_world->ChangeIPAddress( settings.m_serverIPAddress );
+		bot.m_world->ChangePortNumber( settings.m_serverPortNumber );
+
+		// Started only once retargeted, as the thread sends to the server address
+		if( settings.m_useNetworkThreads )
+			bot.m_world->GetClient().StartNetworkThread();
+
+		bot.m_input = new BotTankInput( 0x9E3779B9u * ( botIndex + 1 ) );
+		bot.m_hasEnteredGame = false;
+	}
+
+	double startTime = GetCurrentTimeSeconds();
+	double endTime = startTime + settings.m_runSeconds;
+	Thread* botThreads = new Thread[ numThreads ];
+	std::vector< BotThreadJob > botThreadJobs( numThreads );
+	int firstBotIndex = 0;
+	for( int threadIndex = 0; threadIndex < numThreads; ++threadIndex )
+	{
+		BotThreadJob& job = botThreadJobs[ threadIndex ];
+		job.m_bots = &bots[ firstBotIndex ];
+		job.m_numBots = numBots / numThreads + ( threadIndex < numBots % numThreads ? 1 : 0 );
+		job.m_endTimeSeconds = endTime;
+		job.m_numFrames = 0;
+		firstBotIndex += job.m_numBots;
+
+		botThreads[ threadIndex ].Start( StepBots, &job );
+	}
+
+	for( int threadIndex = 0; threadIndex < numThreads; ++threadIndex )
+	{
+		botThreads[ threadIndex ].Join();
+	}
+
+	delete[] botThreads;
+
+	double elapsedSeconds = GetCurrentTimeSeconds() - startTime;
+
+	std::vector< double > roundTripMilliseconds;
+	int numConnectedBots = 0;
+	int numBotsThatPlayed = 0;
+	long long numGuaranteedPacketsSent = 0;
+	long long numRetransmissions = 0;
+	int numReliabilityWindowOverflows = 0;
+	double totalIncomingLossPercentage = 0.0;
+	WorldTrafficStats totalStats;
+	for( int botIndex = 0; botIndex < numBots; ++botIndex )
+	{
+		const Bot& bot = bots[ botIndex ];
+		const RoundTripEstimator& roundTrip = bot.m_world->GetRoundTripEstimator();
+		const WorldTrafficStats& stats = bot.m_world->GetTrafficStats();
+		double incomingLossPercentage = GetIncomingLossPercentage( stats );
+
+		out_resultLines.push_back( "bot " + ConvertNumberToString( botIndex ) + ": " + ( bot.m_hasEnteredGame ? "played" : "lobby only" )
+			+ ", rtt " + ConvertNumberToString( roundTrip.GetSmoothedRoundTripSeconds() * 1000.0 ) + " ms (+/- " + ConvertNumberToString( roundTrip.GetRoundTripVarianceSeconds() * 1000.0 )
+			+ ", " + ConvertNumberToString( roundTrip.GetNumSamples() ) + " samples), " + ConvertNumberToString( stats.m_numRetransmissions ) + "/"
+			+ ConvertNumberToString( stats.m_numGuaranteedPacketsSent ) + " guaranteed packets retransmitted, " + ConvertNumberToString( incomingLossPercentage ) + "% incoming loss; "
+			+ ConvertNumberToString( stats.m_numCreateRoomRequests ) + "/" + ConvertNumberToString( stats.m_numJoinRoomRequests ) + " create/join requests, "
+			+ ConvertNumberToString( stats.m_numGamesEntered ) + " games entered, " + ConvertNumberToString( stats.m_numShotsFired ) + " shots, "
+			+ ConvertNumberToString( stats.m_numHitsLanded ) + " hits landed, " + ConvertNumberToString( stats.m_numHitsTaken ) + " taken, " + ConvertNumberToString( stats.m_numRespawns ) + " respawns" );
+
+		if( stats.m_hasReceivedAnyPacket )
+		{
+			++numConnectedBots;
+			totalIncomingLossPercentage += incomingLossPercentage;
+		}
+
+		if( bot.m_hasEnteredGame )
+			++numBotsThatPlayed;
+
+		if( roundTrip.GetNumSamples() > 0 )
+			roundTripMilliseconds.push_back( roundTrip.GetSmoothedRoundTripSeconds() * 1000.0 );
+
+		numGuaranteedPacketsSent += stats.m_numGuaranteedPacketsSent;
+		numRetransmissions += stats.m_numRetransmissions;
+		numReliabilityWindowOverflows += stats.m_numReliabilityWindowOverflows;
+		totalStats.m_numCreateRoomRequests += stats.m_numCreateRoomRequests;
+		totalStats.m_numJoinRoomRequests += stats.m_numJoinRoomRequests;
+		totalStats.m_numGamesEntered += stats.m_numGamesEntered;
+		totalStats.m_numShotsFired += stats.m_numShotsFired;
+		totalStats.m_numHitsLanded += stats.m_numHitsLanded;
+		totalStats.m_numHitsTaken += stats.m_numHitsTaken;
+		totalStats.m_numRespawns += stats.m_numRespawns;
+	}
+
+	std::sort( roundTripMilliseconds.begin(), roundTripMilliseconds.end() );
+
+	int totalNumFrames = 0;
+	for( int threadIndex = 0; threadIndex < numThreads; ++threadIndex )
+	{
+		totalNumFrames += botThreadJobs[ threadIndex ].m_numFrames;
+	}
+
+	out_resultLines.push_back( ConvertNumberToString( numBots ) + " bots on " + ConvertNumberToString( numThreads ) + " threads for " + ConvertNumberToString( elapsedSeconds )
+		+ " s against " + settings.m_serverIPAddress + ":" + ConvertNumberToString( (int) settings.m_serverPortNumber ) + ": " + ConvertNumberToString( numConnectedBots )
+		+ " connected, " + ConvertNumberToString( numBotsThatPlayed ) + " played; " + ConvertNumberToString( totalNumFrames / ( elapsedSeconds * numThreads ) )
+		+ " frames/s per thread (target " + ConvertNumberToString( 1.0 / BOT_SECONDS_PER_FRAME ) + ")" );
+
+	double retransmittedPercentage = numGuaranteedPacketsSent > 0 ? 100.0 * numRetransmissions / numGuaranteedPacketsSent : 0.0;
+	double meanIncomingLossPercentage = numConnectedBots > 0 ? totalIncomingLossPercentage / numConnectedBots : 0.0;
+	out_resultLines.push_back( "rtt ms: p50 " + ConvertNumberToString( GetPercentile( roundTripMilliseconds, 0.5 ) ) + ", p95 " + ConvertNumberToString( GetPercentile( roundTripMilliseconds, 0.95 ) )
+		+ ", max " + ConvertNumberToString( GetPercentile( roundTripMilliseconds, 1.0 ) ) + "; " + ConvertNumberToString( retransmittedPercentage )
+		+ "% guaranteed packets retransmitted; " + ConvertNumberToString( meanIncomingLossPercentage ) + "% mean incoming loss; "
+		+ ConvertNumberToString( numReliabilityWindowOverflows ) + " guaranteed packets sent with the reliability window full" );
+
+	out_resultLines.push_back( "game: " + ConvertNumberToString( totalStats.m_numCreateRoomRequests ) + "/" + ConvertNumberToString( totalStats.m_numJoinRoomRequests ) + " create/join requests, "
+		+ ConvertNumberToString( totalStats.m_numGamesEntered ) + " games entered, " + ConvertNumberToString( totalStats.m_numShotsFired ) + " shots, "
+		+ ConvertNumberToString( totalStats.m_numHitsLanded ) + " hits landed, " + ConvertNumberToString( totalStats.m_numHitsTaken ) + " hits taken, " + ConvertNumberToString( totalStats.m_numRespawns ) + " respawns" );
+
+	for( int botIndex = 0; botIndex < numBots; ++botIndex )
+	{
+		Bot& bot = bots[ botIndex ];
+		bot.m_world->Destruct();
+		delete bot.m_world;
+		delete bot.m_input;
+	}
+
+	delete[] bots;
+}
\ No newline at end of file
@@ -0,0 +1,46 @@
+#ifndef include_BotLauncher
+#define include_BotLauncher
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include <string>
+#include <vector>
+
+
+//-----------------------------------------------------------------------------------------------
+const int DEFAULT_NUM_BOTS = 256;
+const int DEFAULT_NUM_BOT_THREADS = 4;
+const double DEFAULT_BOT_RUN_SECONDS = 30.0;
+const double BOT_SECONDS_PER_FRAME = 1.0 / 60.0;
+const int NUM_BOT_SUMMARY_LINES = 3;
+const std::string BOT_REPORT_FILE_NAME = "BotReport.txt";
+
+
+//-----------------------------------------------------------------------------------------------
+struct BotLaunchSettings
+{
+	BotLaunchSettings();
+
+	int				m_numBots;
+	int				m_numThreads;
+	double			m_runSeconds;
+	std::string		m_serverIPAddress;
+	unsigned short	m_serverPortNumber;
+	bool			m_useNetworkThreads;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+// Runs settings.m_numBots headless Worlds driven by BotTankInput against a server, split evenly
+// across settings.m_numThreads threads that each step their bots at BOT_SECONDS_PER_FRAME, then
+// appends one line per bot (round trip, retransmissions, incoming loss, game events) followed by
+// NUM_BOT_SUMMARY_LINES summary lines.
+// A headless World takes about 400 KB, most of it its UDPClient's datagram ring and send queue, as
+// it keeps only a HEADLESS_RELIABILITY_WINDOW_CAPACITY reliability window; the allocator pool fits
+// about a thousand bots per process. With settings.m_useNetworkThreads each bot's UDPClient also
+// runs its own network thread, as the windowed client does, at two DatagramQueues (about 750 KB)
+// and a thread per bot, so that path can be load tested too.
+void RunBots( const BotLaunchSettings& settings, std::vector< std::string >& out_resultLines );
+
+
+#endif // include_BotLauncher
\ No newline at end of file
@@ -0,0 +1,171 @@
+#include "CaptureReplay.hpp"
+#include "World.hpp"
+#include "TankInput.hpp"
+#include "PacketCapture.hpp"
+#include "../Engine/Time.hpp"
+#include "../Engine/ProfileSection.hpp"
+#include "../Engine/NewMacroDef.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+// Hands World whatever input was recorded for the frame being replayed.
+class CapturedTankInput : public TankInputSource
+{
+public:
+	void SetInput( const TankInput& input ) { m_input = input; }
+	void GetTankInput( bool, const char*, float, TankInput& out_input ) { out_input = m_input; }
+
+private:
+	TankInput	m_input;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+static double GetProfileTotalSeconds( const std::string& profileName )
+{
+	const ProfileSectionInfo* profileInfo = ProfileSection::FindProfileInfo( profileName );
+	if( profileInfo == nullptr )
+		return 0.0;
+
+	return profileInfo->m_totalSeconds;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool RunCaptureReplay( const std::string& fileName, std::vector< std::string >& out_resultLines )
+{
+	InitializeTime();
+
+	PacketCaptureReader reader;
+	if( !reader.Open( fileName ) )
+	{
+		out_resultLines.push_back( "Could not read a packet capture from " + fileName );
+		return false;
+	}
+
+	SetVirtualTimeSeconds( reader.GetStartTimeSeconds() );
+
+	World* world = new World( ARENA_FLOOR_SIZE_X, ARENA_FLOOR_SIZE_Y, true );
+	world->SetProfilingEnabled( true );
+	world->GetClient().SetOffline( true );
+	world->Initialize();
+
+	double receiveSecondsBefore = GetProfileTotalSeconds( RECEIVE_PACKETS_PROFILE_NAME );
+	double deadReckoningSecondsBefore = GetProfileTotalSeconds( DEAD_RECKONING_PROFILE_NAME );
+
+	CapturedTankInput capturedInput;
+	CaptureRecord record;
+	bool hasFrame = false;
+	float frameDeltaSeconds = 0.f;
+	double frameTimeSeconds = reader.GetStartTimeSeconds();
+	int numCapturedOutgoingInFrame = 0;
+	int numFrames = 0;
+	int numIncoming = 0;
+	int numIncomingOverflowed = 0;
+	int numCapturedOutgoing = 0;
+	int numReplayedOutgoing = 0;
+	int numDivergentFrames = 0;
+	double updateSeconds = 0.0;
+
+	// A frame's records run up to the next Frame record; anything before the first one (the Join
+	// queued by Initialize) belongs to the first frame
+	while( true )
+	{
+		bool hasRecord = reader.ReadNextRecord( record );
+		if( !hasRecord || record.m_type == CAPTURE_Frame )
+		{
+			if( hasFrame )
+			{
+				SetVirtualTimeSeconds( frameTimeSeconds );
+
+				double updateStartTime = GetWallClockTimeSeconds();
+				world->Update( frameDeltaSeconds, capturedInput );
+				updateSeconds += GetWallClockTimeSeconds() - updateStartTime;
+
+				int numReplayedOutgoingInFrame = world->GetClient().GetLastFlushNumDatagrams();
+				if( numReplayedOutgoingInFrame != numCapturedOutgoingInFrame )
+					++numDivergentFrames;
+
+				numReplayedOutgoing += numReplayedOutgoingInFrame;
+				numCapturedOutgoingInFrame = 0;
+				++numFrames;
+			}
+
+			if( !hasRecord )
+				break;
+
+			hasFrame = true;
+			frameDeltaSeconds = DecodeCapturedFrame( record );
+			frameTimeSeconds = record.m_timeSeconds;
+		}
+		else if( record.m_type == CAPTURE_Incoming )
+		{
+			if( !world->GetClient().InjectReceivedDatagram( (const char*) record.m_payload, record.m_numBytes ) )
+				++numIncomingOverflowed;
+
+			++numIncoming;
+		}
+		else if( record.m_type == CAPTURE_Input )
+		{
+			TankInput input;
+			DecodeCapturedInput( record, input );
+			capturedInput.SetInput( input );
+		}
+		else if( record.m_type == CAPTURE_Outgoing )
+		{
+			++numCapturedOutgoingInFrame;
+			++numCapturedOutgoing;
+		}
+	}
+
+	double capturedSeconds = frameTimeSeconds - reader.GetStartTimeSeconds();
+	double receiveSeconds = GetProfileTotalSeconds( RECEIVE_PACKETS_PROFILE_NAME ) - receiveSecondsBefore;
+	double deadReckoningSeconds = GetProfileTotalSeconds( DEAD_RECKONING_PROFILE_NAME ) - deadReckoningSecondsBefore;
+	double framesPerSecond = ( updateSeconds > 0.0 ) ? numFrames / updateSeconds : 0.0;
+	double incomingPerSecond = ( updateSeconds > 0.0 ) ? numIncoming / updateSeconds : 0.0;
+	double microsecondsPerFrame = ( numFrames > 0 ) ? 1000000.0 / numFrames : 0.0;
+
+	out_resultLines.push_back( fileName + ": " + ConvertNumberToString( reader.GetNumBytes() ) + " bytes, " + ConvertNumberToString( numFrames ) + " frames over "
+		+ ConvertNumberToString( capturedSeconds ) + " s, " + ConvertNumberToString( numIncoming ) + " incoming / " + ConvertNumberToString( numCapturedOutgoing ) + " outgoing datagrams" );
+	out_resultLines.push_back( "World::Update: " + ConvertNumberToString( updateSeconds * 1000.0 ) + " ms total, " + ConvertNumberToString( framesPerSecond ) + " frames/s, "
+		+ ConvertNumberToString( incomingPerSecond ) + " incoming datagrams/s, " + ConvertNumberToString( updateSeconds > 0.0 ? capturedSeconds / updateSeconds : 0.0 ) + "x real time" );
+	out_resultLines.push_back( "Per frame: ReceivePackets " + ConvertNumberToString( receiveSeconds * microsecondsPerFrame ) + " us, ApplyDeadReckoning "
+		+ ConvertNumberToString( deadReckoningSeconds * microsecondsPerFrame ) + " us" );
+	out_resultLines.push_back( "Outgoing: " + ConvertNumberToString( numReplayedOutgoing ) + " datagrams replayed vs " + ConvertNumberToString( numCapturedOutgoing ) + " captured, "
+		+ ConvertNumberToString( numDivergentFrames ) + " frames differ, " + ConvertNumberToString( numIncomingOverflowed ) + " incoming datagrams overflowed the receive ring" );
+
+	const WorldTrafficStats& stats = world->GetTrafficStats();
+	out_resultLines.push_back( std::string( "Final state: " ) + ( world->IsInGame() ? "in game" : "in lobby" ) + ", " + ConvertNumberToString( stats.m_numPacketsReceived ) + " packets received, "
+		+ ConvertNumberToString( stats.m_numGuaranteedPacketsSent ) + " guaranteed sent, " + ConvertNumberToString( stats.m_numRetransmissions ) + " retransmitted, smoothed rtt "
+		+ ConvertNumberToString( world->GetRoundTripEstimator().GetSmoothedRoundTripSeconds() * 1000.0 ) + " ms" );
+
+	const PredictionErrorStats& predictionErrors = world->GetPredictionErrorStats();
+	out_resultLines.push_back( "Prediction error: avg " + ConvertNumberToString( predictionErrors.GetAverageError() ) + " max " + ConvertNumberToString( predictionErrors.m_maxError )
+		+ " units over " + ConvertNumberToString( predictionErrors.m_numSamples ) + " remote tank updates" );
+
+	std::vector< TankPositionError > positionErrors;
+	world->GetTankPositionErrors( positionErrors );
+	float totalCorrectionDistance = 0.f;
+	float accumulatedErrorUnitSeconds = 0.f;
+	for( unsigned int tankIndex = 0; tankIndex < positionErrors.size(); ++tankIndex )
+	{
+		totalCorrectionDistance += positionErrors[ tankIndex ].m_totalCorrectionDistance;
+		accumulatedErrorUnitSeconds += positionErrors[ tankIndex ].m_accumulatedErrorUnitSeconds;
+	}
+
+	out_resultLines.push_back( "Remote tanks still in game: " + ConvertNumberToString( (int) positionErrors.size() ) + ", " + ConvertNumberToString( totalCorrectionDistance ) + " units corrected, "
+		+ ConvertNumberToString( accumulatedErrorUnitSeconds ) + " unit-seconds off the server's path" );
+
+	const TankPredictionStats& localPrediction = world->GetTankPredictor().GetStats();
+	out_resultLines.push_back( "Local tank: " + ConvertNumberToString( localPrediction.m_numReconciliations ) + " server corrections, " + ConvertNumberToString( localPrediction.m_numMispredictions )
+		+ " mispredicted, " + ConvertNumberToString( localPrediction.m_totalCorrectionDistance ) + " units corrected" );
+
+	const ClockSynchronizer& clockSynchronizer = world->GetClockSynchronizer();
+	out_resultLines.push_back( "Server clock offset: " + ConvertNumberToString( clockSynchronizer.GetOffsetSeconds( frameTimeSeconds ) * 1000.0 ) + " ms, drift "
+		+ ConvertNumberToString( clockSynchronizer.GetDrift() * 1000000.0 ) + " ppm from " + ConvertNumberToString( clockSynchronizer.GetNumSamples() ) + " samples" );
+
+	world->Destruct();
+	delete world;
+	ClearVirtualTime();
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,20 @@
+#ifndef include_CaptureReplay
+#define include_CaptureReplay
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include <string>
+#include <vector>
+
+
+//-----------------------------------------------------------------------------------------------
+// Feeds a packet capture back through a headless, offline World as fast as it will run: each
+// captured frame's incoming datagrams are injected, the game clock is pinned to the frame's
+// recorded time, and World::Update runs with the recorded input. The same capture always replays
+// the same way, so the result lines (throughput, per-phase cost, outgoing datagrams compared with
+// the capture, final state) can be compared across builds. Captures should start with the session
+// (-capture on the command line); one started mid-game replays into a World that never joined.
+bool RunCaptureReplay( const std::string& fileName, std::vector< std::string >& out_resultLines );
+
+
+#endif // include_CaptureReplay
\ No newline at end of file
@@ -0,0 +1,143 @@
+#include "ClockSynchronizer.hpp"
+#include "../Engine/NewMacroDef.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+ClockSynchronizer::ClockSynchronizer()
+{
+	Reset();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void ClockSynchronizer::Reset()
+{
+	m_newestIndex = CLOCK_SYNC_FILTER_SIZE - 1;
+	m_numFilterSamples = 0;
+	m_numSamples = 0;
+	m_filteredSample.m_localTimeSeconds = 0.0;
+	m_filteredSample.m_offsetSeconds = 0.0;
+	m_filteredSample.m_roundTripSeconds = 0.0;
+	m_driftReferenceSample = m_filteredSample;
+	m_hasDriftReference = false;
+	m_drift = 0.0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// The remote stamp must belong to the reply to the exchange that started at localSendTimeSeconds;
+// a stamp from a retransmission made before the request arrived would read as a clock offset.
+void ClockSynchronizer::AddSample( double localSendTimeSeconds, double remoteTimeSeconds, double localReceiveTimeSeconds )
+{
+	double roundTripSeconds = localReceiveTimeSeconds - localSendTimeSeconds;
+	if( roundTripSeconds < 0.0 )
+		return;
+
+	ClockSample sample;
+	sample.m_localTimeSeconds = ( localSendTimeSeconds + localReceiveTimeSeconds ) * 0.5;
+	sample.m_offsetSeconds = remoteTimeSeconds - sample.m_localTimeSeconds;
+	sample.m_roundTripSeconds = roundTripSeconds;
+
+	m_newestIndex = ( m_newestIndex + 1 ) % CLOCK_SYNC_FILTER_SIZE;
+	m_samples[ m_newestIndex ] = sample;
+	if( m_numFilterSamples < CLOCK_SYNC_FILTER_SIZE )
+		++m_numFilterSamples;
+
+	++m_numSamples;
+	SelectFilteredSample();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Picks the least-delayed sample in the filter, then folds the slope between it and the last drift
+// reference into the drift estimate once they are far enough apart to measure.
+void ClockSynchronizer::SelectFilteredSample()
+{
+	const ClockSample* bestSample = &m_samples[ m_newestIndex ];
+	for( int sampleIndex = 0; sampleIndex < m_numFilterSamples; ++sampleIndex )
+	{
+		const ClockSample& sample = m_samples[ sampleIndex ];
+		if( sample.m_roundTripSeconds < bestSample->m_roundTripSeconds )
+			bestSample = &sample;
+	}
+
+	m_filteredSample = *bestSample;
+
+	if( !m_hasDriftReference )
+	{
+		m_driftReferenceSample = m_filteredSample;
+		m_hasDriftReference = true;
+		return;
+	}
+
+	double intervalSeconds = m_filteredSample.m_localTimeSeconds - m_driftReferenceSample.m_localTimeSeconds;
+	if( intervalSeconds < CLOCK_SYNC_MIN_DRIFT_INTERVAL_SECONDS )
+		return;
+
+	double measuredDrift = ( m_filteredSample.m_offsetSeconds - m_driftReferenceSample.m_offsetSeconds ) / intervalSeconds;
+	if( measuredDrift > CLOCK_SYNC_MAX_DRIFT )
+		measuredDrift = CLOCK_SYNC_MAX_DRIFT;
+	else if( measuredDrift < -CLOCK_SYNC_MAX_DRIFT )
+		measuredDrift = -CLOCK_SYNC_MAX_DRIFT;
+
+	m_drift += ( measuredDrift - m_drift ) * CLOCK_SYNC_DRIFT_SMOOTHING;
+	m_driftReferenceSample = m_filteredSample;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool ClockSynchronizer::IsSynchronized() const
+{
+	return m_numSamples > 0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+int ClockSynchronizer::GetNumSamples() const
+{
+	return m_numSamples;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// The filtered offset carried forward at the drift rate from the moment it was measured.
+double ClockSynchronizer::GetOffsetSeconds( double localTimeSeconds ) const
+{
+	if( m_numSamples == 0 )
+		return 0.0;
+
+	return m_filteredSample.m_offsetSeconds + m_drift * ( localTimeSeconds - m_filteredSample.m_localTimeSeconds );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Remote seconds gained per local second; multiply by a million for ppm.
+double ClockSynchronizer::GetDrift() const
+{
+	return m_drift;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+double ClockSynchronizer::GetFilteredRoundTripSeconds() const
+{
+	return m_filteredSample.m_roundTripSeconds;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+double ClockSynchronizer::ConvertLocalToRemoteTime( double localTimeSeconds ) const
+{
+	return localTimeSeconds + GetOffsetSeconds( localTimeSeconds );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Inverts ConvertLocalToRemoteTime: the offset depends on the local time being solved for.
+double ClockSynchronizer::ConvertRemoteToLocalTime( double remoteTimeSeconds ) const
+{
+	if( m_numSamples == 0 )
+		return remoteTimeSeconds;
+
+	return ( remoteTimeSeconds - m_filteredSample.m_offsetSeconds + m_drift * m_filteredSample.m_localTimeSeconds ) / ( 1.0 + m_drift );
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+#ifndef include_ClockSynchronizer
+#define include_ClockSynchronizer
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+// NTP's clock filter keeps the last eight exchanges and trusts the one with the least delay, since
+// queueing only ever adds delay and an asymmetric wait skews the offset by half of it. Drift is
+// measured between filtered offsets far enough apart for millisecond timestamps to resolve it, and
+// bounded by NTP's 500 ppm frequency tolerance.
+const int CLOCK_SYNC_FILTER_SIZE = 8;
+const double CLOCK_SYNC_MIN_DRIFT_INTERVAL_SECONDS = 16.0;
+const double CLOCK_SYNC_DRIFT_SMOOTHING = 0.25;
+const double CLOCK_SYNC_MAX_DRIFT = 0.0005;
+
+
+//-----------------------------------------------------------------------------------------------
+// Estimates the offset of a remote clock from this one out of request/response exchanges: a packet
+// sent at local time t1, answered by a packet the remote stamped Ts, received at local time t4. The
+// remote is assumed to answer at the midpoint, so the offset is Ts - ( t1 + t4 ) / 2, wrong by at
+// most half of t4 - t1. Until the first exchange the clocks are treated as equal.
+class ClockSynchronizer
+{
+public:
+	ClockSynchronizer();
+	void Reset();
+	void AddSample( double localSendTimeSeconds, double remoteTimeSeconds, double localReceiveTimeSeconds );
+	bool IsSynchronized() const;
+	int GetNumSamples() const;
+	double GetOffsetSeconds( double localTimeSeconds ) const;
+	double GetDrift() const;
+	double GetFilteredRoundTripSeconds() const;
+	double ConvertLocalToRemoteTime( double localTimeSeconds ) const;
+	double ConvertRemoteToLocalTime( double remoteTimeSeconds ) const;
+
+private:
+	struct ClockSample
+	{
+		double	m_localTimeSeconds;
+		double	m_offsetSeconds;
+		double	m_roundTripSeconds;
+	};
+
+	void SelectFilteredSample();
+
+	ClockSample	m_samples[ CLOCK_SYNC_FILTER_SIZE ];
+	int			m_newestIndex;
+	int			m_numFilterSamples;
+	int			m_numSamples;
+	ClockSample	m_filteredSample;
+	ClockSample	m_driftReferenceSample;
+	bool		m_hasDriftReference;
+	double		m_drift;
+};
+
+
+#endif // include_ClockSynchronizer
\ No newline at end of file
@@ -12,6 +12,13 @@
 	v1.3: (VK) - Made ErrorCode 0 indicate success, and 255 be unknown.
 				 This way, functions can use ErrorCode to indicate success or failure.
 				 Prettied up the change log...because reasons.
+	v1.4: (MB) - Added capabilities to JoinRoomPacket so clients can advertise optional wire features.
+				 Legacy servers ignore the byte; the union size is unchanged.
+	v1.5: (MB) - Added CAPABILITY_SelectiveAcks for ack blocks carried in coalesced datagram headers.
+	v1.6: (MB) - Added CAPABILITY_ServerMovement: clients send TankInput runs instead of GameUpdates and
+				 the server answers with TankCorrection. GameReset echoes the capabilities accepted.
+	v1.7: (MB) - Fire is stamped with the server time of the targets the shooter saw; the server rewinds
+				 tanks to it to resolve hits. Stamps it cannot trust are resolved against current positions.
 */
 #pragma endregion //Change Log
 
@@ -75,6 +82,10 @@
 //	Client->Server: Update, Hit, Fire
 //	Server->Client: Update, Respawn
 
+//	With CAPABILITY_ServerMovement accepted in GameReset:
+//		Client->Server: TankInput (in place of Update)
+//		Server->Client: TankCorrection
+
 //	When end score is reached OR host exits the game:
 //		Server->ALL Clients: ReturnToLobby
 //		Client->Server: Ack
@@ -107,6 +118,9 @@ static const PacketType TYPE_Respawn = 9;
 static const PacketType TYPE_Hit = 10;
 static const PacketType TYPE_Fire = 11;
 static const PacketType TYPE_ReturnToLobby = 12;
+// 13 is taken on the compact wire by delta-encoded GameUpdates
+static const PacketType TYPE_TankInput = 14;
+static const PacketType TYPE_TankCorrection = 15;
 
 //-----------------------------------------------------------------------------------------------
 typedef unsigned char ErrorCode;
@@ -115,6 +129,13 @@ static const ErrorCode ERROR_RoomEmpty = 1;
 static const ErrorCode ERROR_RoomFull = 2;
 static const ErrorCode ERROR_BadRoomID = 3;
 static const ErrorCode ERROR_Unknown = 255;
+
+//-----------------------------------------------------------------------------------------------
+typedef unsigned char CapabilityFlags;
+static const CapabilityFlags CAPABILITY_None = 0;
+static const CapabilityFlags CAPABILITY_CoalescedPackets = 1 << 0;
+static const CapabilityFlags CAPABILITY_SelectiveAcks = 1 << 1;
+static const CapabilityFlags CAPABILITY_ServerMovement = 1 << 2;
 #pragma endregion //Packet Type Definitions
 
 
@@ -156,6 +177,7 @@ struct JoinRoomPacket
 	// 1-8 joins room at i-1
 	// 9-255 is an error (ERROR_BadRoomID)
 	RoomID room;
+	CapabilityFlags capabilities;
 };
 
 //-----------------------------------------------------------------------------------------------
@@ -185,6 +207,7 @@ struct GameResetPacket
 	float yPosition;
 	float orientationDegrees;
 	ClientID id;
+	CapabilityFlags capabilities;
 };
 
 //-----------------------------------------------------------------------------------------------
@@ -214,6 +237,29 @@ struct ReturnToLobbyPacket
 {
 
 };
+
+//-----------------------------------------------------------------------------------------------
+// numSteps fixed movement steps, numbered from firstStep, all with the same controls.
+// Throttle is -127 to 127; turn direction 1 is left, -1 is right. spawnPacketNumber is the number
+// of the GameReset or Respawn that placed the tank, so inputs for an earlier life are not applied.
+struct TankInputPacket
+{
+	unsigned int firstStep;
+	unsigned char numSteps;
+	signed char turnDirection;
+	signed char throttle;
+	PacketNumber spawnPacketNumber;
+};
+
+//-----------------------------------------------------------------------------------------------
+// The server's state for the receiving client's tank after every step before nextStep.
+struct TankCorrectionPacket
+{
+	unsigned int nextStep;
+	float xPosition;
+	float yPosition;
+	float orientationDegrees;
+};
 #pragma endregion //Packet Structure Definitions
 
 
@@ -241,6 +287,8 @@ struct FinalPacket
 		HitPacket hit;
 		GunfirePacket gunfire;
 		ReturnToLobbyPacket lobbyReturn;
+		TankInputPacket tankInput;
+		TankCorrectionPacket tankCorrection;
 	} data;
 
 
@@ -276,6 +324,8 @@ inline bool FinalPacket::IsGuaranteed() const
 	case TYPE_KeepAlive:
 	case TYPE_LobbyUpdate:
 	case TYPE_GameUpdate:
+	case TYPE_TankInput:
+	case TYPE_TankCorrection:
 	case TYPE_None:
 	default:
 		break;
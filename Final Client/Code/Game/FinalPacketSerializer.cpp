@@ -0,0 +1,345 @@
+#include "FinalPacketSerializer.hpp"
+#include <math.h>
+#include <string.h>
+#include "SnapshotDelta.hpp"
+#include "../Engine/NewMacroDef.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+static const unsigned int MAX_QUANTIZED_POSITION = ( 1u << QUANTIZED_POSITION_NUM_BITS ) - 1u;
+static const int MAX_QUANTIZED_VECTOR_STEPS = ( 1 << ( QUANTIZED_VECTOR_NUM_BITS - 1 ) ) - 1;
+static const unsigned int NUM_QUANTIZED_ANGLES = 1u << QUANTIZED_ANGLE_NUM_BITS;
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int QuantizePosition( float position )
+{
+	if( position < 0.f )
+		position = 0.f;
+	else if( position > WIRE_ARENA_SIZE )
+		position = WIRE_ARENA_SIZE;
+
+	return (unsigned int) ( ( position / WIRE_ARENA_SIZE ) * (float) MAX_QUANTIZED_POSITION + 0.5f );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+float DequantizePosition( unsigned int quantizedPosition )
+{
+	return ( (float) quantizedPosition / (float) MAX_QUANTIZED_POSITION ) * WIRE_ARENA_SIZE;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Signed, stored offset-binary so it fits the unsigned bit writer.
+unsigned int QuantizeVectorComponent( float value )
+{
+	int numSteps = (int) floor( ( value / WIRE_VECTOR_UNITS_PER_STEP ) + 0.5f );
+	if( numSteps > MAX_QUANTIZED_VECTOR_STEPS )
+		numSteps = MAX_QUANTIZED_VECTOR_STEPS;
+	else if( numSteps < -MAX_QUANTIZED_VECTOR_STEPS )
+		numSteps = -MAX_QUANTIZED_VECTOR_STEPS;
+
+	return (unsigned int) ( numSteps + MAX_QUANTIZED_VECTOR_STEPS );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+float DequantizeVectorComponent( unsigned int quantizedValue )
+{
+	int numSteps = (int) quantizedValue - MAX_QUANTIZED_VECTOR_STEPS;
+	return (float) numSteps * WIRE_VECTOR_UNITS_PER_STEP;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int QuantizeAngleDegrees( float degrees )
+{
+	float wrappedDegrees = fmod( degrees, 360.f );
+	if( wrappedDegrees < 0.f )
+		wrappedDegrees += 360.f;
+
+	unsigned int quantizedDegrees = (unsigned int) ( ( wrappedDegrees / 360.f ) * (float) NUM_QUANTIZED_ANGLES + 0.5f );
+	return quantizedDegrees & ( NUM_QUANTIZED_ANGLES - 1u );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+float DequantizeAngleDegrees( unsigned int quantizedDegrees )
+{
+	return ( (float) quantizedDegrees / (float) NUM_QUANTIZED_ANGLES ) * 360.f;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static void WritePosition( BitWriter& writer, float x, float y )
+{
+	writer.WriteBits( QuantizePosition( x ), QUANTIZED_POSITION_NUM_BITS );
+	writer.WriteBits( QuantizePosition( y ), QUANTIZED_POSITION_NUM_BITS );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static void ReadPosition( BitReader& reader, float& out_x, float& out_y )
+{
+	out_x = DequantizePosition( reader.ReadBits( QUANTIZED_POSITION_NUM_BITS ) );
+	out_y = DequantizePosition( reader.ReadBits( QUANTIZED_POSITION_NUM_BITS ) );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// 4-bit type, 8-bit client ID, varint number, varint millisecond timestamp. wireType differs from
+// packet.type only for wire-only encodings such as WIRE_TYPE_GameUpdateDelta.
+void WriteCompactPacketHeader( BitWriter& writer, const FinalPacket& packet, PacketType wireType )
+{
+	writer.WriteBits( wireType, PACKET_TYPE_NUM_BITS );
+	writer.WriteBits( packet.clientID, 8 );
+	writer.WriteVarUInt( packet.number );
+	writer.WriteVarUInt64( (unsigned long long) ( packet.timestamp * 1000.0 + 0.5 ) );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Header as above, then only the union member selected by the type.
+void WriteCompactFinalPacket( BitWriter& writer, const FinalPacket& packet )
+{
+	WriteCompactPacketHeader( writer, packet, packet.type );
+
+	switch( packet.type )
+	{
+	case TYPE_Ack:
+		writer.WriteBits( packet.data.acknowledged.type, PACKET_TYPE_NUM_BITS );
+		writer.WriteVarUInt( packet.data.acknowledged.number );
+		break;
+
+	case TYPE_Nack:
+		writer.WriteBits( packet.data.refused.type, PACKET_TYPE_NUM_BITS );
+		writer.WriteVarUInt( packet.data.refused.number );
+		writer.WriteBits( packet.data.refused.errorCode, 8 );
+		break;
+
+	case TYPE_CreateRoom:
+		writer.WriteBits( packet.data.creating.room, 8 );
+		break;
+
+	case TYPE_JoinRoom:
+		writer.WriteBits( packet.data.joining.room, 8 );
+		writer.WriteBits( packet.data.joining.capabilities, 8 );
+		break;
+
+	case TYPE_LobbyUpdate:
+		for( int roomIndex = 0; roomIndex < 8; ++roomIndex )
+		{
+			writer.WriteBits( (unsigned char) packet.data.updatedLobby.playersInRoomNumber[ roomIndex ], PLAYERS_IN_ROOM_NUM_BITS );
+		}
+		break;
+
+	case TYPE_GameUpdate:
+	{
+		QuantizedTankState state;
+		QuantizeGameUpdate( packet, state );
+		WriteQuantizedGameUpdate( writer, state );
+		break;
+	}
+
+	case TYPE_GameReset:
+		WritePosition( writer, packet.data.reset.xPosition, packet.data.reset.yPosition );
+		writer.WriteBits( QuantizeAngleDegrees( packet.data.reset.orientationDegrees ), QUANTIZED_ANGLE_NUM_BITS );
+		writer.WriteBits( packet.data.reset.id, 8 );
+		writer.WriteBits( packet.data.reset.capabilities, 8 );
+		break;
+
+	case TYPE_Respawn:
+		WritePosition( writer, packet.data.respawn.xPosition, packet.data.respawn.yPosition );
+		writer.WriteBits( QuantizeAngleDegrees( packet.data.respawn.orientationDegrees ), QUANTIZED_ANGLE_NUM_BITS );
+		break;
+
+	case TYPE_Hit:
+		writer.WriteBits( packet.data.hit.instigatorID, 8 );
+		writer.WriteBits( packet.data.hit.targetID, 8 );
+		writer.WriteBits( packet.data.hit.damageDealt, 8 );
+		break;
+
+	case TYPE_Fire:
+		writer.WriteBits( packet.data.gunfire.instigatorID, 8 );
+		break;
+
+	case TYPE_TankInput:
+		writer.WriteVarUInt( packet.data.tankInput.firstStep );
+		writer.WriteBits( packet.data.tankInput.numSteps, 8 );
+		writer.WriteBits( (unsigned char) packet.data.tankInput.turnDirection, 8 );
+		writer.WriteBits( (unsigned char) packet.data.tankInput.throttle, 8 );
+		writer.WriteVarUInt( packet.data.tankInput.spawnPacketNumber );
+		break;
+
+	case TYPE_TankCorrection:
+		writer.WriteVarUInt( packet.data.tankCorrection.nextStep );
+		WritePosition( writer, packet.data.tankCorrection.xPosition, packet.data.tankCorrection.yPosition );
+		writer.WriteBits( QuantizeAngleDegrees( packet.data.tankCorrection.orientationDegrees ), QUANTIZED_ANGLE_NUM_BITS );
+		break;
+
+	case TYPE_KeepAlive:
+	case TYPE_ReturnToLobby:
+	case TYPE_None:
+	default:
+		break;
+	}
+
+	writer.AlignToByte();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// GameUpdates are recorded in snapshotHistory when one is given, and delta GameUpdates can only be
+// decoded against it; without a history they are rejected.
+bool ReadCompactFinalPacket( BitReader& reader, FinalPacket& out_packet, SnapshotHistory* snapshotHistory )
+{
+	memset( &out_packet, 0, sizeof( out_packet ) );
+
+	QuantizedTankState tankState;
+	out_packet.type = (PacketType) reader.ReadBits( PACKET_TYPE_NUM_BITS );
+	out_packet.clientID = (ClientID) reader.ReadBits( 8 );
+	out_packet.number = reader.ReadVarUInt();
+	tankState.timestampMilliseconds = reader.ReadVarUInt64();
+	out_packet.timestamp = (double) tankState.timestampMilliseconds * 0.001;
+
+	switch( out_packet.type )
+	{
+	case TYPE_Ack:
+		out_packet.data.acknowledged.type = (PacketType) reader.ReadBits( PACKET_TYPE_NUM_BITS );
+		out_packet.data.acknowledged.number = reader.ReadVarUInt();
+		break;
+
+	case TYPE_Nack:
+		out_packet.data.refused.type = (PacketType) reader.ReadBits( PACKET_TYPE_NUM_BITS );
+		out_packet.data.refused.number = reader.ReadVarUInt();
+		out_packet.data.refused.errorCode = (ErrorCode) reader.ReadBits( 8 );
+		break;
+
+	case TYPE_CreateRoom:
+		out_packet.data.creating.room = (RoomID) reader.ReadBits( 8 );
+		break;
+
+	case TYPE_JoinRoom:
+		out_packet.data.joining.room = (RoomID) reader.ReadBits( 8 );
+		out_packet.data.joining.capabilities = (CapabilityFlags) reader.ReadBits( 8 );
+		break;
+
+	case TYPE_LobbyUpdate:
+		for( int roomIndex = 0; roomIndex < 8; ++roomIndex )
+		{
+			out_packet.data.updatedLobby.playersInRoomNumber[ roomIndex ] = (char) reader.ReadBits( PLAYERS_IN_ROOM_NUM_BITS );
+		}
+		break;
+
+	case TYPE_GameUpdate:
+		ReadQuantizedGameUpdate( reader, tankState );
+		DequantizeGameUpdate( tankState, out_packet );
+		if( snapshotHistory != nullptr && !reader.HasOverflowed() )
+			snapshotHistory->StoreSnapshot( out_packet.number, out_packet.clientID, tankState );
+		break;
+
+	case WIRE_TYPE_GameUpdateDelta:
+		// An undecodable delta comes back as TYPE_None so the rest of the datagram is still read
+		if( !ReadDeltaGameUpdate( reader, out_packet.number, out_packet.clientID, snapshotHistory, tankState ) )
+		{
+			out_packet.type = TYPE_None;
+			break;
+		}
+
+		out_packet.type = TYPE_GameUpdate;
+		DequantizeGameUpdate( tankState, out_packet );
+		snapshotHistory->StoreSnapshot( out_packet.number, out_packet.clientID, tankState );
+		break;
+
+	case TYPE_GameReset:
+		ReadPosition( reader, out_packet.data.reset.xPosition, out_packet.data.reset.yPosition );
+		out_packet.data.reset.orientationDegrees = DequantizeAngleDegrees( reader.ReadBits( QUANTIZED_ANGLE_NUM_BITS ) );
+		out_packet.data.reset.id = (ClientID) reader.ReadBits( 8 );
+		out_packet.data.reset.capabilities = (CapabilityFlags) reader.ReadBits( 8 );
+		break;
+
+	case TYPE_Respawn:
+		ReadPosition( reader, out_packet.data.respawn.xPosition, out_packet.data.respawn.yPosition );
+		out_packet.data.respawn.orientationDegrees = DequantizeAngleDegrees( reader.ReadBits( QUANTIZED_ANGLE_NUM_BITS ) );
+		break;
+
+	case TYPE_Hit:
+		out_packet.data.hit.instigatorID = (ClientID) reader.ReadBits( 8 );
+		out_packet.data.hit.targetID = (ClientID) reader.ReadBits( 8 );
+		out_packet.data.hit.damageDealt = (unsigned char) reader.ReadBits( 8 );
+		break;
+
+	case TYPE_Fire:
+		out_packet.data.gunfire.instigatorID = (ClientID) reader.ReadBits( 8 );
+		break;
+
+	case TYPE_TankInput:
+		out_packet.data.tankInput.firstStep = reader.ReadVarUInt();
+		out_packet.data.tankInput.numSteps = (unsigned char) reader.ReadBits( 8 );
+		out_packet.data.tankInput.turnDirection = (signed char) reader.ReadBits( 8 );
+		out_packet.data.tankInput.throttle = (signed char) reader.ReadBits( 8 );
+		out_packet.data.tankInput.spawnPacketNumber = reader.ReadVarUInt();
+		break;
+
+	case TYPE_TankCorrection:
+		out_packet.data.tankCorrection.nextStep = reader.ReadVarUInt();
+		ReadPosition( reader, out_packet.data.tankCorrection.xPosition, out_packet.data.tankCorrection.yPosition );
+		out_packet.data.tankCorrection.orientationDegrees = DequantizeAngleDegrees( reader.ReadBits( QUANTIZED_ANGLE_NUM_BITS ) );
+		break;
+
+	case TYPE_KeepAlive:
+	case TYPE_ReturnToLobby:
+		break;
+
+	case TYPE_None:
+	default:
+		return false;
+	}
+
+	reader.AlignToByte();
+	return !reader.HasOverflowed();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Returns the number of bytes written, or 0 if the buffer was too small.
+int SerializeFinalPacket( const FinalPacket& packet, unsigned char* out_buffer, int bufferSizeBytes )
+{
+	BitWriter writer( out_buffer, bufferSizeBytes );
+	writer.WriteBits( WIRE_MARKER_COMPACT, 8 );
+	WriteCompactFinalPacket( writer, packet );
+
+	if( writer.HasOverflowed() )
+		return 0;
+
+	return writer.GetNumBytesWritten();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Accepts both compact datagrams and legacy raw FinalPacket datagrams.
+bool DeserializeFinalPacket( const unsigned char* buffer, int numBytes, FinalPacket& out_packet )
+{
+	if( numBytes <= 0 )
+		return false;
+
+	if( IsLegacyFinalPacketDatagram( buffer, numBytes ) )
+	{
+		memcpy( &out_packet, buffer, sizeof( out_packet ) );
+		return true;
+	}
+
+	if( buffer[ 0 ] != WIRE_MARKER_COMPACT )
+		return false;
+
+	BitReader reader( buffer + 1, numBytes - 1 );
+	return ReadCompactFinalPacket( reader, out_packet );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool IsLegacyFinalPacketDatagram( const unsigned char* buffer, int numBytes )
+{
+	return numBytes == sizeof( FinalPacket ) && buffer[ 0 ] <= TYPE_ReturnToLobby;
+}
\ No newline at end of file
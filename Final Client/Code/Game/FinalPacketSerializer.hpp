@@ -0,0 +1,45 @@
+#ifndef include_FinalPacketSerializer
+#define include_FinalPacketSerializer
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include "FinalPacket.hpp"
+#include "../Engine/BitStream.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+class SnapshotHistory;
+
+
+//-----------------------------------------------------------------------------------------------
+// Compact wire format for FinalPacket (protocol v1.3). A compact datagram starts with the marker
+// byte below; legacy datagrams are a raw sizeof( FinalPacket ) copy whose first byte is a
+// PacketType, so the two can never be confused. Bump the marker if the encoding changes.
+const unsigned char COMPACT_WIRE_FORMAT_VERSION = 1;
+const unsigned char WIRE_MARKER_COMPACT = 0xF0 | COMPACT_WIRE_FORMAT_VERSION;
+const int PACKET_TYPE_NUM_BITS = 4;
+const int QUANTIZED_POSITION_NUM_BITS = 16;
+const int QUANTIZED_VECTOR_NUM_BITS = 16;
+const int QUANTIZED_ANGLE_NUM_BITS = 16;
+const int PLAYERS_IN_ROOM_NUM_BITS = 4;
+const float WIRE_ARENA_SIZE = 500.f; // see Game Rules in FinalPacket.hpp
+const float WIRE_VECTOR_UNITS_PER_STEP = 1.f / 64.f;
+const int MAX_COMPACT_PACKET_SIZE_BYTES = 40;
+
+
+//-----------------------------------------------------------------------------------------------
+int SerializeFinalPacket( const FinalPacket& packet, unsigned char* out_buffer, int bufferSizeBytes );
+bool DeserializeFinalPacket( const unsigned char* buffer, int numBytes, FinalPacket& out_packet );
+bool IsLegacyFinalPacketDatagram( const unsigned char* buffer, int numBytes );
+void WriteCompactPacketHeader( BitWriter& writer, const FinalPacket& packet, PacketType wireType );
+void WriteCompactFinalPacket( BitWriter& writer, const FinalPacket& packet );
+bool ReadCompactFinalPacket( BitReader& reader, FinalPacket& out_packet, SnapshotHistory* snapshotHistory = nullptr );
+unsigned int QuantizePosition( float position );
+float DequantizePosition( unsigned int quantizedPosition );
+unsigned int QuantizeVectorComponent( float value );
+float DequantizeVectorComponent( unsigned int quantizedValue );
+unsigned int QuantizeAngleDegrees( float degrees );
+float DequantizeAngleDegrees( unsigned int quantizedDegrees );
+
+
+#endif // include_FinalPacketSerializer
\ No newline at end of file
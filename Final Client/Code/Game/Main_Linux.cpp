@@ -0,0 +1,178 @@
+#include <time.h>
+#include <stdio.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include "RoomServer.hpp"
+#include "BotLauncher.hpp"
+#include "ServerBenchmarks.hpp"
+#include "../Engine/Threading.hpp"
+#include "../Engine/NewMacroDef.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+// Headless dedicated server and load-test bots; no window, renderer or OpenGL. Build from the Code
+// directory with:
+//   g++ -O2 -std=c++11 -pthread -o FinalServer Game/Main_Linux.cpp Game/RoomServer.cpp
+//       Game/RoomShard.cpp Game/UDPSocket.cpp Game/PacketFraming.cpp Game/FinalPacketSerializer.cpp
+//       Game/SelectiveAck.cpp Game/SnapshotDelta.cpp Game/RoundTripEstimator.cpp Game/TankMovement.cpp
+//       Game/TankPositionHistory.cpp Game/ServerBenchmarks.cpp Game/BotLauncher.cpp Game/World.cpp
+//       Game/Tank.cpp Game/TankInput.cpp Game/TankStateBuffer.cpp Game/TankPredictor.cpp
+//       Game/UDPClient.cpp Game/NetworkConditioner.cpp Game/ReorderBuffer.cpp
+//       Game/ReliabilityWindow.cpp Game/ClockSynchronizer.cpp Game/UpdateSendScheduler.cpp
+//       Game/PacketCapture.cpp Engine/BitStream.cpp Engine/Time.cpp Engine/SIMDMathFunctions.cpp
+//       Engine/NewDeleteFunctions.cpp Engine/Threading.cpp Engine/StringFunctions.cpp Engine/Color.cpp
+// Add -mavx (or -march=native) for the AVX laser hit kernel.
+// Usage: FinalServer [-port <number>] [-tickRate <ticksPerSecond>] [-threads <workerThreads>]
+//                    [-reusePort <0|1>]
+//        FinalServer -benchmark reusePort|laserHit
+//        FinalServer -bots <numBots> [-threads <botThreads>] [-seconds <runSeconds>]
+//                    [-server <ipAddress>] [-port <number>] [-networkThreads <0|1>]
+// Room worker threads default to one per core beyond the one that owns the socket, and never exceed
+// one per room (MAX_SERVER_WORKER_THREADS), as a room is never split across workers. Unless
+// -reusePort is 0, each worker also receives on its own SO_REUSEPORT socket.
+// With -bots this process is a client instead: it runs the bots against the server at -server and
+// -port, writes every line of the report to BOT_REPORT_FILE_NAME and prints the summary. With
+// -networkThreads 1 each bot's UDPClient receives on its own thread through the epoll wait.
+static volatile bool g_isQuitting = false;
+
+
+//-----------------------------------------------------------------------------------------------
+void HandleQuitSignal( int )
+{
+	g_isQuitting = true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+int RunBenchmark( const char* benchmarkName )
+{
+	std::vector< std::string > resultLines;
+	if( strcmp( benchmarkName, "reusePort" ) == 0 )
+	{
+		RunReusePortBenchmark( resultLines );
+	}
+	else if( strcmp( benchmarkName, "laserHit" ) == 0 )
+	{
+		RunLaserHitBenchmark( resultLines );
+	}
+	else
+	{
+		fprintf( stderr, "Unknown benchmark %s\n", benchmarkName );
+		return 1;
+	}
+
+	for( unsigned int lineIndex = 0; lineIndex < resultLines.size(); ++lineIndex )
+	{
+		printf( "%s\n", resultLines[ lineIndex ].c_str() );
+	}
+
+	return 0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+int RunBotsAndReport( const BotLaunchSettings& settings )
+{
+	std::vector< std::string > resultLines;
+	RunBots( settings, resultLines );
+
+	FILE* reportFile = fopen( BOT_REPORT_FILE_NAME.c_str(), "w" );
+	if( reportFile != nullptr )
+	{
+		for( unsigned int lineIndex = 0; lineIndex < resultLines.size(); ++lineIndex )
+		{
+			fprintf( reportFile, "%s\n", resultLines[ lineIndex ].c_str() );
+		}
+
+		fclose( reportFile );
+	}
+
+	unsigned int numBotLines = resultLines.size() - NUM_BOT_SUMMARY_LINES;
+	for( unsigned int lineIndex = numBotLines; lineIndex < resultLines.size(); ++lineIndex )
+	{
+		printf( "%s\n", resultLines[ lineIndex ].c_str() );
+	}
+
+	return 0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+int main( int argc, char** argv )
+{
+	unsigned short portNumber = DEFAULT_SERVER_PORT_NUMBER;
+	int ticksPerSecond = DEFAULT_SERVER_TICKS_PER_SECOND;
+	int numWorkerThreads = GetNumHardwareThreads() - 1;
+	bool isReusingPort = true;
+	const char* benchmarkName = nullptr;
+	bool isRunningBots = false;
+	bool hasThreadCount = false;
+	BotLaunchSettings botSettings;
+
+	for( int argIndex = 1; argIndex + 1 < argc; argIndex += 2 )
+	{
+		if( strcmp( argv[ argIndex ], "-port" ) == 0 )
+			portNumber = (unsigned short) atoi( argv[ argIndex + 1 ] );
+		else if( strcmp( argv[ argIndex ], "-tickRate" ) == 0 )
+			ticksPerSecond = atoi( argv[ argIndex + 1 ] );
+		else if( strcmp( argv[ argIndex ], "-threads" ) == 0 )
+		{
+			numWorkerThreads = atoi( argv[ argIndex + 1 ] );
+			hasThreadCount = true;
+		}
+		else if( strcmp( argv[ argIndex ], "-reusePort" ) == 0 )
+			isReusingPort = ( atoi( argv[ argIndex + 1 ] ) != 0 );
+		else if( strcmp( argv[ argIndex ], "-benchmark" ) == 0 )
+			benchmarkName = argv[ argIndex + 1 ];
+		else if( strcmp( argv[ argIndex ], "-bots" ) == 0 )
+		{
+			botSettings.m_numBots = atoi( argv[ argIndex + 1 ] );
+			isRunningBots = true;
+		}
+		else if( strcmp( argv[ argIndex ], "-seconds" ) == 0 )
+			botSettings.m_runSeconds = atof( argv[ argIndex + 1 ] );
+		else if( strcmp( argv[ argIndex ], "-server" ) == 0 )
+			botSettings.m_serverIPAddress = argv[ argIndex + 1 ];
+		else if( strcmp( argv[ argIndex ], "-networkThreads" ) == 0 )
+			botSettings.m_useNetworkThreads = ( atoi( argv[ argIndex + 1 ] ) != 0 );
+	}
+
+	if( benchmarkName != nullptr )
+		return RunBenchmark( benchmarkName );
+
+	if( isRunningBots )
+	{
+		botSettings.m_serverPortNumber = portNumber;
+		if( hasThreadCount )
+			botSettings.m_numThreads = numWorkerThreads;
+
+		return RunBotsAndReport( botSettings );
+	}
+
+	if( ticksPerSecond <= 0 )
+		ticksPerSecond = DEFAULT_SERVER_TICKS_PER_SECOND;
+
+	if( numWorkerThreads < 0 )
+		numWorkerThreads = 0;
+	else if( numWorkerThreads > MAX_SERVER_WORKER_THREADS )
+		numWorkerThreads = MAX_SERVER_WORKER_THREADS;
+
+	srand( (unsigned int) time( nullptr ) );
+	signal( SIGINT, HandleQuitSignal );
+	signal( SIGTERM, HandleQuitSignal );
+
+	RoomServer server;
+	if( !server.Startup( portNumber, ticksPerSecond, numWorkerThreads, isReusingPort ) )
+	{
+		fprintf( stderr, "Could not bind UDP port %u\n", portNumber );
+		return 1;
+	}
+
+	printf( "Serving %d rooms on UDP port %u at %d ticks per second with %d room threads and %d sockets\n", SERVER_NUM_ROOMS, portNumber, ticksPerSecond, numWorkerThreads, server.GetNumReceiveSockets() );
+	server.Run( g_isQuitting );
+	server.Shutdown();
+
+	printf( "Server stopped\n" );
+	return 0;
+}
\ No newline at end of file
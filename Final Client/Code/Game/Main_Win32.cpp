@@ -1,22 +1,31 @@
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
+#include <mmsystem.h>
 #include <math.h>
 #include <cassert>
 #include <crtdbg.h>
 #include "Game.hpp"
+#include "RoomServer.hpp"
+#include "BotLauncher.hpp"
+#include "CaptureReplay.hpp"
+#include "NetworkBenchmarks.hpp"
 #include "../Engine/Time.hpp"
+#include "../Engine/Threading.hpp"
 #include "../Engine/Texture.hpp"
 #include "../Engine/BitmapFont.hpp"
 #include "../Engine/EngineCommon.hpp"
 #include "../Engine/OpenGLRenderer.hpp"
 #include "../Engine/DeveloperConsole.hpp"
+#include "../Engine/ErrorWarningAssertions.hpp"
 #include "../Engine/NewMacroDef.hpp"
 #pragma comment( lib, "opengl32" ) // Link in the OpenGL32.lib static library
 #pragma comment( lib, "glu32" ) // Link in the GLU32.lib static library
+#pragma comment( lib, "winmm" ) // Link in the WinMM.lib static library, for timeBeginPeriod
 
 //-----------------------------------------------------------------------------------------------
 const int SCREEN_WIDTH = 1600;
 const int SCREEN_HEIGHT = 900;
+const double FRAME_WAIT_SPIN_SECONDS = 0.002;
 const std::string MAIN_FONT_GLYPH_SHEET_FILE_NAME = "Data/Fonts/MainFont_EN_00.png";
 const std::string MAIN_FONT_META_DATA_FILE_NAME = "Data/Fonts/MainFont_EN.FontDef.xml";
 
@@ -230,6 +239,380 @@ bool ConsoleFunctionChangePortNumber( const ConsoleCommandArgs& params )
 }
 
 
+//-----------------------------------------------------------------------------------------------
+bool ConsoleFunctionSetReceiveBatchSize( const ConsoleCommandArgs& params )
+{
+	if( params.m_argsList.size() == 0 )
+		return false;
+
+	int maxDatagrams = atoi( params.m_argsList[ 0 ].c_str() );
+	g_game.m_world.GetClient().SetMaxDatagramsPerReceiveBatch( maxDatagrams );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool ConsoleFunctionNetStats( const ConsoleCommandArgs& )
+{
+	UDPClient& client = g_game.m_world.GetClient();
+	g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( "Last receive batch: " + ConvertNumberToString( client.GetLastReceiveBatchSize() ) + " datagrams", Color::White ) );
+	g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( "Average receive batch: " + ConvertNumberToString( client.GetAverageDatagramsPerReceiveBatch() ) + " datagrams", Color::White ) );
+	g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( "Last send flush: " + ConvertNumberToString( client.GetLastFlushNumDatagrams() ) + " datagrams, " + ConvertNumberToString( client.GetLastFlushNumBytes() ) + " bytes", Color::White ) );
+	g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( "Outgoing bandwidth: " + ConvertNumberToString( client.GetOutgoingBytesPerSecond() ) + " bytes/sec", Color::White ) );
+	g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( "Update interval: " + ConvertNumberToString( g_game.m_world.GetUpdateScheduler().GetLastSendIntervalSeconds() * 1000.0 ) + " ms, budget " + ConvertNumberToString( g_game.m_world.GetUpdateScheduler().GetBandwidthBudget() ) + " bytes/sec", Color::White ) );
+	g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( "Encoded updates sent alone for lack of room: " + ConvertNumberToString( g_game.m_world.GetTrafficStats().m_numEncodedUpdateFallbacks ), Color::White ) );
+	g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( std::string( "Network thread: " ) + ( client.IsNetworkThreadRunning() ? "running" : "off" ) + ", " + ConvertNumberToString( client.GetNumOutgoingQueueDrops() ) + " datagrams dropped on a full outgoing queue", Color::White ) );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool ConsoleFunctionSetNetworkThread( const ConsoleCommandArgs& params )
+{
+	if( params.m_argsList.size() < 1 )
+		return false;
+
+	UDPClient& client = g_game.m_world.GetClient();
+	if( atoi( params.m_argsList[ 0 ].c_str() ) != 0 )
+		client.StartNetworkThread();
+	else
+		client.StopNetworkThread();
+
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool ConsoleFunctionNetRoundTrip( const ConsoleCommandArgs& )
+{
+	const RoundTripEstimator& roundTrip = g_game.m_world.GetRoundTripEstimator();
+	g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( "Smoothed RTT: " + ConvertNumberToString( roundTrip.GetSmoothedRoundTripSeconds() * 1000.0 ) + " ms, variance " + ConvertNumberToString( roundTrip.GetRoundTripVarianceSeconds() * 1000.0 ) + " ms", Color::White ) );
+	g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( "Last sample: " + ConvertNumberToString( roundTrip.GetLastSampleSeconds() * 1000.0 ) + " ms, " + ConvertNumberToString( roundTrip.GetNumSamples() ) + " samples", Color::White ) );
+	g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( "Retransmission timeout: " + ConvertNumberToString( roundTrip.GetRetransmissionTimeoutSeconds() * 1000.0 ) + " ms, backoff x" + ConvertNumberToString( roundTrip.GetBackoffMultiplier() ), Color::White ) );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool ConsoleFunctionSetCompactWireFormat( const ConsoleCommandArgs& params )
+{
+	if( params.m_argsList.size() == 0 )
+		return false;
+
+	g_game.m_world.SetCompactWireFormat( atoi( params.m_argsList[ 0 ].c_str() ) != 0 );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool ConsoleFunctionSetUpdateBandwidthBudget( const ConsoleCommandArgs& params )
+{
+	if( params.m_argsList.size() == 0 )
+		return false;
+
+	int bytesPerSecond = atoi( params.m_argsList[ 0 ].c_str() );
+	if( bytesPerSecond <= 0 )
+		return false;
+
+	g_game.m_world.GetUpdateScheduler().SetBandwidthBudget( bytesPerSecond );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// One-way milliseconds, added in each direction
+bool ConsoleFunctionSetSimulatedLatency( const ConsoleCommandArgs& params )
+{
+	if( params.m_argsList.size() == 0 )
+		return false;
+
+	NetworkConditions conditions = g_game.m_world.GetClient().GetNetworkConditions();
+	conditions.m_latencySeconds = 0.001 * atof( params.m_argsList[ 0 ].c_str() );
+	g_game.m_world.GetClient().SetNetworkConditions( conditions );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// +/- milliseconds around the simulated latency
+bool ConsoleFunctionSetSimulatedJitter( const ConsoleCommandArgs& params )
+{
+	if( params.m_argsList.size() == 0 )
+		return false;
+
+	NetworkConditions conditions = g_game.m_world.GetClient().GetNetworkConditions();
+	conditions.m_jitterSeconds = 0.001 * atof( params.m_argsList[ 0 ].c_str() );
+	g_game.m_world.GetClient().SetNetworkConditions( conditions );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool ConsoleFunctionSetSimulatedLoss( const ConsoleCommandArgs& params )
+{
+	if( params.m_argsList.size() == 0 )
+		return false;
+
+	NetworkConditions conditions = g_game.m_world.GetClient().GetNetworkConditions();
+	conditions.m_lossPercentage = (float) atof( params.m_argsList[ 0 ].c_str() );
+	g_game.m_world.GetClient().SetNetworkConditions( conditions );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool ConsoleFunctionSetSimulatedReorder( const ConsoleCommandArgs& params )
+{
+	if( params.m_argsList.size() == 0 )
+		return false;
+
+	NetworkConditions conditions = g_game.m_world.GetClient().GetNetworkConditions();
+	conditions.m_reorderPercentage = (float) atof( params.m_argsList[ 0 ].c_str() );
+	g_game.m_world.GetClient().SetNetworkConditions( conditions );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool ConsoleFunctionSetSimulatedDuplicate( const ConsoleCommandArgs& params )
+{
+	if( params.m_argsList.size() == 0 )
+		return false;
+
+	NetworkConditions conditions = g_game.m_world.GetClient().GetNetworkConditions();
+	conditions.m_duplicatePercentage = (float) atof( params.m_argsList[ 0 ].c_str() );
+	g_game.m_world.GetClient().SetNetworkConditions( conditions );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Bytes per second in each direction; 0 removes the cap
+bool ConsoleFunctionSetSimulatedBandwidthCap( const ConsoleCommandArgs& params )
+{
+	if( params.m_argsList.size() == 0 )
+		return false;
+
+	NetworkConditions conditions = g_game.m_world.GetClient().GetNetworkConditions();
+	conditions.m_bandwidthBytesPerSecond = atoi( params.m_argsList[ 0 ].c_str() );
+	g_game.m_world.GetClient().SetNetworkConditions( conditions );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool ConsoleFunctionClearSimulatedConditions( const ConsoleCommandArgs& )
+{
+	g_game.m_world.GetClient().SetNetworkConditions( NetworkConditions() );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool ConsoleFunctionSimulatedNetworkStats( const ConsoleCommandArgs& )
+{
+	UDPClient& client = g_game.m_world.GetClient();
+	const NetworkConditions& conditions = client.GetNetworkConditions();
+	g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( "Simulating " + ConvertNumberToString( conditions.m_latencySeconds * 1000.0 ) + " +/- " + ConvertNumberToString( conditions.m_jitterSeconds * 1000.0 ) + " ms each way, "
+		+ ConvertNumberToString( conditions.m_lossPercentage ) + "% loss, " + ConvertNumberToString( conditions.m_reorderPercentage ) + "% reorder, " + ConvertNumberToString( conditions.m_duplicatePercentage ) + "% duplicate, "
+		+ ( conditions.m_bandwidthBytesPerSecond > 0 ? ConvertNumberToString( conditions.m_bandwidthBytesPerSecond ) + " bytes/sec cap" : std::string( "no bandwidth cap" ) ), Color::White ) );
+
+	const NetworkConditioner* conditioners[ 2 ] = { &client.GetOutgoingConditioner(), &client.GetIncomingConditioner() };
+	const char* directionNames[ 2 ] = { "Outgoing", "Incoming" };
+	for( int directionIndex = 0; directionIndex < 2; ++directionIndex )
+	{
+		const NetworkConditioner& conditioner = *conditioners[ directionIndex ];
+		g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( std::string( directionNames[ directionIndex ] ) + ": " + ConvertNumberToString( conditioner.GetNumHeldDatagrams() ) + " held, "
+			+ ConvertNumberToString( conditioner.GetNumDropped() ) + " lost, " + ConvertNumberToString( conditioner.GetNumOverflowDropped() ) + " over the link's queue, "
+			+ ConvertNumberToString( conditioner.GetNumReordered() ) + " reordered, " + ConvertNumberToString( conditioner.GetNumDuplicated() ) + " duplicated", Color::White ) );
+	}
+
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Stats restart on every switch so each mode's numbers stand on their own.
+bool ConsoleFunctionSetRemoteTankSmoothing( const ConsoleCommandArgs& params )
+{
+	if( params.m_argsList.size() < 1 )
+		return false;
+
+	std::string smoothingName = GetLowercaseString( params.m_argsList[ 0 ] );
+	if( smoothingName == "interp" )
+		g_game.m_world.SetRemoteTankSmoothing( SMOOTHING_Interpolation );
+	else if( smoothingName == "dr" )
+		g_game.m_world.SetRemoteTankSmoothing( SMOOTHING_DeadReckoning );
+	else
+		return false;
+
+	g_game.m_world.ResetPredictionErrorStats();
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool ConsoleFunctionSetInterpolationDelay( const ConsoleCommandArgs& params )
+{
+	if( params.m_argsList.size() < 1 )
+		return false;
+
+	g_game.m_world.SetInterpolationDelaySeconds( atof( params.m_argsList[ 0 ].c_str() ) * 0.001 );
+	g_game.m_world.ResetPredictionErrorStats();
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool ConsoleFunctionShowPredictionErrorGraph( const ConsoleCommandArgs& params )
+{
+	if( params.m_argsList.size() < 1 )
+		return false;
+
+	g_game.m_world.SetPredictionErrorGraphVisible( atoi( params.m_argsList[ 0 ].c_str() ) != 0 );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool ConsoleFunctionPredictionErrorStats( const ConsoleCommandArgs& )
+{
+	const PredictionErrorStats& stats = g_game.m_world.GetPredictionErrorStats();
+	std::string smoothingName = ( g_game.m_world.GetRemoteTankSmoothing() == SMOOTHING_Interpolation ) ? "Interpolation (" + ConvertNumberToString( g_game.m_world.GetInterpolationDelaySeconds() * 1000.0 ) + " ms delay)" : "Dead reckoning";
+	g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( smoothingName + ": " + ConvertNumberToString( stats.m_numSamples ) + " updates, prediction error avg "
+		+ ConvertNumberToString( stats.GetAverageError() ) + " max " + ConvertNumberToString( stats.m_maxError ) + " units", Color::White ) );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool ConsoleFunctionSetConvergenceTime( const ConsoleCommandArgs& params )
+{
+	if( params.m_argsList.size() < 1 )
+		return false;
+
+	g_game.m_world.SetConvergenceSeconds( atof( params.m_argsList[ 0 ].c_str() ) * 0.001 );
+	g_game.m_world.ResetPredictionErrorStats();
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool ConsoleFunctionTankPositionErrors( const ConsoleCommandArgs& )
+{
+	std::vector< TankPositionError > positionErrors;
+	g_game.m_world.GetTankPositionErrors( positionErrors );
+	for( unsigned int tankIndex = 0; tankIndex < positionErrors.size(); ++tankIndex )
+	{
+		const TankPositionError& positionError = positionErrors[ tankIndex ];
+		float averageCorrection = ( positionError.m_numCorrections > 0 ) ? positionError.m_totalCorrectionDistance / positionError.m_numCorrections : 0.f;
+		float errorPerSecond = ( positionError.m_trackedSeconds > 0.f ) ? positionError.m_accumulatedErrorUnitSeconds / positionError.m_trackedSeconds : 0.f;
+		g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( "Tank " + ConvertNumberToString( (int) positionError.m_playerID ) + ": " + ConvertNumberToString( positionError.m_numCorrections ) + " corrections, avg "
+			+ ConvertNumberToString( averageCorrection ) + " units, accumulated error " + ConvertNumberToString( positionError.m_accumulatedErrorUnitSeconds ) + " unit-seconds ("
+			+ ConvertNumberToString( errorPerSecond ) + " units on average)", Color::White ) );
+	}
+
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool ConsoleFunctionClockSync( const ConsoleCommandArgs& )
+{
+	const ClockSynchronizer& clockSynchronizer = g_game.m_world.GetClockSynchronizer();
+	if( !clockSynchronizer.IsSynchronized() )
+	{
+		g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( "Clock not synchronized with the server yet", Color::White ) );
+		return true;
+	}
+
+	g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( "Server clock offset: " + ConvertNumberToString( clockSynchronizer.GetOffsetSeconds( GetCurrentTimeSeconds() ) * 1000.0 ) + " ms, drift "
+		+ ConvertNumberToString( clockSynchronizer.GetDrift() * 1000000.0 ) + " ppm, filtered rtt " + ConvertNumberToString( clockSynchronizer.GetFilteredRoundTripSeconds() * 1000.0 ) + " ms over "
+		+ ConvertNumberToString( clockSynchronizer.GetNumSamples() ) + " samples", Color::White ) );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool ConsoleFunctionTankPrediction( const ConsoleCommandArgs& )
+{
+	const TankPredictor& tankPredictor = g_game.m_world.GetTankPredictor();
+	const TankPredictionStats& stats = tankPredictor.GetStats();
+	float averageCorrection = ( stats.m_numReconciliations > 0 ) ? stats.m_totalCorrectionDistance / stats.m_numReconciliations : 0.f;
+	std::string mode = g_game.m_world.IsServerMovementNegotiated() ? "server reconciled" : "client authoritative";
+
+	g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( "Local tank: " + mode + ", " + ConvertNumberToString( tankPredictor.GetNumUnacknowledgedSteps() ) + " unacknowledged steps, "
+		+ ConvertNumberToString( stats.m_numReconciliations ) + " corrections (" + ConvertNumberToString( stats.m_numMispredictions ) + " mispredicted), avg "
+		+ ConvertNumberToString( averageCorrection ) + " max " + ConvertNumberToString( stats.m_maxCorrectionDistance ) + " units", Color::White ) );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool ConsoleFunctionStartCapture( const ConsoleCommandArgs& params )
+{
+	if( params.m_argsList.size() < 1 )
+		return false;
+
+	if( !g_game.m_world.GetClient().StartCapture( params.m_argsList[ 0 ] ) )
+	{
+		g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( "Could not open " + params.m_argsList[ 0 ] + " for capture", Color::Red ) );
+		return true;
+	}
+
+	g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( "Capturing to " + params.m_argsList[ 0 ], Color::White ) );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool ConsoleFunctionStopCapture( const ConsoleCommandArgs& )
+{
+	g_game.m_world.GetClient().StopCapture();
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void LogBenchmarkResults( const std::vector< std::string >& resultLines )
+{
+	for( unsigned int lineIndex = 0; lineIndex < resultLines.size(); ++lineIndex )
+	{
+		g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( resultLines[ lineIndex ], Color::White ) );
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool ConsoleFunctionBenchmarkSerializer( const ConsoleCommandArgs& )
+{
+	std::vector< std::string > resultLines;
+	RunSerializerBenchmark( resultLines );
+	LogBenchmarkResults( resultLines );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool ConsoleFunctionBenchmarkReliabilityWindow( const ConsoleCommandArgs& )
+{
+	std::vector< std::string > resultLines;
+	RunReliabilityWindowBenchmark( resultLines );
+	LogBenchmarkResults( resultLines );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool ConsoleFunctionBenchmarkReorderBuffer( const ConsoleCommandArgs& )
+{
+	std::vector< std::string > resultLines;
+	RunReorderBufferBenchmark( resultLines );
+	LogBenchmarkResults( resultLines );
+	return true;
+}
+
+
 //-----------------------------------------------------------------------------------------------
 void Update()
 {
@@ -252,12 +635,16 @@ void Render()
 
 
 //-----------------------------------------------------------------------------------------------
+// Sleeps through the bulk of the wait, leaving the core to the network thread, and only yields
+// through the last FRAME_WAIT_SPIN_SECONDS, which a 1 ms timer period cannot be trusted to hit.
 void WaitUntilNextFrameTime()
 {
 	double timeNow = GetCurrentTimeSeconds();
 	static double targetTime = timeNow;
 	while( timeNow < targetTime )
 	{
+		double secondsLeft = targetTime - timeNow;
+		SleepThread( ( secondsLeft > FRAME_WAIT_SPIN_SECONDS ) ? secondsLeft - FRAME_WAIT_SPIN_SECONDS : 0.0 );
 		timeNow = GetCurrentTimeSeconds();
 	}
 	targetTime = timeNow + FRAME_TIME_SECONDS;
@@ -290,6 +677,33 @@ void LoadDeveloperConsole()
 	g_developerConsole.AddCommandFuncPtr( "quit", ConsoleFunctionQuit );
 	g_developerConsole.AddCommandFuncPtr( "changeIP", ConsoleFunctionChangeIP );
 	g_developerConsole.AddCommandFuncPtr( "changePort", ConsoleFunctionChangePortNumber );
+	g_developerConsole.AddCommandFuncPtr( "netBatchSize", ConsoleFunctionSetReceiveBatchSize );
+	g_developerConsole.AddCommandFuncPtr( "netStats", ConsoleFunctionNetStats );
+	g_developerConsole.AddCommandFuncPtr( "netRTT", ConsoleFunctionNetRoundTrip );
+	g_developerConsole.AddCommandFuncPtr( "netCompact", ConsoleFunctionSetCompactWireFormat );
+	g_developerConsole.AddCommandFuncPtr( "netBudget", ConsoleFunctionSetUpdateBandwidthBudget );
+	g_developerConsole.AddCommandFuncPtr( "netThread", ConsoleFunctionSetNetworkThread );
+	g_developerConsole.AddCommandFuncPtr( "netSimLatency", ConsoleFunctionSetSimulatedLatency );
+	g_developerConsole.AddCommandFuncPtr( "netSimJitter", ConsoleFunctionSetSimulatedJitter );
+	g_developerConsole.AddCommandFuncPtr( "netSimLoss", ConsoleFunctionSetSimulatedLoss );
+	g_developerConsole.AddCommandFuncPtr( "netSimReorder", ConsoleFunctionSetSimulatedReorder );
+	g_developerConsole.AddCommandFuncPtr( "netSimDuplicate", ConsoleFunctionSetSimulatedDuplicate );
+	g_developerConsole.AddCommandFuncPtr( "netSimBandwidth", ConsoleFunctionSetSimulatedBandwidthCap );
+	g_developerConsole.AddCommandFuncPtr( "netSimOff", ConsoleFunctionClearSimulatedConditions );
+	g_developerConsole.AddCommandFuncPtr( "netSimStats", ConsoleFunctionSimulatedNetworkStats );
+	g_developerConsole.AddCommandFuncPtr( "netSmoothing", ConsoleFunctionSetRemoteTankSmoothing );
+	g_developerConsole.AddCommandFuncPtr( "netInterpDelay", ConsoleFunctionSetInterpolationDelay );
+	g_developerConsole.AddCommandFuncPtr( "netErrorGraph", ConsoleFunctionShowPredictionErrorGraph );
+	g_developerConsole.AddCommandFuncPtr( "netErrorStats", ConsoleFunctionPredictionErrorStats );
+	g_developerConsole.AddCommandFuncPtr( "netConvergence", ConsoleFunctionSetConvergenceTime );
+	g_developerConsole.AddCommandFuncPtr( "netTankErrors", ConsoleFunctionTankPositionErrors );
+	g_developerConsole.AddCommandFuncPtr( "netClock", ConsoleFunctionClockSync );
+	g_developerConsole.AddCommandFuncPtr( "netPrediction", ConsoleFunctionTankPrediction );
+	g_developerConsole.AddCommandFuncPtr( "netCaptureStart", ConsoleFunctionStartCapture );
+	g_developerConsole.AddCommandFuncPtr( "netCaptureStop", ConsoleFunctionStopCapture );
+	g_developerConsole.AddCommandFuncPtr( "benchmarkSerializer", ConsoleFunctionBenchmarkSerializer );
+	g_developerConsole.AddCommandFuncPtr( "benchmarkReliability", ConsoleFunctionBenchmarkReliabilityWindow );
+	g_developerConsole.AddCommandFuncPtr( "benchmarkReorder", ConsoleFunctionBenchmarkReorderBuffer );
 }
 
 
@@ -327,6 +741,85 @@ void RunCommandlet( const std::string& commandName, const std::vector< std::stri
 	std::string lowercaseCommandName = GetLowercaseString( commandName );
 	if( lowercaseCommandName == "server" )
 	{
+		// -server [port] [numThreads]
+		unsigned short portNumber = DEFAULT_SERVER_PORT_NUMBER;
+		int numWorkerThreads = GetNumHardwareThreads() - 1;
+		if( args.size() > 0 )
+			portNumber = (unsigned short) atoi( args[ 0 ].c_str() );
+		if( args.size() > 1 )
+			numWorkerThreads = atoi( args[ 1 ].c_str() );
+
+		// There is no SO_REUSEPORT here, so this thread receives for every room and the workers only simulate
+		RoomServer server;
+		if( server.Startup( portNumber, DEFAULT_SERVER_TICKS_PER_SECOND, numWorkerThreads, false ) )
+			server.Run( g_isQuitting );
+
+		server.Shutdown();
+		g_isQuitting = true;
+	}
+	else if( lowercaseCommandName == "bots" )
+	{
+		// -bots [numBots] [numThreads] [seconds] [serverIP] [serverPort] [networkThreads]
+		BotLaunchSettings settings;
+		if( args.size() > 0 )
+			settings.m_numBots = atoi( args[ 0 ].c_str() );
+		if( args.size() > 1 )
+			settings.m_numThreads = atoi( args[ 1 ].c_str() );
+		if( args.size() > 2 )
+			settings.m_runSeconds = atof( args[ 2 ].c_str() );
+		if( args.size() > 3 )
+			settings.m_serverIPAddress = args[ 3 ];
+		if( args.size() > 4 )
+			settings.m_serverPortNumber = (unsigned short) atoi( args[ 4 ].c_str() );
+		if( args.size() > 5 )
+			settings.m_useNetworkThreads = ( atoi( args[ 5 ].c_str() ) != 0 );
+
+		std::vector< std::string > resultLines;
+		RunBots( settings, resultLines );
+
+		FILE* reportFile = fopen( BOT_REPORT_FILE_NAME.c_str(), "w" );
+		if( reportFile != nullptr )
+		{
+			for( unsigned int lineIndex = 0; lineIndex < resultLines.size(); ++lineIndex )
+			{
+				fprintf( reportFile, "%s\n", resultLines[ lineIndex ].c_str() );
+			}
+
+			fclose( reportFile );
+		}
+
+		// Per-bot lines only go to the report; the summary lines at the end also go to the debugger
+		unsigned int numBotLines = resultLines.size() - NUM_BOT_SUMMARY_LINES;
+		for( unsigned int lineIndex = numBotLines; lineIndex < resultLines.size(); ++lineIndex )
+		{
+			DebuggerPrintf( "%s\n", resultLines[ lineIndex ].c_str() );
+		}
+
+		g_isQuitting = true;
+	}
+	else if( lowercaseCommandName == "capture" )
+	{
+		// -capture <file>: records the whole session, join included, so it can be replayed
+		if( args.size() > 0 )
+		{
+			InitializeTime();
+			g_game.m_world.GetClient().StartCapture( args[ 0 ] );
+		}
+	}
+	else if( lowercaseCommandName == "replay" )
+	{
+		// -replay <file>
+		if( args.size() > 0 )
+		{
+			std::vector< std::string > resultLines;
+			RunCaptureReplay( args[ 0 ], resultLines );
+			for( unsigned int lineIndex = 0; lineIndex < resultLines.size(); ++lineIndex )
+			{
+				DebuggerPrintf( "%s\n", resultLines[ lineIndex ].c_str() );
+			}
+		}
+
+		g_isQuitting = true;
 	}
 }
 
@@ -412,10 +905,13 @@ int WINAPI WinMain( HINSTANCE applicationInstanceHandle, HINSTANCE, LPSTR comman
 	if( !g_isQuitting )
 		Initialize( applicationInstanceHandle );
 
+	// Without a 1 ms timer period, the frame wait's sleeps could overshoot by a whole 15.6 ms tick
+	timeBeginPeriod( 1 );
 	while( !g_isQuitting )
 	{
 		RunFrame();
 	}
+	timeEndPeriod( 1 );
 
 	UnloadTextures();
 	g_game.Destruct();
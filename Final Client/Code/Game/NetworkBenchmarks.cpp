@@ -0,0 +1,544 @@
+#include "NetworkBenchmarks.hpp"
+#include <set>
+#include <math.h>
+#include <string.h>
+#include "FinalPacket.hpp"
+#include "ReorderBuffer.hpp"
+#include "ReliabilityWindow.hpp"
+#include "SnapshotDelta.hpp"
+#include "FinalPacketSerializer.hpp"
+#include "../Engine/Time.hpp"
+#include "../Engine/StringFunctions.hpp"
+#include "../Engine/NewDeleteFunctions.hpp"
+#include "../Engine/NewMacroDef.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+static FinalPacket MakeBenchmarkPacket( PacketType type, PacketNumber number, double timestamp )
+{
+	FinalPacket packet;
+	memset( &packet, 0, sizeof( packet ) );
+	packet.type = type;
+	packet.clientID = 3;
+	packet.number = number;
+	packet.timestamp = timestamp;
+
+	switch( type )
+	{
+	case TYPE_Ack:
+		packet.data.acknowledged.type = TYPE_Fire;
+		packet.data.acknowledged.number = number - 7;
+		break;
+
+	case TYPE_GameUpdate:
+		packet.data.updatedGame.xPosition = 250.f + 200.f * (float) sin( timestamp );
+		packet.data.updatedGame.yPosition = 250.f + 200.f * (float) cos( timestamp );
+		packet.data.updatedGame.xVelocity = 70.7f;
+		packet.data.updatedGame.yVelocity = -70.7f;
+		packet.data.updatedGame.orientationDegrees = 315.f;
+		packet.data.updatedGame.health = 1;
+		packet.data.updatedGame.score = 4;
+		break;
+
+	case TYPE_Fire:
+		packet.data.gunfire.instigatorID = packet.clientID;
+		break;
+
+	case TYPE_Hit:
+		packet.data.hit.instigatorID = packet.clientID;
+		packet.data.hit.targetID = 5;
+		packet.data.hit.damageDealt = 1;
+		break;
+
+	default:
+		break;
+	}
+
+	return packet;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// One second of one client's traffic: lobby keep-alives, or a firefight at the 20 Hz update rate.
+static void BuildBenchmarkTrafficMix( bool isInGame, std::vector< FinalPacket >& out_packets )
+{
+	PacketNumber number = 1000;
+	double timestamp = 5000.0;
+
+	for( int updateIndex = 0; updateIndex < 20; ++updateIndex )
+	{
+		timestamp += 0.05;
+		out_packets.push_back( MakeBenchmarkPacket( isInGame ? TYPE_GameUpdate : TYPE_KeepAlive, number++, timestamp ) );
+	}
+
+	if( !isInGame )
+		return;
+
+	for( int shotIndex = 0; shotIndex < 3; ++shotIndex )
+	{
+		out_packets.push_back( MakeBenchmarkPacket( TYPE_Fire, number++, timestamp ) );
+		out_packets.push_back( MakeBenchmarkPacket( TYPE_Ack, number++, timestamp ) );
+		out_packets.push_back( MakeBenchmarkPacket( TYPE_Hit, number++, timestamp ) );
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static bool DoesPositionSurviveQuantization( float original, float decoded )
+{
+	return decoded == DequantizePosition( QuantizePosition( original ) );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static bool DoesVectorSurviveQuantization( float original, float decoded )
+{
+	return decoded == DequantizeVectorComponent( QuantizeVectorComponent( original ) );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static bool DoesAngleSurviveQuantization( float original, float decoded )
+{
+	return decoded == DequantizeAngleDegrees( QuantizeAngleDegrees( original ) );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Decoded fields must equal what the quantizers make of the originals, clamping included.
+static bool DoPacketsMatchAfterQuantization( const FinalPacket& original, const FinalPacket& decoded )
+{
+	if( original.type != decoded.type || original.clientID != decoded.clientID || original.number != decoded.number )
+		return false;
+
+	if( fabs( original.timestamp - decoded.timestamp ) > 0.001 )
+		return false;
+
+	const FinalPacket::PacketData& before = original.data;
+	const FinalPacket::PacketData& after = decoded.data;
+	switch( original.type )
+	{
+	case TYPE_Ack:
+		return before.acknowledged.type == after.acknowledged.type && before.acknowledged.number == after.acknowledged.number;
+
+	case TYPE_Nack:
+		return before.refused.type == after.refused.type && before.refused.number == after.refused.number && before.refused.errorCode == after.refused.errorCode;
+
+	case TYPE_CreateRoom:
+		return before.creating.room == after.creating.room;
+
+	case TYPE_JoinRoom:
+		return before.joining.room == after.joining.room && before.joining.capabilities == after.joining.capabilities;
+
+	case TYPE_LobbyUpdate:
+		return memcmp( before.updatedLobby.playersInRoomNumber, after.updatedLobby.playersInRoomNumber, sizeof( before.updatedLobby.playersInRoomNumber ) ) == 0;
+
+	case TYPE_GameUpdate:
+		return DoesPositionSurviveQuantization( before.updatedGame.xPosition, after.updatedGame.xPosition )
+			&& DoesPositionSurviveQuantization( before.updatedGame.yPosition, after.updatedGame.yPosition )
+			&& DoesVectorSurviveQuantization( before.updatedGame.xVelocity, after.updatedGame.xVelocity )
+			&& DoesVectorSurviveQuantization( before.updatedGame.yVelocity, after.updatedGame.yVelocity )
+			&& DoesVectorSurviveQuantization( before.updatedGame.xAcceleration, after.updatedGame.xAcceleration )
+			&& DoesVectorSurviveQuantization( before.updatedGame.yAcceleration, after.updatedGame.yAcceleration )
+			&& DoesAngleSurviveQuantization( before.updatedGame.orientationDegrees, after.updatedGame.orientationDegrees )
+			&& before.updatedGame.health == after.updatedGame.health && before.updatedGame.score == after.updatedGame.score;
+
+	case TYPE_GameReset:
+		return DoesPositionSurviveQuantization( before.reset.xPosition, after.reset.xPosition )
+			&& DoesPositionSurviveQuantization( before.reset.yPosition, after.reset.yPosition )
+			&& DoesAngleSurviveQuantization( before.reset.orientationDegrees, after.reset.orientationDegrees )
+			&& before.reset.id == after.reset.id && before.reset.capabilities == after.reset.capabilities;
+
+	case TYPE_Respawn:
+		return DoesPositionSurviveQuantization( before.respawn.xPosition, after.respawn.xPosition )
+			&& DoesPositionSurviveQuantization( before.respawn.yPosition, after.respawn.yPosition )
+			&& DoesAngleSurviveQuantization( before.respawn.orientationDegrees, after.respawn.orientationDegrees );
+
+	case TYPE_Hit:
+		return before.hit.instigatorID == after.hit.instigatorID && before.hit.targetID == after.hit.targetID && before.hit.damageDealt == after.hit.damageDealt;
+
+	case TYPE_Fire:
+		return before.gunfire.instigatorID == after.gunfire.instigatorID;
+
+	case TYPE_TankInput:
+		return before.tankInput.firstStep == after.tankInput.firstStep && before.tankInput.numSteps == after.tankInput.numSteps
+			&& before.tankInput.turnDirection == after.tankInput.turnDirection && before.tankInput.throttle == after.tankInput.throttle
+			&& before.tankInput.spawnPacketNumber == after.tankInput.spawnPacketNumber;
+
+	case TYPE_TankCorrection:
+		return before.tankCorrection.nextStep == after.tankCorrection.nextStep
+			&& DoesPositionSurviveQuantization( before.tankCorrection.xPosition, after.tankCorrection.xPosition )
+			&& DoesPositionSurviveQuantization( before.tankCorrection.yPosition, after.tankCorrection.yPosition )
+			&& DoesAngleSurviveQuantization( before.tankCorrection.orientationDegrees, after.tankCorrection.orientationDegrees );
+
+	default:
+		return true;
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Every packet type twice: once at the low end of each field's range and once at the high end,
+// with positions and vectors pushed past the range so the clamps are exercised too.
+static void BuildEdgeValuePackets( std::vector< FinalPacket >& out_packets )
+{
+	const PacketNumber MAX_PACKET_NUMBER = 0xFFFFFFFFu;
+	for( int extremeIndex = 0; extremeIndex < 2; ++extremeIndex )
+	{
+		bool isHigh = ( extremeIndex == 1 );
+		for( PacketType type = TYPE_Ack; type <= TYPE_TankCorrection; ++type )
+		{
+			if( type == WIRE_TYPE_GameUpdateDelta )
+				continue;
+
+			FinalPacket packet;
+			memset( &packet, 0, sizeof( packet ) );
+			packet.type = type;
+			packet.clientID = isHigh ? 255 : 0;
+			packet.number = isHigh ? MAX_PACKET_NUMBER : 0;
+			packet.timestamp = isHigh ? 4000000000.0 : 0.0;
+
+			float position = isHigh ? WIRE_ARENA_SIZE + 100.f : -100.f;
+			float vector = isHigh ? 1000.f : -1000.f;
+			float degrees = isHigh ? 719.99f : -90.f;
+			FinalPacket::PacketData& data = packet.data;
+			switch( type )
+			{
+			case TYPE_Ack:
+				data.acknowledged.type = TYPE_TankCorrection;
+				data.acknowledged.number = packet.number;
+				break;
+
+			case TYPE_Nack:
+				data.refused.type = TYPE_JoinRoom;
+				data.refused.number = packet.number;
+				data.refused.errorCode = isHigh ? ERROR_Unknown : ERROR_None;
+				break;
+
+			case TYPE_CreateRoom:
+				data.creating.room = isHigh ? ROOM_None : ROOM_Lobby;
+				break;
+
+			case TYPE_JoinRoom:
+				data.joining.room = isHigh ? ROOM_None : ROOM_Lobby;
+				data.joining.capabilities = isHigh ? 255 : CAPABILITY_None;
+				break;
+
+			case TYPE_LobbyUpdate:
+				memset( data.updatedLobby.playersInRoomNumber, isHigh ? ( 1 << PLAYERS_IN_ROOM_NUM_BITS ) - 1 : 0, sizeof( data.updatedLobby.playersInRoomNumber ) );
+				break;
+
+			case TYPE_GameUpdate:
+				data.updatedGame.xPosition = position;
+				data.updatedGame.yPosition = -position;
+				data.updatedGame.xVelocity = vector;
+				data.updatedGame.yVelocity = -vector;
+				data.updatedGame.xAcceleration = -vector;
+				data.updatedGame.yAcceleration = vector;
+				data.updatedGame.orientationDegrees = degrees;
+				data.updatedGame.health = isHigh ? 255 : 0;
+				data.updatedGame.score = isHigh ? 255 : 0;
+				break;
+
+			case TYPE_GameReset:
+				data.reset.xPosition = position;
+				data.reset.yPosition = position;
+				data.reset.orientationDegrees = degrees;
+				data.reset.id = packet.clientID;
+				data.reset.capabilities = isHigh ? 255 : CAPABILITY_None;
+				break;
+
+			case TYPE_Respawn:
+				data.respawn.xPosition = position;
+				data.respawn.yPosition = position;
+				data.respawn.orientationDegrees = degrees;
+				break;
+
+			case TYPE_Hit:
+				data.hit.instigatorID = packet.clientID;
+				data.hit.targetID = isHigh ? 0 : 255;
+				data.hit.damageDealt = isHigh ? 255 : 0;
+				break;
+
+			case TYPE_Fire:
+				data.gunfire.instigatorID = packet.clientID;
+				break;
+
+			case TYPE_TankInput:
+				data.tankInput.firstStep = isHigh ? MAX_PACKET_NUMBER : 0;
+				data.tankInput.numSteps = isHigh ? 255 : 0;
+				data.tankInput.turnDirection = isHigh ? 1 : -1;
+				data.tankInput.throttle = isHigh ? 127 : -127;
+				data.tankInput.spawnPacketNumber = isHigh ? MAX_PACKET_NUMBER : 0;
+				break;
+
+			case TYPE_TankCorrection:
+				data.tankCorrection.nextStep = isHigh ? MAX_PACKET_NUMBER : 0;
+				data.tankCorrection.xPosition = position;
+				data.tankCorrection.yPosition = position;
+				data.tankCorrection.orientationDegrees = degrees;
+				break;
+
+			default:
+				break;
+			}
+
+			out_packets.push_back( packet );
+		}
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Returns the number of packets that failed to encode, failed to decode, or decoded differently.
+static int CountRoundTripFailures( const std::vector< FinalPacket >& packets )
+{
+	unsigned char datagram[ MAX_COMPACT_PACKET_SIZE_BYTES ];
+	int numRoundTripFailures = 0;
+	for( unsigned int packetIndex = 0; packetIndex < packets.size(); ++packetIndex )
+	{
+		FinalPacket decodedPacket;
+		int numBytes = SerializeFinalPacket( packets[ packetIndex ], datagram, sizeof( datagram ) );
+		if( numBytes == 0 || !DeserializeFinalPacket( datagram, numBytes, decodedPacket ) || !DoPacketsMatchAfterQuantization( packets[ packetIndex ], decodedPacket ) )
+			++numRoundTripFailures;
+	}
+
+	return numRoundTripFailures;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static void RunSerializerBenchmarkForMix( const std::string& mixName, bool isInGame, std::vector< std::string >& out_resultLines )
+{
+	std::vector< FinalPacket > packets;
+	BuildBenchmarkTrafficMix( isInGame, packets );
+
+	unsigned char datagram[ MAX_COMPACT_PACKET_SIZE_BYTES ];
+	int rawBytesPerSecond = 0;
+	int compactBytesPerSecond = 0;
+	int numRoundTripFailures = CountRoundTripFailures( packets );
+
+	for( unsigned int packetIndex = 0; packetIndex < packets.size(); ++packetIndex )
+	{
+		int numBytes = SerializeFinalPacket( packets[ packetIndex ], datagram, sizeof( datagram ) );
+		rawBytesPerSecond += sizeof( FinalPacket ) + UDP_IP_HEADER_SIZE_BYTES;
+		compactBytesPerSecond += numBytes + UDP_IP_HEADER_SIZE_BYTES;
+	}
+
+	int numPacketsProcessed = 0;
+	double startTime = GetCurrentTimeSeconds();
+	for( int iteration = 0; iteration < SERIALIZER_BENCHMARK_ITERATIONS; iteration += (int) packets.size() )
+	{
+		for( unsigned int packetIndex = 0; packetIndex < packets.size(); ++packetIndex )
+		{
+			FinalPacket decodedPacket;
+			int numBytes = SerializeFinalPacket( packets[ packetIndex ], datagram, sizeof( datagram ) );
+			DeserializeFinalPacket( datagram, numBytes, decodedPacket );
+			++numPacketsProcessed;
+		}
+	}
+	double elapsedSeconds = GetCurrentTimeSeconds() - startTime;
+	double packetsPerSecond = ( elapsedSeconds > 0.0 ) ? ( numPacketsProcessed / elapsedSeconds ) : 0.0;
+
+	out_resultLines.push_back( mixName + ": raw " + ConvertNumberToString( rawBytesPerSecond ) + " bytes/sec, compact " + ConvertNumberToString( compactBytesPerSecond ) + " bytes/sec (incl. UDP/IP headers)" );
+	out_resultLines.push_back( mixName + ": " + ConvertNumberToString( packetsPerSecond ) + " encode+decode round trips/sec, " + ConvertNumberToString( numRoundTripFailures ) + " round-trip mismatches" );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RunSerializerBenchmark( std::vector< std::string >& out_resultLines )
+{
+	RunSerializerBenchmarkForMix( "Lobby", false, out_resultLines );
+	RunSerializerBenchmarkForMix( "Firefight", true, out_resultLines );
+
+	std::vector< FinalPacket > edgeValuePackets;
+	BuildEdgeValuePackets( edgeValuePackets );
+	out_resultLines.push_back( "Edge values: " + ConvertNumberToString( (int) edgeValuePackets.size() ) + " packets, " + ConvertNumberToString( CountRoundTripFailures( edgeValuePackets ) ) + " round-trip mismatches" );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// The pre-window bookkeeping: a vector scanned and erased from for every ack and every resend pass.
+static int RunLinearSentPacketsRound( const std::vector< FinalPacket >& packets, double sendTime )
+{
+	std::vector< FinalPacket > sentPackets;
+	for( unsigned int packetIndex = 0; packetIndex < packets.size(); ++packetIndex )
+	{
+		sentPackets.push_back( packets[ packetIndex ] );
+	}
+
+	for( unsigned int ackIndex = 0; ackIndex < packets.size(); ++ackIndex )
+	{
+		if( ackIndex % RELIABILITY_BENCHMARK_LOSS_INTERVAL == 0 )
+			continue;
+
+		for( unsigned int packetIndex = 0; packetIndex < sentPackets.size(); ++packetIndex )
+		{
+			FinalPacket packet = sentPackets[ packetIndex ];
+			if( packet.number == packets[ ackIndex ].number )
+			{
+				sentPackets.erase( sentPackets.begin() + packetIndex );
+				break;
+			}
+		}
+	}
+
+	std::vector< FinalPacket > resendPackets;
+	for( unsigned int packetIndex = 0; packetIndex < sentPackets.size(); ++packetIndex )
+	{
+		FinalPacket packet = sentPackets[ packetIndex ];
+		if( ( sendTime + 1.0 - packet.timestamp ) > 0.25 )
+		{
+			resendPackets.push_back( packet );
+			sentPackets.erase( sentPackets.begin() + packetIndex );
+			--packetIndex;
+		}
+	}
+
+	return (int) resendPackets.size();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static int RunReliabilityWindowRound( ReliabilityWindow& window, const std::vector< FinalPacket >& packets, double sendTime )
+{
+	for( unsigned int packetIndex = 0; packetIndex < packets.size(); ++packetIndex )
+	{
+		window.AddPacket( packets[ packetIndex ], sendTime, sendTime + 0.25 );
+	}
+
+	for( unsigned int ackIndex = 0; ackIndex < packets.size(); ++ackIndex )
+	{
+		if( ackIndex % RELIABILITY_BENCHMARK_LOSS_INTERVAL == 0 )
+			continue;
+
+		window.RemovePacket( packets[ ackIndex ].number );
+	}
+
+	std::vector< FinalPacket > resendPackets;
+	window.CollectExpiredPackets( sendTime + 1.0, resendPackets );
+
+	// Retransmits stay in the window until acked; ack them all so the next round starts empty
+	for( unsigned int packetIndex = 0; packetIndex < resendPackets.size(); ++packetIndex )
+	{
+		window.RemovePacket( resendPackets[ packetIndex ].number );
+	}
+
+	return (int) resendPackets.size();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Each round: send RELIABILITY_BENCHMARK_OUTSTANDING_PACKETS guaranteed packets, ack all but every
+// RELIABILITY_BENCHMARK_LOSS_INTERVAL'th, then run one resend pass after the timeout has elapsed.
+void RunReliabilityWindowBenchmark( std::vector< std::string >& out_resultLines )
+{
+	std::vector< FinalPacket > packets;
+	double sendTime = 5000.0;
+	for( int packetIndex = 0; packetIndex < RELIABILITY_BENCHMARK_OUTSTANDING_PACKETS; ++packetIndex )
+	{
+		packets.push_back( MakeBenchmarkPacket( TYPE_Fire, 1000 + packetIndex, sendTime ) );
+	}
+
+	int numLinearResends = 0;
+	double startTime = GetCurrentTimeSeconds();
+	for( int roundIndex = 0; roundIndex < RELIABILITY_BENCHMARK_ROUNDS; ++roundIndex )
+	{
+		numLinearResends += RunLinearSentPacketsRound( packets, sendTime );
+	}
+	double linearSeconds = GetCurrentTimeSeconds() - startTime;
+
+	ReliabilityWindow* window = new ReliabilityWindow();
+	int numWindowResends = 0;
+	startTime = GetCurrentTimeSeconds();
+	for( int roundIndex = 0; roundIndex < RELIABILITY_BENCHMARK_ROUNDS; ++roundIndex )
+	{
+		numWindowResends += RunReliabilityWindowRound( *window, packets, sendTime + roundIndex );
+	}
+	double windowSeconds = GetCurrentTimeSeconds() - startTime;
+	delete window;
+
+	double linearMillisecondsPerRound = 1000.0 * linearSeconds / RELIABILITY_BENCHMARK_ROUNDS;
+	double windowMillisecondsPerRound = 1000.0 * windowSeconds / RELIABILITY_BENCHMARK_ROUNDS;
+
+	out_resultLines.push_back( ConvertNumberToString( RELIABILITY_BENCHMARK_OUTSTANDING_PACKETS ) + " outstanding guaranteed packets, 1 in " + ConvertNumberToString( RELIABILITY_BENCHMARK_LOSS_INTERVAL ) + " lost" );
+	out_resultLines.push_back( "Linear vector: " + ConvertNumberToString( linearMillisecondsPerRound ) + " ms/round, " + ConvertNumberToString( numLinearResends / RELIABILITY_BENCHMARK_ROUNDS ) + " resends/round" );
+	out_resultLines.push_back( "Reliability window: " + ConvertNumberToString( windowMillisecondsPerRound ) + " ms/round, " + ConvertNumberToString( numWindowResends / RELIABILITY_BENCHMARK_ROUNDS ) + " resends/round" );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// One frame of a full room: seven remote GameUpdates plus the odd Fire/Hit, with neighbours swapped
+// the way a jittery path delivers them.
+static void BuildReorderBenchmarkFrame( int frameIndex, std::vector< FinalPacket >& out_packets )
+{
+	PacketNumber firstNumber = 1000 + frameIndex * REORDER_BENCHMARK_PACKETS_PER_FRAME;
+	for( int packetIndex = 0; packetIndex < REORDER_BENCHMARK_PACKETS_PER_FRAME; ++packetIndex )
+	{
+		PacketType type = ( packetIndex % 8 == 7 ) ? TYPE_Fire : TYPE_GameUpdate;
+		out_packets.push_back( MakeBenchmarkPacket( type, firstNumber + packetIndex, 5000.0 + frameIndex * 0.016 ) );
+	}
+
+	for( int packetIndex = 1; packetIndex < REORDER_BENCHMARK_PACKETS_PER_FRAME; packetIndex += 3 )
+	{
+		FinalPacket swapped = out_packets[ packetIndex ];
+		out_packets[ packetIndex ] = out_packets[ packetIndex - 1 ];
+		out_packets[ packetIndex - 1 ] = swapped;
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RunReorderBufferBenchmark( std::vector< std::string >& out_resultLines )
+{
+	std::vector< FinalPacket > packets;
+	BuildReorderBenchmarkFrame( 0, packets );
+
+	// The checksum keeps the optimizer from discarding the dispatch loops
+	unsigned int setChecksum = 0;
+	size_t numAllocationsBefore = GetNumAllocationsMade();
+	double startTime = GetCurrentTimeSeconds();
+	for( int frameIndex = 0; frameIndex < REORDER_BENCHMARK_FRAMES; ++frameIndex )
+	{
+		std::set< FinalPacket > recvPackets;
+		for( unsigned int packetIndex = 0; packetIndex < packets.size(); ++packetIndex )
+		{
+			recvPackets.insert( packets[ packetIndex ] );
+		}
+
+		std::set< FinalPacket >::iterator setIter;
+		for( setIter = recvPackets.begin(); setIter != recvPackets.end(); ++setIter )
+		{
+			setChecksum = setChecksum * 31 + setIter->number;
+		}
+	}
+	double setSeconds = GetCurrentTimeSeconds() - startTime;
+	size_t numSetAllocations = GetNumAllocationsMade() - numAllocationsBefore;
+
+	ReorderBuffer* reorderBuffer = new ReorderBuffer();
+	unsigned int bufferChecksum = 0;
+	numAllocationsBefore = GetNumAllocationsMade();
+	startTime = GetCurrentTimeSeconds();
+	for( int frameIndex = 0; frameIndex < REORDER_BENCHMARK_FRAMES; ++frameIndex )
+	{
+		reorderBuffer->Clear();
+		for( unsigned int packetIndex = 0; packetIndex < packets.size(); ++packetIndex )
+		{
+			reorderBuffer->AddPacket( packets[ packetIndex ] );
+		}
+
+		for( int packetIndex = 0; packetIndex < reorderBuffer->GetNumPackets(); ++packetIndex )
+		{
+			bufferChecksum = bufferChecksum * 31 + reorderBuffer->GetPacket( packetIndex ).number;
+		}
+	}
+	double bufferSeconds = GetCurrentTimeSeconds() - startTime;
+	size_t numBufferAllocations = GetNumAllocationsMade() - numAllocationsBefore;
+	delete reorderBuffer;
+
+	double numPackets = (double) REORDER_BENCHMARK_FRAMES * REORDER_BENCHMARK_PACKETS_PER_FRAME;
+	out_resultLines.push_back( ConvertNumberToString( REORDER_BENCHMARK_PACKETS_PER_FRAME ) + " packets/frame, " + ConvertNumberToString( REORDER_BENCHMARK_FRAMES ) + " frames" );
+	out_resultLines.push_back( "std::set: " + ConvertNumberToString( setSeconds * 1000000000.0 / numPackets ) + " ns/packet, " + ConvertNumberToString( (double) numSetAllocations / REORDER_BENCHMARK_FRAMES ) + " allocations/frame" );
+	out_resultLines.push_back( "Reorder buffer: " + ConvertNumberToString( bufferSeconds * 1000000000.0 / numPackets ) + " ns/packet, " + ConvertNumberToString( (double) numBufferAllocations / REORDER_BENCHMARK_FRAMES ) + " allocations/frame" );
+	out_resultLines.push_back( std::string( "Dispatch order " ) + ( ( setChecksum == bufferChecksum ) ? "matches" : "DIFFERS" ) );
+}
\ No newline at end of file
@@ -0,0 +1,27 @@
+#ifndef include_NetworkBenchmarks
+#define include_NetworkBenchmarks
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include <string>
+#include <vector>
+
+
+//-----------------------------------------------------------------------------------------------
+const int SERIALIZER_BENCHMARK_ITERATIONS = 200000;
+const int UDP_IP_HEADER_SIZE_BYTES = 28;
+const int RELIABILITY_BENCHMARK_OUTSTANDING_PACKETS = 10000;
+const int RELIABILITY_BENCHMARK_ROUNDS = 5;
+const int RELIABILITY_BENCHMARK_LOSS_INTERVAL = 10;
+const int REORDER_BENCHMARK_FRAMES = 20000;
+const int REORDER_BENCHMARK_PACKETS_PER_FRAME = 24;
+
+
+//-----------------------------------------------------------------------------------------------
+// Each benchmark appends human-readable result lines for the developer console.
+void RunSerializerBenchmark( std::vector< std::string >& out_resultLines );
+void RunReliabilityWindowBenchmark( std::vector< std::string >& out_resultLines );
+void RunReorderBufferBenchmark( std::vector< std::string >& out_resultLines );
+
+
+#endif // include_NetworkBenchmarks
\ No newline at end of file
@@ -0,0 +1,341 @@
+#include "NetworkConditioner.hpp"
+#include <string.h>
+#include "../Engine/NewMacroDef.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+NetworkConditions::NetworkConditions()
+	: m_latencySeconds( 0.0 )
+	, m_jitterSeconds( 0.0 )
+	, m_lossPercentage( 0.f )
+	, m_reorderPercentage( 0.f )
+	, m_duplicatePercentage( 0.f )
+	, m_bandwidthBytesPerSecond( 0 )
+{
+
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool NetworkConditions::IsImpaired() const
+{
+	return m_latencySeconds > 0.0 || m_jitterSeconds > 0.0 || m_lossPercentage > 0.f || m_reorderPercentage > 0.f
+		|| m_duplicatePercentage > 0.f || m_bandwidthBytesPerSecond > 0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+NetworkConditioner::NetworkConditioner( unsigned int seed )
+	: m_slots( nullptr )
+	, m_freeSlotIndices( nullptr )
+	, m_numFreeSlots( 0 )
+	, m_releaseHeap( nullptr )
+	, m_numHeld( 0 )
+	, m_nextSubmitNumber( 0 )
+	, m_timeLinkIsFree( 0.0 )
+	, m_latestInOrderReleaseTime( 0.0 )
+	, m_randomState( seed != 0 ? seed : 1 )
+	, m_numDropped( 0 )
+	, m_numOverflowDropped( 0 )
+	, m_numDuplicated( 0 )
+	, m_numReordered( 0 )
+{
+
+}
+
+
+//-----------------------------------------------------------------------------------------------
+NetworkConditioner::~NetworkConditioner()
+{
+	delete[] m_slots;
+	delete[] m_freeSlotIndices;
+	delete[] m_releaseHeap;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Datagrams already held keep the release times they were given; only new ones see the change.
+void NetworkConditioner::SetConditions( const NetworkConditions& conditions )
+{
+	m_conditions = conditions;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+const NetworkConditions& NetworkConditioner::GetConditions() const
+{
+	return m_conditions;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Stays active after the conditions are cleared until the datagrams it holds have drained.
+bool NetworkConditioner::IsActive() const
+{
+	return m_conditions.IsImpaired() || m_numHeld > 0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void NetworkConditioner::Clear()
+{
+	m_numHeld = 0;
+	m_numFreeSlots = ( m_slots != nullptr ) ? NETWORK_CONDITIONER_CAPACITY : 0;
+	for( int slotIndex = 0; slotIndex < m_numFreeSlots; ++slotIndex )
+	{
+		m_freeSlotIndices[ slotIndex ] = slotIndex;
+	}
+
+	m_timeLinkIsFree = 0.0;
+	m_latestInOrderReleaseTime = 0.0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void NetworkConditioner::SubmitDatagram( const char* data, int numBytes, double currentTimeSeconds )
+{
+	if( RollPercentage( m_conditions.m_lossPercentage ) )
+	{
+		++m_numDropped;
+		return;
+	}
+
+	double departureTime = currentTimeSeconds;
+	if( m_conditions.m_bandwidthBytesPerSecond > 0 )
+	{
+		if( m_timeLinkIsFree > currentTimeSeconds + MAX_BANDWIDTH_QUEUE_SECONDS )
+		{
+			++m_numOverflowDropped;
+			return;
+		}
+
+		if( departureTime < m_timeLinkIsFree )
+			departureTime = m_timeLinkIsFree;
+
+		departureTime += (double) numBytes / (double) m_conditions.m_bandwidthBytesPerSecond;
+		m_timeLinkIsFree = departureTime;
+	}
+
+	int numCopies = 1;
+	if( RollPercentage( m_conditions.m_duplicatePercentage ) )
+	{
+		++m_numDuplicated;
+		numCopies = 2;
+	}
+
+	for( int copyIndex = 0; copyIndex < numCopies; ++copyIndex )
+	{
+		double releaseTime = departureTime + GetDelaySeconds();
+		if( RollPercentage( m_conditions.m_reorderPercentage ) )
+		{
+			++m_numReordered;
+			releaseTime += NETWORK_REORDER_DELAY_SECONDS;
+		}
+		else
+		{
+			if( releaseTime < m_latestInOrderReleaseTime )
+				releaseTime = m_latestInOrderReleaseTime;
+
+			m_latestInOrderReleaseTime = releaseTime;
+		}
+
+		if( !HoldDatagram( data, numBytes, releaseTime ) )
+			++m_numOverflowDropped;
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// The release time is when the simulated link delivered the datagram, which is usually before now.
+bool NetworkConditioner::PopReadyDatagram( double currentTimeSeconds, char* out_data, int maxNumBytes, int& out_numBytes, double* out_releaseTimeSeconds )
+{
+	if( m_numHeld == 0 || m_slots[ m_releaseHeap[ 0 ] ].m_releaseTimeSeconds > currentTimeSeconds )
+		return false;
+
+	int slotIndex = m_releaseHeap[ 0 ];
+	const HeldDatagram& datagram = m_slots[ slotIndex ];
+	int numBytesToCopy = ( datagram.m_numBytes < maxNumBytes ) ? datagram.m_numBytes : maxNumBytes;
+	memcpy( out_data, datagram.m_data, numBytesToCopy );
+
+	out_numBytes = numBytesToCopy;
+	if( out_releaseTimeSeconds != nullptr )
+		*out_releaseTimeSeconds = datagram.m_releaseTimeSeconds;
+
+	--m_numHeld;
+	m_releaseHeap[ 0 ] = m_releaseHeap[ m_numHeld ];
+	SiftDown( 0 );
+	m_freeSlotIndices[ m_numFreeSlots ] = slotIndex;
+	++m_numFreeSlots;
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Returns false if there is no datagram held.
+bool NetworkConditioner::GetNextReleaseTime( double& out_releaseTimeSeconds ) const
+{
+	if( m_numHeld == 0 )
+		return false;
+
+	out_releaseTimeSeconds = m_slots[ m_releaseHeap[ 0 ] ].m_releaseTimeSeconds;
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+int NetworkConditioner::GetNumHeldDatagrams() const
+{
+	return m_numHeld;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+int NetworkConditioner::GetNumDropped() const
+{
+	return m_numDropped;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+int NetworkConditioner::GetNumOverflowDropped() const
+{
+	return m_numOverflowDropped;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+int NetworkConditioner::GetNumDuplicated() const
+{
+	return m_numDuplicated;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+int NetworkConditioner::GetNumReordered() const
+{
+	return m_numReordered;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Copies the datagram into a free slot of the pool and queues it for release. Returns false if the
+// pool is full or the datagram will not fit a slot.
+bool NetworkConditioner::HoldDatagram( const char* data, int numBytes, double releaseTimeSeconds )
+{
+	if( m_slots == nullptr )
+	{
+		m_slots = new HeldDatagram[ NETWORK_CONDITIONER_CAPACITY ];
+		m_freeSlotIndices = new int[ NETWORK_CONDITIONER_CAPACITY ];
+		m_releaseHeap = new int[ NETWORK_CONDITIONER_CAPACITY ];
+		for( int slotIndex = 0; slotIndex < NETWORK_CONDITIONER_CAPACITY; ++slotIndex )
+		{
+			m_freeSlotIndices[ slotIndex ] = slotIndex;
+		}
+
+		m_numFreeSlots = NETWORK_CONDITIONER_CAPACITY;
+	}
+
+	if( m_numFreeSlots == 0 || numBytes > MAX_CONDITIONED_DATAGRAM_BYTES )
+		return false;
+
+	--m_numFreeSlots;
+	int slotIndex = m_freeSlotIndices[ m_numFreeSlots ];
+	HeldDatagram& datagram = m_slots[ slotIndex ];
+	memcpy( datagram.m_data, data, numBytes );
+	datagram.m_numBytes = numBytes;
+	datagram.m_releaseTimeSeconds = releaseTimeSeconds;
+	datagram.m_submitNumber = m_nextSubmitNumber++;
+
+	m_releaseHeap[ m_numHeld ] = slotIndex;
+	++m_numHeld;
+	SiftUp( m_numHeld - 1 );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Submit numbers are compared by their wrapped difference, as packet numbers are.
+bool NetworkConditioner::IsReleasedBefore( int slotIndex, int otherSlotIndex ) const
+{
+	const HeldDatagram& datagram = m_slots[ slotIndex ];
+	const HeldDatagram& otherDatagram = m_slots[ otherSlotIndex ];
+	if( datagram.m_releaseTimeSeconds != otherDatagram.m_releaseTimeSeconds )
+		return datagram.m_releaseTimeSeconds < otherDatagram.m_releaseTimeSeconds;
+
+	return (int) ( datagram.m_submitNumber - otherDatagram.m_submitNumber ) < 0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void NetworkConditioner::SiftUp( int heapIndex )
+{
+	while( heapIndex > 0 )
+	{
+		int parentIndex = ( heapIndex - 1 ) / 2;
+		if( !IsReleasedBefore( m_releaseHeap[ heapIndex ], m_releaseHeap[ parentIndex ] ) )
+			return;
+
+		int swappedSlotIndex = m_releaseHeap[ parentIndex ];
+		m_releaseHeap[ parentIndex ] = m_releaseHeap[ heapIndex ];
+		m_releaseHeap[ heapIndex ] = swappedSlotIndex;
+		heapIndex = parentIndex;
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void NetworkConditioner::SiftDown( int heapIndex )
+{
+	while( true )
+	{
+		int earliestIndex = heapIndex;
+		int leftChildIndex = heapIndex * 2 + 1;
+		int rightChildIndex = leftChildIndex + 1;
+		if( leftChildIndex < m_numHeld && IsReleasedBefore( m_releaseHeap[ leftChildIndex ], m_releaseHeap[ earliestIndex ] ) )
+			earliestIndex = leftChildIndex;
+
+		if( rightChildIndex < m_numHeld && IsReleasedBefore( m_releaseHeap[ rightChildIndex ], m_releaseHeap[ earliestIndex ] ) )
+			earliestIndex = rightChildIndex;
+
+		if( earliestIndex == heapIndex )
+			return;
+
+		int swappedSlotIndex = m_releaseHeap[ earliestIndex ];
+		m_releaseHeap[ earliestIndex ] = m_releaseHeap[ heapIndex ];
+		m_releaseHeap[ heapIndex ] = swappedSlotIndex;
+		heapIndex = earliestIndex;
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Jitter is uniform in +/- m_jitterSeconds around the latency.
+double NetworkConditioner::GetDelaySeconds()
+{
+	double delaySeconds = m_conditions.m_latencySeconds;
+	if( m_conditions.m_jitterSeconds > 0.0 )
+		delaySeconds += m_conditions.m_jitterSeconds * ( 2.0 * GetRandomZeroToOne() - 1.0 );
+
+	return ( delaySeconds > 0.0 ) ? delaySeconds : 0.0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool NetworkConditioner::RollPercentage( float percentage )
+{
+	if( percentage <= 0.f )
+		return false;
+
+	return GetRandomZeroToOne() * 100.f < percentage;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// xorshift32, so each client (and each headless bot thread) has its own repeatable sequence.
+float NetworkConditioner::GetRandomZeroToOne()
+{
+	m_randomState ^= m_randomState << 13;
+	m_randomState ^= m_randomState >> 17;
+	m_randomState ^= m_randomState << 5;
+	return (float) ( m_randomState >> 8 ) / (float) ( 1 << 24 );
+}
\ No newline at end of file
@@ -0,0 +1,96 @@
+#ifndef include_NetworkConditioner
+#define include_NetworkConditioner
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+const double NETWORK_REORDER_DELAY_SECONDS = 0.05;
+const int NETWORK_CONDITIONER_CAPACITY = 128;
+const int MAX_CONDITIONED_DATAGRAM_BYTES = 1472; // the largest datagram UDPClient sends or receives
+const double MAX_BANDWIDTH_QUEUE_SECONDS = 1.0;
+const unsigned int OUTGOING_CONDITIONER_SEED = 0x2545F491u;
+const unsigned int INCOMING_CONDITIONER_SEED = 0x9E3779B9u;
+
+
+//-----------------------------------------------------------------------------------------------
+// Impairments for one direction of traffic. Latency is one-way, so it shows up twice in the RTT.
+// A bandwidth of 0 means uncapped.
+struct NetworkConditions
+{
+	NetworkConditions();
+	bool IsImpaired() const;
+
+	double	m_latencySeconds;
+	double	m_jitterSeconds;
+	float	m_lossPercentage;
+	float	m_reorderPercentage;
+	float	m_duplicatePercentage;
+	int		m_bandwidthBytesPerSecond;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+// The submit number breaks ties between equal release times, so they leave in the order they came.
+struct HeldDatagram
+{
+	char			m_data[ MAX_CONDITIONED_DATAGRAM_BYTES ];
+	int				m_numBytes;
+	double			m_releaseTimeSeconds;
+	unsigned int	m_submitNumber;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+// Holds datagrams until a simulated link would have delivered them. Under a bandwidth cap each
+// datagram waits for the ones ahead of it to be serialized, and the queue tail-drops once it is
+// MAX_BANDWIDTH_QUEUE_SECONDS deep. Jitter alone never reorders: like a real link, a datagram is
+// not delivered before the one sent ahead of it. Reordering is its own rate, and a reordered
+// datagram is held NETWORK_REORDER_DELAY_SECONDS longer so later ones overtake it.
+// Held datagrams live in a fixed pool of NETWORK_CONDITIONER_CAPACITY slots, allocated on the first
+// submit, ordered by a binary heap of slot indices; a full pool drops like a full router queue.
+class NetworkConditioner
+{
+public:
+	explicit NetworkConditioner( unsigned int seed );
+	~NetworkConditioner();
+	void SetConditions( const NetworkConditions& conditions );
+	const NetworkConditions& GetConditions() const;
+	bool IsActive() const;
+	void Clear();
+	void SubmitDatagram( const char* data, int numBytes, double currentTimeSeconds );
+	bool PopReadyDatagram( double currentTimeSeconds, char* out_data, int maxNumBytes, int& out_numBytes, double* out_releaseTimeSeconds = nullptr );
+	bool GetNextReleaseTime( double& out_releaseTimeSeconds ) const;
+	int GetNumHeldDatagrams() const;
+	int GetNumDropped() const;
+	int GetNumOverflowDropped() const;
+	int GetNumDuplicated() const;
+	int GetNumReordered() const;
+
+private:
+	NetworkConditioner( const NetworkConditioner& );
+	NetworkConditioner& operator=( const NetworkConditioner& );
+	bool HoldDatagram( const char* data, int numBytes, double releaseTimeSeconds );
+	bool IsReleasedBefore( int slotIndex, int otherSlotIndex ) const;
+	void SiftUp( int heapIndex );
+	void SiftDown( int heapIndex );
+	double GetDelaySeconds();
+	bool RollPercentage( float percentage );
+	float GetRandomZeroToOne();
+
+	NetworkConditions	m_conditions;
+	HeldDatagram*		m_slots;
+	int*				m_freeSlotIndices;
+	int					m_numFreeSlots;
+	int*				m_releaseHeap;
+	int					m_numHeld;
+	unsigned int		m_nextSubmitNumber;
+	double				m_timeLinkIsFree;
+	double				m_latestInOrderReleaseTime;
+	unsigned int		m_randomState;
+	int					m_numDropped;
+	int					m_numOverflowDropped;
+	int					m_numDuplicated;
+	int					m_numReordered;
+};
+
+
+#endif // include_NetworkConditioner
\ No newline at end of file
@@ -0,0 +1,331 @@
+#include "PacketCapture.hpp"
+#include <string.h>
+#include "TankInput.hpp"
+#include "../Engine/Time.hpp"
+#include "../Engine/NewMacroDef.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+static void WriteUint16( unsigned char* out_bytes, unsigned short value )
+{
+	out_bytes[ 0 ] = (unsigned char) ( value & 0xFF );
+	out_bytes[ 1 ] = (unsigned char) ( value >> 8 );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static void WriteUint32( unsigned char* out_bytes, unsigned int value )
+{
+	for( int byteIndex = 0; byteIndex < 4; ++byteIndex )
+	{
+		out_bytes[ byteIndex ] = (unsigned char) ( ( value >> ( 8 * byteIndex ) ) & 0xFF );
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static unsigned short ReadUint16( const unsigned char* bytes )
+{
+	return (unsigned short) ( bytes[ 0 ] | ( bytes[ 1 ] << 8 ) );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static unsigned int ReadUint32( const unsigned char* bytes )
+{
+	unsigned int value = 0;
+	for( int byteIndex = 0; byteIndex < 4; ++byteIndex )
+	{
+		value |= (unsigned int) bytes[ byteIndex ] << ( 8 * byteIndex );
+	}
+
+	return value;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static void WriteFloat( unsigned char* out_bytes, float value )
+{
+	unsigned int bits;
+	memcpy( &bits, &value, sizeof( bits ) );
+	WriteUint32( out_bytes, bits );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static float ReadFloat( const unsigned char* bytes )
+{
+	unsigned int bits = ReadUint32( bytes );
+	float value;
+	memcpy( &value, &bits, sizeof( value ) );
+	return value;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static void WriteDouble( unsigned char* out_bytes, double value )
+{
+	unsigned long long bits;
+	memcpy( &bits, &value, sizeof( bits ) );
+	WriteUint32( out_bytes, (unsigned int) ( bits & 0xFFFFFFFF ) );
+	WriteUint32( out_bytes + 4, (unsigned int) ( bits >> 32 ) );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static double ReadDouble( const unsigned char* bytes )
+{
+	unsigned long long bits = (unsigned long long) ReadUint32( bytes ) | ( (unsigned long long) ReadUint32( bytes + 4 ) << 32 );
+	double value;
+	memcpy( &value, &bits, sizeof( value ) );
+	return value;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+PacketCaptureWriter::PacketCaptureWriter()
+	: m_file( nullptr )
+	, m_startTimeSeconds( 0.0 )
+	, m_lastRecordMicroseconds( 0 )
+	, m_numRecordsWritten( 0 )
+{
+
+}
+
+
+//-----------------------------------------------------------------------------------------------
+PacketCaptureWriter::~PacketCaptureWriter()
+{
+	Close();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool PacketCaptureWriter::Open( const std::string& fileName )
+{
+	Close();
+
+	m_file = fopen( fileName.c_str(), "wb" );
+	if( m_file == nullptr )
+		return false;
+
+	m_startTimeSeconds = GetCurrentTimeSeconds();
+	m_lastRecordMicroseconds = 0;
+	m_numRecordsWritten = 0;
+	m_buffer.clear();
+	m_buffer.reserve( PACKET_CAPTURE_WRITE_BUFFER_SIZE_BYTES );
+
+	unsigned char header[ PACKET_CAPTURE_HEADER_SIZE_BYTES ];
+	memcpy( header, PACKET_CAPTURE_MAGIC, sizeof( PACKET_CAPTURE_MAGIC ) );
+	WriteUint16( header + 4, PACKET_CAPTURE_VERSION );
+	WriteUint16( header + 6, 0 );
+	WriteDouble( header + 8, m_startTimeSeconds );
+	m_buffer.insert( m_buffer.end(), header, header + PACKET_CAPTURE_HEADER_SIZE_BYTES );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void PacketCaptureWriter::Close()
+{
+	if( m_file == nullptr )
+		return;
+
+	FlushBuffer();
+	fclose( m_file );
+	m_file = nullptr;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool PacketCaptureWriter::IsOpen() const
+{
+	return m_file != nullptr;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void PacketCaptureWriter::WriteFrame( float deltaSeconds )
+{
+	unsigned char payload[ 4 ];
+	WriteFloat( payload, deltaSeconds );
+	WriteRecord( CAPTURE_Frame, payload, sizeof( payload ) );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void PacketCaptureWriter::WriteInput( const TankInput& input )
+{
+	unsigned char payload[ PACKET_CAPTURE_INPUT_SIZE_BYTES ];
+	payload[ 0 ] = (unsigned char) (signed char) input.m_turnDirection;
+	WriteFloat( payload + 1, input.m_throttle );
+	payload[ 5 ] = input.m_isFiring ? 1 : 0;
+	payload[ 6 ] = input.m_requestedRoom;
+	WriteRecord( CAPTURE_Input, payload, sizeof( payload ) );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void PacketCaptureWriter::WriteDatagram( CaptureRecordType type, const char* data, int numBytes )
+{
+	WriteRecord( type, (const unsigned char*) data, numBytes );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+int PacketCaptureWriter::GetNumRecordsWritten() const
+{
+	return m_numRecordsWritten;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void PacketCaptureWriter::WriteRecord( CaptureRecordType type, const unsigned char* payload, int numBytes )
+{
+	if( m_file == nullptr || numBytes < 0 || numBytes > 0xFFFF )
+		return;
+
+	double secondsSinceStart = GetCurrentTimeSeconds() - m_startTimeSeconds;
+	unsigned long long recordMicroseconds = ( secondsSinceStart > 0.0 ) ? (unsigned long long) ( secondsSinceStart * 1000000.0 ) : 0;
+	if( recordMicroseconds < m_lastRecordMicroseconds )
+		recordMicroseconds = m_lastRecordMicroseconds;
+
+	// Gaps longer than a u32 of microseconds (71 minutes) are clamped
+	unsigned long long deltaMicroseconds = recordMicroseconds - m_lastRecordMicroseconds;
+	if( deltaMicroseconds > 0xFFFFFFFFull )
+		deltaMicroseconds = 0xFFFFFFFFull;
+
+	m_lastRecordMicroseconds += deltaMicroseconds;
+
+	unsigned char recordHeader[ PACKET_CAPTURE_RECORD_HEADER_SIZE_BYTES ];
+	recordHeader[ 0 ] = (unsigned char) type;
+	WriteUint32( recordHeader + 1, (unsigned int) deltaMicroseconds );
+	WriteUint16( recordHeader + 5, (unsigned short) numBytes );
+	m_buffer.insert( m_buffer.end(), recordHeader, recordHeader + PACKET_CAPTURE_RECORD_HEADER_SIZE_BYTES );
+	m_buffer.insert( m_buffer.end(), payload, payload + numBytes );
+	++m_numRecordsWritten;
+
+	if( m_buffer.size() >= (size_t) PACKET_CAPTURE_WRITE_BUFFER_SIZE_BYTES )
+		FlushBuffer();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void PacketCaptureWriter::FlushBuffer()
+{
+	if( !m_buffer.empty() )
+		fwrite( &m_buffer[ 0 ], 1, m_buffer.size(), m_file );
+
+	m_buffer.clear();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+PacketCaptureReader::PacketCaptureReader()
+	: m_readOffset( 0 )
+	, m_startTimeSeconds( 0.0 )
+	, m_elapsedMicroseconds( 0 )
+{
+
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool PacketCaptureReader::Open( const std::string& fileName )
+{
+	m_data.clear();
+
+	FILE* file = fopen( fileName.c_str(), "rb" );
+	if( file == nullptr )
+		return false;
+
+	unsigned char chunk[ 4096 ];
+	size_t numBytesRead;
+	while( ( numBytesRead = fread( chunk, 1, sizeof( chunk ), file ) ) > 0 )
+	{
+		m_data.insert( m_data.end(), chunk, chunk + numBytesRead );
+	}
+
+	fclose( file );
+
+	if( m_data.size() < (size_t) PACKET_CAPTURE_HEADER_SIZE_BYTES || memcmp( &m_data[ 0 ], PACKET_CAPTURE_MAGIC, sizeof( PACKET_CAPTURE_MAGIC ) ) != 0
+		|| ReadUint16( &m_data[ 4 ] ) != PACKET_CAPTURE_VERSION )
+	{
+		m_data.clear();
+		return false;
+	}
+
+	m_startTimeSeconds = ReadDouble( &m_data[ 8 ] );
+	Rewind();
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Returns false at the end of the capture, including on a record cut short by a crash mid-write.
+bool PacketCaptureReader::ReadNextRecord( CaptureRecord& out_record )
+{
+	if( m_readOffset + PACKET_CAPTURE_RECORD_HEADER_SIZE_BYTES > m_data.size() )
+		return false;
+
+	const unsigned char* recordHeader = &m_data[ m_readOffset ];
+	int numBytes = ReadUint16( recordHeader + 5 );
+	if( m_readOffset + PACKET_CAPTURE_RECORD_HEADER_SIZE_BYTES + numBytes > m_data.size() )
+		return false;
+
+	m_elapsedMicroseconds += ReadUint32( recordHeader + 1 );
+
+	out_record.m_type = (CaptureRecordType) recordHeader[ 0 ];
+	out_record.m_timeSeconds = m_startTimeSeconds + m_elapsedMicroseconds * 0.000001;
+	out_record.m_payload = recordHeader + PACKET_CAPTURE_RECORD_HEADER_SIZE_BYTES;
+	out_record.m_numBytes = numBytes;
+
+	m_readOffset += PACKET_CAPTURE_RECORD_HEADER_SIZE_BYTES + numBytes;
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void PacketCaptureReader::Rewind()
+{
+	m_readOffset = PACKET_CAPTURE_HEADER_SIZE_BYTES;
+	m_elapsedMicroseconds = 0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+double PacketCaptureReader::GetStartTimeSeconds() const
+{
+	return m_startTimeSeconds;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+int PacketCaptureReader::GetNumBytes() const
+{
+	return (int) m_data.size();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+float DecodeCapturedFrame( const CaptureRecord& frameRecord )
+{
+	if( frameRecord.m_numBytes < 4 )
+		return 0.f;
+
+	return ReadFloat( frameRecord.m_payload );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void DecodeCapturedInput( const CaptureRecord& inputRecord, TankInput& out_input )
+{
+	out_input = TankInput();
+	if( inputRecord.m_numBytes < PACKET_CAPTURE_INPUT_SIZE_BYTES )
+		return;
+
+	out_input.m_turnDirection = (signed char) inputRecord.m_payload[ 0 ];
+	out_input.m_throttle = ReadFloat( inputRecord.m_payload + 1 );
+	out_input.m_isFiring = inputRecord.m_payload[ 5 ] != 0;
+	out_input.m_requestedRoom = inputRecord.m_payload[ 6 ];
+}
\ No newline at end of file
@@ -0,0 +1,105 @@
+#ifndef include_PacketCapture
+#define include_PacketCapture
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+
+//-----------------------------------------------------------------------------------------------
+struct TankInput;
+
+
+//-----------------------------------------------------------------------------------------------
+// File layout, all little-endian:
+//	header:	'F' 'P' 'C' 'P', u16 version, u16 reserved, f64 capture start time (game clock seconds)
+//	record:	u8 type, u32 microseconds since the previous record, u16 payload size, payload
+// Each World::Update starts with a Frame record (payload f32 deltaSeconds), followed by the Incoming
+// datagrams World consumed and the frame's Input (i8 turn, f32 throttle, u8 firing, u8 requested
+// room), with the Outgoing datagrams World queued mixed in wherever they were sent.
+const unsigned char PACKET_CAPTURE_MAGIC[ 4 ] = { 'F', 'P', 'C', 'P' };
+const unsigned short PACKET_CAPTURE_VERSION = 1;
+const int PACKET_CAPTURE_HEADER_SIZE_BYTES = 16;
+const int PACKET_CAPTURE_RECORD_HEADER_SIZE_BYTES = 7;
+const int PACKET_CAPTURE_INPUT_SIZE_BYTES = 7;
+const int PACKET_CAPTURE_WRITE_BUFFER_SIZE_BYTES = 64 * 1024;
+
+
+//-----------------------------------------------------------------------------------------------
+enum CaptureRecordType
+{
+	CAPTURE_Frame = 1,
+	CAPTURE_Incoming = 2,
+	CAPTURE_Outgoing = 3,
+	CAPTURE_Input = 4,
+};
+
+
+//-----------------------------------------------------------------------------------------------
+struct CaptureRecord
+{
+	CaptureRecordType		m_type;
+	double					m_timeSeconds;
+	const unsigned char*	m_payload;
+	int						m_numBytes;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+// Appends records to a capture file through a write buffer, so capturing costs a memcpy per
+// datagram and a disk write every PACKET_CAPTURE_WRITE_BUFFER_SIZE_BYTES.
+class PacketCaptureWriter
+{
+public:
+	PacketCaptureWriter();
+	~PacketCaptureWriter();
+	bool Open( const std::string& fileName );
+	void Close();
+	bool IsOpen() const;
+	void WriteFrame( float deltaSeconds );
+	void WriteInput( const TankInput& input );
+	void WriteDatagram( CaptureRecordType type, const char* data, int numBytes );
+	int GetNumRecordsWritten() const;
+
+private:
+	PacketCaptureWriter( const PacketCaptureWriter& );
+	PacketCaptureWriter& operator=( const PacketCaptureWriter& );
+	void WriteRecord( CaptureRecordType type, const unsigned char* payload, int numBytes );
+	void FlushBuffer();
+
+	FILE*							m_file;
+	std::vector< unsigned char >	m_buffer;
+	double							m_startTimeSeconds;
+	unsigned long long				m_lastRecordMicroseconds;
+	int								m_numRecordsWritten;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+// Loads a whole capture into memory up front, so replays measure World rather than the disk.
+class PacketCaptureReader
+{
+public:
+	PacketCaptureReader();
+	bool Open( const std::string& fileName );
+	bool ReadNextRecord( CaptureRecord& out_record );
+	void Rewind();
+	double GetStartTimeSeconds() const;
+	int GetNumBytes() const;
+
+private:
+	std::vector< unsigned char >	m_data;
+	size_t							m_readOffset;
+	double							m_startTimeSeconds;
+	unsigned long long				m_elapsedMicroseconds;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+float DecodeCapturedFrame( const CaptureRecord& frameRecord );
+void DecodeCapturedInput( const CaptureRecord& inputRecord, TankInput& out_input );
+
+
+#endif // include_PacketCapture
\ No newline at end of file
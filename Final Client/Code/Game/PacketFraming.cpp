@@ -0,0 +1,146 @@
+#include "PacketFraming.hpp"
+#include <string.h>
+#include "../Engine/NewMacroDef.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+PacketCoalescer::PacketCoalescer()
+	: m_numPacketBytes( 0 )
+	, m_numPackets( 0 )
+	, m_hasAckBlock( false )
+{
+
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Returns false when the packet would push the datagram past the MTU budget; flush and retry.
+bool PacketCoalescer::AddPacket( const FinalPacket& packet )
+{
+	unsigned char encodedPacket[ MAX_COMPACT_PACKET_SIZE_BYTES ];
+	BitWriter writer( encodedPacket, sizeof( encodedPacket ) );
+	WriteCompactFinalPacket( writer, packet );
+	if( writer.HasOverflowed() )
+		return false;
+
+	return AddEncodedPacket( encodedPacket, writer.GetNumBytesWritten() );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// For packets the caller has already run through WriteCompactFinalPacket or a delta encoder.
+bool PacketCoalescer::AddEncodedPacket( const unsigned char* encodedPacket, int numPacketBytes )
+{
+	if( COALESCED_HEADER_MAX_SIZE_BYTES + m_numPacketBytes + numPacketBytes > MAX_COALESCED_DATAGRAM_SIZE_BYTES )
+		return false;
+
+	if( !m_hasAckBlock )
+		m_datagram[ COALESCED_HEADER_MAX_SIZE_BYTES - 1 ] = WIRE_MARKER_COALESCED;
+
+	memcpy( m_datagram + COALESCED_HEADER_MAX_SIZE_BYTES + m_numPacketBytes, encodedPacket, numPacketBytes );
+	m_numPacketBytes += numPacketBytes;
+	++m_numPackets;
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// May be called at any point before the datagram is read; the latest block wins.
+void PacketCoalescer::SetAckBlock( const AckBlock& ackBlock )
+{
+	m_datagram[ 0 ] = WIRE_MARKER_COALESCED_ACKED;
+	WriteAckBlock( ackBlock, m_datagram + 1 );
+	m_hasAckBlock = true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void PacketCoalescer::Reset()
+{
+	m_numPacketBytes = 0;
+	m_numPackets = 0;
+	m_hasAckBlock = false;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool PacketCoalescer::IsEmpty() const
+{
+	return m_numPackets == 0 && !m_hasAckBlock;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+int PacketCoalescer::GetNumPackets() const
+{
+	return m_numPackets;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+const unsigned char* PacketCoalescer::GetDatagram() const
+{
+	if( m_hasAckBlock )
+		return m_datagram;
+
+	return m_datagram + COALESCED_HEADER_MAX_SIZE_BYTES - 1;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+int PacketCoalescer::GetDatagramSize() const
+{
+	if( m_hasAckBlock )
+		return COALESCED_HEADER_MAX_SIZE_BYTES + m_numPacketBytes;
+
+	return 1 + m_numPacketBytes;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool IsCoalescedDatagram( const unsigned char* datagram, int numBytes )
+{
+	return numBytes > 0 && ( datagram[ 0 ] == WIRE_MARKER_COALESCED || datagram[ 0 ] == WIRE_MARKER_COALESCED_ACKED );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool ReadDatagramAckBlock( const unsigned char* datagram, int numBytes, AckBlock& out_ackBlock )
+{
+	if( numBytes < COALESCED_HEADER_MAX_SIZE_BYTES || datagram[ 0 ] != WIRE_MARKER_COALESCED_ACKED )
+		return false;
+
+	ReadAckBlock( datagram + 1, out_ackBlock );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Splits any supported datagram (legacy raw, single compact, or coalesced) into FinalPackets.
+// Returns how many packets were written to out_packets; a corrupt tail is dropped. Delta GameUpdates
+// only ever arrive coalesced, so snapshotHistory is only consulted for coalesced datagrams.
+int UnpackDatagram( const unsigned char* datagram, int numBytes, FinalPacket* out_packets, int maxPackets, SnapshotHistory* snapshotHistory )
+{
+	if( maxPackets <= 0 )
+		return 0;
+
+	if( !IsCoalescedDatagram( datagram, numBytes ) )
+		return DeserializeFinalPacket( datagram, numBytes, out_packets[ 0 ] ) ? 1 : 0;
+
+	int numHeaderBytes = ( datagram[ 0 ] == WIRE_MARKER_COALESCED_ACKED ) ? COALESCED_HEADER_MAX_SIZE_BYTES : 1;
+	if( numBytes < numHeaderBytes )
+		return 0;
+
+	int numPackets = 0;
+	BitReader reader( datagram + numHeaderBytes, numBytes - numHeaderBytes );
+	while( numPackets < maxPackets && reader.GetNumBytesRemaining() > 0 )
+	{
+		if( !ReadCompactFinalPacket( reader, out_packets[ numPackets ], snapshotHistory ) )
+			break;
+
+		if( out_packets[ numPackets ].type != TYPE_None )
+			++numPackets;
+	}
+
+	return numPackets;
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+#ifndef include_PacketFraming
+#define include_PacketFraming
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include "FinalPacket.hpp"
+#include "SelectiveAck.hpp"
+#include "FinalPacketSerializer.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+// A coalesced datagram is WIRE_MARKER_COALESCED followed by back-to-back compact packets, each
+// padded to a byte boundary. Only sent to peers that advertised CAPABILITY_CoalescedPackets.
+// WIRE_MARKER_COALESCED_ACKED datagrams carry an ACK_BLOCK_SIZE_BYTES AckBlock after the marker.
+const unsigned char WIRE_MARKER_COALESCED = 0xE0 | COMPACT_WIRE_FORMAT_VERSION;
+const unsigned char WIRE_MARKER_COALESCED_ACKED = 0xD0 | COMPACT_WIRE_FORMAT_VERSION;
+const int COALESCED_HEADER_MAX_SIZE_BYTES = 1 + ACK_BLOCK_SIZE_BYTES;
+const int MAX_COALESCED_DATAGRAM_SIZE_BYTES = 1200;
+const int MAX_PACKETS_PER_DATAGRAM = MAX_COALESCED_DATAGRAM_SIZE_BYTES / 4; // smallest compact packet is 4 bytes
+
+
+//-----------------------------------------------------------------------------------------------
+class PacketCoalescer
+{
+public:
+	PacketCoalescer();
+	bool AddPacket( const FinalPacket& packet );
+	bool AddEncodedPacket( const unsigned char* encodedPacket, int numPacketBytes );
+	void SetAckBlock( const AckBlock& ackBlock );
+	void Reset();
+	bool IsEmpty() const;
+	int GetNumPackets() const;
+	const unsigned char* GetDatagram() const;
+	int GetDatagramSize() const;
+
+private:
+	// Packets start after the largest header; the smaller header is written right before them
+	unsigned char	m_datagram[ MAX_COALESCED_DATAGRAM_SIZE_BYTES ];
+	int				m_numPacketBytes;
+	int				m_numPackets;
+	bool			m_hasAckBlock;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+bool IsCoalescedDatagram( const unsigned char* datagram, int numBytes );
+bool ReadDatagramAckBlock( const unsigned char* datagram, int numBytes, AckBlock& out_ackBlock );
+int UnpackDatagram( const unsigned char* datagram, int numBytes, FinalPacket* out_packets, int maxPackets, SnapshotHistory* snapshotHistory = nullptr );
+
+
+#endif // include_PacketFraming
\ No newline at end of file
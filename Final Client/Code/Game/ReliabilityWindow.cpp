@@ -0,0 +1,250 @@
+#include "ReliabilityWindow.hpp"
+#include <math.h>
+#include "../Engine/NewMacroDef.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+// The capacity must be a power of two.
+ReliabilityWindow::ReliabilityWindow( int capacity )
+	: m_entries( capacity )
+	, m_capacityMask( capacity - 1 )
+{
+	Reset();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void ReliabilityWindow::Reset()
+{
+	for( unsigned int entryIndex = 0; entryIndex < m_entries.size(); ++entryIndex )
+	{
+		m_entries[ entryIndex ].m_isOccupied = false;
+	}
+
+	for( int slotIndex = 0; slotIndex < RESEND_TIMER_WHEEL_NUM_SLOTS; ++slotIndex )
+	{
+		m_wheelSlotHeads[ slotIndex ] = INVALID_WINDOW_INDEX;
+	}
+
+	m_lastProcessedTick = -1;
+	m_numOutstandingPackets = 0;
+	m_maxProbeDistance = 0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Only fails if every entry is outstanding; the caller's packet then goes out without a resend
+// guarantee.
+bool ReliabilityWindow::AddPacket( const FinalPacket& packet, double sendTimeSeconds, double resendTimeSeconds )
+{
+	if( m_numOutstandingPackets >= (int) m_entries.size() )
+		return false;
+
+	int homeEntryIndex = GetHomeEntryIndex( packet.number );
+	int probeDistance = 0;
+	while( m_entries[ ( homeEntryIndex + probeDistance ) & m_capacityMask ].m_isOccupied )
+	{
+		++probeDistance;
+	}
+
+	if( probeDistance > m_maxProbeDistance )
+		m_maxProbeDistance = probeDistance;
+
+	int entryIndex = ( homeEntryIndex + probeDistance ) & m_capacityMask;
+	WindowEntry& entry = m_entries[ entryIndex ];
+	entry.m_packet = packet;
+	entry.m_sendTimeSeconds = sendTimeSeconds;
+	entry.m_resendTimeSeconds = resendTimeSeconds;
+	entry.m_numTransmissions = 1;
+	entry.m_isOccupied = true;
+	LinkIntoWheel( entryIndex );
+	++m_numOutstandingPackets;
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// out_sendTimeSeconds is only written for packets sent exactly once, so it is a valid RTT sample.
+bool ReliabilityWindow::RemovePacket( PacketNumber number, double* out_sendTimeSeconds )
+{
+	int entryIndex = FindEntryIndex( number );
+	if( entryIndex == INVALID_WINDOW_INDEX )
+		return false;
+
+	if( out_sendTimeSeconds != nullptr && m_entries[ entryIndex ].m_numTransmissions == 1 )
+		*out_sendTimeSeconds = m_entries[ entryIndex ].m_sendTimeSeconds;
+
+	if( m_entries[ entryIndex ].m_wheelSlot != INVALID_WINDOW_INDEX )
+		UnlinkFromWheel( entryIndex );
+
+	m_entries[ entryIndex ].m_isOccupied = false;
+	--m_numOutstandingPackets;
+
+	// Once the window drains nothing is displaced, so lookups go back to a single slot
+	if( m_numOutstandingPackets == 0 )
+		m_maxProbeDistance = 0;
+
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// out_newestSendTimeSeconds receives the latest send time among acked, never-retransmitted packets.
+int ReliabilityWindow::RemoveAckedPackets( const AckBlock& ackBlock, double* out_newestSendTimeSeconds )
+{
+	int numRemoved = 0;
+	for( int bitIndex = -1; bitIndex < ACK_BITFIELD_NUM_BITS; ++bitIndex )
+	{
+		if( bitIndex >= 0 && ( ackBlock.receivedBits & ( 1u << bitIndex ) ) == 0 )
+			continue;
+
+		double sendTimeSeconds = -1.0;
+		if( !RemovePacket( ackBlock.latestNumber - 1 - bitIndex, &sendTimeSeconds ) )
+			continue;
+
+		++numRemoved;
+		if( out_newestSendTimeSeconds != nullptr && sendTimeSeconds > *out_newestSendTimeSeconds )
+			*out_newestSendTimeSeconds = sendTimeSeconds;
+	}
+
+	return numRemoved;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool ReliabilityWindow::IsOutstanding( PacketNumber number ) const
+{
+	return FindEntryIndex( number ) != INVALID_WINDOW_INDEX;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Appends every packet whose resend time has passed to out_expiredPackets and takes it off the
+// wheel. It stays outstanding; the caller resends it and re-arms it with MarkRetransmitted.
+// Entries more than one wheel revolution out share a slot with nearer ones and are skipped over.
+void ReliabilityWindow::CollectExpiredPackets( double currentTimeSeconds, std::vector< FinalPacket >& out_expiredPackets )
+{
+	long long currentTick = GetWheelTick( currentTimeSeconds );
+	if( m_lastProcessedTick < 0 || currentTick - m_lastProcessedTick > RESEND_TIMER_WHEEL_NUM_SLOTS )
+		m_lastProcessedTick = currentTick - RESEND_TIMER_WHEEL_NUM_SLOTS;
+
+	for( long long tick = m_lastProcessedTick + 1; tick <= currentTick; ++tick )
+	{
+		int entryIndex = m_wheelSlotHeads[ GetWheelSlot( tick ) ];
+		while( entryIndex != INVALID_WINDOW_INDEX )
+		{
+			WindowEntry& entry = m_entries[ entryIndex ];
+			int nextEntryIndex = entry.m_nextInSlot;
+			if( entry.m_resendTimeSeconds <= currentTimeSeconds )
+			{
+				out_expiredPackets.push_back( entry.m_packet );
+				UnlinkFromWheel( entryIndex );
+				entry.m_wheelSlot = INVALID_WINDOW_INDEX;
+			}
+
+			entryIndex = nextEntryIndex;
+		}
+	}
+
+	// The current tick stays open so packets due later within it are not skipped
+	m_lastProcessedTick = currentTick - 1;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void ReliabilityWindow::MarkRetransmitted( PacketNumber number, double sendTimeSeconds, double resendTimeSeconds )
+{
+	int entryIndex = FindEntryIndex( number );
+	if( entryIndex == INVALID_WINDOW_INDEX )
+		return;
+
+	WindowEntry& entry = m_entries[ entryIndex ];
+	if( entry.m_wheelSlot != INVALID_WINDOW_INDEX )
+		UnlinkFromWheel( entryIndex );
+
+	entry.m_sendTimeSeconds = sendTimeSeconds;
+	entry.m_resendTimeSeconds = resendTimeSeconds;
+	++entry.m_numTransmissions;
+	LinkIntoWheel( entryIndex );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+int ReliabilityWindow::GetNumOutstandingPackets() const
+{
+	return m_numOutstandingPackets;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+int ReliabilityWindow::GetHomeEntryIndex( PacketNumber number ) const
+{
+	return (int) ( number & m_capacityMask );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Looks no further from the home slot than any packet has had to be placed since the window was
+// last empty, which is nowhere further at all unless a packet has outlived a whole ring of numbers.
+int ReliabilityWindow::FindEntryIndex( PacketNumber number ) const
+{
+	int homeEntryIndex = GetHomeEntryIndex( number );
+	for( int probeDistance = 0; probeDistance <= m_maxProbeDistance; ++probeDistance )
+	{
+		int entryIndex = ( homeEntryIndex + probeDistance ) & m_capacityMask;
+		const WindowEntry& entry = m_entries[ entryIndex ];
+		if( entry.m_isOccupied && entry.m_packet.number == number )
+			return entryIndex;
+	}
+
+	return INVALID_WINDOW_INDEX;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Masked rather than taken modulo so ticks before the clock's first revolution stay in range.
+int ReliabilityWindow::GetWheelSlot( long long tick ) const
+{
+	return (int) ( tick & ( RESEND_TIMER_WHEEL_NUM_SLOTS - 1 ) );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+long long ReliabilityWindow::GetWheelTick( double timeSeconds ) const
+{
+	return (long long) floor( timeSeconds / RESEND_TIMER_WHEEL_SLOT_SECONDS );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void ReliabilityWindow::LinkIntoWheel( int entryIndex )
+{
+	WindowEntry& entry = m_entries[ entryIndex ];
+	long long deadlineTick = GetWheelTick( entry.m_resendTimeSeconds );
+	if( deadlineTick <= m_lastProcessedTick )
+		deadlineTick = m_lastProcessedTick + 1;
+
+	entry.m_wheelSlot = GetWheelSlot( deadlineTick );
+	entry.m_prevInSlot = INVALID_WINDOW_INDEX;
+	entry.m_nextInSlot = m_wheelSlotHeads[ entry.m_wheelSlot ];
+
+	if( entry.m_nextInSlot != INVALID_WINDOW_INDEX )
+		m_entries[ entry.m_nextInSlot ].m_prevInSlot = entryIndex;
+
+	m_wheelSlotHeads[ entry.m_wheelSlot ] = entryIndex;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void ReliabilityWindow::UnlinkFromWheel( int entryIndex )
+{
+	WindowEntry& entry = m_entries[ entryIndex ];
+
+	if( entry.m_prevInSlot != INVALID_WINDOW_INDEX )
+		m_entries[ entry.m_prevInSlot ].m_nextInSlot = entry.m_nextInSlot;
+	else
+		m_wheelSlotHeads[ entry.m_wheelSlot ] = entry.m_nextInSlot;
+
+	if( entry.m_nextInSlot != INVALID_WINDOW_INDEX )
+		m_entries[ entry.m_nextInSlot ].m_prevInSlot = entry.m_prevInSlot;
+}
\ No newline at end of file
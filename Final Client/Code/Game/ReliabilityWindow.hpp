@@ -0,0 +1,68 @@
+#ifndef include_ReliabilityWindow
+#define include_ReliabilityWindow
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include <vector>
+#include "FinalPacket.hpp"
+#include "SelectiveAck.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+const int RELIABILITY_WINDOW_CAPACITY = 16384; // must be a power of two
+const int HEADLESS_RELIABILITY_WINDOW_CAPACITY = 256; // must be a power of two
+const int RESEND_TIMER_WHEEL_NUM_SLOTS = 256; // must be a power of two
+const double RESEND_TIMER_WHEEL_SLOT_SECONDS = 0.01;
+const int INVALID_WINDOW_INDEX = -1;
+
+
+//-----------------------------------------------------------------------------------------------
+// Outstanding guaranteed packets, indexed by PacketNumber into a ring so acks and naks are O(1).
+// A number whose ring slot is still held by an older packet goes in the next free slot instead.
+// Resend deadlines live in a timer wheel, so each frame only touches the slots that have come due.
+// A retransmit keeps its PacketNumber and window entry; only its send and resend times move.
+// An entry is about a hundred bytes, so the default window is over a megabyte; headless bots,
+// which keep a handful of packets in flight, take a smaller one.
+class ReliabilityWindow
+{
+public:
+	explicit ReliabilityWindow( int capacity = RELIABILITY_WINDOW_CAPACITY );
+	void Reset();
+	bool AddPacket( const FinalPacket& packet, double sendTimeSeconds, double resendTimeSeconds );
+	bool RemovePacket( PacketNumber number, double* out_sendTimeSeconds = nullptr );
+	int RemoveAckedPackets( const AckBlock& ackBlock, double* out_newestSendTimeSeconds = nullptr );
+	bool IsOutstanding( PacketNumber number ) const;
+	void CollectExpiredPackets( double currentTimeSeconds, std::vector< FinalPacket >& out_expiredPackets );
+	void MarkRetransmitted( PacketNumber number, double sendTimeSeconds, double resendTimeSeconds );
+	int GetNumOutstandingPackets() const;
+
+private:
+	struct WindowEntry
+	{
+		FinalPacket	m_packet;
+		double		m_sendTimeSeconds;
+		double		m_resendTimeSeconds;
+		int			m_numTransmissions;
+		int			m_wheelSlot;
+		int			m_prevInSlot;
+		int			m_nextInSlot;
+		bool		m_isOccupied;
+	};
+
+	int GetHomeEntryIndex( PacketNumber number ) const;
+	int FindEntryIndex( PacketNumber number ) const;
+	int GetWheelSlot( long long tick ) const;
+	long long GetWheelTick( double timeSeconds ) const;
+	void LinkIntoWheel( int entryIndex );
+	void UnlinkFromWheel( int entryIndex );
+
+	std::vector< WindowEntry >	m_entries;
+	int							m_capacityMask;
+	int							m_wheelSlotHeads[ RESEND_TIMER_WHEEL_NUM_SLOTS ];
+	long long					m_lastProcessedTick;
+	int							m_numOutstandingPackets;
+	int							m_maxProbeDistance;
+};
+
+
+#endif // include_ReliabilityWindow
\ No newline at end of file
@@ -0,0 +1,59 @@
+#include "ReorderBuffer.hpp"
+#include "SelectiveAck.hpp"
+#include "../Engine/NewMacroDef.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+ReorderBuffer::ReorderBuffer()
+	: m_numPackets( 0 )
+{
+
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Returns false when full; the caller should drain the buffer and add the packet again.
+bool ReorderBuffer::AddPacket( const FinalPacket& packet )
+{
+	if( IsFull() )
+		return false;
+
+	int insertIndex = m_numPackets;
+	while( insertIndex > 0 && IsPacketNumberNewer( m_packets[ insertIndex - 1 ].number, packet.number ) )
+	{
+		m_packets[ insertIndex ] = m_packets[ insertIndex - 1 ];
+		--insertIndex;
+	}
+
+	m_packets[ insertIndex ] = packet;
+	++m_numPackets;
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void ReorderBuffer::Clear()
+{
+	m_numPackets = 0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool ReorderBuffer::IsFull() const
+{
+	return m_numPackets == REORDER_BUFFER_CAPACITY;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+int ReorderBuffer::GetNumPackets() const
+{
+	return m_numPackets;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+const FinalPacket& ReorderBuffer::GetPacket( int packetIndex ) const
+{
+	return m_packets[ packetIndex ];
+}
\ No newline at end of file
@@ -0,0 +1,33 @@
+#ifndef include_ReorderBuffer
+#define include_ReorderBuffer
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include "FinalPacket.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+const int REORDER_BUFFER_CAPACITY = 512;
+
+
+//-----------------------------------------------------------------------------------------------
+// Fixed-capacity list of one frame's received packets, kept sorted by PacketNumber as they arrive.
+// Packets mostly arrive in order, so the insertion sort usually touches only the last element.
+// Packets that share a number are all kept, in arrival order.
+class ReorderBuffer
+{
+public:
+	ReorderBuffer();
+	bool AddPacket( const FinalPacket& packet );
+	void Clear();
+	bool IsFull() const;
+	int GetNumPackets() const;
+	const FinalPacket& GetPacket( int packetIndex ) const;
+
+private:
+	FinalPacket	m_packets[ REORDER_BUFFER_CAPACITY ];
+	int			m_numPackets;
+};
+
+
+#endif // include_ReorderBuffer
\ No newline at end of file
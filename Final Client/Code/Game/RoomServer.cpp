@@ -0,0 +1,491 @@
+#include "RoomServer.hpp"
+#include <string.h>
+#include "../Engine/Time.hpp"
+#include "../Engine/NewMacroDef.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+static bool IsGameRoom( RoomID room )
+{
+	return room != ROOM_Lobby && room != ROOM_None;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static void RoomShardThreadEntryFunc( void* data )
+{
+	static_cast< RoomShard* >( data )->Run();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+RoomServer::RoomServer()
+	: m_secondsPerTick( 1.0 / DEFAULT_SERVER_TICKS_PER_SECOND )
+	, m_numWorkerThreads( 0 )
+	, m_isShuttingDown( 0 )
+	, m_numConnections( 0 )
+	, m_receiveBuffers( nullptr )
+{
+	memset( m_rooms, 0, sizeof( m_rooms ) );
+	for( int roomIndex = 0; roomIndex < SERVER_NUM_ROOMS; ++roomIndex )
+	{
+		m_playersPerRoom[ roomIndex ] = 0;
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+RoomServer::~RoomServer()
+{
+	Shutdown();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Shard 0 is the lobby and runs on this thread; shards 1..numWorkerThreads each get a thread.
+bool RoomServer::Startup( unsigned short portNumber, int ticksPerSecond, int numWorkerThreads, bool isReusingPort )
+{
+	InitializeTime();
+
+	if( !UDPSocket::StartupNetworking() )
+	{
+		return false;
+	}
+
+	if( !m_socket.Open() )
+	{
+		return false;
+	}
+
+	// Without SO_REUSEPORT the workers only simulate; this thread still receives everything
+	if( isReusingPort && numWorkerThreads > 0 )
+		isReusingPort = m_socket.EnableReusePort();
+
+	if( !m_socket.Bind( portNumber ) )
+	{
+		m_socket.Close();
+		return false;
+	}
+
+	m_socket.SetBufferSizes( SERVER_SOCKET_BUFFER_SIZE_BYTES );
+
+	if( m_receiveBuffers == nullptr )
+		m_receiveBuffers = new DatagramBuffer[ MAX_DATAGRAMS_PER_SYSTEM_CALL ];
+
+	if( numWorkerThreads < 0 )
+		numWorkerThreads = 0;
+	else if( numWorkerThreads > MAX_SERVER_WORKER_THREADS )
+		numWorkerThreads = MAX_SERVER_WORKER_THREADS;
+
+	m_secondsPerTick = 1.0 / ticksPerSecond;
+	m_numWorkerThreads = numWorkerThreads;
+	AtomicStore( m_isShuttingDown, 0 );
+
+	for( int shardIndex = 0; shardIndex <= m_numWorkerThreads; ++shardIndex )
+	{
+		UDPSocket* receiveSocket = nullptr;
+		if( isReusingPort && shardIndex != LOBBY_SHARD_INDEX )
+		{
+			receiveSocket = new UDPSocket();
+			if( OpenReusePortSocket( portNumber, *receiveSocket ) )
+			{
+				m_receiveSockets.push_back( receiveSocket );
+			}
+			else
+			{
+				delete receiveSocket;
+				receiveSocket = nullptr;
+			}
+		}
+
+		m_shards.push_back( new RoomShard( *this, shardIndex, receiveSocket ) );
+	}
+
+	m_pendingShardMessages.resize( m_shards.size() );
+	for( int shardIndex = 1; shardIndex <= m_numWorkerThreads; ++shardIndex )
+	{
+		m_workerThreads[ shardIndex - 1 ].Start( RoomShardThreadEntryFunc, m_shards[ shardIndex ] );
+	}
+
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RoomServer::Shutdown()
+{
+	AtomicStore( m_isShuttingDown, 1 );
+	for( unsigned int shardIndex = 0; shardIndex < m_shards.size(); ++shardIndex )
+	{
+		m_shards[ shardIndex ]->WakeUp();
+	}
+
+	for( int threadIndex = 0; threadIndex < MAX_SERVER_WORKER_THREADS; ++threadIndex )
+	{
+		m_workerThreads[ threadIndex ].Join();
+	}
+
+	// Shards flush their last datagrams as they shut down, so the sockets go last
+	for( unsigned int shardIndex = 0; shardIndex < m_shards.size(); ++shardIndex )
+	{
+		delete m_shards[ shardIndex ];
+	}
+
+	m_shards.clear();
+
+	for( unsigned int socketIndex = 0; socketIndex < m_receiveSockets.size(); ++socketIndex )
+	{
+		m_receiveSockets[ socketIndex ]->Close();
+		delete m_receiveSockets[ socketIndex ];
+	}
+
+	m_receiveSockets.clear();
+
+	if( m_socket.IsOpen() )
+	{
+		m_socket.Close();
+		UDPSocket::ShutdownNetworking();
+	}
+
+	for( unsigned int messageIndex = 0; messageIndex < m_inbox.size(); ++messageIndex )
+	{
+		if( m_inbox[ messageIndex ].m_type == SHARD_MESSAGE_Handoff )
+			delete m_inbox[ messageIndex ].m_connection;
+	}
+
+	for( unsigned int shardIndex = 0; shardIndex < m_pendingShardMessages.size(); ++shardIndex )
+	{
+		std::vector< ShardMessage >& pendingMessages = m_pendingShardMessages[ shardIndex ];
+		for( unsigned int messageIndex = 0; messageIndex < pendingMessages.size(); ++messageIndex )
+		{
+			if( pendingMessages[ messageIndex ].m_type == SHARD_MESSAGE_Handoff )
+				delete pendingMessages[ messageIndex ].m_connection;
+		}
+	}
+
+	m_inbox.clear();
+	m_pendingShardMessages.clear();
+	m_shardIndexByAddress.clear();
+	m_numWorkerThreads = 0;
+	m_numConnections = 0;
+
+	memset( m_rooms, 0, sizeof( m_rooms ) );
+	for( int roomIndex = 0; roomIndex < SERVER_NUM_ROOMS; ++roomIndex )
+	{
+		m_playersPerRoom[ roomIndex ] = 0;
+	}
+
+	delete[] m_receiveBuffers;
+	m_receiveBuffers = nullptr;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RoomServer::Run( const volatile bool& isQuitting )
+{
+	while( !isQuitting )
+	{
+		Update();
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Sleeps in epoll until a datagram arrives or the lobby's next tick is due, so an idle server
+// costs nothing. Worker shards tick on their own threads.
+void RoomServer::Update()
+{
+	RoomShard& lobbyShard = *m_shards[ LOBBY_SHARD_INDEX ];
+	int millisecondsUntilTick = (int) ( ( lobbyShard.GetTimeOfNextTick() - GetCurrentTimeSeconds() ) * 1000.0 );
+	if( millisecondsUntilTick > 0 )
+		m_socket.WaitUntilReadable( millisecondsUntilTick );
+
+	ProcessServerMessages();
+	ReceiveDatagrams();
+
+	if( GetCurrentTimeSeconds() >= lobbyShard.GetTimeOfNextTick() )
+		lobbyShard.Tick();
+
+	ProcessServerMessages();
+	lobbyShard.FlushPendingConnections();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+int RoomServer::GetNumConnections() const
+{
+	return AtomicLoad( m_numConnections );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+int RoomServer::GetNumPlayersInRoom( RoomID room ) const
+{
+	if( !IsGameRoom( room ) || room > SERVER_NUM_ROOMS )
+		return 0;
+
+	return AtomicLoad( m_playersPerRoom[ room - 1 ] );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+int RoomServer::GetNumReceiveSockets() const
+{
+	return 1 + (int) m_receiveSockets.size();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+UDPSocket& RoomServer::GetSocket()
+{
+	return m_socket;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+double RoomServer::GetSecondsPerTick() const
+{
+	return m_secondsPerTick;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool RoomServer::IsShuttingDown() const
+{
+	return AtomicLoad( m_isShuttingDown ) != 0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Rooms are dealt round-robin so neighbouring rooms land on different cores. A room is simulated
+// by a single shard, so the protocol's SERVER_NUM_ROOMS rooms are also the most workers that can
+// have work; Startup clamps to MAX_SERVER_WORKER_THREADS for that reason, not for want of cores.
+int RoomServer::GetShardIndexForRoom( RoomID room ) const
+{
+	if( !IsGameRoom( room ) || m_numWorkerThreads == 0 )
+		return LOBBY_SHARD_INDEX;
+
+	return 1 + ( ( room - 1 ) % m_numWorkerThreads );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Only the shard that owns the room may touch it.
+ServerRoom& RoomServer::GetRoom( RoomID room )
+{
+	return m_rooms[ room - 1 ];
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RoomServer::SetNumPlayersInRoom( RoomID room, int numPlayers )
+{
+	AtomicStore( m_playersPerRoom[ room - 1 ], numPlayers );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Each count is read on its own; a snapshot mid-join is at worst one tick stale, never torn.
+void RoomServer::GetPlayersPerRoom( char* out_playersPerRoom ) const
+{
+	for( int roomIndex = 0; roomIndex < SERVER_NUM_ROOMS; ++roomIndex )
+	{
+		out_playersPerRoom[ roomIndex ] = (char) AtomicLoad( m_playersPerRoom[ roomIndex ] );
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RoomServer::AddToConnectionCount( int numConnections )
+{
+	AtomicAdd( m_numConnections, numConnections );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RoomServer::PostToServer( const ShardMessage& message )
+{
+	m_inboxLock.Enter();
+	m_inbox.push_back( message );
+	m_inboxLock.Leave();
+
+	m_socket.Wake();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RoomServer::FindShardIndices( const unsigned long long* addressKeys, int* out_shardIndices, int numAddresses ) const
+{
+	m_routingLock.Enter();
+	for( int addressIndex = 0; addressIndex < numAddresses; ++addressIndex )
+	{
+		std::map< unsigned long long, int >::const_iterator routeIter = m_shardIndexByAddress.find( addressKeys[ addressIndex ] );
+		out_shardIndices[ addressIndex ] = ( routeIter == m_shardIndexByAddress.end() ) ? LOBBY_SHARD_INDEX : routeIter->second;
+	}
+	m_routingLock.Leave();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Lobby datagrams go through this thread's inbox rather than straight to the lobby shard, which
+// only this thread may touch; they are routed again when processed, so a handoff in between is seen.
+void RoomServer::PostForwardedDatagrams( std::vector< std::vector< ShardMessage > >& messagesByShard )
+{
+	for( unsigned int shardIndex = 0; shardIndex < messagesByShard.size(); ++shardIndex )
+	{
+		std::vector< ShardMessage >& messages = messagesByShard[ shardIndex ];
+		if( messages.empty() )
+			continue;
+
+		if( shardIndex != LOBBY_SHARD_INDEX )
+		{
+			m_shards[ shardIndex ]->PostMessages( messages );
+			continue;
+		}
+
+		m_inboxLock.Enter();
+		m_inbox.insert( m_inbox.end(), messages.begin(), messages.end() );
+		m_inboxLock.Leave();
+
+		messages.clear();
+		m_socket.Wake();
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// The routing entry changes before anything else from this address is routed, so later datagrams
+// queue up behind the handoff in the new owner's inbox.
+void RoomServer::RouteHandoff( const ShardMessage& handoffMessage )
+{
+	int shardIndex = GetShardIndexForRoom( handoffMessage.m_targetRoom );
+	if( shardIndex == LOBBY_SHARD_INDEX )
+	{
+		m_routingLock.Enter();
+		m_shardIndexByAddress.erase( handoffMessage.m_addressKey );
+		m_routingLock.Leave();
+
+		m_shards[ LOBBY_SHARD_INDEX ]->AcceptConnection( handoffMessage.m_connection, handoffMessage.m_hasPacket ? &handoffMessage.m_packet : nullptr );
+		return;
+	}
+
+	m_routingLock.Enter();
+	m_shardIndexByAddress[ handoffMessage.m_addressKey ] = shardIndex;
+	m_routingLock.Leave();
+
+	m_pendingShardMessages[ shardIndex ].push_back( handoffMessage );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Every socket in a SO_REUSEPORT group needs the option set before binding.
+bool RoomServer::OpenReusePortSocket( unsigned short portNumber, UDPSocket& socket )
+{
+	if( !socket.Open() )
+	{
+		return false;
+	}
+
+	if( !socket.EnableReusePort() || !socket.Bind( portNumber ) )
+	{
+		socket.Close();
+		return false;
+	}
+
+	socket.SetBufferSizes( SERVER_SOCKET_BUFFER_SIZE_BYTES );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RoomServer::ReceiveDatagrams()
+{
+	char* receiveBuffers[ MAX_DATAGRAMS_PER_SYSTEM_CALL ];
+	int numBytesReceived[ MAX_DATAGRAMS_PER_SYSTEM_CALL ];
+	struct sockaddr_in fromAddrs[ MAX_DATAGRAMS_PER_SYSTEM_CALL ];
+	for( int bufferIndex = 0; bufferIndex < MAX_DATAGRAMS_PER_SYSTEM_CALL; ++bufferIndex )
+	{
+		receiveBuffers[ bufferIndex ] = m_receiveBuffers[ bufferIndex ].m_data;
+	}
+
+	// Stop draining once the lobby tick is due so a flood cannot starve it
+	RoomShard& lobbyShard = *m_shards[ LOBBY_SHARD_INDEX ];
+	for( ;; )
+	{
+		int numDatagrams = m_socket.ReceiveBatch( receiveBuffers, MAX_DATAGRAM_SIZE_BYTES, numBytesReceived, fromAddrs, MAX_DATAGRAMS_PER_SYSTEM_CALL );
+		for( int datagramIndex = 0; datagramIndex < numDatagrams; ++datagramIndex )
+		{
+			RouteDatagram( GetAddressKey( fromAddrs[ datagramIndex ] ), fromAddrs[ datagramIndex ], (const unsigned char*) receiveBuffers[ datagramIndex ], numBytesReceived[ datagramIndex ] );
+		}
+
+		PostPendingShardMessages();
+
+		if( numDatagrams < MAX_DATAGRAMS_PER_SYSTEM_CALL || GetCurrentTimeSeconds() >= lobbyShard.GetTimeOfNextTick() )
+			break;
+	}
+
+	lobbyShard.FlushPendingConnections();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Addresses without a routing entry belong to the lobby shard, which is handled inline. This
+// thread is the only writer of the routing table, so it reads it without the lock.
+void RoomServer::RouteDatagram( unsigned long long addressKey, const struct sockaddr_in& fromAddr, const unsigned char* datagram, int numBytes )
+{
+	std::map< unsigned long long, int >::iterator routeIter = m_shardIndexByAddress.find( addressKey );
+	if( routeIter == m_shardIndexByAddress.end() )
+	{
+		m_shards[ LOBBY_SHARD_INDEX ]->ProcessDatagram( addressKey, fromAddr, datagram, numBytes );
+		return;
+	}
+
+	std::vector< ShardMessage >& pendingMessages = m_pendingShardMessages[ routeIter->second ];
+	pendingMessages.resize( pendingMessages.size() + 1 );
+
+	MakeDatagramMessage( pendingMessages.back(), addressKey, fromAddr, datagram, numBytes );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RoomServer::ProcessServerMessages()
+{
+	m_inboxLock.Enter();
+	m_messagesBeingProcessed.swap( m_inbox );
+	m_inboxLock.Leave();
+
+	for( unsigned int messageIndex = 0; messageIndex < m_messagesBeingProcessed.size(); ++messageIndex )
+	{
+		const ShardMessage& message = m_messagesBeingProcessed[ messageIndex ];
+		switch( message.m_type )
+		{
+		case SHARD_MESSAGE_Datagram:
+			RouteDatagram( message.m_addressKey, message.m_address, (const unsigned char*) message.m_datagram.m_data, message.m_datagram.m_numBytes );
+			break;
+
+		case SHARD_MESSAGE_Handoff:
+			RouteHandoff( message );
+			break;
+
+		case SHARD_MESSAGE_Removed:
+			m_routingLock.Enter();
+			m_shardIndexByAddress.erase( message.m_addressKey );
+			m_routingLock.Leave();
+			break;
+		}
+	}
+
+	m_messagesBeingProcessed.clear();
+	PostPendingShardMessages();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RoomServer::PostPendingShardMessages()
+{
+	for( unsigned int shardIndex = 1; shardIndex < m_pendingShardMessages.size(); ++shardIndex )
+	{
+		if( !m_pendingShardMessages[ shardIndex ].empty() )
+			m_shards[ shardIndex ]->PostMessages( m_pendingShardMessages[ shardIndex ] );
+	}
+}
\ No newline at end of file
@@ -0,0 +1,85 @@
+#ifndef include_RoomServer
+#define include_RoomServer
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include <map>
+#include <vector>
+#include "RoomShard.hpp"
+#include "UDPClient.hpp"
+#include "UDPSocket.hpp"
+#include "FinalPacket.hpp"
+#include "../Engine/Threading.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+const unsigned short DEFAULT_SERVER_PORT_NUMBER = 5000;
+const int DEFAULT_SERVER_TICKS_PER_SECOND = 20;
+const int MAX_SERVER_WORKER_THREADS = SERVER_NUM_ROOMS; // a room never spans shards, so more would idle
+const int SERVER_SOCKET_BUFFER_SIZE_BYTES = 4 * 1024 * 1024;
+
+
+//-----------------------------------------------------------------------------------------------
+// Headless authority for the FinalPacket protocol. The calling thread owns the socket: it drains
+// it in batches, runs the lobby shard itself and routes every other datagram to the shard that
+// owns its sender. Rooms are split across the worker shards, each simulating on its own thread.
+// With no worker threads the lobby shard owns every room and nothing runs concurrently.
+// With isReusingPort, each worker also binds its own SO_REUSEPORT socket to the port and drains
+// it, so receiving scales with the workers instead of stopping at one core's recvmmsg rate.
+class RoomServer
+{
+public:
+	RoomServer();
+	~RoomServer();
+	bool Startup( unsigned short portNumber, int ticksPerSecond, int numWorkerThreads, bool isReusingPort );
+	void Shutdown();
+	void Run( const volatile bool& isQuitting );
+	void Update();
+	int GetNumConnections() const;
+	int GetNumPlayersInRoom( RoomID room ) const;
+	int GetNumReceiveSockets() const;
+
+	// Called from shard threads
+	UDPSocket& GetSocket();
+	double GetSecondsPerTick() const;
+	bool IsShuttingDown() const;
+	int GetShardIndexForRoom( RoomID room ) const;
+	ServerRoom& GetRoom( RoomID room );
+	void SetNumPlayersInRoom( RoomID room, int numPlayers );
+	void GetPlayersPerRoom( char* out_playersPerRoom ) const;
+	void AddToConnectionCount( int numConnections );
+	void PostToServer( const ShardMessage& message );
+	void FindShardIndices( const unsigned long long* addressKeys, int* out_shardIndices, int numAddresses ) const;
+	void PostForwardedDatagrams( std::vector< std::vector< ShardMessage > >& messagesByShard );
+
+	// Called from the lobby shard, which shares the server thread
+	void RouteHandoff( const ShardMessage& handoffMessage );
+
+private:
+	bool OpenReusePortSocket( unsigned short portNumber, UDPSocket& socket );
+	void ReceiveDatagrams();
+	void RouteDatagram( unsigned long long addressKey, const struct sockaddr_in& fromAddr, const unsigned char* datagram, int numBytes );
+	void ProcessServerMessages();
+	void PostPendingShardMessages();
+
+	UDPSocket										m_socket;
+	double											m_secondsPerTick;
+	int												m_numWorkerThreads;
+	volatile int									m_isShuttingDown;
+	std::vector< RoomShard* >						m_shards;
+	Thread											m_workerThreads[ MAX_SERVER_WORKER_THREADS ];
+	std::vector< UDPSocket* >						m_receiveSockets;
+	ServerRoom										m_rooms[ SERVER_NUM_ROOMS ];
+	volatile int									m_playersPerRoom[ SERVER_NUM_ROOMS ];
+	volatile int									m_numConnections;
+	mutable CriticalSection							m_routingLock; // held to write here, or to read off the server thread
+	std::map< unsigned long long, int >				m_shardIndexByAddress; // absent = lobby shard
+	std::vector< std::vector< ShardMessage > >		m_pendingShardMessages;
+	CriticalSection									m_inboxLock;
+	std::vector< ShardMessage >						m_inbox;
+	std::vector< ShardMessage >						m_messagesBeingProcessed;
+	DatagramBuffer*									m_receiveBuffers;
+};
+
+
+#endif // include_RoomServer
\ No newline at end of file
@@ -0,0 +1,1432 @@
+#include "RoomShard.hpp"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include "RoomServer.hpp"
+#include "GameCommon.hpp"
+#include "FinalPacketSerializer.hpp"
+#include "../Engine/Time.hpp"
+#include "../Engine/MathFunctions.hpp"
+#include "../Engine/NewMacroDef.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+static bool IsGameRoom( RoomID room )
+{
+	return room != ROOM_Lobby && room != ROOM_None;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Ack blocks ride in the coalesced datagram header, so they need both capabilities.
+static bool HasSelectiveAcks( const ServerConnection& connection )
+{
+	return ( connection.m_capabilities & CAPABILITY_CoalescedPackets ) != 0 && ( connection.m_capabilities & CAPABILITY_SelectiveAcks ) != 0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Corrections and inputs only have a compact encoding, so movement needs coalescing as well.
+static bool HasServerMovement( const ServerConnection& connection )
+{
+	return ( connection.m_capabilities & CAPABILITY_CoalescedPackets ) != 0 && ( connection.m_capabilities & CAPABILITY_ServerMovement ) != 0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// A tank's last reported state, carried forward by its velocity from when it was sampled. Stamps
+// from the future or too old to be plausible (senders without a synchronized clock) are taken as
+// current, so those tanks stay where they reported.
+static Vector2 GetTankPositionAt( const ServerConnection& player, double timeSeconds )
+{
+	const GameUpdatePacket& state = player.m_lastGameUpdate.data.updatedGame;
+	Vector2 position( state.xPosition, state.yPosition );
+	double sampleAgeSeconds = timeSeconds - player.m_lastGameUpdate.timestamp;
+	if( !player.m_hasGameUpdate || sampleAgeSeconds <= 0.0 || sampleAgeSeconds > LAG_COMPENSATION_MAX_REWIND_SECONDS )
+		return position;
+
+	position.x = ClampFloat( position.x + ( state.xVelocity * (float) sampleAgeSeconds ), 0.f, SERVER_ARENA_SIZE );
+	position.y = ClampFloat( position.y + ( state.yVelocity * (float) sampleAgeSeconds ), 0.f, SERVER_ARENA_SIZE );
+	return position;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static void InitializeServerPacket( FinalPacket& packet, PacketType type, ClientID clientID )
+{
+	memset( &packet, 0, sizeof( packet ) );
+	packet.type = type;
+	packet.clientID = clientID;
+	packet.timestamp = GetCurrentTimeSeconds();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+ServerConnection::ServerConnection( const struct sockaddr_in& address, unsigned long long addressKey )
+	: m_address( address )
+	, m_addressKey( addressKey )
+	, m_wireFormat( WIRE_FORMAT_Legacy )
+	, m_capabilities( CAPABILITY_None )
+	, m_nextPacketNumber( 0 )
+	, m_timeOfLastReceive( 0.0 )
+	, m_isPendingFlush( false )
+	, m_isLeavingShard( false )
+	, m_room( ROOM_None )
+	, m_playerID( ID_None )
+	, m_hasGameUpdate( false )
+	, m_hasNewGameUpdate( false )
+	, m_health( TANK_MAX_HEALTH )
+	, m_score( 0 )
+	, m_invulnerableUntilSeconds( 0.0 )
+	, m_nextMovementStep( 0 )
+	, m_hasMovementStep( false )
+	, m_hasNewMovement( false )
+	, m_spawnPacketNumber( 0 )
+	, m_movementBudgetSteps( 0.0 )
+	, m_timeOfMovementBudgetRefill( 0.0 )
+{
+	memset( &m_lastGameUpdate, 0, sizeof( m_lastGameUpdate ) );
+}
+
+//-----------------------------------------------------------------------------------------------
+RoomShard::RoomShard( RoomServer& server, int shardIndex, UDPSocket* receiveSocket )
+	: m_server( server )
+	, m_shardIndex( shardIndex )
+	, m_timeOfNextTick( GetCurrentTimeSeconds() + server.GetSecondsPerTick() )
+	, m_receiveSocket( receiveSocket )
+	, m_receiveBuffers( nullptr )
+	, m_sendQueue( new DatagramBuffer[ MAX_DATAGRAMS_PER_SYSTEM_CALL ] )
+	, m_sendQueueCount( 0 )
+{
+	memset( m_lastBroadcastPlayersPerRoom, 0, sizeof( m_lastBroadcastPlayersPerRoom ) );
+
+	if( m_receiveSocket != nullptr )
+	{
+		m_receiveBuffers = new DatagramBuffer[ MAX_DATAGRAMS_PER_SYSTEM_CALL ];
+		m_forwardedDatagrams.resize( MAX_SERVER_WORKER_THREADS + 1 );
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+RoomShard::~RoomShard()
+{
+	Shutdown();
+	delete[] m_sendQueue;
+	delete[] m_receiveBuffers;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Worker thread body: sleeps until the next tick, a post to the inbox or, with a socket of its own,
+// a datagram. Posting wakes the socket's epoll as well, so one wait covers both.
+void RoomShard::Run()
+{
+	while( !m_server.IsShuttingDown() )
+	{
+		double secondsUntilTick = m_timeOfNextTick - GetCurrentTimeSeconds();
+		if( m_receiveSocket != nullptr )
+		{
+			if( secondsUntilTick > 0.0 )
+				m_receiveSocket->WaitUntilReadable( (int) ( secondsUntilTick * 1000.0 ) + 1 );
+
+			ReceiveDatagrams();
+		}
+		else if( secondsUntilTick > 0.0 )
+		{
+			// A post since the last wait left the event signalled, so this returns at once
+			m_inboxEvent.Wait( secondsUntilTick );
+		}
+
+		ProcessMessages();
+
+		if( GetCurrentTimeSeconds() >= m_timeOfNextTick )
+			Tick();
+
+		FlushPendingConnections();
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RoomShard::WakeUp()
+{
+	m_inboxEvent.Signal();
+
+	if( m_receiveSocket != nullptr )
+		m_receiveSocket->Wake();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// One lock per batch from the server thread, not per datagram.
+void RoomShard::PostMessages( std::vector< ShardMessage >& messages )
+{
+	m_inboxLock.Enter();
+	m_inbox.insert( m_inbox.end(), messages.begin(), messages.end() );
+	m_inboxLock.Leave();
+	m_inboxEvent.Signal();
+
+	if( m_receiveSocket != nullptr )
+		m_receiveSocket->Wake();
+
+	messages.clear();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RoomShard::ProcessMessages()
+{
+	m_inboxLock.Enter();
+	m_messagesBeingProcessed.swap( m_inbox );
+	m_inboxLock.Leave();
+
+	for( unsigned int messageIndex = 0; messageIndex < m_messagesBeingProcessed.size(); ++messageIndex )
+	{
+		const ShardMessage& message = m_messagesBeingProcessed[ messageIndex ];
+		if( message.m_type == SHARD_MESSAGE_Datagram )
+			ProcessDatagram( message.m_addressKey, message.m_address, (const unsigned char*) message.m_datagram.m_data, message.m_datagram.m_numBytes );
+		else if( message.m_type == SHARD_MESSAGE_Handoff )
+			AcceptConnection( message.m_connection, message.m_hasPacket ? &message.m_packet : nullptr );
+	}
+
+	m_messagesBeingProcessed.clear();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RoomShard::ProcessDatagram( unsigned long long addressKey, const struct sockaddr_in& fromAddr, const unsigned char* datagram, int numBytes )
+{
+	ServerConnection* connection = FindConnection( addressKey );
+
+	// Sent before our handoff back to the lobby was routed; let the server thread route it again
+	if( connection == nullptr && !IsLobbyShard() )
+	{
+		ShardMessage bouncedMessage;
+		MakeDatagramMessage( bouncedMessage, addressKey, fromAddr, datagram, numBytes );
+		m_server.PostToServer( bouncedMessage );
+		return;
+	}
+
+	int numPackets = UnpackDatagram( datagram, numBytes, m_unpackedPackets, MAX_PACKETS_PER_DATAGRAM, ( connection != nullptr ) ? &connection->m_receivedSnapshots : nullptr );
+	if( numPackets == 0 )
+		return;
+
+	// Only a Join opens a connection, so stray datagrams cost nothing beyond the decode
+	if( connection == nullptr )
+	{
+		if( m_unpackedPackets[ 0 ].type != TYPE_JoinRoom )
+			return;
+
+		connection = new ServerConnection( fromAddr, addressKey );
+		AddConnection( connection );
+		m_server.AddToConnectionCount( 1 );
+	}
+
+	connection->m_timeOfLastReceive = GetCurrentTimeSeconds();
+	if( ( connection->m_capabilities & CAPABILITY_CoalescedPackets ) == 0 )
+		connection->m_wireFormat = IsLegacyFinalPacketDatagram( datagram, numBytes ) ? WIRE_FORMAT_Legacy : WIRE_FORMAT_Compact;
+
+	AckBlock ackBlock;
+	if( ReadDatagramAckBlock( datagram, numBytes, ackBlock ) )
+		RemoveAckedPackets( *connection, ackBlock );
+
+	for( int packetIndex = 0; packetIndex < numPackets; ++packetIndex )
+	{
+		// The rest belongs to the connection's new shard; guaranteed packets are resent to it
+		if( connection->m_isLeavingShard )
+			break;
+
+		const FinalPacket& packet = m_unpackedPackets[ packetIndex ];
+		if( !connection->m_receivedPackets.RecordReceivedPacket( packet.number, packet.IsGuaranteed() ) )
+		{
+			// A retransmit of something already applied: our ack went missing, so ack again
+			if( packet.IsGuaranteed() )
+				SendAck( *connection, packet );
+
+			continue;
+		}
+
+		ProcessPacket( *connection, packet );
+		ReleaseToLobbyIfIdle( *connection );
+	}
+
+	if( !connection->m_isLeavingShard && HasSelectiveAcks( *connection ) && connection->m_receivedPackets.IsAckPending() )
+		MarkPendingFlush( *connection );
+
+	ApplyPendingHandoffs();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// The kernel picks this socket by client address, not by room, so datagrams from connections
+// owned elsewhere are passed on; the routing table is locked once per batch.
+void RoomShard::ReceiveDatagrams()
+{
+	char* receiveBuffers[ MAX_DATAGRAMS_PER_SYSTEM_CALL ];
+	int numBytesReceived[ MAX_DATAGRAMS_PER_SYSTEM_CALL ];
+	struct sockaddr_in fromAddrs[ MAX_DATAGRAMS_PER_SYSTEM_CALL ];
+	unsigned long long addressKeys[ MAX_DATAGRAMS_PER_SYSTEM_CALL ];
+	int shardIndices[ MAX_DATAGRAMS_PER_SYSTEM_CALL ];
+	for( int bufferIndex = 0; bufferIndex < MAX_DATAGRAMS_PER_SYSTEM_CALL; ++bufferIndex )
+	{
+		receiveBuffers[ bufferIndex ] = m_receiveBuffers[ bufferIndex ].m_data;
+	}
+
+	int numDatagrams = m_receiveSocket->ReceiveBatch( receiveBuffers, MAX_DATAGRAM_SIZE_BYTES, numBytesReceived, fromAddrs, MAX_DATAGRAMS_PER_SYSTEM_CALL );
+	if( numDatagrams <= 0 )
+		return;
+
+	for( int datagramIndex = 0; datagramIndex < numDatagrams; ++datagramIndex )
+	{
+		addressKeys[ datagramIndex ] = GetAddressKey( fromAddrs[ datagramIndex ] );
+	}
+
+	m_server.FindShardIndices( addressKeys, shardIndices, numDatagrams );
+
+	for( int datagramIndex = 0; datagramIndex < numDatagrams; ++datagramIndex )
+	{
+		const unsigned char* datagram = (const unsigned char*) receiveBuffers[ datagramIndex ];
+		if( shardIndices[ datagramIndex ] == m_shardIndex )
+		{
+			ProcessDatagram( addressKeys[ datagramIndex ], fromAddrs[ datagramIndex ], datagram, numBytesReceived[ datagramIndex ] );
+			continue;
+		}
+
+		std::vector< ShardMessage >& forwardedDatagrams = m_forwardedDatagrams[ shardIndices[ datagramIndex ] ];
+		forwardedDatagrams.resize( forwardedDatagrams.size() + 1 );
+		MakeDatagramMessage( forwardedDatagrams.back(), addressKeys[ datagramIndex ], fromAddrs[ datagramIndex ], datagram, numBytesReceived[ datagramIndex ] );
+	}
+
+	m_server.PostForwardedDatagrams( m_forwardedDatagrams );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Takes ownership of a connection handed over by another shard, then finishes what it asked for.
+void RoomShard::AcceptConnection( ServerConnection* connection, const FinalPacket* packet )
+{
+	connection->m_isLeavingShard = false;
+	AddConnection( connection );
+
+	if( packet != nullptr )
+		ProcessPacket( *connection, *packet );
+
+	ReleaseToLobbyIfIdle( *connection );
+	ApplyPendingHandoffs();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+double RoomShard::GetTimeOfNextTick() const
+{
+	return m_timeOfNextTick;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RoomShard::Tick()
+{
+	if( IsLobbyShard() )
+		BroadcastLobbyUpdate();
+
+	RecordTankPositions();
+	RelayGameUpdates();
+	SendTankCorrections();
+	ResendGuaranteedPackets();
+	RemoveTimedOutConnections();
+	ApplyPendingHandoffs();
+	FlushPendingConnections();
+
+	// After a stall, skip the missed ticks instead of running them back to back
+	double currentTime = GetCurrentTimeSeconds();
+	m_timeOfNextTick += m_server.GetSecondsPerTick();
+	if( m_timeOfNextTick < currentTime )
+		m_timeOfNextTick = currentTime + m_server.GetSecondsPerTick();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Connections still in the inbox were handed over but never accepted, so they are ours to free.
+void RoomShard::Shutdown()
+{
+	FlushPendingConnections();
+
+	for( unsigned int connectionIndex = 0; connectionIndex < m_connections.size(); ++connectionIndex )
+	{
+		delete m_connections[ connectionIndex ];
+	}
+
+	m_inboxLock.Enter();
+	for( unsigned int messageIndex = 0; messageIndex < m_inbox.size(); ++messageIndex )
+	{
+		if( m_inbox[ messageIndex ].m_type == SHARD_MESSAGE_Handoff )
+			delete m_inbox[ messageIndex ].m_connection;
+	}
+
+	m_inbox.clear();
+	m_inboxLock.Leave();
+
+	m_connections.clear();
+	m_connectionsByAddress.clear();
+	m_pendingFlushConnections.clear();
+	m_pendingHandoffs.clear();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool RoomShard::IsLobbyShard() const
+{
+	return m_shardIndex == LOBBY_SHARD_INDEX;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RoomShard::ProcessPacket( ServerConnection& connection, const FinalPacket& packet )
+{
+	switch( packet.type )
+	{
+	case TYPE_Ack:
+		ProcessAck( connection, packet );
+		break;
+
+	case TYPE_KeepAlive:
+		if( connection.m_room == ROOM_Lobby )
+			SendLobbyUpdate( connection );
+		break;
+
+	case TYPE_JoinRoom:
+		ProcessJoinRoom( connection, packet );
+		break;
+
+	case TYPE_CreateRoom:
+		ProcessCreateRoom( connection, packet );
+		break;
+
+	case TYPE_GameUpdate:
+		ProcessGameUpdate( connection, packet );
+		break;
+
+	case TYPE_Fire:
+		ProcessFire( connection, packet );
+		break;
+
+	case TYPE_TankInput:
+		ProcessTankInput( connection, packet );
+		break;
+
+	// Hits are resolved here from Fire; client-reported ones are only acknowledged
+	case TYPE_Hit:
+	default:
+		if( packet.IsGuaranteed() )
+			SendAck( connection, packet );
+		break;
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RoomShard::ProcessAck( ServerConnection& connection, const FinalPacket& ackPacket )
+{
+	RemoveOutstandingPacket( connection, ackPacket.data.acknowledged.number );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RoomShard::ProcessJoinRoom( ServerConnection& connection, const FinalPacket& joinPacket )
+{
+	connection.m_capabilities = joinPacket.data.joining.capabilities;
+	if( ( connection.m_capabilities & CAPABILITY_CoalescedPackets ) != 0 )
+		connection.m_wireFormat = WIRE_FORMAT_Coalesced;
+
+	RoomID room = joinPacket.data.joining.room;
+	if( room == ROOM_Lobby )
+	{
+		RemovePlayerFromRoom( connection );
+		if( !IsLobbyShard() )
+		{
+			HandOffConnection( connection, ROOM_Lobby, &joinPacket );
+			return;
+		}
+
+		connection.m_room = ROOM_Lobby;
+		SendAck( connection, joinPacket );
+		SendLobbyUpdate( connection );
+		return;
+	}
+
+	if( room > SERVER_NUM_ROOMS )
+	{
+		SendNack( connection, joinPacket, ERROR_BadRoomID );
+		return;
+	}
+
+	if( !IsRoomOwnedHere( room ) )
+	{
+		RemovePlayerFromRoom( connection );
+		HandOffConnection( connection, room, &joinPacket );
+		return;
+	}
+
+	const ServerRoom& serverRoom = m_server.GetRoom( room );
+	if( serverRoom.m_numPlayers == 0 )
+	{
+		SendNack( connection, joinPacket, ERROR_RoomEmpty );
+		return;
+	}
+
+	if( serverRoom.m_numPlayers >= SERVER_MAX_PLAYERS_PER_ROOM )
+	{
+		SendNack( connection, joinPacket, ERROR_RoomFull );
+		return;
+	}
+
+	RemovePlayerFromRoom( connection );
+	AddPlayerToRoom( connection, room );
+	SendAck( connection, joinPacket );
+	SendGameReset( connection );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RoomShard::ProcessCreateRoom( ServerConnection& connection, const FinalPacket& createPacket )
+{
+	RoomID room = createPacket.data.creating.room;
+	if( !IsGameRoom( room ) || room > SERVER_NUM_ROOMS )
+	{
+		SendNack( connection, createPacket, ERROR_BadRoomID );
+		return;
+	}
+
+	if( !IsRoomOwnedHere( room ) )
+	{
+		RemovePlayerFromRoom( connection );
+		HandOffConnection( connection, room, &createPacket );
+		return;
+	}
+
+	if( m_server.GetRoom( room ).m_numPlayers > 0 )
+	{
+		SendNack( connection, createPacket, ERROR_RoomFull );
+		return;
+	}
+
+	RemovePlayerFromRoom( connection );
+	AddPlayerToRoom( connection, room );
+	SendAck( connection, createPacket );
+	SendGameReset( connection );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Updates are unreliable and may arrive out of order; only the newest one is kept for the relay.
+void RoomShard::ProcessGameUpdate( ServerConnection& connection, const FinalPacket& updatePacket )
+{
+	// The server moves these tanks itself; their reported positions are not trusted
+	if( !IsGameRoom( connection.m_room ) || HasServerMovement( connection ) )
+		return;
+
+	if( connection.m_hasGameUpdate && !IsPacketNumberNewer( updatePacket.number, connection.m_lastGameUpdate.number ) )
+		return;
+
+	connection.m_lastGameUpdate = updatePacket;
+	connection.m_lastGameUpdate.clientID = connection.m_playerID;
+	connection.m_hasGameUpdate = true;
+	connection.m_hasNewGameUpdate = true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Runs the client's input steps through the same fixed-step movement the client predicts with.
+// Steps already simulated are skipped, so reordered and repeated runs are harmless. Lost runs
+// are filled by holding the last input, as the client would have if it had kept its controls;
+// the correction then tells the client what the server actually did. Inputs from before the
+// tank's latest spawn are dropped, and steps beyond the movement budget are counted but not run.
+void RoomShard::ProcessTankInput( ServerConnection& connection, const FinalPacket& inputPacket )
+{
+	if( !IsGameRoom( connection.m_room ) || !HasServerMovement( connection ) )
+		return;
+
+	const TankInputPacket& tankInput = inputPacket.data.tankInput;
+	if( tankInput.spawnPacketNumber != connection.m_spawnPacketNumber )
+		return;
+
+	unsigned int endStep = tankInput.firstStep + tankInput.numSteps;
+	if( !connection.m_hasMovementStep )
+	{
+		connection.m_nextMovementStep = tankInput.firstStep;
+		connection.m_hasMovementStep = true;
+	}
+
+	int numNewSteps = (int) ( endStep - connection.m_nextMovementStep );
+	if( numNewSteps <= 0 )
+		return;
+
+	RefillMovementBudget( connection );
+
+	int numMissingSteps = (int) ( tankInput.firstStep - connection.m_nextMovementStep );
+	if( numMissingSteps > MAX_MOVEMENT_GAP_STEPS )
+	{
+		connection.m_nextMovementStep = tankInput.firstStep;
+	}
+	else
+	{
+		for( int stepIndex = 0; stepIndex < numMissingSteps; ++stepIndex )
+		{
+			if( SpendMovementBudget( connection ) )
+				StepTankMovement( connection.m_movementState, connection.m_lastMovementInput );
+
+			++connection.m_nextMovementStep;
+		}
+	}
+
+	// Clamped rather than trusted: the constructor limits turn direction to one step either way
+	TankMovementInput movementInput( tankInput.turnDirection, (float) tankInput.throttle / (float) TANK_MOVEMENT_THROTTLE_SCALE );
+	while( connection.m_nextMovementStep != endStep )
+	{
+		if( SpendMovementBudget( connection ) )
+			StepTankMovement( connection.m_movementState, movementInput );
+
+		++connection.m_nextMovementStep;
+	}
+
+	connection.m_lastMovementInput = movementInput;
+	connection.m_hasNewMovement = true;
+	PublishMovementState( connection );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// A client steps at TANK_MOVEMENT_STEPS_PER_SECOND of real time, so the budget grows at that rate.
+// It is capped at MOVEMENT_BUDGET_SLACK_SECONDS of steps: enough for inputs held up by the network
+// to arrive together, not enough for a sped-up client clock to bank a dash.
+void RoomShard::RefillMovementBudget( ServerConnection& connection )
+{
+	double currentTime = GetCurrentTimeSeconds();
+	connection.m_movementBudgetSteps += ( currentTime - connection.m_timeOfMovementBudgetRefill ) * TANK_MOVEMENT_STEPS_PER_SECOND;
+	connection.m_timeOfMovementBudgetRefill = currentTime;
+
+	double maxBudgetSteps = MOVEMENT_BUDGET_SLACK_SECONDS * TANK_MOVEMENT_STEPS_PER_SECOND;
+	if( connection.m_movementBudgetSteps > maxBudgetSteps )
+		connection.m_movementBudgetSteps = maxBudgetSteps;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Returns false, spending nothing, when the client has claimed more steps than time has passed.
+bool RoomShard::SpendMovementBudget( ServerConnection& connection )
+{
+	if( connection.m_movementBudgetSteps < 1.0 )
+		return false;
+
+	connection.m_movementBudgetSteps -= 1.0;
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Stands the server's state in for the GameUpdate the client would have sent, so relays and hit
+// tests see where the server has the tank.
+void RoomShard::PublishMovementState( ServerConnection& connection )
+{
+	Vector2 velocity = GetTankMovementVelocity( connection.m_movementState, connection.m_lastMovementInput );
+
+	FinalPacket& updatePacket = connection.m_lastGameUpdate;
+	updatePacket.type = TYPE_GameUpdate;
+	updatePacket.clientID = connection.m_playerID;
+	updatePacket.timestamp = GetCurrentTimeSeconds();
+	updatePacket.data.updatedGame.xPosition = connection.m_movementState.m_position.x;
+	updatePacket.data.updatedGame.yPosition = connection.m_movementState.m_position.y;
+	updatePacket.data.updatedGame.xVelocity = velocity.x;
+	updatePacket.data.updatedGame.yVelocity = velocity.y;
+	updatePacket.data.updatedGame.xAcceleration = 0.f;
+	updatePacket.data.updatedGame.yAcceleration = 0.f;
+	updatePacket.data.updatedGame.orientationDegrees = connection.m_movementState.m_orientationDegrees;
+
+	connection.m_hasGameUpdate = true;
+	connection.m_hasNewGameUpdate = true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// The laser has infinite penetration: every vulnerable tank on the ray from the shooter is hit.
+// Targets are where the shooter saw them, rewound to the view time the Fire is stamped with. The
+// shooter is where it last reported, or where we have run its inputs to: clients we move send their
+// inputs up to the shot in the same datagram, ahead of the Fire.
+void RoomShard::ProcessFire( ServerConnection& connection, const FinalPacket& firePacket )
+{
+	SendAck( connection, firePacket );
+
+	if( !IsGameRoom( connection.m_room ) )
+		return;
+
+	ServerRoom& serverRoom = m_server.GetRoom( connection.m_room );
+	const GameUpdatePacket& shooterState = connection.m_lastGameUpdate.data.updatedGame;
+	Vector2 laserOrigin( shooterState.xPosition, shooterState.yPosition );
+	float laserRadians = ConvertDegreesToRadians( shooterState.orientationDegrees );
+	Vector2 laserDirection( cos( laserRadians ), sin( laserRadians ) );
+	double currentTime = GetCurrentTimeSeconds();
+
+	for( int playerIndex = 0; playerIndex < SERVER_MAX_PLAYERS_PER_ROOM; ++playerIndex )
+	{
+		ServerConnection* player = serverRoom.m_players[ playerIndex ];
+		if( player == nullptr || player == &connection )
+			continue;
+
+		FinalPacket relayedFirePacket;
+		InitializeServerPacket( relayedFirePacket, TYPE_Fire, connection.m_playerID );
+		relayedFirePacket.data.gunfire.instigatorID = connection.m_playerID;
+		SendPacket( *player, relayedFirePacket );
+	}
+
+	TankHistoryFrame targetFrame;
+	GetTanksSeenByShooter( serverRoom, firePacket.timestamp, targetFrame );
+	unsigned int hitMask = GetLaserHitMask( targetFrame, laserOrigin, laserDirection, TANK_COLLIDER_RADIUS );
+
+	for( int targetIndex = 0; targetIndex < SERVER_MAX_PLAYERS_PER_ROOM; ++targetIndex )
+	{
+		ServerConnection* target = serverRoom.m_players[ targetIndex ];
+		if( ( hitMask & ( 1u << targetIndex ) ) == 0 || target == nullptr || target == &connection || currentTime < target->m_invulnerableUntilSeconds )
+			continue;
+
+		for( int playerIndex = 0; playerIndex < SERVER_MAX_PLAYERS_PER_ROOM; ++playerIndex )
+		{
+			ServerConnection* player = serverRoom.m_players[ playerIndex ];
+			if( player == nullptr )
+				continue;
+
+			FinalPacket hitPacket;
+			InitializeServerPacket( hitPacket, TYPE_Hit, connection.m_playerID );
+			hitPacket.data.hit.instigatorID = connection.m_playerID;
+			hitPacket.data.hit.targetID = target->m_playerID;
+			hitPacket.data.hit.damageDealt = LASER_DAMAGE;
+			SendPacket( *player, hitPacket );
+		}
+
+		target->m_health = ( target->m_health > LASER_DAMAGE ) ? target->m_health - LASER_DAMAGE : 0;
+		if( target->m_health > 0 )
+			continue;
+
+		++connection.m_score;
+		SendRespawn( *target );
+	}
+
+	if( connection.m_score >= KILLS_TO_WIN )
+		ReturnRoomToLobby( connection.m_room );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Clients stamp Fire with the server time of the remote tanks on their screen. A stamp from the
+// future, beyond the rewind limit or older than the history (an unsynchronized or legacy client)
+// gets no compensation, and neither does one newer than the last tick: both use the tanks now.
+void RoomShard::GetTanksSeenByShooter( const ServerRoom& serverRoom, double viewTimeSeconds, TankHistoryFrame& out_frame ) const
+{
+	double currentTime = GetCurrentTimeSeconds();
+	const TankPositionHistory& history = serverRoom.m_positionHistory;
+	bool isRewinding = viewTimeSeconds <= currentTime && ( currentTime - viewTimeSeconds ) <= LAG_COMPENSATION_MAX_REWIND_SECONDS
+		&& history.HasFrames() && viewTimeSeconds < history.GetNewestTimeSeconds();
+	if( isRewinding && history.GetRewoundFrame( viewTimeSeconds, out_frame ) )
+		return;
+
+	out_frame.m_timeSeconds = currentTime;
+	out_frame.m_presentMask = 0;
+	for( int playerIndex = 0; playerIndex < SERVER_MAX_PLAYERS_PER_ROOM; ++playerIndex )
+	{
+		ServerConnection* player = serverRoom.m_players[ playerIndex ];
+		if( player == nullptr )
+			continue;
+
+		const GameUpdatePacket& state = player->m_lastGameUpdate.data.updatedGame;
+		out_frame.m_xPositions[ playerIndex ] = state.xPosition;
+		out_frame.m_yPositions[ playerIndex ] = state.yPosition;
+		out_frame.m_presentMask |= 1u << playerIndex;
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Room counts are published by every shard through atomics; only this thread sends them out, and
+// only when they change, so KeepAlive replies cover clients that joined the lobby in between.
+void RoomShard::BroadcastLobbyUpdate()
+{
+	char playersPerRoom[ SERVER_NUM_ROOMS ];
+	m_server.GetPlayersPerRoom( playersPerRoom );
+	if( memcmp( playersPerRoom, m_lastBroadcastPlayersPerRoom, sizeof( playersPerRoom ) ) == 0 )
+		return;
+
+	memcpy( m_lastBroadcastPlayersPerRoom, playersPerRoom, sizeof( playersPerRoom ) );
+	for( unsigned int connectionIndex = 0; connectionIndex < m_connections.size(); ++connectionIndex )
+	{
+		ServerConnection& connection = *m_connections[ connectionIndex ];
+		if( connection.m_room == ROOM_Lobby )
+			SendLobbyUpdate( connection );
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// One history frame a tick for each room in play, of where its tanks were at the tick.
+void RoomShard::RecordTankPositions()
+{
+	double currentTime = GetCurrentTimeSeconds();
+	for( RoomID room = 1; room <= SERVER_NUM_ROOMS; ++room )
+	{
+		if( !IsRoomOwnedHere( room ) )
+			continue;
+
+		ServerRoom& serverRoom = m_server.GetRoom( room );
+		if( serverRoom.m_numPlayers == 0 )
+			continue;
+
+		serverRoom.m_positionHistory.AddFrame( currentTime );
+		for( int playerIndex = 0; playerIndex < SERVER_MAX_PLAYERS_PER_ROOM; ++playerIndex )
+		{
+			ServerConnection* player = serverRoom.m_players[ playerIndex ];
+			if( player != nullptr )
+				serverRoom.m_positionHistory.SetTankPosition( playerIndex, GetTankPositionAt( *player, currentTime ) );
+		}
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Each tick forwards every player's newest state to the rest of the room, once.
+void RoomShard::RelayGameUpdates()
+{
+	for( RoomID room = 1; room <= SERVER_NUM_ROOMS; ++room )
+	{
+		if( !IsRoomOwnedHere( room ) )
+			continue;
+
+		ServerRoom& serverRoom = m_server.GetRoom( room );
+		if( serverRoom.m_numPlayers < 2 )
+			continue;
+
+		for( int moverIndex = 0; moverIndex < SERVER_MAX_PLAYERS_PER_ROOM; ++moverIndex )
+		{
+			ServerConnection* mover = serverRoom.m_players[ moverIndex ];
+			if( mover == nullptr || !mover->m_hasNewGameUpdate )
+				continue;
+
+			mover->m_hasNewGameUpdate = false;
+			for( int playerIndex = 0; playerIndex < SERVER_MAX_PLAYERS_PER_ROOM; ++playerIndex )
+			{
+				ServerConnection* player = serverRoom.m_players[ playerIndex ];
+				if( player == nullptr || player == mover )
+					continue;
+
+				FinalPacket updatePacket = mover->m_lastGameUpdate;
+				updatePacket.data.updatedGame.health = mover->m_health;
+				updatePacket.data.updatedGame.score = mover->m_score;
+				SendPacket( *player, updatePacket );
+			}
+		}
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// One correction a tick to each client whose inputs moved its tank since the last one.
+void RoomShard::SendTankCorrections()
+{
+	for( unsigned int connectionIndex = 0; connectionIndex < m_connections.size(); ++connectionIndex )
+	{
+		ServerConnection& connection = *m_connections[ connectionIndex ];
+		if( !connection.m_hasNewMovement || !IsGameRoom( connection.m_room ) )
+			continue;
+
+		connection.m_hasNewMovement = false;
+
+		FinalPacket correctionPacket;
+		InitializeServerPacket( correctionPacket, TYPE_TankCorrection, connection.m_playerID );
+		correctionPacket.data.tankCorrection.nextStep = connection.m_nextMovementStep;
+		correctionPacket.data.tankCorrection.xPosition = connection.m_movementState.m_position.x;
+		correctionPacket.data.tankCorrection.yPosition = connection.m_movementState.m_position.y;
+		correctionPacket.data.tankCorrection.orientationDegrees = connection.m_movementState.m_orientationDegrees;
+
+		SendPacket( connection, correctionPacket );
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RoomShard::ResendGuaranteedPackets()
+{
+	double currentTime = GetCurrentTimeSeconds();
+	for( unsigned int connectionIndex = 0; connectionIndex < m_connections.size(); ++connectionIndex )
+	{
+		ServerConnection& connection = *m_connections[ connectionIndex ];
+		bool hasBackedOff = false;
+
+		for( unsigned int outstandingIndex = 0; outstandingIndex < connection.m_outstandingPackets.size(); ++outstandingIndex )
+		{
+			OutstandingPacket& outstandingPacket = connection.m_outstandingPackets[ outstandingIndex ];
+			if( currentTime < outstandingPacket.m_resendTimeSeconds )
+				continue;
+
+			// One loss event per tick: back off once however many packets expired together
+			if( !hasBackedOff )
+			{
+				connection.m_roundTripEstimator.BackOff();
+				hasBackedOff = true;
+			}
+
+			// Restamped so clients can take the timestamp as the time this copy was sent
+			outstandingPacket.m_packet.timestamp = currentTime;
+			TransmitPacket( connection, outstandingPacket.m_packet );
+			outstandingPacket.m_sendTimeSeconds = currentTime;
+			outstandingPacket.m_resendTimeSeconds = currentTime + connection.m_roundTripEstimator.GetRetransmissionTimeoutSeconds();
+			++outstandingPacket.m_numTransmissions;
+		}
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RoomShard::RemoveTimedOutConnections()
+{
+	double currentTime = GetCurrentTimeSeconds();
+
+	// Walk backwards: RemoveConnection swaps the last connection into the freed slot
+	for( int connectionIndex = (int) m_connections.size() - 1; connectionIndex >= 0; --connectionIndex )
+	{
+		ServerConnection* connection = m_connections[ connectionIndex ];
+		if( !connection->m_isLeavingShard && ( currentTime - connection->m_timeOfLastReceive ) > SECONDS_BEFORE_CONNECTION_TIMEOUT )
+			RemoveConnection( connection );
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool RoomShard::IsRoomOwnedHere( RoomID room ) const
+{
+	return m_server.GetShardIndexForRoom( room ) == m_shardIndex;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+ServerConnection* RoomShard::FindConnection( unsigned long long addressKey )
+{
+	std::map< unsigned long long, ServerConnection* >::iterator connectionIter = m_connectionsByAddress.find( addressKey );
+	if( connectionIter == m_connectionsByAddress.end() )
+		return nullptr;
+
+	return connectionIter->second;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RoomShard::AddConnection( ServerConnection* connection )
+{
+	m_connections.push_back( connection );
+	m_connectionsByAddress[ connection->m_addressKey ] = connection;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RoomShard::RemoveConnection( ServerConnection* connection )
+{
+	RemovePlayerFromRoom( *connection );
+
+	if( connection->m_isPendingFlush )
+	{
+		std::vector< ServerConnection* >::iterator pendingIter = std::find( m_pendingFlushConnections.begin(), m_pendingFlushConnections.end(), connection );
+		if( pendingIter != m_pendingFlushConnections.end() )
+			m_pendingFlushConnections.erase( pendingIter );
+	}
+
+	std::vector< ServerConnection* >::iterator connectionIter = std::find( m_connections.begin(), m_connections.end(), connection );
+	if( connectionIter != m_connections.end() )
+	{
+		*connectionIter = m_connections.back();
+		m_connections.pop_back();
+	}
+
+	m_connectionsByAddress.erase( connection->m_addressKey );
+
+	// The lobby is the default route, so only room shards have a routing entry to clear
+	if( !IsLobbyShard() )
+	{
+		ShardMessage removedMessage;
+		removedMessage.m_type = SHARD_MESSAGE_Removed;
+		removedMessage.m_addressKey = connection->m_addressKey;
+		m_server.PostToServer( removedMessage );
+	}
+
+	m_server.AddToConnectionCount( -1 );
+	delete connection;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Deferred so no caller loses the connection while iterating rooms or the connection list.
+void RoomShard::HandOffConnection( ServerConnection& connection, RoomID targetRoom, const FinalPacket* packet )
+{
+	if( connection.m_isLeavingShard )
+		return;
+
+	connection.m_isLeavingShard = true;
+
+	ShardMessage handoffMessage;
+	handoffMessage.m_type = SHARD_MESSAGE_Handoff;
+	handoffMessage.m_addressKey = connection.m_addressKey;
+	handoffMessage.m_address = connection.m_address;
+	handoffMessage.m_connection = &connection;
+	handoffMessage.m_targetRoom = targetRoom;
+	handoffMessage.m_hasPacket = ( packet != nullptr );
+	if( packet != nullptr )
+		handoffMessage.m_packet = *packet;
+
+	m_pendingHandoffs.push_back( handoffMessage );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Room shards only keep connections that are playing in one of their rooms.
+void RoomShard::ReleaseToLobbyIfIdle( ServerConnection& connection )
+{
+	if( !IsLobbyShard() && !IsGameRoom( connection.m_room ) )
+		HandOffConnection( connection, ROOM_Lobby, nullptr );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RoomShard::ApplyPendingHandoffs()
+{
+	for( unsigned int handoffIndex = 0; handoffIndex < m_pendingHandoffs.size(); ++handoffIndex )
+	{
+		ServerConnection* connection = m_pendingHandoffs[ handoffIndex ].m_connection;
+		FlushConnection( *connection );
+
+		if( connection->m_isPendingFlush )
+		{
+			std::vector< ServerConnection* >::iterator pendingIter = std::find( m_pendingFlushConnections.begin(), m_pendingFlushConnections.end(), connection );
+			if( pendingIter != m_pendingFlushConnections.end() )
+				m_pendingFlushConnections.erase( pendingIter );
+
+			connection->m_isPendingFlush = false;
+		}
+
+		std::vector< ServerConnection* >::iterator connectionIter = std::find( m_connections.begin(), m_connections.end(), connection );
+		if( connectionIter != m_connections.end() )
+		{
+			*connectionIter = m_connections.back();
+			m_connections.pop_back();
+		}
+
+		m_connectionsByAddress.erase( connection->m_addressKey );
+
+		// The lobby shard shares the server thread, so its routing changes take effect at once
+		if( IsLobbyShard() )
+			m_server.RouteHandoff( m_pendingHandoffs[ handoffIndex ] );
+		else
+			m_server.PostToServer( m_pendingHandoffs[ handoffIndex ] );
+	}
+
+	m_pendingHandoffs.clear();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Player IDs are the room slot + 1, so ID_None is never handed out.
+bool RoomShard::AddPlayerToRoom( ServerConnection& connection, RoomID room )
+{
+	ServerRoom& serverRoom = m_server.GetRoom( room );
+	for( int playerIndex = 0; playerIndex < SERVER_MAX_PLAYERS_PER_ROOM; ++playerIndex )
+	{
+		if( serverRoom.m_players[ playerIndex ] != nullptr )
+			continue;
+
+		serverRoom.m_players[ playerIndex ] = &connection;
+		++serverRoom.m_numPlayers;
+		m_server.SetNumPlayersInRoom( room, serverRoom.m_numPlayers );
+		if( serverRoom.m_host == nullptr )
+			serverRoom.m_host = &connection;
+
+		connection.m_room = room;
+		connection.m_playerID = (ClientID) ( playerIndex + 1 );
+		connection.m_score = 0;
+		connection.m_hasGameUpdate = false;
+		connection.m_hasNewGameUpdate = false;
+		return true;
+	}
+
+	return false;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// The game ends for everyone when its host leaves.
+void RoomShard::RemovePlayerFromRoom( ServerConnection& connection )
+{
+	if( !IsGameRoom( connection.m_room ) )
+		return;
+
+	RoomID room = connection.m_room;
+	ServerRoom& serverRoom = m_server.GetRoom( room );
+	serverRoom.m_players[ connection.m_playerID - 1 ] = nullptr;
+	--serverRoom.m_numPlayers;
+	m_server.SetNumPlayersInRoom( room, serverRoom.m_numPlayers );
+
+	connection.m_room = ROOM_Lobby;
+	connection.m_playerID = ID_None;
+	connection.m_hasGameUpdate = false;
+	connection.m_hasNewGameUpdate = false;
+
+	if( serverRoom.m_host == &connection )
+	{
+		serverRoom.m_host = nullptr;
+		ReturnRoomToLobby( room );
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RoomShard::ReturnRoomToLobby( RoomID room )
+{
+	ServerRoom& serverRoom = m_server.GetRoom( room );
+	for( int playerIndex = 0; playerIndex < SERVER_MAX_PLAYERS_PER_ROOM; ++playerIndex )
+	{
+		ServerConnection* player = serverRoom.m_players[ playerIndex ];
+		if( player == nullptr )
+			continue;
+
+		player->m_room = ROOM_Lobby;
+		player->m_playerID = ID_None;
+		player->m_hasGameUpdate = false;
+		player->m_hasNewGameUpdate = false;
+
+		FinalPacket lobbyReturnPacket;
+		InitializeServerPacket( lobbyReturnPacket, TYPE_ReturnToLobby, ID_None );
+		SendPacket( *player, lobbyReturnPacket );
+		ReleaseToLobbyIfIdle( *player );
+
+		serverRoom.m_players[ playerIndex ] = nullptr;
+	}
+
+	serverRoom.m_host = nullptr;
+	serverRoom.m_numPlayers = 0;
+	m_server.SetNumPlayersInRoom( room, 0 );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Random point far enough from the walls for the whole collider; 2 s of invulnerability.
+void RoomShard::SpawnPlayer( ServerConnection& connection, Vector2& out_position, float& out_orientationDegrees )
+{
+	float spawnRange = SERVER_ARENA_SIZE - ( 2.f * TANK_COLLIDER_RADIUS );
+	out_position.x = TANK_COLLIDER_RADIUS + ( GetRandomPercentage() * spawnRange );
+	out_position.y = TANK_COLLIDER_RADIUS + ( GetRandomPercentage() * spawnRange );
+	out_orientationDegrees = GetRandomPercentage() * 359.99f;
+
+	GameUpdatePacket& state = connection.m_lastGameUpdate.data.updatedGame;
+	memset( &state, 0, sizeof( state ) );
+	state.xPosition = out_position.x;
+	state.yPosition = out_position.y;
+	state.orientationDegrees = out_orientationDegrees;
+
+	connection.m_movementState = TankMovementState( out_position, out_orientationDegrees );
+	connection.m_lastMovementInput = TankMovementInput();
+	connection.m_movementBudgetSteps = MOVEMENT_BUDGET_SLACK_SECONDS * TANK_MOVEMENT_STEPS_PER_SECOND;
+	connection.m_timeOfMovementBudgetRefill = GetCurrentTimeSeconds();
+
+	// A new life restarts the client's step numbering from its first input tagged with it
+	connection.m_hasMovementStep = false;
+
+	// Shots rewound to before the respawn must not hit the tank where it died
+	m_server.GetRoom( connection.m_room ).m_positionHistory.ForgetTank( connection.m_playerID - 1 );
+
+	connection.m_health = TANK_MAX_HEALTH;
+	connection.m_invulnerableUntilSeconds = GetCurrentTimeSeconds() + RESPAWN_INVULNERABILITY_SECONDS;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RoomShard::SendGameReset( ServerConnection& connection )
+{
+	Vector2 spawnPosition;
+	float spawnOrientationDegrees;
+	SpawnPlayer( connection, spawnPosition, spawnOrientationDegrees );
+
+	FinalPacket resetPacket;
+	InitializeServerPacket( resetPacket, TYPE_GameReset, connection.m_playerID );
+	resetPacket.data.reset.xPosition = spawnPosition.x;
+	resetPacket.data.reset.yPosition = spawnPosition.y;
+	resetPacket.data.reset.orientationDegrees = spawnOrientationDegrees;
+	resetPacket.data.reset.id = connection.m_playerID;
+	resetPacket.data.reset.capabilities = connection.m_capabilities & ( CAPABILITY_CoalescedPackets | CAPABILITY_SelectiveAcks );
+	if( HasServerMovement( connection ) )
+		resetPacket.data.reset.capabilities |= CAPABILITY_ServerMovement;
+
+	SendPacket( connection, resetPacket );
+	connection.m_spawnPacketNumber = resetPacket.number;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RoomShard::SendRespawn( ServerConnection& connection )
+{
+	Vector2 spawnPosition;
+	float spawnOrientationDegrees;
+	SpawnPlayer( connection, spawnPosition, spawnOrientationDegrees );
+
+	FinalPacket respawnPacket;
+	InitializeServerPacket( respawnPacket, TYPE_Respawn, connection.m_playerID );
+	respawnPacket.data.respawn.xPosition = spawnPosition.x;
+	respawnPacket.data.respawn.yPosition = spawnPosition.y;
+	respawnPacket.data.respawn.orientationDegrees = spawnOrientationDegrees;
+
+	SendPacket( connection, respawnPacket );
+	connection.m_spawnPacketNumber = respawnPacket.number;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Clients that send ack blocks get recent guaranteed packets acked in our next datagram header.
+void RoomShard::SendAck( ServerConnection& connection, const FinalPacket& packet )
+{
+	if( HasSelectiveAcks( connection ) && connection.m_receivedPackets.IsCoveredByAckBlock( packet.number ) )
+	{
+		MarkPendingFlush( connection );
+		return;
+	}
+
+	FinalPacket ackPacket;
+	InitializeServerPacket( ackPacket, TYPE_Ack, connection.m_playerID );
+	ackPacket.data.acknowledged.type = packet.type;
+	ackPacket.data.acknowledged.number = packet.number;
+
+	SendPacket( connection, ackPacket );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RoomShard::SendNack( ServerConnection& connection, const FinalPacket& packet, ErrorCode errorCode )
+{
+	FinalPacket nackPacket;
+	InitializeServerPacket( nackPacket, TYPE_Nack, connection.m_playerID );
+	nackPacket.data.refused.type = packet.type;
+	nackPacket.data.refused.number = packet.number;
+	nackPacket.data.refused.errorCode = errorCode;
+
+	SendPacket( connection, nackPacket );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RoomShard::SendLobbyUpdate( ServerConnection& connection )
+{
+	FinalPacket lobbyUpdatePacket;
+	InitializeServerPacket( lobbyUpdatePacket, TYPE_LobbyUpdate, ID_None );
+	m_server.GetPlayersPerRoom( lobbyUpdatePacket.data.updatedLobby.playersInRoomNumber );
+
+	SendPacket( connection, lobbyUpdatePacket );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RoomShard::SendPacket( ServerConnection& connection, FinalPacket& packet )
+{
+	packet.number = connection.m_nextPacketNumber;
+	++connection.m_nextPacketNumber;
+
+	if( packet.IsGuaranteed() )
+	{
+		OutstandingPacket outstandingPacket;
+		outstandingPacket.m_packet = packet;
+		outstandingPacket.m_sendTimeSeconds = GetCurrentTimeSeconds();
+		outstandingPacket.m_resendTimeSeconds = outstandingPacket.m_sendTimeSeconds + connection.m_roundTripEstimator.GetRetransmissionTimeoutSeconds();
+		outstandingPacket.m_numTransmissions = 1;
+		connection.m_outstandingPackets.push_back( outstandingPacket );
+	}
+
+	TransmitPacket( connection, packet );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Replies in whatever format the client speaks; retransmits come through here so they keep their number.
+void RoomShard::TransmitPacket( ServerConnection& connection, const FinalPacket& packet )
+{
+	if( connection.m_wireFormat == WIRE_FORMAT_Coalesced )
+	{
+		if( connection.m_coalescer.AddPacket( packet ) )
+		{
+			MarkPendingFlush( connection );
+			return;
+		}
+
+		FlushConnection( connection );
+		if( connection.m_coalescer.AddPacket( packet ) )
+		{
+			MarkPendingFlush( connection );
+			return;
+		}
+	}
+
+	// Packets too big to coalesce go out alone rather than being dropped
+	if( connection.m_wireFormat != WIRE_FORMAT_Legacy )
+	{
+		// Anything too big to encode goes out raw; compact clients decode either format
+		unsigned char datagram[ MAX_COMPACT_PACKET_SIZE_BYTES ];
+		int numBytes = SerializeFinalPacket( packet, datagram, sizeof( datagram ) );
+		if( numBytes > 0 )
+			QueueDatagram( connection.m_address, datagram, numBytes );
+		else
+			QueueDatagram( connection.m_address, (const unsigned char*) &packet, sizeof( packet ) );
+	}
+	else
+	{
+		QueueDatagram( connection.m_address, (const unsigned char*) &packet, sizeof( packet ) );
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Karn's rule: only packets sent exactly once give an unambiguous round-trip sample.
+bool RoomShard::RemoveOutstandingPacket( ServerConnection& connection, PacketNumber number )
+{
+	std::vector< OutstandingPacket >& outstandingPackets = connection.m_outstandingPackets;
+	for( unsigned int outstandingIndex = 0; outstandingIndex < outstandingPackets.size(); ++outstandingIndex )
+	{
+		if( outstandingPackets[ outstandingIndex ].m_packet.number != number )
+			continue;
+
+		if( outstandingPackets[ outstandingIndex ].m_numTransmissions == 1 )
+			connection.m_roundTripEstimator.AddSample( GetCurrentTimeSeconds() - outstandingPackets[ outstandingIndex ].m_sendTimeSeconds );
+
+		outstandingPackets[ outstandingIndex ] = outstandingPackets.back();
+		outstandingPackets.pop_back();
+		return true;
+	}
+
+	return false;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RoomShard::RemoveAckedPackets( ServerConnection& connection, const AckBlock& ackBlock )
+{
+	std::vector< OutstandingPacket >& outstandingPackets = connection.m_outstandingPackets;
+	double newestSendTimeSeconds = -1.0;
+
+	for( unsigned int outstandingIndex = 0; outstandingIndex < outstandingPackets.size(); )
+	{
+		const OutstandingPacket& outstandingPacket = outstandingPackets[ outstandingIndex ];
+		if( !IsPacketNumberInAckBlock( ackBlock, outstandingPacket.m_packet.number ) )
+		{
+			++outstandingIndex;
+			continue;
+		}
+
+		if( outstandingPacket.m_numTransmissions == 1 && outstandingPacket.m_sendTimeSeconds > newestSendTimeSeconds )
+			newestSendTimeSeconds = outstandingPacket.m_sendTimeSeconds;
+
+		outstandingPackets[ outstandingIndex ] = outstandingPackets.back();
+		outstandingPackets.pop_back();
+	}
+
+	if( newestSendTimeSeconds >= 0.0 )
+		connection.m_roundTripEstimator.AddSample( GetCurrentTimeSeconds() - newestSendTimeSeconds );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RoomShard::MarkPendingFlush( ServerConnection& connection )
+{
+	if( connection.m_isPendingFlush )
+		return;
+
+	connection.m_isPendingFlush = true;
+	m_pendingFlushConnections.push_back( &connection );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RoomShard::FlushConnection( ServerConnection& connection )
+{
+	PacketCoalescer& coalescer = connection.m_coalescer;
+	ReceivedPacketTracker& receivedPackets = connection.m_receivedPackets;
+	if( HasSelectiveAcks( connection ) && receivedPackets.HasReceivedAnyPacket() && ( !coalescer.IsEmpty() || receivedPackets.IsAckPending() ) )
+		coalescer.SetAckBlock( receivedPackets.BuildAckBlock() );
+
+	if( coalescer.IsEmpty() )
+		return;
+
+	QueueDatagram( connection.m_address, coalescer.GetDatagram(), coalescer.GetDatagramSize() );
+	coalescer.Reset();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RoomShard::FlushPendingConnections()
+{
+	for( unsigned int connectionIndex = 0; connectionIndex < m_pendingFlushConnections.size(); ++connectionIndex )
+	{
+		ServerConnection* connection = m_pendingFlushConnections[ connectionIndex ];
+		FlushConnection( *connection );
+		connection->m_isPendingFlush = false;
+	}
+
+	m_pendingFlushConnections.clear();
+	FlushQueuedDatagrams();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RoomShard::QueueDatagram( const struct sockaddr_in& toAddr, const unsigned char* datagram, int numBytes )
+{
+	if( numBytes <= 0 || numBytes > MAX_DATAGRAM_SIZE_BYTES )
+		return;
+
+	if( m_sendQueueCount == MAX_DATAGRAMS_PER_SYSTEM_CALL )
+		FlushQueuedDatagrams();
+
+	DatagramBuffer& queuedDatagram = m_sendQueue[ m_sendQueueCount ];
+	memcpy( queuedDatagram.m_data, datagram, numBytes );
+	queuedDatagram.m_numBytes = numBytes;
+	m_sendQueueAddrs[ m_sendQueueCount ] = toAddr;
+	++m_sendQueueCount;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Hands the whole queue to one sendmmsg(); anything the kernel refuses is dropped like any UDP loss.
+void RoomShard::FlushQueuedDatagrams()
+{
+	if( m_sendQueueCount == 0 )
+		return;
+
+	char* sendBuffers[ MAX_DATAGRAMS_PER_SYSTEM_CALL ];
+	int numBytesToSend[ MAX_DATAGRAMS_PER_SYSTEM_CALL ];
+	const struct sockaddr_in* toAddrs[ MAX_DATAGRAMS_PER_SYSTEM_CALL ];
+	for( int datagramIndex = 0; datagramIndex < m_sendQueueCount; ++datagramIndex )
+	{
+		sendBuffers[ datagramIndex ] = m_sendQueue[ datagramIndex ].m_data;
+		numBytesToSend[ datagramIndex ] = m_sendQueue[ datagramIndex ].m_numBytes;
+		toAddrs[ datagramIndex ] = &m_sendQueueAddrs[ datagramIndex ];
+	}
+
+	m_server.GetSocket().SendBatch( sendBuffers, numBytesToSend, toAddrs, m_sendQueueCount );
+	m_sendQueueCount = 0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned long long GetAddressKey( const struct sockaddr_in& address )
+{
+	return ( (unsigned long long) address.sin_addr.s_addr << 16 ) | address.sin_port;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void MakeDatagramMessage( ShardMessage& out_message, unsigned long long addressKey, const struct sockaddr_in& fromAddr, const unsigned char* datagram, int numBytes )
+{
+	out_message.m_type = SHARD_MESSAGE_Datagram;
+	out_message.m_addressKey = addressKey;
+	out_message.m_address = fromAddr;
+	memcpy( out_message.m_datagram.m_data, datagram, numBytes );
+	out_message.m_datagram.m_numBytes = numBytes;
+}
\ No newline at end of file
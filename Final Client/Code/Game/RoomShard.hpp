@@ -0,0 +1,231 @@
+#ifndef include_RoomShard
+#define include_RoomShard
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include <map>
+#include <vector>
+#include "UDPClient.hpp"
+#include "UDPSocket.hpp"
+#include "FinalPacket.hpp"
+#include "SelectiveAck.hpp"
+#include "PacketFraming.hpp"
+#include "SnapshotDelta.hpp"
+#include "TankMovement.hpp"
+#include "TankPositionHistory.hpp"
+#include "RoundTripEstimator.hpp"
+#include "../Engine/Vector2.hpp"
+#include "../Engine/Threading.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+class RoomServer;
+
+
+//-----------------------------------------------------------------------------------------------
+// Game rules from FinalPacket.hpp, enforced by the server.
+const int SERVER_NUM_ROOMS = 8;
+const int SERVER_MAX_PLAYERS_PER_ROOM = 8;
+const int KILLS_TO_WIN = 10;
+const unsigned char TANK_MAX_HEALTH = 1;
+const unsigned char LASER_DAMAGE = 1;
+const float TANK_COLLIDER_RADIUS = 10.f;
+const float SERVER_ARENA_SIZE = 500.f;
+const double RESPAWN_INVULNERABILITY_SECONDS = 2.0;
+const double SECONDS_BEFORE_CONNECTION_TIMEOUT = 5.0;
+const int MAX_MOVEMENT_GAP_STEPS = 30;
+const double MOVEMENT_BUDGET_SLACK_SECONDS = 0.5; // how far inputs may bunch up after a network stall
+const int LOBBY_SHARD_INDEX = 0;
+
+
+//-----------------------------------------------------------------------------------------------
+enum WireFormat
+{
+	WIRE_FORMAT_Legacy,
+	WIRE_FORMAT_Compact,
+	WIRE_FORMAT_Coalesced
+};
+
+
+//-----------------------------------------------------------------------------------------------
+// A client has only a handful of guaranteed packets in flight at once, so a short vector scanned
+// linearly beats giving every connection a ReliabilityWindow (over a megabyte each).
+struct OutstandingPacket
+{
+	FinalPacket	m_packet;
+	double		m_sendTimeSeconds;
+	double		m_resendTimeSeconds;
+	int			m_numTransmissions;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+// Owned by exactly one shard at a time; only the owning shard's thread may touch it.
+struct ServerConnection
+{
+	ServerConnection( const struct sockaddr_in& address, unsigned long long addressKey );
+
+	struct sockaddr_in					m_address;
+	unsigned long long					m_addressKey;
+	WireFormat							m_wireFormat;
+	CapabilityFlags						m_capabilities;
+	PacketNumber						m_nextPacketNumber;
+	double								m_timeOfLastReceive;
+	bool								m_isPendingFlush;
+	bool								m_isLeavingShard;
+	PacketCoalescer						m_coalescer;
+	ReceivedPacketTracker				m_receivedPackets;
+	SnapshotHistory						m_receivedSnapshots;
+	RoundTripEstimator					m_roundTripEstimator;
+	std::vector< OutstandingPacket >	m_outstandingPackets;
+
+	RoomID								m_room;
+	ClientID							m_playerID;
+	FinalPacket							m_lastGameUpdate;
+	bool								m_hasGameUpdate;
+	bool								m_hasNewGameUpdate;
+	unsigned char						m_health;
+	unsigned char						m_score;
+	double								m_invulnerableUntilSeconds;
+
+	TankMovementState					m_movementState;
+	TankMovementInput					m_lastMovementInput;
+	unsigned int						m_nextMovementStep;
+	bool								m_hasMovementStep;
+	bool								m_hasNewMovement;
+	PacketNumber						m_spawnPacketNumber; // of the GameReset or Respawn that placed the tank
+	double								m_movementBudgetSteps;
+	double								m_timeOfMovementBudgetRefill;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+// Tank n of the position history is m_players[ n ].
+struct ServerRoom
+{
+	ServerConnection*	m_host;
+	ServerConnection*	m_players[ SERVER_MAX_PLAYERS_PER_ROOM ];
+	int					m_numPlayers;
+	TankPositionHistory	m_positionHistory;
+};
+static_assert( SERVER_MAX_PLAYERS_PER_ROOM <= TANK_HISTORY_NUM_TANKS, "Every player in a room needs a slot in its position history" );
+
+
+//-----------------------------------------------------------------------------------------------
+enum ShardMessageType
+{
+	SHARD_MESSAGE_Datagram,
+	SHARD_MESSAGE_Handoff,
+	SHARD_MESSAGE_Removed
+};
+
+
+//-----------------------------------------------------------------------------------------------
+// Shards and the server thread talk only through these: raw datagrams routed to the owner of their
+// address, connections changing owner (with the packet that asked to move), and removals.
+struct ShardMessage
+{
+	ShardMessageType	m_type;
+	unsigned long long	m_addressKey;
+	struct sockaddr_in	m_address;
+	DatagramBuffer		m_datagram;
+	ServerConnection*	m_connection;
+	RoomID				m_targetRoom;
+	bool				m_hasPacket;
+	FinalPacket			m_packet;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+// Runs the lobby or a slice of the rooms: the connections in them, their simulation and their
+// outgoing send queue. The lobby shard lives on the server's socket thread; room shards each
+// get a worker thread and are fed through their inbox, plus their own SO_REUSEPORT socket if given one.
+class RoomShard
+{
+public:
+	RoomShard( RoomServer& server, int shardIndex, UDPSocket* receiveSocket );
+	~RoomShard();
+	void Run();
+	void WakeUp();
+	void PostMessages( std::vector< ShardMessage >& messages );
+	void ProcessMessages();
+	void ProcessDatagram( unsigned long long addressKey, const struct sockaddr_in& fromAddr, const unsigned char* datagram, int numBytes );
+	void AcceptConnection( ServerConnection* connection, const FinalPacket* packet );
+	double GetTimeOfNextTick() const;
+	void Tick();
+	void FlushPendingConnections();
+	void Shutdown();
+	bool IsLobbyShard() const;
+
+private:
+	void ReceiveDatagrams();
+	void ProcessPacket( ServerConnection& connection, const FinalPacket& packet );
+	void ProcessAck( ServerConnection& connection, const FinalPacket& ackPacket );
+	void ProcessJoinRoom( ServerConnection& connection, const FinalPacket& joinPacket );
+	void ProcessCreateRoom( ServerConnection& connection, const FinalPacket& createPacket );
+	void ProcessGameUpdate( ServerConnection& connection, const FinalPacket& updatePacket );
+	void ProcessFire( ServerConnection& connection, const FinalPacket& firePacket );
+	void ProcessTankInput( ServerConnection& connection, const FinalPacket& inputPacket );
+	void RefillMovementBudget( ServerConnection& connection );
+	bool SpendMovementBudget( ServerConnection& connection );
+	void PublishMovementState( ServerConnection& connection );
+	void BroadcastLobbyUpdate();
+	void RecordTankPositions();
+	void GetTanksSeenByShooter( const ServerRoom& serverRoom, double viewTimeSeconds, TankHistoryFrame& out_frame ) const;
+	void RelayGameUpdates();
+	void SendTankCorrections();
+	void ResendGuaranteedPackets();
+	void RemoveTimedOutConnections();
+	bool IsRoomOwnedHere( RoomID room ) const;
+	ServerConnection* FindConnection( unsigned long long addressKey );
+	void AddConnection( ServerConnection* connection );
+	void RemoveConnection( ServerConnection* connection );
+	void HandOffConnection( ServerConnection& connection, RoomID targetRoom, const FinalPacket* packet );
+	void ReleaseToLobbyIfIdle( ServerConnection& connection );
+	void ApplyPendingHandoffs();
+	bool AddPlayerToRoom( ServerConnection& connection, RoomID room );
+	void RemovePlayerFromRoom( ServerConnection& connection );
+	void ReturnRoomToLobby( RoomID room );
+	void SpawnPlayer( ServerConnection& connection, Vector2& out_position, float& out_orientationDegrees );
+	void SendGameReset( ServerConnection& connection );
+	void SendRespawn( ServerConnection& connection );
+	void SendAck( ServerConnection& connection, const FinalPacket& packet );
+	void SendNack( ServerConnection& connection, const FinalPacket& packet, ErrorCode errorCode );
+	void SendLobbyUpdate( ServerConnection& connection );
+	void SendPacket( ServerConnection& connection, FinalPacket& packet );
+	void TransmitPacket( ServerConnection& connection, const FinalPacket& packet );
+	bool RemoveOutstandingPacket( ServerConnection& connection, PacketNumber number );
+	void RemoveAckedPackets( ServerConnection& connection, const AckBlock& ackBlock );
+	void MarkPendingFlush( ServerConnection& connection );
+	void FlushConnection( ServerConnection& connection );
+	void QueueDatagram( const struct sockaddr_in& toAddr, const unsigned char* datagram, int numBytes );
+	void FlushQueuedDatagrams();
+
+	RoomServer&											m_server;
+	int													m_shardIndex;
+	double												m_timeOfNextTick;
+	UDPSocket*											m_receiveSocket;
+	DatagramBuffer*										m_receiveBuffers;
+	std::vector< std::vector< ShardMessage > >			m_forwardedDatagrams;
+	std::vector< ServerConnection* >					m_connections;
+	std::map< unsigned long long, ServerConnection* >	m_connectionsByAddress;
+	std::vector< ServerConnection* >					m_pendingFlushConnections;
+	std::vector< ShardMessage >							m_pendingHandoffs;
+	CriticalSection										m_inboxLock;
+	WakeEvent											m_inboxEvent;
+	std::vector< ShardMessage >							m_inbox;
+	std::vector< ShardMessage >							m_messagesBeingProcessed;
+	DatagramBuffer*										m_sendQueue;
+	struct sockaddr_in									m_sendQueueAddrs[ MAX_DATAGRAMS_PER_SYSTEM_CALL ];
+	int													m_sendQueueCount;
+	char												m_lastBroadcastPlayersPerRoom[ SERVER_NUM_ROOMS ];
+	FinalPacket											m_unpackedPackets[ MAX_PACKETS_PER_DATAGRAM ];
+};
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned long long GetAddressKey( const struct sockaddr_in& address );
+void MakeDatagramMessage( ShardMessage& out_message, unsigned long long addressKey, const struct sockaddr_in& fromAddr, const unsigned char* datagram, int numBytes );
+
+
+#endif // include_RoomShard
\ No newline at end of file
@@ -0,0 +1,112 @@
+#include "RoundTripEstimator.hpp"
+#include <math.h>
+#include "../Engine/NewMacroDef.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+RoundTripEstimator::RoundTripEstimator()
+{
+	Reset();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RoundTripEstimator::Reset()
+{
+	m_numSamples = 0;
+	m_backoffMultiplier = 1;
+	m_lastSampleSeconds = 0.0;
+	m_smoothedRoundTripSeconds = 0.0;
+	m_roundTripVarianceSeconds = 0.0;
+	m_retransmissionTimeoutSeconds = INITIAL_RETRANSMISSION_TIMEOUT_SECONDS;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Callers must only pass samples from packets that were never retransmitted (Karn's algorithm).
+void RoundTripEstimator::AddSample( double roundTripSeconds )
+{
+	if( roundTripSeconds < 0.0 )
+		return;
+
+	if( m_numSamples == 0 )
+	{
+		m_smoothedRoundTripSeconds = roundTripSeconds;
+		m_roundTripVarianceSeconds = roundTripSeconds * 0.5;
+	}
+	else
+	{
+		m_roundTripVarianceSeconds = ( 1.0 - RTT_VARIANCE_BETA ) * m_roundTripVarianceSeconds + RTT_VARIANCE_BETA * fabs( m_smoothedRoundTripSeconds - roundTripSeconds );
+		m_smoothedRoundTripSeconds = ( 1.0 - RTT_SMOOTHING_ALPHA ) * m_smoothedRoundTripSeconds + RTT_SMOOTHING_ALPHA * roundTripSeconds;
+	}
+
+	double varianceTerm = RTO_VARIANCE_MULTIPLIER * m_roundTripVarianceSeconds;
+	if( varianceTerm < RTO_CLOCK_GRANULARITY_SECONDS )
+		varianceTerm = RTO_CLOCK_GRANULARITY_SECONDS;
+
+	m_retransmissionTimeoutSeconds = m_smoothedRoundTripSeconds + varianceTerm;
+	if( m_retransmissionTimeoutSeconds < MIN_RETRANSMISSION_TIMEOUT_SECONDS )
+		m_retransmissionTimeoutSeconds = MIN_RETRANSMISSION_TIMEOUT_SECONDS;
+	else if( m_retransmissionTimeoutSeconds > MAX_RETRANSMISSION_TIMEOUT_SECONDS )
+		m_retransmissionTimeoutSeconds = MAX_RETRANSMISSION_TIMEOUT_SECONDS;
+
+	// A fresh measurement means the path is delivering again, so the backoff collapses
+	m_backoffMultiplier = 1;
+	m_lastSampleSeconds = roundTripSeconds;
+	++m_numSamples;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Called once per retransmission-timer expiry; doubles the timeout until the next valid sample.
+void RoundTripEstimator::BackOff()
+{
+	if( m_retransmissionTimeoutSeconds * m_backoffMultiplier < MAX_RETRANSMISSION_TIMEOUT_SECONDS )
+		m_backoffMultiplier *= 2;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+int RoundTripEstimator::GetNumSamples() const
+{
+	return m_numSamples;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+int RoundTripEstimator::GetBackoffMultiplier() const
+{
+	return m_backoffMultiplier;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+double RoundTripEstimator::GetLastSampleSeconds() const
+{
+	return m_lastSampleSeconds;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+double RoundTripEstimator::GetSmoothedRoundTripSeconds() const
+{
+	return m_smoothedRoundTripSeconds;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+double RoundTripEstimator::GetRoundTripVarianceSeconds() const
+{
+	return m_roundTripVarianceSeconds;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+double RoundTripEstimator::GetRetransmissionTimeoutSeconds() const
+{
+	double backedOffTimeout = m_retransmissionTimeoutSeconds * m_backoffMultiplier;
+	if( backedOffTimeout > MAX_RETRANSMISSION_TIMEOUT_SECONDS )
+		return MAX_RETRANSMISSION_TIMEOUT_SECONDS;
+
+	return backedOffTimeout;
+}
\ No newline at end of file
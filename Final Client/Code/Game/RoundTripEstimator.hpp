@@ -0,0 +1,43 @@
+#ifndef include_RoundTripEstimator
+#define include_RoundTripEstimator
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+// RFC 6298 gains and bounds. The RFC's 1 s floor and 60 s ceiling suit bulk TCP transfers; a
+// 20 Hz game wants a lost Fire recovered within a few frames, so both bounds are much tighter.
+const double RTT_SMOOTHING_ALPHA = 0.125;
+const double RTT_VARIANCE_BETA = 0.25;
+const double RTO_VARIANCE_MULTIPLIER = 4.0;
+const double RTO_CLOCK_GRANULARITY_SECONDS = 0.016;
+const double INITIAL_RETRANSMISSION_TIMEOUT_SECONDS = 0.25;
+const double MIN_RETRANSMISSION_TIMEOUT_SECONDS = 0.05;
+const double MAX_RETRANSMISSION_TIMEOUT_SECONDS = 2.0;
+
+
+//-----------------------------------------------------------------------------------------------
+// Smoothed RTT / RTT variance from ack samples, and the retransmission timeout derived from them.
+class RoundTripEstimator
+{
+public:
+	RoundTripEstimator();
+	void Reset();
+	void AddSample( double roundTripSeconds );
+	void BackOff();
+	int GetNumSamples() const;
+	int GetBackoffMultiplier() const;
+	double GetLastSampleSeconds() const;
+	double GetSmoothedRoundTripSeconds() const;
+	double GetRoundTripVarianceSeconds() const;
+	double GetRetransmissionTimeoutSeconds() const;
+
+private:
+	int		m_numSamples;
+	int		m_backoffMultiplier;
+	double	m_lastSampleSeconds;
+	double	m_smoothedRoundTripSeconds;
+	double	m_roundTripVarianceSeconds;
+	double	m_retransmissionTimeoutSeconds;
+};
+
+
+#endif // include_RoundTripEstimator
\ No newline at end of file
@@ -0,0 +1,162 @@
+#include "SelectiveAck.hpp"
+#include "../Engine/NewMacroDef.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+// Wrap-safe: numbers less than half the number space ahead count as newer.
+bool IsPacketNumberNewer( PacketNumber number, PacketNumber comparedTo )
+{
+	return (int) ( number - comparedTo ) > 0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool IsPacketNumberInAckBlock( const AckBlock& ackBlock, PacketNumber number )
+{
+	if( number == ackBlock.latestNumber )
+		return true;
+
+	PacketNumber distance = ackBlock.latestNumber - number;
+	if( distance == 0 || distance > ACK_BITFIELD_NUM_BITS )
+		return false;
+
+	return ( ackBlock.receivedBits & ( 1u << ( distance - 1 ) ) ) != 0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Fixed little-endian layout so the block can be patched into a datagram header in place.
+void WriteAckBlock( const AckBlock& ackBlock, unsigned char* out_bytes )
+{
+	for( int byteIndex = 0; byteIndex < 4; ++byteIndex )
+	{
+		out_bytes[ byteIndex ] = (unsigned char) ( ackBlock.latestNumber >> ( 8 * byteIndex ) );
+		out_bytes[ 4 + byteIndex ] = (unsigned char) ( ackBlock.receivedBits >> ( 8 * byteIndex ) );
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void ReadAckBlock( const unsigned char* bytes, AckBlock& out_ackBlock )
+{
+	out_ackBlock.latestNumber = 0;
+	out_ackBlock.receivedBits = 0;
+	for( int byteIndex = 0; byteIndex < 4; ++byteIndex )
+	{
+		out_ackBlock.latestNumber |= (PacketNumber) bytes[ byteIndex ] << ( 8 * byteIndex );
+		out_ackBlock.receivedBits |= (unsigned int) bytes[ 4 + byteIndex ] << ( 8 * byteIndex );
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+ReceivedPacketTracker::ReceivedPacketTracker()
+{
+	Reset();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void ReceivedPacketTracker::Reset()
+{
+	m_ackBlock.latestNumber = 0;
+	m_ackBlock.receivedBits = 0;
+	m_hasReceivedAnyPacket = false;
+	m_isAckPending = false;
+
+	for( int slotIndex = 0; slotIndex < DUPLICATE_HISTORY_SIZE; ++slotIndex )
+	{
+		m_isHistorySlotUsed[ slotIndex ] = false;
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Every packet is recorded so the peer learns what arrived; only guaranteed ones make an ack urgent.
+// Returns false for a packet seen before: it must be acked again (our ack was lost) but not applied.
+bool ReceivedPacketTracker::RecordReceivedPacket( PacketNumber number, bool needsAck )
+{
+	if( needsAck )
+		m_isAckPending = true;
+
+	if( IsDuplicate( number ) )
+		return false;
+
+	int historySlot = (int) ( number & ( DUPLICATE_HISTORY_SIZE - 1 ) );
+	m_history[ historySlot ] = number;
+	m_isHistorySlotUsed[ historySlot ] = true;
+
+	if( !m_hasReceivedAnyPacket )
+	{
+		m_ackBlock.latestNumber = number;
+		m_ackBlock.receivedBits = 0;
+		m_hasReceivedAnyPacket = true;
+		return true;
+	}
+
+	if( IsPacketNumberNewer( number, m_ackBlock.latestNumber ) )
+	{
+		PacketNumber shift = number - m_ackBlock.latestNumber;
+		if( shift > ACK_BITFIELD_NUM_BITS )
+			m_ackBlock.receivedBits = 0;
+		else if( shift == ACK_BITFIELD_NUM_BITS )
+			m_ackBlock.receivedBits = 1u << ( ACK_BITFIELD_NUM_BITS - 1 );
+		else
+			m_ackBlock.receivedBits = ( m_ackBlock.receivedBits << shift ) | ( 1u << ( shift - 1 ) );
+
+		m_ackBlock.latestNumber = number;
+		return true;
+	}
+
+	PacketNumber distance = m_ackBlock.latestNumber - number;
+	if( distance >= 1 && distance <= ACK_BITFIELD_NUM_BITS )
+		m_ackBlock.receivedBits |= 1u << ( distance - 1 );
+
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool ReceivedPacketTracker::HasReceivedAnyPacket() const
+{
+	return m_hasReceivedAnyPacket;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool ReceivedPacketTracker::IsAckPending() const
+{
+	return m_isAckPending;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Packets that arrive more than ACK_BITFIELD_NUM_BITS behind the newest one need a standalone Ack.
+bool ReceivedPacketTracker::IsCoveredByAckBlock( PacketNumber number ) const
+{
+	return m_hasReceivedAnyPacket && IsPacketNumberInAckBlock( m_ackBlock, number );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Clears the pending flag; the block keeps sliding so every datagram restates the recent history.
+AckBlock ReceivedPacketTracker::BuildAckBlock()
+{
+	m_isAckPending = false;
+	return m_ackBlock;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Anything older than the history is assumed to have been applied already.
+bool ReceivedPacketTracker::IsDuplicate( PacketNumber number ) const
+{
+	if( !m_hasReceivedAnyPacket )
+		return false;
+
+	if( !IsPacketNumberNewer( number, m_ackBlock.latestNumber ) && m_ackBlock.latestNumber - number >= DUPLICATE_HISTORY_SIZE )
+		return true;
+
+	int historySlot = (int) ( number & ( DUPLICATE_HISTORY_SIZE - 1 ) );
+	return m_isHistorySlotUsed[ historySlot ] && m_history[ historySlot ] == number;
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+#ifndef include_SelectiveAck
+#define include_SelectiveAck
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include "FinalPacket.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+const int ACK_BITFIELD_NUM_BITS = 32;
+const int ACK_BLOCK_SIZE_BYTES = 8;
+const int DUPLICATE_HISTORY_SIZE = 1024; // must be a power of two
+
+
+//-----------------------------------------------------------------------------------------------
+// Bit n of receivedBits set means ( latestNumber - 1 - n ) also arrived.
+struct AckBlock
+{
+	PacketNumber	latestNumber;
+	unsigned int	receivedBits;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+bool IsPacketNumberNewer( PacketNumber number, PacketNumber comparedTo );
+bool IsPacketNumberInAckBlock( const AckBlock& ackBlock, PacketNumber number );
+void WriteAckBlock( const AckBlock& ackBlock, unsigned char* out_bytes );
+void ReadAckBlock( const unsigned char* bytes, AckBlock& out_ackBlock );
+
+
+//-----------------------------------------------------------------------------------------------
+// Remembers which of the peer's packet numbers have arrived recently, for the next outgoing AckBlock
+// and to recognise retransmits of packets that were already applied.
+class ReceivedPacketTracker
+{
+public:
+	ReceivedPacketTracker();
+	void Reset();
+	bool RecordReceivedPacket( PacketNumber number, bool needsAck );
+	bool HasReceivedAnyPacket() const;
+	bool IsAckPending() const;
+	bool IsCoveredByAckBlock( PacketNumber number ) const;
+	AckBlock BuildAckBlock();
+
+private:
+	bool IsDuplicate( PacketNumber number ) const;
+
+	AckBlock		m_ackBlock;
+	PacketNumber	m_history[ DUPLICATE_HISTORY_SIZE ];
+	bool			m_isHistorySlotUsed[ DUPLICATE_HISTORY_SIZE ];
+	bool			m_hasReceivedAnyPacket;
+	bool			m_isAckPending;
+};
+
+
+#endif // include_SelectiveAck
\ No newline at end of file
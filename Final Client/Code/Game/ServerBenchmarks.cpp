@@ -0,0 +1,399 @@
+#include "ServerBenchmarks.hpp"
+#include <map>
+#include <set>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "UDPClient.hpp"
+#include "UDPSocket.hpp"
+#include "FinalPacket.hpp"
+#include "PacketFraming.hpp"
+#include "FinalPacketSerializer.hpp"
+#include "../Engine/Time.hpp"
+#include "../Engine/MathFunctions.hpp"
+#include "../Engine/SIMDMathFunctions.hpp"
+#include "../Engine/NewMacroDef.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+struct BenchmarkReceiver
+{
+	UDPSocket						m_socket;
+	long long						m_numPacketsReceived;
+	std::set< unsigned short >		m_clientPorts;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+// Tank positions of one room, laid out as the kernels take them, with room for the widest batch.
+struct LaserBenchmarkRoom
+{
+	float	m_xCenters[ RAY_CIRCLE_MAX_CIRCLES ];
+	float	m_yCenters[ RAY_CIRCLE_MAX_CIRCLES ];
+};
+
+
+//-----------------------------------------------------------------------------------------------
+struct LaserBenchmarkShot
+{
+	Vector2	m_origin;
+	Vector2	m_direction;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+typedef unsigned int ( *RayCircleHitMaskFunction )( const float* xCenters, const float* yCenters, int numCircles, const Vector2& rayOrigin, const Vector2& rayDirection, float radius );
+
+
+//-----------------------------------------------------------------------------------------------
+// Decoding is part of ingest, so every datagram is unpacked; the packets themselves are dropped.
+static void DrainBenchmarkSocket( BenchmarkReceiver* receiver, const std::atomic< bool >* isReceiving )
+{
+	DatagramBuffer* receiveBuffers = new DatagramBuffer[ MAX_DATAGRAMS_PER_SYSTEM_CALL ];
+	char* bufferPointers[ MAX_DATAGRAMS_PER_SYSTEM_CALL ];
+	int numBytesReceived[ MAX_DATAGRAMS_PER_SYSTEM_CALL ];
+	struct sockaddr_in fromAddrs[ MAX_DATAGRAMS_PER_SYSTEM_CALL ];
+	FinalPacket unpackedPackets[ MAX_PACKETS_PER_DATAGRAM ];
+	for( int bufferIndex = 0; bufferIndex < MAX_DATAGRAMS_PER_SYSTEM_CALL; ++bufferIndex )
+	{
+		bufferPointers[ bufferIndex ] = receiveBuffers[ bufferIndex ].m_data;
+	}
+
+	unsigned short lastClientPort = 0;
+	while( isReceiving->load() )
+	{
+		if( !receiver->m_socket.WaitUntilReadable( 10 ) )
+			continue;
+
+		int numDatagrams = receiver->m_socket.ReceiveBatch( bufferPointers, MAX_DATAGRAM_SIZE_BYTES, numBytesReceived, fromAddrs, MAX_DATAGRAMS_PER_SYSTEM_CALL );
+		for( int datagramIndex = 0; datagramIndex < numDatagrams; ++datagramIndex )
+		{
+			receiver->m_numPacketsReceived += UnpackDatagram( (const unsigned char*) bufferPointers[ datagramIndex ], numBytesReceived[ datagramIndex ], unpackedPackets, MAX_PACKETS_PER_DATAGRAM );
+
+			// Clients send in bursts, so the set is only touched about once per burst
+			unsigned short clientPort = ntohs( fromAddrs[ datagramIndex ].sin_port );
+			if( clientPort == lastClientPort )
+				continue;
+
+			lastClientPort = clientPort;
+			receiver->m_clientPorts.insert( clientPort );
+		}
+	}
+
+	delete[] receiveBuffers;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Each synthetic client has its own socket, so its own source port and its own 4-tuple hash.
+static void FloodBenchmarkPort( UDPSocket* clientSockets, int numClientSockets, const unsigned char* datagram, int numBytes, const std::atomic< bool >* isSending, long long* out_numDatagramsSent )
+{
+	struct sockaddr_in serverAddr;
+	memset( &serverAddr, 0, sizeof( serverAddr ) );
+	serverAddr.sin_family = AF_INET;
+	serverAddr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+	serverAddr.sin_port = htons( REUSEPORT_BENCHMARK_PORT_NUMBER );
+
+	char* sendBuffers[ REUSEPORT_BENCHMARK_DATAGRAMS_PER_BATCH ];
+	int numBytesToSend[ REUSEPORT_BENCHMARK_DATAGRAMS_PER_BATCH ];
+	const struct sockaddr_in* toAddrs[ REUSEPORT_BENCHMARK_DATAGRAMS_PER_BATCH ];
+	for( int datagramIndex = 0; datagramIndex < REUSEPORT_BENCHMARK_DATAGRAMS_PER_BATCH; ++datagramIndex )
+	{
+		sendBuffers[ datagramIndex ] = (char*) datagram;
+		numBytesToSend[ datagramIndex ] = numBytes;
+		toAddrs[ datagramIndex ] = &serverAddr;
+	}
+
+	long long numDatagramsSent = 0;
+	while( isSending->load() )
+	{
+		for( int clientIndex = 0; clientIndex < numClientSockets; ++clientIndex )
+		{
+			numDatagramsSent += clientSockets[ clientIndex ].SendBatch( sendBuffers, numBytesToSend, toAddrs, REUSEPORT_BENCHMARK_DATAGRAMS_PER_BATCH );
+		}
+	}
+
+	*out_numDatagramsSent = numDatagramsSent;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static bool RunReusePortBenchmarkRound( int numSockets, const unsigned char* datagram, int numBytes, std::vector< std::string >& out_resultLines )
+{
+	char resultLine[ 256 ];
+	BenchmarkReceiver* receivers = new BenchmarkReceiver[ numSockets ];
+	bool isSupported = true;
+	for( int socketIndex = 0; socketIndex < numSockets && isSupported; ++socketIndex )
+	{
+		BenchmarkReceiver& receiver = receivers[ socketIndex ];
+		receiver.m_numPacketsReceived = 0;
+		isSupported = receiver.m_socket.Open() && receiver.m_socket.EnableReusePort() && receiver.m_socket.Bind( REUSEPORT_BENCHMARK_PORT_NUMBER );
+		receiver.m_socket.SetBufferSizes( REUSEPORT_BENCHMARK_SOCKET_BUFFER_SIZE_BYTES );
+	}
+
+	if( !isSupported )
+	{
+		snprintf( resultLine, sizeof( resultLine ), "%d sockets: could not bind with SO_REUSEPORT on port %u", numSockets, REUSEPORT_BENCHMARK_PORT_NUMBER );
+		out_resultLines.push_back( resultLine );
+		delete[] receivers;
+		return false;
+	}
+
+	UDPSocket* clientSockets = new UDPSocket[ REUSEPORT_BENCHMARK_CLIENTS ];
+	for( int clientIndex = 0; clientIndex < REUSEPORT_BENCHMARK_CLIENTS; ++clientIndex )
+	{
+		clientSockets[ clientIndex ].Open();
+	}
+
+	std::atomic< bool > isReceiving( true );
+	std::atomic< bool > isSending( true );
+	std::vector< std::thread > receiverThreads;
+	std::vector< std::thread > senderThreads;
+	long long numDatagramsSentBySender[ REUSEPORT_BENCHMARK_SENDER_THREADS ];
+
+	for( int socketIndex = 0; socketIndex < numSockets; ++socketIndex )
+	{
+		receiverThreads.push_back( std::thread( DrainBenchmarkSocket, &receivers[ socketIndex ], &isReceiving ) );
+	}
+
+	double startTime = GetCurrentTimeSeconds();
+	int numClientsPerSender = REUSEPORT_BENCHMARK_CLIENTS / REUSEPORT_BENCHMARK_SENDER_THREADS;
+	for( int senderIndex = 0; senderIndex < REUSEPORT_BENCHMARK_SENDER_THREADS; ++senderIndex )
+	{
+		senderThreads.push_back( std::thread( FloodBenchmarkPort, &clientSockets[ senderIndex * numClientsPerSender ], numClientsPerSender, datagram, numBytes, &isSending, &numDatagramsSentBySender[ senderIndex ] ) );
+	}
+
+	std::this_thread::sleep_for( std::chrono::duration< double >( REUSEPORT_BENCHMARK_SECONDS ) );
+	isSending = false;
+	for( unsigned int threadIndex = 0; threadIndex < senderThreads.size(); ++threadIndex )
+	{
+		senderThreads[ threadIndex ].join();
+	}
+
+	double elapsedSeconds = GetCurrentTimeSeconds() - startTime;
+
+	// Let the receivers drain what is already queued before stopping them
+	std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
+	isReceiving = false;
+	for( unsigned int threadIndex = 0; threadIndex < receiverThreads.size(); ++threadIndex )
+	{
+		receiverThreads[ threadIndex ].join();
+	}
+
+	long long numDatagramsSent = 0;
+	for( int senderIndex = 0; senderIndex < REUSEPORT_BENCHMARK_SENDER_THREADS; ++senderIndex )
+	{
+		numDatagramsSent += numDatagramsSentBySender[ senderIndex ];
+	}
+
+	long long numPacketsReceived = 0;
+	std::map< unsigned short, int > numSocketsByClientPort;
+	std::string perSocketCounts;
+	for( int socketIndex = 0; socketIndex < numSockets; ++socketIndex )
+	{
+		const BenchmarkReceiver& receiver = receivers[ socketIndex ];
+		numPacketsReceived += receiver.m_numPacketsReceived;
+
+		std::set< unsigned short >::const_iterator portIter;
+		for( portIter = receiver.m_clientPorts.begin(); portIter != receiver.m_clientPorts.end(); ++portIter )
+		{
+			++numSocketsByClientPort[ *portIter ];
+		}
+
+		char socketCount[ 32 ];
+		snprintf( socketCount, sizeof( socketCount ), " %d", (int) receiver.m_clientPorts.size() );
+		perSocketCounts += socketCount;
+	}
+
+	// The kernel hashes the 4-tuple, so a client seen on two sockets means affinity broke
+	int numSplitClients = 0;
+	std::map< unsigned short, int >::const_iterator clientIter;
+	for( clientIter = numSocketsByClientPort.begin(); clientIter != numSocketsByClientPort.end(); ++clientIter )
+	{
+		if( clientIter->second > 1 )
+			++numSplitClients;
+	}
+
+	snprintf( resultLine, sizeof( resultLine ), "%d sockets: %.0f packets/s received of %.0f sent; clients per socket:%s; %d clients split across sockets",
+		numSockets, numPacketsReceived / elapsedSeconds, numDatagramsSent / elapsedSeconds, perSocketCounts.c_str(), numSplitClients );
+	out_resultLines.push_back( resultLine );
+
+	for( int clientIndex = 0; clientIndex < REUSEPORT_BENCHMARK_CLIENTS; ++clientIndex )
+	{
+		clientSockets[ clientIndex ].Close();
+	}
+
+	for( int socketIndex = 0; socketIndex < numSockets; ++socketIndex )
+	{
+		receivers[ socketIndex ].m_socket.Close();
+	}
+
+	delete[] clientSockets;
+	delete[] receivers;
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// REUSEPORT_BENCHMARK_CLIENTS synthetic clients flood loopback with compact GameUpdates while 1, 2,
+// 4... SO_REUSEPORT sockets drain and decode them, one thread each. Scaling needs spare cores:
+// the senders share the machine with the receivers.
+void RunReusePortBenchmark( std::vector< std::string >& out_resultLines )
+{
+	InitializeTime();
+	UDPSocket::StartupNetworking();
+
+	FinalPacket updatePacket;
+	memset( &updatePacket, 0, sizeof( updatePacket ) );
+	updatePacket.type = TYPE_GameUpdate;
+	updatePacket.clientID = 3;
+	updatePacket.number = 1;
+	updatePacket.data.updatedGame.xPosition = 250.f;
+	updatePacket.data.updatedGame.yPosition = 125.f;
+	updatePacket.data.updatedGame.xVelocity = 70.7f;
+	updatePacket.data.updatedGame.yVelocity = -70.7f;
+	updatePacket.data.updatedGame.orientationDegrees = 315.f;
+	updatePacket.data.updatedGame.health = 1;
+
+	unsigned char datagram[ MAX_COMPACT_PACKET_SIZE_BYTES ];
+	int numBytes = SerializeFinalPacket( updatePacket, datagram, sizeof( datagram ) );
+
+	char resultLine[ 256 ];
+	snprintf( resultLine, sizeof( resultLine ), "%d clients, %d sender threads, %d-byte GameUpdates, %.1f s per round, %u cores",
+		REUSEPORT_BENCHMARK_CLIENTS, REUSEPORT_BENCHMARK_SENDER_THREADS, numBytes, REUSEPORT_BENCHMARK_SECONDS, std::thread::hardware_concurrency() );
+	out_resultLines.push_back( resultLine );
+
+	for( int numSockets = 1; numSockets <= REUSEPORT_BENCHMARK_MAX_SOCKETS; numSockets *= 2 )
+	{
+		if( !RunReusePortBenchmarkRound( numSockets, datagram, numBytes, out_resultLines ) )
+			break;
+	}
+
+	UDPSocket::ShutdownNetworking();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Every shot goes to the next room, so the rooms' positions stream through the cache the way a
+// busy server's would. Hits are counted so the compiler cannot drop the work.
+static double TimeLaserHitKernel( const char* kernelName, RayCircleHitMaskFunction kernel, int numCircles, const LaserBenchmarkRoom* rooms, const LaserBenchmarkShot* shots, double scalarNanosecondsPerShot, std::vector< std::string >& out_resultLines )
+{
+	unsigned long long numHits = 0;
+	double startTime = GetCurrentTimeSeconds();
+	for( int shotIndex = 0; shotIndex < LASER_BENCHMARK_SHOTS_PER_KERNEL; ++shotIndex )
+	{
+		const LaserBenchmarkRoom& room = rooms[ shotIndex & ( LASER_BENCHMARK_NUM_ROOMS - 1 ) ];
+		const LaserBenchmarkShot& shot = shots[ shotIndex & ( LASER_BENCHMARK_NUM_LASERS - 1 ) ];
+		unsigned int hitMask = kernel( room.m_xCenters, room.m_yCenters, numCircles, shot.m_origin, shot.m_direction, LASER_BENCHMARK_TANK_RADIUS );
+		numHits += __builtin_popcount( hitMask );
+	}
+
+	double elapsedSeconds = GetCurrentTimeSeconds() - startTime;
+	double nanosecondsPerShot = ( elapsedSeconds * 1.0e9 ) / LASER_BENCHMARK_SHOTS_PER_KERNEL;
+
+	char resultLine[ 256 ];
+	snprintf( resultLine, sizeof( resultLine ), "%2d tanks, %-6s: %6.2f ns/shot, %6.1f M shots/s, %.2fx scalar, %.3f hits/shot",
+		numCircles, kernelName, nanosecondsPerShot, 1.0e3 / nanosecondsPerShot, ( scalarNanosecondsPerShot > 0.0 ) ? scalarNanosecondsPerShot / nanosecondsPerShot : 1.0,
+		(double) numHits / LASER_BENCHMARK_SHOTS_PER_KERNEL );
+	out_resultLines.push_back( resultLine );
+	return nanosecondsPerShot;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Before timing anything, every SIMD mask is checked against the scalar one for every room and
+// laser pairing; a kernel that disagrees is reported and not timed.
+static bool DoLaserHitKernelsAgree( RayCircleHitMaskFunction kernel, int numCircles, const LaserBenchmarkRoom* rooms, const LaserBenchmarkShot* shots )
+{
+	for( int roomIndex = 0; roomIndex < LASER_BENCHMARK_NUM_ROOMS; ++roomIndex )
+	{
+		const LaserBenchmarkRoom& room = rooms[ roomIndex ];
+		for( int shotIndex = roomIndex & 7; shotIndex < LASER_BENCHMARK_NUM_LASERS; shotIndex += 8 )
+		{
+			const LaserBenchmarkShot& shot = shots[ shotIndex ];
+			unsigned int expectedMask = GetRayCircleHitMaskScalar( room.m_xCenters, room.m_yCenters, numCircles, shot.m_origin, shot.m_direction, LASER_BENCHMARK_TANK_RADIUS );
+			if( kernel( room.m_xCenters, room.m_yCenters, numCircles, shot.m_origin, shot.m_direction, LASER_BENCHMARK_TANK_RADIUS ) != expectedMask )
+				return false;
+		}
+	}
+
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static void RunLaserHitBenchmarkRound( int numCircles, const LaserBenchmarkRoom* rooms, const LaserBenchmarkShot* shots, std::vector< std::string >& out_resultLines )
+{
+	const char* kernelNames[ 3 ];
+	RayCircleHitMaskFunction kernels[ 3 ];
+	int numKernels = 0;
+	kernelNames[ numKernels ] = "scalar";
+	kernels[ numKernels++ ] = GetRayCircleHitMaskScalar;
+#ifdef SIMD_MATH_HAS_SSE
+	kernelNames[ numKernels ] = "SSE";
+	kernels[ numKernels++ ] = GetRayCircleHitMaskSSE;
+#endif
+#ifdef SIMD_MATH_HAS_AVX
+	kernelNames[ numKernels ] = "AVX";
+	kernels[ numKernels++ ] = GetRayCircleHitMaskAVX;
+#endif
+
+	double scalarNanosecondsPerShot = 0.0;
+	for( int kernelIndex = 0; kernelIndex < numKernels; ++kernelIndex )
+	{
+		if( !DoLaserHitKernelsAgree( kernels[ kernelIndex ], numCircles, rooms, shots ) )
+		{
+			char resultLine[ 256 ];
+			snprintf( resultLine, sizeof( resultLine ), "%2d tanks, %-6s: masks differ from the scalar kernel", numCircles, kernelNames[ kernelIndex ] );
+			out_resultLines.push_back( resultLine );
+			continue;
+		}
+
+		double nanosecondsPerShot = TimeLaserHitKernel( kernelNames[ kernelIndex ], kernels[ kernelIndex ], numCircles, rooms, shots, scalarNanosecondsPerShot, out_resultLines );
+		if( kernelIndex == 0 )
+			scalarNanosecondsPerShot = nanosecondsPerShot;
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// One laser against every tank of a room, for rooms of 8 and of 16 tanks scattered over the arena,
+// timed for the scalar kernel and each SIMD kernel this build has. The radius and arena are from
+// FinalPacket.hpp's game rules; hits per shot is reported to show the kernels did the same work.
+void RunLaserHitBenchmark( std::vector< std::string >& out_resultLines )
+{
+	InitializeTime();
+	srand( 1 );
+
+	LaserBenchmarkRoom* rooms = new LaserBenchmarkRoom[ LASER_BENCHMARK_NUM_ROOMS ];
+	for( int roomIndex = 0; roomIndex < LASER_BENCHMARK_NUM_ROOMS; ++roomIndex )
+	{
+		for( int circleIndex = 0; circleIndex < RAY_CIRCLE_MAX_CIRCLES; ++circleIndex )
+		{
+			rooms[ roomIndex ].m_xCenters[ circleIndex ] = GetRandomPercentage() * LASER_BENCHMARK_ARENA_SIZE;
+			rooms[ roomIndex ].m_yCenters[ circleIndex ] = GetRandomPercentage() * LASER_BENCHMARK_ARENA_SIZE;
+		}
+	}
+
+	LaserBenchmarkShot* shots = new LaserBenchmarkShot[ LASER_BENCHMARK_NUM_LASERS ];
+	for( int shotIndex = 0; shotIndex < LASER_BENCHMARK_NUM_LASERS; ++shotIndex )
+	{
+		float laserRadians = GetRandomPercentage() * TWO_PI;
+		shots[ shotIndex ].m_origin = Vector2( GetRandomPercentage() * LASER_BENCHMARK_ARENA_SIZE, GetRandomPercentage() * LASER_BENCHMARK_ARENA_SIZE );
+		shots[ shotIndex ].m_direction = Vector2( cos( laserRadians ), sin( laserRadians ) );
+	}
+
+	char resultLine[ 256 ];
+	snprintf( resultLine, sizeof( resultLine ), "%d rooms, %d lasers, %d shots per kernel, radius %.0f",
+		LASER_BENCHMARK_NUM_ROOMS, LASER_BENCHMARK_NUM_LASERS, LASER_BENCHMARK_SHOTS_PER_KERNEL, LASER_BENCHMARK_TANK_RADIUS );
+	out_resultLines.push_back( resultLine );
+
+	RunLaserHitBenchmarkRound( 8, rooms, shots, out_resultLines );
+	RunLaserHitBenchmarkRound( 16, rooms, shots, out_resultLines );
+
+	delete[] shots;
+	delete[] rooms;
+}
\ No newline at end of file
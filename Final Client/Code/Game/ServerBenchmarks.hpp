@@ -0,0 +1,32 @@
+#ifndef include_ServerBenchmarks
+#define include_ServerBenchmarks
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include <string>
+#include <vector>
+
+
+//-----------------------------------------------------------------------------------------------
+const unsigned short REUSEPORT_BENCHMARK_PORT_NUMBER = 5099;
+const int REUSEPORT_BENCHMARK_MAX_SOCKETS = 8;
+const int REUSEPORT_BENCHMARK_CLIENTS = 64;
+const int REUSEPORT_BENCHMARK_SENDER_THREADS = 2;
+const int REUSEPORT_BENCHMARK_DATAGRAMS_PER_BATCH = 16;
+const double REUSEPORT_BENCHMARK_SECONDS = 2.0;
+const int REUSEPORT_BENCHMARK_SOCKET_BUFFER_SIZE_BYTES = 4 * 1024 * 1024;
+const int LASER_BENCHMARK_NUM_ROOMS = 1024;
+const int LASER_BENCHMARK_NUM_LASERS = 4096;
+const int LASER_BENCHMARK_SHOTS_PER_KERNEL = 20000000;
+const float LASER_BENCHMARK_TANK_RADIUS = 10.f;
+const float LASER_BENCHMARK_ARENA_SIZE = 500.f;
+
+
+//-----------------------------------------------------------------------------------------------
+// Dedicated server benchmarks, run with FinalServer -benchmark <name>. Like NetworkBenchmarks, each
+// appends human-readable result lines. Rooms and lasers are powers of two.
+void RunReusePortBenchmark( std::vector< std::string >& out_resultLines );
+void RunLaserHitBenchmark( std::vector< std::string >& out_resultLines );
+
+
+#endif // include_ServerBenchmarks
\ No newline at end of file
@@ -0,0 +1,314 @@
+#include "SnapshotDelta.hpp"
+#include "FinalPacketSerializer.hpp"
+#include "../Engine/NewMacroDef.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+// A velocity step is WIRE_VECTOR_UNITS_PER_STEP ( 1/64 ) units per second and a position step is
+// WIRE_ARENA_SIZE / 65535 units, so one velocity step covers 65535 / ( 64 * 500 * 1000 ) position
+// steps per millisecond. Kept as an integer ratio so the prediction never touches floating point.
+static const long long MAX_QUANTIZED_POSITION_VALUE = ( 1 << QUANTIZED_POSITION_NUM_BITS ) - 1;
+static const long long POSITION_STEPS_PER_VELOCITY_STEP_MS_NUMERATOR = MAX_QUANTIZED_POSITION_VALUE;
+static const long long POSITION_STEPS_PER_VELOCITY_STEP_MS_DENOMINATOR = 64 * 500 * 1000;
+static const int MAX_QUANTIZED_VECTOR_OFFSET = ( 1 << ( QUANTIZED_VECTOR_NUM_BITS - 1 ) ) - 1;
+
+static const unsigned int DELTA_FIELD_XPosition = 1 << 0;
+static const unsigned int DELTA_FIELD_YPosition = 1 << 1;
+static const unsigned int DELTA_FIELD_XVelocity = 1 << 2;
+static const unsigned int DELTA_FIELD_YVelocity = 1 << 3;
+static const unsigned int DELTA_FIELD_XAcceleration = 1 << 4;
+static const unsigned int DELTA_FIELD_YAcceleration = 1 << 5;
+static const unsigned int DELTA_FIELD_Orientation = 1 << 6;
+static const unsigned int DELTA_FIELD_Health = 1 << 7;
+static const unsigned int DELTA_FIELD_Score = 1 << 8;
+
+
+//-----------------------------------------------------------------------------------------------
+SnapshotHistory::SnapshotHistory( int numSenders )
+	: m_entries( numSenders * SNAPSHOT_HISTORY_SIZE )
+	, m_numSenders( numSenders )
+{
+	Reset();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void SnapshotHistory::Reset()
+{
+	for( unsigned int entryIndex = 0; entryIndex < m_entries.size(); ++entryIndex )
+	{
+		m_entries[ entryIndex ].m_isValid = false;
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void SnapshotHistory::StoreSnapshot( PacketNumber number, ClientID clientID, const QuantizedTankState& state )
+{
+	SnapshotEntry& entry = m_entries[ GetEntryIndex( number, clientID ) ];
+	entry.m_state = state;
+	entry.m_number = number;
+	entry.m_clientID = clientID;
+	entry.m_isValid = true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool SnapshotHistory::FindSnapshot( PacketNumber number, ClientID clientID, QuantizedTankState& out_state ) const
+{
+	const SnapshotEntry& entry = m_entries[ GetEntryIndex( number, clientID ) ];
+	if( !entry.m_isValid || entry.m_number != number || entry.m_clientID != clientID )
+		return false;
+
+	out_state = entry.m_state;
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Walks the block from its newest number down, so the first stored snapshot found is the newest.
+bool SnapshotHistory::FindNewestAckedSnapshot( const AckBlock& ackBlock, ClientID clientID, PacketNumber& out_number, QuantizedTankState& out_state ) const
+{
+	if( FindSnapshot( ackBlock.latestNumber, clientID, out_state ) )
+	{
+		out_number = ackBlock.latestNumber;
+		return true;
+	}
+
+	for( int bitIndex = 0; bitIndex < ACK_BITFIELD_NUM_BITS; ++bitIndex )
+	{
+		PacketNumber number = ackBlock.latestNumber - 1 - bitIndex;
+		if( ( ackBlock.receivedBits & ( 1u << bitIndex ) ) != 0 && FindSnapshot( number, clientID, out_state ) )
+		{
+			out_number = number;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Room player IDs run 1 to SNAPSHOT_HISTORY_MAX_SENDERS, so each lands in its own ring.
+int SnapshotHistory::GetEntryIndex( PacketNumber number, ClientID clientID ) const
+{
+	int senderIndex = clientID % m_numSenders;
+	return ( senderIndex * SNAPSHOT_HISTORY_SIZE ) + (int) ( number & ( SNAPSHOT_HISTORY_SIZE - 1 ) );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void QuantizeGameUpdate( const FinalPacket& packet, QuantizedTankState& out_state )
+{
+	const GameUpdatePacket& update = packet.data.updatedGame;
+	out_state.timestampMilliseconds = (unsigned long long) ( packet.timestamp * 1000.0 + 0.5 );
+	out_state.xPosition = QuantizePosition( update.xPosition );
+	out_state.yPosition = QuantizePosition( update.yPosition );
+	out_state.xVelocity = QuantizeVectorComponent( update.xVelocity );
+	out_state.yVelocity = QuantizeVectorComponent( update.yVelocity );
+	out_state.xAcceleration = QuantizeVectorComponent( update.xAcceleration );
+	out_state.yAcceleration = QuantizeVectorComponent( update.yAcceleration );
+	out_state.orientation = QuantizeAngleDegrees( update.orientationDegrees );
+	out_state.health = update.health;
+	out_state.score = update.score;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Fills the timestamp and GameUpdate body; the caller owns the rest of the header.
+void DequantizeGameUpdate( const QuantizedTankState& state, FinalPacket& out_packet )
+{
+	GameUpdatePacket& update = out_packet.data.updatedGame;
+	out_packet.timestamp = (double) state.timestampMilliseconds * 0.001;
+	update.xPosition = DequantizePosition( state.xPosition );
+	update.yPosition = DequantizePosition( state.yPosition );
+	update.xVelocity = DequantizeVectorComponent( state.xVelocity );
+	update.yVelocity = DequantizeVectorComponent( state.yVelocity );
+	update.xAcceleration = DequantizeVectorComponent( state.xAcceleration );
+	update.yAcceleration = DequantizeVectorComponent( state.yAcceleration );
+	update.orientationDegrees = DequantizeAngleDegrees( state.orientation );
+	update.health = (unsigned char) state.health;
+	update.score = (unsigned char) state.score;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void WriteQuantizedGameUpdate( BitWriter& writer, const QuantizedTankState& state )
+{
+	writer.WriteBits( state.xPosition, QUANTIZED_POSITION_NUM_BITS );
+	writer.WriteBits( state.yPosition, QUANTIZED_POSITION_NUM_BITS );
+	writer.WriteBits( state.xVelocity, QUANTIZED_VECTOR_NUM_BITS );
+	writer.WriteBits( state.yVelocity, QUANTIZED_VECTOR_NUM_BITS );
+	writer.WriteBits( state.xAcceleration, QUANTIZED_VECTOR_NUM_BITS );
+	writer.WriteBits( state.yAcceleration, QUANTIZED_VECTOR_NUM_BITS );
+	writer.WriteBits( state.orientation, QUANTIZED_ANGLE_NUM_BITS );
+	writer.WriteBits( state.health, 8 );
+	writer.WriteBits( state.score, 8 );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Leaves timestampMilliseconds untouched; it travels in the packet header.
+void ReadQuantizedGameUpdate( BitReader& reader, QuantizedTankState& out_state )
+{
+	out_state.xPosition = reader.ReadBits( QUANTIZED_POSITION_NUM_BITS );
+	out_state.yPosition = reader.ReadBits( QUANTIZED_POSITION_NUM_BITS );
+	out_state.xVelocity = reader.ReadBits( QUANTIZED_VECTOR_NUM_BITS );
+	out_state.yVelocity = reader.ReadBits( QUANTIZED_VECTOR_NUM_BITS );
+	out_state.xAcceleration = reader.ReadBits( QUANTIZED_VECTOR_NUM_BITS );
+	out_state.yAcceleration = reader.ReadBits( QUANTIZED_VECTOR_NUM_BITS );
+	out_state.orientation = reader.ReadBits( QUANTIZED_ANGLE_NUM_BITS );
+	out_state.health = reader.ReadBits( 8 );
+	out_state.score = reader.ReadBits( 8 );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Integer-only so sender and receiver always agree on the prediction.
+static unsigned int PredictQuantizedPosition( unsigned int basePosition, unsigned int quantizedVelocity, long long elapsedMilliseconds )
+{
+	long long velocitySteps = (long long) quantizedVelocity - MAX_QUANTIZED_VECTOR_OFFSET;
+	long long numerator = velocitySteps * elapsedMilliseconds * POSITION_STEPS_PER_VELOCITY_STEP_MS_NUMERATOR;
+	long long halfDenominator = POSITION_STEPS_PER_VELOCITY_STEP_MS_DENOMINATOR / 2;
+	long long positionSteps = ( numerator >= 0 ) ? ( numerator + halfDenominator ) / POSITION_STEPS_PER_VELOCITY_STEP_MS_DENOMINATOR : ( numerator - halfDenominator ) / POSITION_STEPS_PER_VELOCITY_STEP_MS_DENOMINATOR;
+
+	long long predictedPosition = (long long) basePosition + positionSteps;
+	if( predictedPosition < 0 )
+		return 0;
+	if( predictedPosition > MAX_QUANTIZED_POSITION_VALUE )
+		return (unsigned int) MAX_QUANTIZED_POSITION_VALUE;
+
+	return (unsigned int) predictedPosition;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static unsigned int ZigZagEncode( int value )
+{
+	return ( (unsigned int) value << 1 ) ^ (unsigned int) ( value >> 31 );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static int ZigZagDecode( unsigned int value )
+{
+	return (int) ( value >> 1 ) ^ -(int) ( value & 1 );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static void WriteChangedField( BitWriter& writer, unsigned int changedFields, unsigned int field, unsigned int value, int numBits )
+{
+	if( ( changedFields & field ) != 0 )
+		writer.WriteBits( value, numBits );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static void ReadChangedField( BitReader& reader, unsigned int changedFields, unsigned int field, unsigned int& inout_value, int numBits )
+{
+	if( ( changedFields & field ) != 0 )
+		inout_value = reader.ReadBits( numBits );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// A whole compact packet. After the usual header: varint distance back to the baseline number, a changed-
+// fields mask, then only the changed fields. Positions are sent as a zig-zag varint residual
+// against the baseline extrapolated at its own velocity, so a tank coasting in a straight line
+// costs the same few bytes as one sitting still.
+void WriteDeltaGameUpdate( BitWriter& writer, const FinalPacket& packet, PacketNumber baselineNumber, const QuantizedTankState& baseline )
+{
+	QuantizedTankState state;
+	QuantizeGameUpdate( packet, state );
+	WriteCompactPacketHeader( writer, packet, WIRE_TYPE_GameUpdateDelta );
+
+	long long elapsedMilliseconds = (long long) ( state.timestampMilliseconds - baseline.timestampMilliseconds );
+	unsigned int predictedX = PredictQuantizedPosition( baseline.xPosition, baseline.xVelocity, elapsedMilliseconds );
+	unsigned int predictedY = PredictQuantizedPosition( baseline.yPosition, baseline.yVelocity, elapsedMilliseconds );
+
+	unsigned int changedFields = 0;
+	if( state.xPosition != predictedX )
+		changedFields |= DELTA_FIELD_XPosition;
+	if( state.yPosition != predictedY )
+		changedFields |= DELTA_FIELD_YPosition;
+	if( state.xVelocity != baseline.xVelocity )
+		changedFields |= DELTA_FIELD_XVelocity;
+	if( state.yVelocity != baseline.yVelocity )
+		changedFields |= DELTA_FIELD_YVelocity;
+	if( state.xAcceleration != baseline.xAcceleration )
+		changedFields |= DELTA_FIELD_XAcceleration;
+	if( state.yAcceleration != baseline.yAcceleration )
+		changedFields |= DELTA_FIELD_YAcceleration;
+	if( state.orientation != baseline.orientation )
+		changedFields |= DELTA_FIELD_Orientation;
+	if( state.health != baseline.health )
+		changedFields |= DELTA_FIELD_Health;
+	if( state.score != baseline.score )
+		changedFields |= DELTA_FIELD_Score;
+
+	writer.WriteVarUInt( packet.number - baselineNumber );
+	writer.WriteBits( changedFields, NUM_DELTA_FIELDS );
+
+	if( ( changedFields & DELTA_FIELD_XPosition ) != 0 )
+		writer.WriteVarUInt( ZigZagEncode( (int) state.xPosition - (int) predictedX ) );
+	if( ( changedFields & DELTA_FIELD_YPosition ) != 0 )
+		writer.WriteVarUInt( ZigZagEncode( (int) state.yPosition - (int) predictedY ) );
+
+	WriteChangedField( writer, changedFields, DELTA_FIELD_XVelocity, state.xVelocity, QUANTIZED_VECTOR_NUM_BITS );
+	WriteChangedField( writer, changedFields, DELTA_FIELD_YVelocity, state.yVelocity, QUANTIZED_VECTOR_NUM_BITS );
+	WriteChangedField( writer, changedFields, DELTA_FIELD_XAcceleration, state.xAcceleration, QUANTIZED_VECTOR_NUM_BITS );
+	WriteChangedField( writer, changedFields, DELTA_FIELD_YAcceleration, state.yAcceleration, QUANTIZED_VECTOR_NUM_BITS );
+	WriteChangedField( writer, changedFields, DELTA_FIELD_Orientation, state.orientation, QUANTIZED_ANGLE_NUM_BITS );
+	WriteChangedField( writer, changedFields, DELTA_FIELD_Health, state.health, 8 );
+	WriteChangedField( writer, changedFields, DELTA_FIELD_Score, state.score, 8 );
+	writer.AlignToByte();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// inout_state arrives holding the header timestamp. The body is always consumed so the packets
+// after it stay readable; returns false if the baseline is no longer in history, in which case the
+// packet goes unacked and the sender falls back to full state once its baseline ages out.
+bool ReadDeltaGameUpdate( BitReader& reader, PacketNumber number, ClientID clientID, const SnapshotHistory* history, QuantizedTankState& inout_state )
+{
+	PacketNumber baselineNumber = number - reader.ReadVarUInt();
+	unsigned int changedFields = reader.ReadBits( NUM_DELTA_FIELDS );
+
+	int xResidual = 0;
+	int yResidual = 0;
+	if( ( changedFields & DELTA_FIELD_XPosition ) != 0 )
+		xResidual = ZigZagDecode( reader.ReadVarUInt() );
+	if( ( changedFields & DELTA_FIELD_YPosition ) != 0 )
+		yResidual = ZigZagDecode( reader.ReadVarUInt() );
+
+	QuantizedTankState baseline;
+	bool hasBaseline = ( history != nullptr ) && history->FindSnapshot( baselineNumber, clientID, baseline );
+
+	unsigned long long timestampMilliseconds = inout_state.timestampMilliseconds;
+	if( hasBaseline )
+		inout_state = baseline;
+
+	ReadChangedField( reader, changedFields, DELTA_FIELD_XVelocity, inout_state.xVelocity, QUANTIZED_VECTOR_NUM_BITS );
+	ReadChangedField( reader, changedFields, DELTA_FIELD_YVelocity, inout_state.yVelocity, QUANTIZED_VECTOR_NUM_BITS );
+	ReadChangedField( reader, changedFields, DELTA_FIELD_XAcceleration, inout_state.xAcceleration, QUANTIZED_VECTOR_NUM_BITS );
+	ReadChangedField( reader, changedFields, DELTA_FIELD_YAcceleration, inout_state.yAcceleration, QUANTIZED_VECTOR_NUM_BITS );
+	ReadChangedField( reader, changedFields, DELTA_FIELD_Orientation, inout_state.orientation, QUANTIZED_ANGLE_NUM_BITS );
+	ReadChangedField( reader, changedFields, DELTA_FIELD_Health, inout_state.health, 8 );
+	ReadChangedField( reader, changedFields, DELTA_FIELD_Score, inout_state.score, 8 );
+
+	if( !hasBaseline || reader.HasOverflowed() )
+		return false;
+
+	long long elapsedMilliseconds = (long long) ( timestampMilliseconds - baseline.timestampMilliseconds );
+	long long xPosition = (long long) PredictQuantizedPosition( baseline.xPosition, baseline.xVelocity, elapsedMilliseconds ) + xResidual;
+	long long yPosition = (long long) PredictQuantizedPosition( baseline.yPosition, baseline.yVelocity, elapsedMilliseconds ) + yResidual;
+	if( xPosition < 0 || xPosition > MAX_QUANTIZED_POSITION_VALUE || yPosition < 0 || yPosition > MAX_QUANTIZED_POSITION_VALUE )
+		return false;
+
+	inout_state.timestampMilliseconds = timestampMilliseconds;
+	inout_state.xPosition = (unsigned int) xPosition;
+	inout_state.yPosition = (unsigned int) yPosition;
+	return true;
+}
\ No newline at end of file
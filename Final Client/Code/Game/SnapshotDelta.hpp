@@ -0,0 +1,78 @@
+#ifndef include_SnapshotDelta
+#define include_SnapshotDelta
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include <vector>
+#include "FinalPacket.hpp"
+#include "SelectiveAck.hpp"
+#include "../Engine/BitStream.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+// A delta GameUpdate goes out under a wire-only type and decodes back into TYPE_GameUpdate.
+// Fields are compared in quantized form so both ends reconstruct bit-identical states.
+const PacketType WIRE_TYPE_GameUpdateDelta = 13;
+const int SNAPSHOT_HISTORY_SIZE = 256; // per sender; must be a power of two
+const int SNAPSHOT_HISTORY_MAX_SENDERS = 8; // one per tank slot in a room
+const int MAX_DELTA_BASELINE_AGE = SNAPSHOT_HISTORY_SIZE / 2;
+const int MAX_UPDATES_WITHOUT_BASELINE_ACK = 16;
+const int NUM_DELTA_FIELDS = 9;
+
+
+//-----------------------------------------------------------------------------------------------
+struct QuantizedTankState
+{
+	unsigned long long	timestampMilliseconds;
+	unsigned int		xPosition;
+	unsigned int		yPosition;
+	unsigned int		xVelocity;
+	unsigned int		yVelocity;
+	unsigned int		xAcceleration;
+	unsigned int		yAcceleration;
+	unsigned int		orientation;
+	unsigned int		health;
+	unsigned int		score;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+// Recent GameUpdate states keyed by sender and PacketNumber. The sender keeps what it sent so an
+// acked number becomes the next baseline; the receiver keeps what it decoded so it can apply deltas.
+// Each sender gets its own ring, so one tank's updates never evict another's baselines; a history
+// that hears from a single sender needs only one.
+class SnapshotHistory
+{
+public:
+	explicit SnapshotHistory( int numSenders = 1 );
+	void Reset();
+	void StoreSnapshot( PacketNumber number, ClientID clientID, const QuantizedTankState& state );
+	bool FindSnapshot( PacketNumber number, ClientID clientID, QuantizedTankState& out_state ) const;
+	bool FindNewestAckedSnapshot( const AckBlock& ackBlock, ClientID clientID, PacketNumber& out_number, QuantizedTankState& out_state ) const;
+
+private:
+	struct SnapshotEntry
+	{
+		QuantizedTankState	m_state;
+		PacketNumber		m_number;
+		ClientID			m_clientID;
+		bool				m_isValid;
+	};
+
+	int GetEntryIndex( PacketNumber number, ClientID clientID ) const;
+
+	std::vector< SnapshotEntry >	m_entries;
+	int								m_numSenders;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+void QuantizeGameUpdate( const FinalPacket& packet, QuantizedTankState& out_state );
+void DequantizeGameUpdate( const QuantizedTankState& state, FinalPacket& out_packet );
+void WriteQuantizedGameUpdate( BitWriter& writer, const QuantizedTankState& state );
+void ReadQuantizedGameUpdate( BitReader& reader, QuantizedTankState& out_state );
+void WriteDeltaGameUpdate( BitWriter& writer, const FinalPacket& packet, PacketNumber baselineNumber, const QuantizedTankState& baseline );
+bool ReadDeltaGameUpdate( BitReader& reader, PacketNumber number, ClientID clientID, const SnapshotHistory* history, QuantizedTankState& inout_state );
+
+
+#endif // include_SnapshotDelta
\ No newline at end of file
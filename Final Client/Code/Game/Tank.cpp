@@ -1,31 +1,107 @@
 #include "Tank.hpp"
 
 
+//-----------------------------------------------------------------------------------------------
+TankPositionError::TankPositionError()
+	: m_playerID( 0 )
+	, m_numCorrections( 0 )
+	, m_totalCorrectionDistance( 0.f )
+	, m_accumulatedErrorUnitSeconds( 0.f )
+	, m_trackedSeconds( 0.f )
+{
+
+}
+
+
+//-----------------------------------------------------------------------------------------------
+TankDrawnHistory::TankDrawnHistory()
+	: m_newestIndex( TANK_DRAWN_HISTORY_SIZE - 1 )
+	, m_numPositions( 0 )
+{
+
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void TankDrawnHistory::AddPosition( double timeSeconds, const Vector2& position )
+{
+	m_newestIndex = ( m_newestIndex + 1 ) & ( TANK_DRAWN_HISTORY_SIZE - 1 );
+	m_timesSeconds[ m_newestIndex ] = timeSeconds;
+	m_positions[ m_newestIndex ] = position;
+	if( m_numPositions < TANK_DRAWN_HISTORY_SIZE )
+		++m_numPositions;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Blends the two frames either side of the time; times after the newest frame get the newest.
+// Returns false for times before the oldest.
+bool TankDrawnHistory::GetPositionAt( double timeSeconds, Vector2& out_position ) const
+{
+	if( m_numPositions == 0 )
+		return false;
+
+	int newerIndex = m_newestIndex;
+	if( timeSeconds >= m_timesSeconds[ newerIndex ] )
+	{
+		out_position = m_positions[ newerIndex ];
+		return true;
+	}
+
+	for( int framesBack = 1; framesBack < m_numPositions; ++framesBack )
+	{
+		int olderIndex = ( m_newestIndex - framesBack ) & ( TANK_DRAWN_HISTORY_SIZE - 1 );
+		if( m_timesSeconds[ olderIndex ] > timeSeconds )
+		{
+			newerIndex = olderIndex;
+			continue;
+		}
+
+		double frameSeconds = m_timesSeconds[ newerIndex ] - m_timesSeconds[ olderIndex ];
+		float blendFraction = ( frameSeconds > 0.0 ) ? (float) ( ( timeSeconds - m_timesSeconds[ olderIndex ] ) / frameSeconds ) : 1.f;
+		out_position = m_positions[ olderIndex ] + ( m_positions[ newerIndex ] - m_positions[ olderIndex ] ) * blendFraction;
+		return true;
+	}
+
+	return false;
+}
+
+
 //-----------------------------------------------------------------------------------------------
 Tank::Tank()
 	: m_health( 1 )
 	, m_score( 0 )
 	, m_yawOrientationDeg( 0.f )
+	, m_timeOfLastUpdate( 0.0 )
+	, m_isConverging( false )
+	, m_convergenceStartTime( 0.0 )
+	, m_timeOfLastErrorSample( 0.0 )
 {
+#if defined( _WIN32 )
 	m_tankBase = DebugGraphicsAABB3( Vector3( 0.f, 0.f, 5.f ), 10.f, 10.f, 10.f, m_color, m_color );
 	m_tankBarrel = DebugGraphicsAABB3( Vector3( 4.f, 0.f, 5.f ), 10.f, 2.5f, 1.75f, m_color, m_color );
 	m_laser = DebugGraphicsLine( Vector3( 4.f, 0.f, 5.f ), Vector3( 504.f, 0.f, 5.f ), m_color, m_color, 0.25f );
+#endif
 }
 
 
 //-----------------------------------------------------------------------------------------------
 void Tank::FireLaser()
 {
+#if defined( _WIN32 )
 	m_laser = DebugGraphicsLine( Vector3( 4.f, 0.f, 5.f ), Vector3( 504.f, 0.f, 5.f ), m_color, m_color, 0.25f );
+#endif
 }
 
 
 //-----------------------------------------------------------------------------------------------
 void Tank::SetColor()
 {
+#if defined( _WIN32 )
 	m_tankBase = DebugGraphicsAABB3( Vector3( 0.f, 0.f, 5.f ), 10.f, 10.f, 10.f, m_color, m_color );
 	m_tankBarrel = DebugGraphicsAABB3( Vector3( 4.f, 0.f, 5.f ), 10.f, 2.5f, 1.75f, m_color, m_color );
 	m_laser = DebugGraphicsLine( Vector3( 4.f, 0.f, 5.f ), Vector3( 504.f, 0.f, 5.f ), m_color, m_color, 0.25f );
+#endif
 }
 
 
@@ -35,10 +111,23 @@ void Tank::Update( float deltaSeconds )
 	m_firstPersonCamera.m_position = m_currentPosition;
 	m_firstPersonCamera.m_position.z += 5.f;
 	m_firstPersonCamera.m_orientation.yaw = m_yawOrientationDeg;
+#if defined( _WIN32 )
 	m_laser.Update( deltaSeconds );
+#endif
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Where the last reported state puts the tank at timeSeconds, on the local clock like
+// m_timeOfLastUpdate, which is when that state was sampled rather than when it arrived.
+Vector2 Tank::GetExtrapolatedPosition( double timeSeconds ) const
+{
+	float elapsedSeconds = (float) ( timeSeconds - m_timeOfLastUpdate );
+	return m_lastUpdatePosition + ( m_velocity * elapsedSeconds ) + ( m_acceleration * ( 0.5f * elapsedSeconds * elapsedSeconds ) );
 }
 
 
+#if defined( _WIN32 )
 //-----------------------------------------------------------------------------------------------
 void Tank::Render()
 {
@@ -53,4 +142,5 @@ void Tank::Render()
 	m_laser.Render();
 
 	OpenGLRenderer::PopMatrix();
-}
\ No newline at end of file
+}
+#endif
\ No newline at end of file
@@ -4,10 +4,52 @@
 
 //-----------------------------------------------------------------------------------------------
 #include <string>
+#include "TankStateBuffer.hpp"
 #include "../Engine/Color.hpp"
 #include "../Engine/Camera.hpp"
 #include "../Engine/Vector2.hpp"
+#if defined( _WIN32 )
 #include "../Engine/DebugGraphics.hpp"
+#endif
+
+
+//-----------------------------------------------------------------------------------------------
+const int TANK_DRAWN_HISTORY_SIZE = 64; // must be a power of two; a second of frames at 60 Hz
+
+
+//-----------------------------------------------------------------------------------------------
+// How far a remote tank has been drawn from where it really was, for tuning update rates.
+// Corrections are the distance a dead-reckoned tank's drawn position jumped to each newly reported
+// path. The accumulated error is measured against the server: each reported state is compared with
+// where the tank was drawn at its sample time, weighted by the seconds since the previous one. It
+// counts in every smoothing mode, snapping included, and interpolation's delay shows up in it.
+struct TankPositionError
+{
+	TankPositionError();
+
+	unsigned char	m_playerID;
+	int				m_numCorrections;
+	float			m_totalCorrectionDistance;
+	float			m_accumulatedErrorUnitSeconds;
+	float			m_trackedSeconds;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+// Where a tank was drawn over the last TANK_DRAWN_HISTORY_SIZE frames.
+class TankDrawnHistory
+{
+public:
+	TankDrawnHistory();
+	void AddPosition( double timeSeconds, const Vector2& position );
+	bool GetPositionAt( double timeSeconds, Vector2& out_position ) const;
+
+private:
+	double	m_timesSeconds[ TANK_DRAWN_HISTORY_SIZE ];
+	Vector2	m_positions[ TANK_DRAWN_HISTORY_SIZE ];
+	int		m_newestIndex;
+	int		m_numPositions;
+};
 
 
 //-----------------------------------------------------------------------------------------------
@@ -18,7 +60,10 @@ public:
 	void FireLaser();
 	void SetColor();
 	void Update( float deltaSeconds );
+#if defined( _WIN32 )
 	void Render();
+#endif
+	Vector2 GetExtrapolatedPosition( double timeSeconds ) const;
 
 	unsigned char		m_playerID;
 	unsigned char		m_health;
@@ -31,9 +76,20 @@ public:
 	Vector2				m_acceleration;
 	Camera				m_firstPersonCamera;
 	double				m_timeOfLastUpdate;
+	TankStateBuffer		m_stateBuffer;
+	bool				m_isConverging;
+	double				m_convergenceStartTime;
+	Vector2				m_convergenceStartPosition;
+	Vector2				m_convergenceStartVelocity;
+	Vector2				m_drawnVelocity;
+	TankPositionError	m_positionError;
+	TankDrawnHistory	m_drawnPositions;
+	double				m_timeOfLastErrorSample;
+#if defined( _WIN32 )
 	DebugGraphicsAABB3	m_tankBase;
 	DebugGraphicsAABB3	m_tankBarrel;
 	DebugGraphicsLine	m_laser;
+#endif
 };
 
 
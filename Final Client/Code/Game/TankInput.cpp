@@ -0,0 +1,133 @@
+#include "TankInput.hpp"
+#include "World.hpp"
+#include "../Engine/NewMacroDef.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+TankInput::TankInput()
+	: m_turnDirection( 0 )
+	, m_throttle( 0.f )
+	, m_isFiring( false )
+	, m_requestedRoom( ROOM_None )
+{
+
+}
+
+
+#if defined( _WIN32 )
+//-----------------------------------------------------------------------------------------------
+KeyboardTankInput::KeyboardTankInput( const Keyboard& keyboard )
+	: m_keyboard( keyboard )
+{
+
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void KeyboardTankInput::GetTankInput( bool isInGame, const char*, float, TankInput& out_input )
+{
+	out_input = TankInput();
+	if( !isInGame )
+		return;
+
+	out_input.m_isFiring = m_keyboard.IsKeyPressedDownAndWasNotBefore( KEY_SPACE );
+
+	if( m_keyboard.IsKeyPressedDown( KEY_A ) )
+		out_input.m_turnDirection = 1;
+	else if( m_keyboard.IsKeyPressedDown( KEY_D ) )
+		out_input.m_turnDirection = -1;
+
+	if( m_keyboard.IsKeyPressedDown( KEY_W ) )
+		out_input.m_throttle = 1.f;
+	else if( m_keyboard.IsKeyPressedDown( KEY_S ) )
+		out_input.m_throttle = -1.f;
+}
+#endif
+
+
+//-----------------------------------------------------------------------------------------------
+BotTankInput::BotTankInput( unsigned int seed )
+	: m_randomState( seed != 0 ? seed : 1 )
+	, m_secondsUntilNextManeuver( 0.f )
+	, m_secondsUntilNextRoomRequest( BOT_SECONDS_BEFORE_FIRST_ROOM_REQUEST )
+	, m_turnDirection( 0 )
+	, m_throttle( 0.f )
+{
+
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void BotTankInput::GetTankInput( bool isInGame, const char* playersPerRoom, float deltaSeconds, TankInput& out_input )
+{
+	out_input = TankInput();
+	if( !isInGame )
+	{
+		m_secondsUntilNextRoomRequest -= deltaSeconds;
+		if( m_secondsUntilNextRoomRequest > 0.f )
+			return;
+
+		m_secondsUntilNextRoomRequest = BOT_SECONDS_BETWEEN_ROOM_REQUESTS;
+		out_input.m_requestedRoom = ChooseRoom( playersPerRoom );
+		return;
+	}
+
+	m_secondsUntilNextRoomRequest = BOT_SECONDS_BEFORE_FIRST_ROOM_REQUEST;
+
+	m_secondsUntilNextManeuver -= deltaSeconds;
+	if( m_secondsUntilNextManeuver <= 0.f )
+		StartNextManeuver();
+
+	out_input.m_turnDirection = m_turnDirection;
+	out_input.m_throttle = m_throttle;
+	out_input.m_isFiring = GetRandomZeroToOne() < BOT_SHOTS_PER_SECOND * deltaSeconds;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Filling rooms before opening new ones keeps as many bots as possible playing against each other.
+RoomID BotTankInput::ChooseRoom( const char* playersPerRoom ) const
+{
+	RoomID chosenRoom = ROOM_None;
+	int mostPlayers = -1;
+	for( int roomIndex = 0; roomIndex < MAX_NUMBER_OF_ROOMS; ++roomIndex )
+	{
+		int numPlayers = playersPerRoom[ roomIndex ];
+		if( numPlayers < MAX_NUMBER_OF_PLAYERS_PER_ROOM && numPlayers > mostPlayers )
+		{
+			chosenRoom = (RoomID) ( roomIndex + 1 );
+			mostPlayers = numPlayers;
+		}
+	}
+
+	return chosenRoom;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void BotTankInput::StartNextManeuver()
+{
+	m_turnDirection = GetRandomIntInRange( -1, 1 );
+	m_throttle = (float) GetRandomIntInRange( -1, 1 );
+	m_secondsUntilNextManeuver = BOT_MIN_SECONDS_PER_MANEUVER + ( BOT_MAX_SECONDS_PER_MANEUVER - BOT_MIN_SECONDS_PER_MANEUVER ) * GetRandomZeroToOne();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// xorshift32: rand() shares one state across threads, and bots only need cheap, repeatable noise.
+float BotTankInput::GetRandomZeroToOne()
+{
+	m_randomState ^= m_randomState << 13;
+	m_randomState ^= m_randomState >> 17;
+	m_randomState ^= m_randomState << 5;
+	return (float) ( m_randomState >> 8 ) / (float) ( 1 << 24 );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+int BotTankInput::GetRandomIntInRange( int minValue, int maxValue )
+{
+	int numValues = maxValue - minValue + 1;
+	int value = minValue + (int) ( GetRandomZeroToOne() * numValues );
+	return value > maxValue ? maxValue : value;
+}
\ No newline at end of file
@@ -0,0 +1,87 @@
+#ifndef include_TankInput
+#define include_TankInput
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include "FinalPacket.hpp"
+#if defined( _WIN32 )
+#include "../Engine/Keyboard.hpp"
+#endif
+
+
+//-----------------------------------------------------------------------------------------------
+const float BOT_MIN_SECONDS_PER_MANEUVER = 0.5f;
+const float BOT_MAX_SECONDS_PER_MANEUVER = 2.f;
+const float BOT_SHOTS_PER_SECOND = 1.f;
+const float BOT_SECONDS_BEFORE_FIRST_ROOM_REQUEST = 0.5f;
+const float BOT_SECONDS_BETWEEN_ROOM_REQUESTS = 3.f;
+
+
+//-----------------------------------------------------------------------------------------------
+// What the main player wants this frame. Throttle is -1 (reverse) to 1 (forward); turn direction
+// is 1 for left, -1 for right. A requested room other than ROOM_None is joined, or created when empty.
+struct TankInput
+{
+	TankInput();
+
+	int		m_turnDirection;
+	float	m_throttle;
+	bool	m_isFiring;
+	RoomID	m_requestedRoom;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+// Drives World's main player in place of reading the keyboard directly.
+class TankInputSource
+{
+public:
+	virtual ~TankInputSource() {}
+	virtual void GetTankInput( bool isInGame, const char* playersPerRoom, float deltaSeconds, TankInput& out_input ) = 0;
+};
+
+
+#if defined( _WIN32 )
+//-----------------------------------------------------------------------------------------------
+// WASD to drive, space to fire. Rooms are picked with the lobby buttons, so none is requested here.
+class KeyboardTankInput : public TankInputSource
+{
+public:
+	explicit KeyboardTankInput( const Keyboard& keyboard );
+	void GetTankInput( bool isInGame, const char* playersPerRoom, float deltaSeconds, TankInput& out_input );
+
+private:
+	KeyboardTankInput& operator=( const KeyboardTankInput& );
+
+	const Keyboard&	m_keyboard;
+};
+#endif
+
+
+//-----------------------------------------------------------------------------------------------
+// Random input for headless load-generation bots. In the lobby it joins the fullest room that still
+// has space, or creates one, and asks again if the server has not moved it into a game after a while.
+// In game it holds each random turn/throttle for a random time and fires at BOT_SHOTS_PER_SECOND.
+// Each bot has its own generator so bots stepped on different threads share no state, and a bot
+// with a given seed always makes the same choices.
+class BotTankInput : public TankInputSource
+{
+public:
+	explicit BotTankInput( unsigned int seed );
+	void GetTankInput( bool isInGame, const char* playersPerRoom, float deltaSeconds, TankInput& out_input );
+
+private:
+	RoomID ChooseRoom( const char* playersPerRoom ) const;
+	void StartNextManeuver();
+	float GetRandomZeroToOne();
+	int GetRandomIntInRange( int minValue, int maxValue );
+
+	unsigned int	m_randomState;
+	float			m_secondsUntilNextManeuver;
+	float			m_secondsUntilNextRoomRequest;
+	int				m_turnDirection;
+	float			m_throttle;
+};
+
+
+#endif // include_TankInput
\ No newline at end of file
@@ -0,0 +1,91 @@
+#include "TankMovement.hpp"
+#include "../Engine/MathFunctions.hpp"
+#include "../Engine/NewMacroDef.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+TankMovementInput::TankMovementInput()
+	: m_turnDirection( 0 )
+	, m_throttle( 0 )
+{
+
+}
+
+
+//-----------------------------------------------------------------------------------------------
+TankMovementInput::TankMovementInput( int turnDirection, float throttle )
+{
+	if( turnDirection > 0 )
+		m_turnDirection = 1;
+	else if( turnDirection < 0 )
+		m_turnDirection = -1;
+	else
+		m_turnDirection = 0;
+
+	float scaledThrottle = ClampFloat( throttle, -1.f, 1.f ) * TANK_MOVEMENT_THROTTLE_SCALE;
+	m_throttle = (signed char) ( scaledThrottle >= 0.f ? scaledThrottle + 0.5f : scaledThrottle - 0.5f );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool TankMovementInput::operator==( const TankMovementInput& other ) const
+{
+	return m_turnDirection == other.m_turnDirection && m_throttle == other.m_throttle;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool TankMovementInput::operator!=( const TankMovementInput& other ) const
+{
+	return !( *this == other );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+TankMovementState::TankMovementState()
+	: m_orientationDegrees( 0.f )
+{
+
+}
+
+
+//-----------------------------------------------------------------------------------------------
+TankMovementState::TankMovementState( const Vector2& position, float orientationDegrees )
+	: m_position( position )
+	, m_orientationDegrees( WrapTankOrientationDegrees( orientationDegrees ) )
+{
+
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Turn first, then drive along the new facing, then stop at the arena edge.
+void StepTankMovement( TankMovementState& inout_state, const TankMovementInput& input )
+{
+	inout_state.m_orientationDegrees = WrapTankOrientationDegrees( inout_state.m_orientationDegrees + input.m_turnDirection * TANK_ROTATION_DEGREES_PER_SECOND * TANK_MOVEMENT_STEP_SECONDS );
+
+	Vector2 velocity = GetTankMovementVelocity( inout_state, input );
+	inout_state.m_position.x = ClampFloat( inout_state.m_position.x + velocity.x * TANK_MOVEMENT_STEP_SECONDS, 0.f, TANK_MOVEMENT_ARENA_SIZE );
+	inout_state.m_position.y = ClampFloat( inout_state.m_position.y + velocity.y * TANK_MOVEMENT_STEP_SECONDS, 0.f, TANK_MOVEMENT_ARENA_SIZE );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+Vector2 GetTankMovementVelocity( const TankMovementState& state, const TankMovementInput& input )
+{
+	float orientationRadians = ConvertDegreesToRadians( state.m_orientationDegrees );
+	float speed = ( (float) input.m_throttle / (float) TANK_MOVEMENT_THROTTLE_SCALE ) * TANK_SPEED_UNITS_PER_SECOND;
+	return Vector2( cos( orientationRadians ) * speed, sin( orientationRadians ) * speed );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+float WrapTankOrientationDegrees( float orientationDegrees )
+{
+	while( orientationDegrees < -180.f )
+		orientationDegrees += 360.f;
+	while( orientationDegrees >= 180.f )
+		orientationDegrees -= 360.f;
+
+	return orientationDegrees;
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#ifndef include_TankMovement
+#define include_TankMovement
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include "../Engine/Vector2.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+// Client prediction and the server both advance tanks in these fixed steps, so the same inputs
+// replayed from the same state land in the same place whatever either side's frame rate is.
+const float TANK_SPEED_UNITS_PER_SECOND = 100.f;
+const float TANK_ROTATION_DEGREES_PER_SECOND = 90.f;
+const float TANK_MOVEMENT_STEPS_PER_SECOND = 60.f;
+const float TANK_MOVEMENT_STEP_SECONDS = 1.f / TANK_MOVEMENT_STEPS_PER_SECOND;
+const float TANK_MOVEMENT_ARENA_SIZE = 500.f;
+const int TANK_MOVEMENT_THROTTLE_SCALE = 127;
+
+
+//-----------------------------------------------------------------------------------------------
+// One step's controls, already quantized to what goes on the wire so the server replays exactly
+// what the client predicted with. Throttle is -127 (full reverse) to 127 (full forward); turn
+// direction is 1 for left, -1 for right.
+struct TankMovementInput
+{
+	TankMovementInput();
+	TankMovementInput( int turnDirection, float throttle );
+	bool operator==( const TankMovementInput& other ) const;
+	bool operator!=( const TankMovementInput& other ) const;
+
+	signed char	m_turnDirection;
+	signed char	m_throttle;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+// Orientation is kept in [-180, 180) degrees, 0 = east.
+struct TankMovementState
+{
+	TankMovementState();
+	TankMovementState( const Vector2& position, float orientationDegrees );
+
+	Vector2	m_position;
+	float	m_orientationDegrees;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+void StepTankMovement( TankMovementState& inout_state, const TankMovementInput& input );
+Vector2 GetTankMovementVelocity( const TankMovementState& state, const TankMovementInput& input );
+float WrapTankOrientationDegrees( float orientationDegrees );
+
+
+#endif // include_TankMovement
\ No newline at end of file
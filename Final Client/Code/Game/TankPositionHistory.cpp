@@ -0,0 +1,111 @@
+#include "TankPositionHistory.hpp"
+#include <string.h>
+#include "../Engine/NewMacroDef.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+void TankPositionHistory::Clear()
+{
+	memset( this, 0, sizeof( *this ) );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Tanks start out absent from the new frame until their position is set.
+void TankPositionHistory::AddFrame( double timeSeconds )
+{
+	m_newestIndex = ( m_newestIndex + 1 ) & ( TANK_HISTORY_NUM_FRAMES - 1 );
+	if( m_numFrames < TANK_HISTORY_NUM_FRAMES )
+		++m_numFrames;
+
+	TankHistoryFrame& frame = m_frames[ m_newestIndex ];
+	frame.m_timeSeconds = timeSeconds;
+	frame.m_presentMask = 0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void TankPositionHistory::SetTankPosition( int tankIndex, const Vector2& position )
+{
+	TankHistoryFrame& frame = m_frames[ m_newestIndex ];
+	frame.m_xPositions[ tankIndex ] = position.x;
+	frame.m_yPositions[ tankIndex ] = position.y;
+	frame.m_presentMask |= 1u << tankIndex;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// For a tank that left or respawned: rewinding must not find where its slot used to be.
+void TankPositionHistory::ForgetTank( int tankIndex )
+{
+	unsigned int keptMask = ~( 1u << tankIndex );
+	for( int frameIndex = 0; frameIndex < TANK_HISTORY_NUM_FRAMES; ++frameIndex )
+	{
+		m_frames[ frameIndex ].m_presentMask &= keptMask;
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Blends the two frames either side of the time; a tank counts as present only if it is in both.
+// Times after the newest frame get the newest frame. Returns false for times before the oldest.
+bool TankPositionHistory::GetRewoundFrame( double timeSeconds, TankHistoryFrame& out_frame ) const
+{
+	if( m_numFrames == 0 )
+		return false;
+
+	const TankHistoryFrame* newerFrame = &m_frames[ m_newestIndex ];
+	if( timeSeconds >= newerFrame->m_timeSeconds )
+	{
+		out_frame = *newerFrame;
+		return true;
+	}
+
+	// Shots rewind a fraction of a second, so walking back from the newest frame beats bisecting
+	for( int framesBack = 1; framesBack < m_numFrames; ++framesBack )
+	{
+		const TankHistoryFrame& olderFrame = m_frames[ ( m_newestIndex - framesBack ) & ( TANK_HISTORY_NUM_FRAMES - 1 ) ];
+		if( olderFrame.m_timeSeconds > timeSeconds )
+		{
+			newerFrame = &olderFrame;
+			continue;
+		}
+
+		double frameSeconds = newerFrame->m_timeSeconds - olderFrame.m_timeSeconds;
+		float blendFraction = ( frameSeconds > 0.0 ) ? (float) ( ( timeSeconds - olderFrame.m_timeSeconds ) / frameSeconds ) : 1.f;
+		for( int tankIndex = 0; tankIndex < TANK_HISTORY_NUM_TANKS; ++tankIndex )
+		{
+			out_frame.m_xPositions[ tankIndex ] = olderFrame.m_xPositions[ tankIndex ] + ( newerFrame->m_xPositions[ tankIndex ] - olderFrame.m_xPositions[ tankIndex ] ) * blendFraction;
+			out_frame.m_yPositions[ tankIndex ] = olderFrame.m_yPositions[ tankIndex ] + ( newerFrame->m_yPositions[ tankIndex ] - olderFrame.m_yPositions[ tankIndex ] ) * blendFraction;
+		}
+
+		out_frame.m_timeSeconds = timeSeconds;
+		out_frame.m_presentMask = olderFrame.m_presentMask & newerFrame->m_presentMask;
+		return true;
+	}
+
+	return false;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool TankPositionHistory::HasFrames() const
+{
+	return m_numFrames > 0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+double TankPositionHistory::GetNewestTimeSeconds() const
+{
+	return m_frames[ m_newestIndex ].m_timeSeconds;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Infinite ray against every present tank's collision circle; laserDirection must be unit length.
+// Bit n of the result is set if tank n is hit.
+unsigned int GetLaserHitMask( const TankHistoryFrame& frame, const Vector2& laserOrigin, const Vector2& laserDirection, float tankRadius )
+{
+	return GetRayCircleHitMask( frame.m_xPositions, frame.m_yPositions, TANK_HISTORY_NUM_TANKS, laserOrigin, laserDirection, tankRadius ) & frame.m_presentMask;
+}
\ No newline at end of file
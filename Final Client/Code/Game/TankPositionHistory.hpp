@@ -0,0 +1,57 @@
+#ifndef include_TankPositionHistory
+#define include_TankPositionHistory
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include "../Engine/Vector2.hpp"
+#include "../Engine/SIMDMathFunctions.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+// One frame per server tick: 64 frames is a second at 64 ticks per second, over three at the
+// default 20. Shots claiming to see further back than the rewind limit are not compensated.
+const int TANK_HISTORY_NUM_TANKS = 8;
+const int TANK_HISTORY_NUM_FRAMES = 64; // must be a power of two
+const double LAG_COMPENSATION_MAX_REWIND_SECONDS = 1.0;
+static_assert( TANK_HISTORY_NUM_TANKS % RAY_CIRCLE_BATCH_SIZE == 0, "Hit tests run whole batches of tanks" );
+
+
+//-----------------------------------------------------------------------------------------------
+// Every tank slot of a room at one moment. Positions are kept as separate x and y arrays so a
+// shot tests all of the room's tanks from two cache lines, eight lanes at a time.
+struct TankHistoryFrame
+{
+	float			m_xPositions[ TANK_HISTORY_NUM_TANKS ];
+	float			m_yPositions[ TANK_HISTORY_NUM_TANKS ];
+	double			m_timeSeconds;
+	unsigned int	m_presentMask;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+// Where each tank of a room was over the last few ticks, so a shot can be judged against the
+// positions the shooter was looking at. There is no constructor: all zero is empty, as the rooms
+// holding these are memset.
+class TankPositionHistory
+{
+public:
+	void Clear();
+	void AddFrame( double timeSeconds );
+	void SetTankPosition( int tankIndex, const Vector2& position );
+	void ForgetTank( int tankIndex );
+	bool GetRewoundFrame( double timeSeconds, TankHistoryFrame& out_frame ) const;
+	bool HasFrames() const;
+	double GetNewestTimeSeconds() const;
+
+private:
+	TankHistoryFrame	m_frames[ TANK_HISTORY_NUM_FRAMES ];
+	int					m_newestIndex;
+	int					m_numFrames;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int GetLaserHitMask( const TankHistoryFrame& frame, const Vector2& laserOrigin, const Vector2& laserDirection, float tankRadius );
+
+
+#endif // include_TankPositionHistory
\ No newline at end of file
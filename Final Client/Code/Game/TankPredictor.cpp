@@ -0,0 +1,171 @@
+#include "TankPredictor.hpp"
+#include "../Engine/NewMacroDef.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+TankPredictionStats::TankPredictionStats()
+	: m_numReconciliations( 0 )
+	, m_numMispredictions( 0 )
+	, m_lastCorrectionDistance( 0.f )
+	, m_maxCorrectionDistance( 0.f )
+	, m_totalCorrectionDistance( 0.f )
+{
+
+}
+
+
+//-----------------------------------------------------------------------------------------------
+TankPredictor::TankPredictor()
+	: m_accumulatedSeconds( 0.f )
+	, m_nextStep( 0 )
+	, m_oldestUnacknowledgedStep( 0 )
+{
+
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Inputs from before a reset or respawn are dropped: the server placed the tank afresh too.
+void TankPredictor::Reset( const TankMovementState& state )
+{
+	m_state = state;
+	m_previousState = state;
+	m_accumulatedSeconds = 0.f;
+	m_oldestUnacknowledgedStep = m_nextStep;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Returns the number of steps run. When the history is full the oldest input is forgotten; a
+// correction from before it can no longer be replayed and is ignored.
+int TankPredictor::Advance( float deltaSeconds, const TankMovementInput& input )
+{
+	m_accumulatedSeconds += deltaSeconds;
+
+	int numSteps = 0;
+	while( m_accumulatedSeconds >= TANK_MOVEMENT_STEP_SECONDS )
+	{
+		if( numSteps == MAX_MOVEMENT_STEPS_PER_FRAME )
+		{
+			m_accumulatedSeconds = 0.f;
+			break;
+		}
+
+		m_previousState = m_state;
+		m_inputHistory[ m_nextStep % TANK_INPUT_HISTORY_SIZE ] = input;
+		StepTankMovement( m_state, input );
+		++m_nextStep;
+		m_accumulatedSeconds -= TANK_MOVEMENT_STEP_SECONDS;
+		++numSteps;
+
+		if( ( m_nextStep - m_oldestUnacknowledgedStep ) > (unsigned int) TANK_INPUT_HISTORY_SIZE )
+			++m_oldestUnacknowledgedStep;
+	}
+
+	return numSteps;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Returns false for a correction older than one already applied, or than the input history. The
+// step being drawn from is shifted by the same correction so the render blend does not jump back.
+bool TankPredictor::Reconcile( unsigned int nextServerStep, const TankMovementState& serverState )
+{
+	if( (int) ( nextServerStep - m_oldestUnacknowledgedStep ) < 0 || (int) ( m_nextStep - nextServerStep ) < 0 )
+		return false;
+
+	TankMovementState replayedState = serverState;
+	for( unsigned int step = nextServerStep; step != m_nextStep; ++step )
+	{
+		StepTankMovement( replayedState, m_inputHistory[ step % TANK_INPUT_HISTORY_SIZE ] );
+	}
+
+	Vector2 correction = replayedState.m_position - m_state.m_position;
+	float correctionDegrees = WrapTankOrientationDegrees( replayedState.m_orientationDegrees - m_state.m_orientationDegrees );
+	m_previousState.m_position += correction;
+	m_previousState.m_orientationDegrees = WrapTankOrientationDegrees( m_previousState.m_orientationDegrees + correctionDegrees );
+	m_state = replayedState;
+
+	m_oldestUnacknowledgedStep = nextServerStep;
+
+	float correctionDistance = correction.GetLength();
+	++m_stats.m_numReconciliations;
+	m_stats.m_lastCorrectionDistance = correctionDistance;
+	m_stats.m_totalCorrectionDistance += correctionDistance;
+	if( correctionDistance > m_stats.m_maxCorrectionDistance )
+		m_stats.m_maxCorrectionDistance = correctionDistance;
+	if( correctionDistance > TANK_PREDICTION_TOLERANCE )
+		++m_stats.m_numMispredictions;
+
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Every step since the last correction, oldest first, cut where the input changes. Returns the
+// number of runs written; past maxRuns the newest steps wait for a correction to make room.
+int TankPredictor::GetUnacknowledgedInputRuns( TankInputRun* out_runs, int maxRuns ) const
+{
+	int numRuns = 0;
+	unsigned int step = m_oldestUnacknowledgedStep;
+	while( step != m_nextStep && numRuns < maxRuns )
+	{
+		TankInputRun& run = out_runs[ numRuns ];
+		run.m_firstStep = step;
+		run.m_input = m_inputHistory[ step % TANK_INPUT_HISTORY_SIZE ];
+		run.m_numSteps = 0;
+		while( step != m_nextStep && run.m_numSteps < MAX_STEPS_PER_INPUT_RUN
+			&& m_inputHistory[ step % TANK_INPUT_HISTORY_SIZE ] == run.m_input )
+		{
+			++step;
+			++run.m_numSteps;
+		}
+
+		++numRuns;
+	}
+
+	return numRuns;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+const TankMovementState& TankPredictor::GetState() const
+{
+	return m_state;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Between the last two steps by the time left over, so drawing is smooth at any frame rate at
+// the cost of one step of display latency.
+TankMovementState TankPredictor::GetRenderState() const
+{
+	float blendFraction = m_accumulatedSeconds / TANK_MOVEMENT_STEP_SECONDS;
+	if( blendFraction > 1.f )
+		blendFraction = 1.f;
+
+	float turnDegrees = WrapTankOrientationDegrees( m_state.m_orientationDegrees - m_previousState.m_orientationDegrees );
+	Vector2 position = m_previousState.m_position + ( m_state.m_position - m_previousState.m_position ) * blendFraction;
+	return TankMovementState( position, m_previousState.m_orientationDegrees + turnDegrees * blendFraction );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+int TankPredictor::GetNumUnacknowledgedSteps() const
+{
+	return (int) ( m_nextStep - m_oldestUnacknowledgedStep );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+const TankPredictionStats& TankPredictor::GetStats() const
+{
+	return m_stats;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void TankPredictor::ResetStats()
+{
+	m_stats = TankPredictionStats();
+}
\ No newline at end of file
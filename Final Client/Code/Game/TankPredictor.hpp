@@ -0,0 +1,76 @@
+#ifndef include_TankPredictor
+#define include_TankPredictor
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include "TankMovement.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+// 256 steps is over four seconds of unacknowledged input at 60 steps a second. A frame longer than
+// the step cap (a hitch, a breakpoint) drops the rest of its time rather than spiralling.
+// Corrections that move the tank less than the tolerance are quantization, not misprediction.
+const int TANK_INPUT_HISTORY_SIZE = 256;
+const int MAX_MOVEMENT_STEPS_PER_FRAME = 15;
+const int MAX_STEPS_PER_INPUT_RUN = 255;
+const int MAX_INPUT_RUNS_PER_SEND = 16;
+const float TANK_PREDICTION_TOLERANCE = 0.05f;
+
+
+//-----------------------------------------------------------------------------------------------
+// Consecutive steps that all used the same input, as sent in one TankInput packet.
+struct TankInputRun
+{
+	unsigned int		m_firstStep;
+	int					m_numSteps;
+	TankMovementInput	m_input;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+struct TankPredictionStats
+{
+	TankPredictionStats();
+
+	int		m_numReconciliations;
+	int		m_numMispredictions;
+	float	m_lastCorrectionDistance;
+	float	m_maxCorrectionDistance;
+	float	m_totalCorrectionDistance;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+// Moves the local tank the moment input happens, in numbered fixed steps, and remembers each
+// step's input until the server reports having simulated it. A correction names the first step
+// the server has not run yet and the state before it; the predictor restarts from that state and
+// replays every later input, so the tank lands where the server will have it once those inputs
+// arrive. Step numbers keep counting across resets so late corrections can be told apart.
+// Every send carries all the input not yet covered by a correction, so a lost send costs nothing
+// as long as a later one gets through.
+class TankPredictor
+{
+public:
+	TankPredictor();
+	void Reset( const TankMovementState& state );
+	int Advance( float deltaSeconds, const TankMovementInput& input );
+	bool Reconcile( unsigned int nextServerStep, const TankMovementState& serverState );
+	int GetUnacknowledgedInputRuns( TankInputRun* out_runs, int maxRuns ) const;
+	const TankMovementState& GetState() const;
+	TankMovementState GetRenderState() const;
+	int GetNumUnacknowledgedSteps() const;
+	const TankPredictionStats& GetStats() const;
+	void ResetStats();
+
+private:
+	TankMovementState	m_state;
+	TankMovementState	m_previousState;
+	float				m_accumulatedSeconds;
+	TankMovementInput	m_inputHistory[ TANK_INPUT_HISTORY_SIZE ];
+	unsigned int		m_nextStep;
+	unsigned int		m_oldestUnacknowledgedStep;
+	TankPredictionStats	m_stats;
+};
+
+
+#endif // include_TankPredictor
\ No newline at end of file
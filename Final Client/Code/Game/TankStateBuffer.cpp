@@ -0,0 +1,137 @@
+#include "TankStateBuffer.hpp"
+#include "../Engine/NewMacroDef.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+// Blends across the shorter arc, so 350 -> 10 turns through 0 rather than back through 180.
+static float InterpolateDegrees( float fromDegrees, float toDegrees, float fraction )
+{
+	float deltaDegrees = toDegrees - fromDegrees;
+	while( deltaDegrees > 180.f )
+		deltaDegrees -= 360.f;
+	while( deltaDegrees < -180.f )
+		deltaDegrees += 360.f;
+
+	float degrees = fromDegrees + deltaDegrees * fraction;
+	if( degrees < 0.f )
+		degrees += 360.f;
+	else if( degrees >= 360.f )
+		degrees -= 360.f;
+
+	return degrees;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+TankStateBuffer::TankStateBuffer()
+{
+	Clear();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void TankStateBuffer::Clear()
+{
+	m_newestIndex = TANK_STATE_BUFFER_SIZE - 1;
+	m_numSamples = 0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Samples must arrive in time order; one stamped no later than the newest replaces it, so a burst
+// of updates drained in the same frame keeps only the latest state.
+void TankStateBuffer::AddSample( const TankStateSample& sample )
+{
+	if( m_numSamples > 0 )
+	{
+		TankStateSample& newestSample = m_samples[ m_newestIndex ];
+		if( ( sample.m_position - newestSample.m_position ).GetLength() > TANK_STATE_TELEPORT_DISTANCE )
+		{
+			Clear();
+		}
+		else if( sample.m_timeSeconds <= newestSample.m_timeSeconds )
+		{
+			double newestTimeSeconds = newestSample.m_timeSeconds;
+			newestSample = sample;
+			newestSample.m_timeSeconds = newestTimeSeconds;
+			return;
+		}
+	}
+
+	m_newestIndex = ( m_newestIndex + 1 ) % TANK_STATE_BUFFER_SIZE;
+	m_samples[ m_newestIndex ] = sample;
+	if( m_numSamples < TANK_STATE_BUFFER_SIZE )
+		++m_numSamples;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool TankStateBuffer::Sample( double timeSeconds, Vector2& out_position, float& out_yawOrientationDeg ) const
+{
+	if( m_numSamples == 0 )
+		return false;
+
+	const TankStateSample& newestSample = GetNewestSample();
+	if( timeSeconds >= newestSample.m_timeSeconds )
+	{
+		double extrapolationSeconds = timeSeconds - newestSample.m_timeSeconds;
+		if( extrapolationSeconds > TANK_STATE_MAX_EXTRAPOLATION_SECONDS )
+			extrapolationSeconds = TANK_STATE_MAX_EXTRAPOLATION_SECONDS;
+
+		out_position = newestSample.m_position + newestSample.m_velocity * (float) extrapolationSeconds;
+		out_yawOrientationDeg = newestSample.m_yawOrientationDeg;
+		return true;
+	}
+
+	// Walk back from the newest sample to the pair that brackets the requested time
+	for( int ageIndex = 1; ageIndex < m_numSamples; ++ageIndex )
+	{
+		const TankStateSample& fromSample = GetSample( ageIndex );
+		if( fromSample.m_timeSeconds > timeSeconds )
+			continue;
+
+		const TankStateSample& toSample = GetSample( ageIndex - 1 );
+		float spanSeconds = (float) ( toSample.m_timeSeconds - fromSample.m_timeSeconds );
+		float t = (float) ( timeSeconds - fromSample.m_timeSeconds ) / spanSeconds;
+		float t2 = t * t;
+		float t3 = t2 * t;
+
+		float fromPositionWeight = ( 2.f * t3 ) - ( 3.f * t2 ) + 1.f;
+		float fromVelocityWeight = ( t3 - ( 2.f * t2 ) + t ) * spanSeconds;
+		float toPositionWeight = ( -2.f * t3 ) + ( 3.f * t2 );
+		float toVelocityWeight = ( t3 - t2 ) * spanSeconds;
+
+		out_position = ( fromSample.m_position * fromPositionWeight ) + ( fromSample.m_velocity * fromVelocityWeight )
+			+ ( toSample.m_position * toPositionWeight ) + ( toSample.m_velocity * toVelocityWeight );
+		out_yawOrientationDeg = InterpolateDegrees( fromSample.m_yawOrientationDeg, toSample.m_yawOrientationDeg, t );
+		return true;
+	}
+
+	// Older than anything still buffered
+	const TankStateSample& oldestSample = GetSample( m_numSamples - 1 );
+	out_position = oldestSample.m_position;
+	out_yawOrientationDeg = oldestSample.m_yawOrientationDeg;
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+int TankStateBuffer::GetNumSamples() const
+{
+	return m_numSamples;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+const TankStateSample& TankStateBuffer::GetNewestSample() const
+{
+	return m_samples[ m_newestIndex ];
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Age 0 is the newest sample.
+const TankStateSample& TankStateBuffer::GetSample( int ageIndex ) const
+{
+	return m_samples[ ( m_newestIndex - ageIndex + TANK_STATE_BUFFER_SIZE ) % TANK_STATE_BUFFER_SIZE ];
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+#ifndef include_TankStateBuffer
+#define include_TankStateBuffer
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include "../Engine/Vector2.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+// At 20 updates a second, 16 samples cover 0.8 s, well past any sensible interpolation delay.
+// A jump further than the teleport distance between two samples is a respawn, not movement.
+const int TANK_STATE_BUFFER_SIZE = 16;
+const float TANK_STATE_TELEPORT_DISTANCE = 50.f;
+const double TANK_STATE_MAX_EXTRAPOLATION_SECONDS = 0.25;
+
+
+//-----------------------------------------------------------------------------------------------
+struct TankStateSample
+{
+	double	m_timeSeconds;
+	Vector2	m_position;
+	Vector2	m_velocity;
+	float	m_yawOrientationDeg;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+// Ring of a remote tank's most recent timestamped states, sampled some delay in the past so the
+// tank is drawn between two states it actually had. Positions follow a cubic Hermite curve through
+// the bracketing samples using their velocities as tangents; past the newest sample it extrapolates
+// along the newest velocity for at most TANK_STATE_MAX_EXTRAPOLATION_SECONDS, then holds.
+class TankStateBuffer
+{
+public:
+	TankStateBuffer();
+	void Clear();
+	void AddSample( const TankStateSample& sample );
+	bool Sample( double timeSeconds, Vector2& out_position, float& out_yawOrientationDeg ) const;
+	int GetNumSamples() const;
+	const TankStateSample& GetNewestSample() const;
+
+private:
+	const TankStateSample& GetSample( int ageIndex ) const;
+
+	TankStateSample	m_samples[ TANK_STATE_BUFFER_SIZE ];
+	int				m_newestIndex;
+	int				m_numSamples;
+};
+
+
+#endif // include_TankStateBuffer
\ No newline at end of file
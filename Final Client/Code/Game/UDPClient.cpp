@@ -1,31 +1,73 @@
 #include "UDPClient.hpp"
+#include <string.h>
+#include "GameCommon.hpp"
+#include "PacketCapture.hpp"
+#include "../Engine/Time.hpp"
 #include "../Engine/NewMacroDef.hpp"
 
 
+//-----------------------------------------------------------------------------------------------
+UDPClient::UDPClient()
+	: m_isSocketReadable( false )
+	, m_receiveRing( nullptr )
+	, m_receiveRingReadIndex( 0 )
+	, m_receiveRingCount( 0 )
+	, m_maxDatagramsPerReceiveBatch( DEFAULT_MAX_DATAGRAMS_PER_RECEIVE_BATCH )
+	, m_lastReceiveBatchSize( 0 )
+	, m_numReceiveBatches( 0 )
+	, m_numDatagramsReceived( 0 )
+	, m_sendQueue( nullptr )
+	, m_sendQueueCount( 0 )
+	, m_lastFlushNumDatagrams( 0 )
+	, m_lastFlushNumBytes( 0 )
+	, m_timeOfLastFlush( 0.0 )
+	, m_outgoingBytesPerSecond( 0.f )
+	, m_outgoingConditioner( OUTGOING_CONDITIONER_SEED )
+	, m_incomingConditioner( INCOMING_CONDITIONER_SEED )
+	, m_capture( nullptr )
+	, m_isOffline( false )
+	, m_numInjectedDatagrams( 0 )
+	, m_incomingQueue( nullptr )
+	, m_outgoingQueue( nullptr )
+	, m_isNetworkThreadQuitting( 0 )
+	, m_isNetworkThreadRunning( false )
+	, m_numOutgoingQueueDrops( 0 )
+{
+
+}
+
+
 //-----------------------------------------------------------------------------------------------
 bool UDPClient::ConnectToServer( const std::string& serverIPAddress, unsigned short serverPortNumber )
 {
-	if( WSAStartup( 0x202, &m_wsaData ) != 0 )
+	StopNetworkThread();
+
+	if( !UDPSocket::StartupNetworking() )
 	{
 		return false;
 	}
 
-	m_socket = socket( AF_INET, SOCK_DGRAM, IPPROTO_UDP );
-	if( m_socket == INVALID_SOCKET )
+	if( !m_socket.Open() )
 	{
 		return false;
 	}
 
+	if( m_receiveRing == nullptr )
+		m_receiveRing = new DatagramBuffer[ RECEIVE_RING_SIZE ];
+
+	if( m_sendQueue == nullptr )
+		m_sendQueue = new DatagramBuffer[ SEND_QUEUE_SIZE ];
+
+	m_receiveRingReadIndex = 0;
+	m_receiveRingCount = 0;
+	m_sendQueueCount = 0;
+	m_outgoingConditioner.Clear();
+	m_incomingConditioner.Clear();
+
 	m_serverAddr.sin_family = AF_INET;
 	m_serverAddr.sin_addr.s_addr = inet_addr( serverIPAddress.c_str() );
 	m_serverAddr.sin_port = htons( serverPortNumber );
 
-	u_long mode = 1;
-	if( ioctlsocket( m_socket, FIONBIO, &mode ) == SOCKET_ERROR )
-	{
-		return false;
-	}
-
 	m_serverIPAddress = serverIPAddress;
 	m_serverPortNumber = serverPortNumber;
 
@@ -36,19 +78,47 @@ bool UDPClient::ConnectToServer( const std::string& serverIPAddress, unsigned sh
 //-----------------------------------------------------------------------------------------------
 void UDPClient::DisconnectFromServer()
 {
-	closesocket( m_socket );
-	WSACleanup();
+	StopNetworkThread();
+	delete m_incomingQueue;
+	m_incomingQueue = nullptr;
+	delete m_outgoingQueue;
+	m_outgoingQueue = nullptr;
+
+	m_socket.Close();
+	UDPSocket::ShutdownNetworking();
+
+	delete[] m_receiveRing;
+	m_receiveRing = nullptr;
+
+	delete[] m_sendQueue;
+	m_sendQueue = nullptr;
+	m_sendQueueCount = 0;
+
+	StopCapture();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool UDPClient::WaitForPacketFromServer( int timeoutMilliseconds )
+{
+	return m_socket.WaitUntilReadable( timeoutMilliseconds );
 }
 
 
 //-----------------------------------------------------------------------------------------------
 bool UDPClient::ReceivePacketFromServer( char* out_packetInfo, int packetLength )
 {
-	struct sockaddr_in clientAddr;
-	int clientLen = sizeof( clientAddr );
+	if( !m_isSocketReadable )
+	{
+		m_isSocketReadable = m_socket.WaitUntilReadable( 0 );
+		if( !m_isSocketReadable )
+			return false;
+	}
 
-	if( recvfrom( m_socket, out_packetInfo, packetLength, 0, (struct sockaddr*) &clientAddr, &clientLen ) < 0 )
+	struct sockaddr_in clientAddr;
+	if( m_socket.ReceiveFrom( out_packetInfo, packetLength, &clientAddr ) < 0 )
 	{
+		m_isSocketReadable = false;
 		return false;
 	}
 
@@ -56,10 +126,231 @@ bool UDPClient::ReceivePacketFromServer( char* out_packetInfo, int packetLength
 }
 
 
+//-----------------------------------------------------------------------------------------------
+// Fills the free slots of the receive ring with one batched receive. Returns the number of new datagrams.
+int UDPClient::ReceivePacketBatchFromServer()
+{
+	if( m_receiveRing == nullptr )
+		return 0;
+
+	if( m_isOffline )
+	{
+		int numInjected = m_numInjectedDatagrams;
+		m_numInjectedDatagrams = 0;
+		return numInjected;
+	}
+
+	// The network thread conditions what it queues, and what it queued before it was stopped is
+	// delivered ahead of the socket's
+	if( m_isNetworkThreadRunning || ( m_incomingQueue != nullptr && m_incomingQueue->GetNumReadableSlots() > 0 ) )
+		return ReceiveFromNetworkThread();
+
+	if( m_incomingConditioner.IsActive() )
+		return ReceiveConditionedDatagrams();
+
+	return ReceiveDatagramBatch();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+int UDPClient::ReceiveDatagramBatch()
+{
+	if( !m_isSocketReadable )
+	{
+		m_isSocketReadable = m_socket.WaitUntilReadable( 0 );
+		if( !m_isSocketReadable )
+			return 0;
+	}
+
+	int numFreeSlots = RECEIVE_RING_SIZE - m_receiveRingCount;
+	int maxDatagrams = ( numFreeSlots < m_maxDatagramsPerReceiveBatch ) ? numFreeSlots : m_maxDatagramsPerReceiveBatch;
+	if( maxDatagrams <= 0 )
+		return 0;
+
+	char* slotBuffers[ MAX_DATAGRAMS_PER_SYSTEM_CALL ];
+	int slotNumBytes[ MAX_DATAGRAMS_PER_SYSTEM_CALL ];
+	int writeIndex = ( m_receiveRingReadIndex + m_receiveRingCount ) % RECEIVE_RING_SIZE;
+	for( int slotIndex = 0; slotIndex < maxDatagrams && slotIndex < MAX_DATAGRAMS_PER_SYSTEM_CALL; ++slotIndex )
+	{
+		slotBuffers[ slotIndex ] = m_receiveRing[ ( writeIndex + slotIndex ) % RECEIVE_RING_SIZE ].m_data;
+	}
+
+	int numReceived = m_socket.ReceiveBatch( slotBuffers, MAX_DATAGRAM_SIZE_BYTES, slotNumBytes, nullptr, maxDatagrams );
+	double arrivalTime = GetCurrentTimeSeconds();
+	for( int slotIndex = 0; slotIndex < numReceived; ++slotIndex )
+	{
+		DatagramBuffer& datagram = m_receiveRing[ ( writeIndex + slotIndex ) % RECEIVE_RING_SIZE ];
+		datagram.m_numBytes = slotNumBytes[ slotIndex ];
+		datagram.m_arrivalTimeSeconds = arrivalTime;
+	}
+
+	if( numReceived < maxDatagrams )
+		m_isSocketReadable = false;
+
+	m_receiveRingCount += numReceived;
+	m_lastReceiveBatchSize = numReceived;
+	if( numReceived > 0 )
+	{
+		++m_numReceiveBatches;
+		m_numDatagramsReceived += numReceived;
+	}
+
+	return numReceived;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Moves whatever the network thread has queued into the ring, keeping the thread's arrival times.
+int UDPClient::ReceiveFromNetworkThread()
+{
+	int numFreeSlots = RECEIVE_RING_SIZE - m_receiveRingCount;
+	int numQueued = (int) m_incomingQueue->GetNumReadableSlots();
+	int numToMove = ( numQueued < numFreeSlots ) ? numQueued : numFreeSlots;
+
+	int writeIndex = ( m_receiveRingReadIndex + m_receiveRingCount ) % RECEIVE_RING_SIZE;
+	for( int datagramIndex = 0; datagramIndex < numToMove; ++datagramIndex )
+	{
+		const DatagramBuffer& queuedDatagram = m_incomingQueue->GetReadSlot( datagramIndex );
+		DatagramBuffer& datagram = m_receiveRing[ ( writeIndex + datagramIndex ) % RECEIVE_RING_SIZE ];
+		memcpy( datagram.m_data, queuedDatagram.m_data, queuedDatagram.m_numBytes );
+		datagram.m_numBytes = queuedDatagram.m_numBytes;
+		datagram.m_arrivalTimeSeconds = queuedDatagram.m_arrivalTimeSeconds;
+	}
+
+	m_incomingQueue->CommitReads( numToMove );
+
+	m_receiveRingCount += numToMove;
+	m_lastReceiveBatchSize = numToMove;
+	if( numToMove > 0 )
+	{
+		++m_numReceiveBatches;
+		m_numDatagramsReceived += numToMove;
+	}
+
+	return numToMove;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Drains the socket into the conditioner, then moves whatever the simulated link has delivered by
+// now into the ring. The link is fed each datagram's real arrival time, and what it delivers is
+// stamped with the time the link released it, not the frame that got round to it. Returns the
+// number of datagrams delivered.
+int UDPClient::ReceiveConditionedDatagrams()
+{
+	double currentTime = GetCurrentTimeSeconds();
+	int numReceived;
+	while( ( numReceived = ReceiveDatagramBatch() ) > 0 )
+	{
+		// The batch was appended to the ring; take it straight back out
+		int firstReceivedIndex = ( m_receiveRingReadIndex + m_receiveRingCount - numReceived ) % RECEIVE_RING_SIZE;
+		for( int datagramIndex = 0; datagramIndex < numReceived; ++datagramIndex )
+		{
+			const DatagramBuffer& datagram = m_receiveRing[ ( firstReceivedIndex + datagramIndex ) % RECEIVE_RING_SIZE ];
+			m_incomingConditioner.SubmitDatagram( datagram.m_data, datagram.m_numBytes, datagram.m_arrivalTimeSeconds );
+		}
+
+		m_receiveRingCount -= numReceived;
+	}
+
+	int numDelivered = 0;
+	while( m_receiveRingCount < RECEIVE_RING_SIZE )
+	{
+		DatagramBuffer& datagram = m_receiveRing[ ( m_receiveRingReadIndex + m_receiveRingCount ) % RECEIVE_RING_SIZE ];
+		if( !m_incomingConditioner.PopReadyDatagram( currentTime, datagram.m_data, MAX_DATAGRAM_SIZE_BYTES, datagram.m_numBytes, &datagram.m_arrivalTimeSeconds ) )
+			break;
+
+		++m_receiveRingCount;
+		++numDelivered;
+	}
+
+	return numDelivered;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool UDPClient::PopReceivedPacket( char* out_packetInfo, int packetLength, int& out_numBytes, double* out_arrivalTimeSeconds )
+{
+	if( m_receiveRingCount == 0 )
+		return false;
+
+	const DatagramBuffer& datagram = m_receiveRing[ m_receiveRingReadIndex ];
+	int numBytesToCopy = ( datagram.m_numBytes < packetLength ) ? datagram.m_numBytes : packetLength;
+	memcpy( out_packetInfo, datagram.m_data, numBytesToCopy );
+	out_numBytes = numBytesToCopy;
+	if( out_arrivalTimeSeconds != nullptr )
+		*out_arrivalTimeSeconds = datagram.m_arrivalTimeSeconds;
+
+	if( m_capture != nullptr )
+		m_capture->WriteDatagram( CAPTURE_Incoming, datagram.m_data, datagram.m_numBytes );
+
+	m_receiveRingReadIndex = ( m_receiveRingReadIndex + 1 ) % RECEIVE_RING_SIZE;
+	--m_receiveRingCount;
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void UDPClient::SetMaxDatagramsPerReceiveBatch( int maxDatagrams )
+{
+	if( maxDatagrams < 1 )
+		maxDatagrams = 1;
+
+	if( maxDatagrams > MAX_DATAGRAMS_PER_SYSTEM_CALL )
+		maxDatagrams = MAX_DATAGRAMS_PER_SYSTEM_CALL;
+
+	m_maxDatagramsPerReceiveBatch = maxDatagrams;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+int UDPClient::GetLastReceiveBatchSize() const
+{
+	return m_lastReceiveBatchSize;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+float UDPClient::GetAverageDatagramsPerReceiveBatch() const
+{
+	if( m_numReceiveBatches == 0 )
+		return 0.f;
+
+	return (float) m_numDatagramsReceived / (float) m_numReceiveBatches;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+int UDPClient::GetLastFlushNumDatagrams() const
+{
+	return m_lastFlushNumDatagrams;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+int UDPClient::GetLastFlushNumBytes() const
+{
+	return m_lastFlushNumBytes;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+float UDPClient::GetOutgoingBytesPerSecond() const
+{
+	return m_outgoingBytesPerSecond;
+}
+
+
 //-----------------------------------------------------------------------------------------------
 bool UDPClient::SendPacketToServer( const char* packetInfo, int packetLength )
 {
-	if( sendto( m_socket, packetInfo, packetLength, 0, (struct sockaddr*) &m_serverAddr, sizeof( m_serverAddr ) ) < 0 )
+	if( m_isNetworkThreadRunning )
+	{
+		char* datagramBuffers[ 1 ] = { const_cast< char* >( packetInfo ) };
+		return SendDatagramBatch( datagramBuffers, &packetLength, 1 ) == 1;
+	}
+
+	if( m_socket.SendTo( packetInfo, packetLength, m_serverAddr ) < 0 )
 	{
 		return false;
 	}
@@ -68,6 +359,139 @@ bool UDPClient::SendPacketToServer( const char* packetInfo, int packetLength )
 }
 
 
+//-----------------------------------------------------------------------------------------------
+// Copies the packet into the outgoing queue; nothing touches the socket until the next flush.
+bool UDPClient::QueuePacketToServer( const char* packetInfo, int packetLength )
+{
+	if( m_sendQueue == nullptr || packetLength > MAX_DATAGRAM_SIZE_BYTES )
+		return false;
+
+	if( m_sendQueueCount == SEND_QUEUE_SIZE )
+		FlushQueuedPacketsToServer();
+
+	DatagramBuffer& datagram = m_sendQueue[ m_sendQueueCount ];
+	memcpy( datagram.m_data, packetInfo, packetLength );
+	datagram.m_numBytes = packetLength;
+	++m_sendQueueCount;
+
+	if( m_capture != nullptr )
+		m_capture->WriteDatagram( CAPTURE_Outgoing, packetInfo, packetLength );
+
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+int UDPClient::FlushQueuedPacketsToServer()
+{
+	char* datagramBuffers[ SEND_QUEUE_SIZE ];
+	int datagramNumBytes[ SEND_QUEUE_SIZE ];
+	int numBytesQueued = 0;
+
+	for( int datagramIndex = 0; datagramIndex < m_sendQueueCount; ++datagramIndex )
+	{
+		datagramBuffers[ datagramIndex ] = m_sendQueue[ datagramIndex ].m_data;
+		datagramNumBytes[ datagramIndex ] = m_sendQueue[ datagramIndex ].m_numBytes;
+		numBytesQueued += m_sendQueue[ datagramIndex ].m_numBytes;
+	}
+
+	int numDatagramsSent = 0;
+	if( m_isOffline )
+		numDatagramsSent = m_sendQueueCount;
+	else if( m_outgoingConditioner.IsActive() && !m_isNetworkThreadRunning )
+		numDatagramsSent = SendConditionedDatagrams();
+	else if( m_sendQueueCount > 0 )
+		numDatagramsSent = SendDatagramBatch( datagramBuffers, datagramNumBytes, m_sendQueueCount );
+
+	double timeNow = GetCurrentTimeSeconds();
+	double secondsSinceLastFlush = timeNow - m_timeOfLastFlush;
+	if( m_timeOfLastFlush != 0.0 && secondsSinceLastFlush > 0.0 )
+	{
+		float instantBytesPerSecond = (float) ( numBytesQueued / secondsSinceLastFlush );
+		m_outgoingBytesPerSecond += ( instantBytesPerSecond - m_outgoingBytesPerSecond ) * OUTGOING_BANDWIDTH_SMOOTHING;
+	}
+
+	m_timeOfLastFlush = timeNow;
+	m_lastFlushNumDatagrams = m_sendQueueCount;
+	m_lastFlushNumBytes = numBytesQueued;
+	m_sendQueueCount = 0;
+
+	return numDatagramsSent;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Hands the queued datagrams to the conditioner, then reuses the send queue to batch out whatever
+// the simulated link has released by now. Returns the number of datagrams put on the wire.
+int UDPClient::SendConditionedDatagrams()
+{
+	double currentTime = GetCurrentTimeSeconds();
+	for( int datagramIndex = 0; datagramIndex < m_sendQueueCount; ++datagramIndex )
+	{
+		const DatagramBuffer& datagram = m_sendQueue[ datagramIndex ];
+		m_outgoingConditioner.SubmitDatagram( datagram.m_data, datagram.m_numBytes, currentTime );
+	}
+
+	char* datagramBuffers[ SEND_QUEUE_SIZE ];
+	int datagramNumBytes[ SEND_QUEUE_SIZE ];
+	int numDatagramsSent = 0;
+	bool hasMoreReady = true;
+	while( hasMoreReady )
+	{
+		int numReady = 0;
+		while( numReady < SEND_QUEUE_SIZE )
+		{
+			DatagramBuffer& datagram = m_sendQueue[ numReady ];
+			if( !m_outgoingConditioner.PopReadyDatagram( currentTime, datagram.m_data, MAX_DATAGRAM_SIZE_BYTES, datagram.m_numBytes ) )
+			{
+				hasMoreReady = false;
+				break;
+			}
+
+			datagramBuffers[ numReady ] = datagram.m_data;
+			datagramNumBytes[ numReady ] = datagram.m_numBytes;
+			++numReady;
+		}
+
+		if( numReady > 0 )
+			numDatagramsSent += SendDatagramBatch( datagramBuffers, datagramNumBytes, numReady );
+	}
+
+	return numDatagramsSent;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Sends at most SEND_QUEUE_SIZE datagrams to the server on this thread, or hands them to the network
+// thread when it runs. A full outgoing queue drops the rest, as a full socket buffer would.
+int UDPClient::SendDatagramBatch( char* const* datagramBuffers, const int* datagramNumBytes, int numDatagrams )
+{
+	if( !m_isNetworkThreadRunning )
+	{
+		const struct sockaddr_in* datagramAddrs[ SEND_QUEUE_SIZE ];
+		for( int datagramIndex = 0; datagramIndex < numDatagrams; ++datagramIndex )
+		{
+			datagramAddrs[ datagramIndex ] = &m_serverAddr;
+		}
+
+		return m_socket.SendBatch( datagramBuffers, datagramNumBytes, datagramAddrs, numDatagrams );
+	}
+
+	int numFreeSlots = (int) m_outgoingQueue->GetNumFreeSlots();
+	int numToQueue = ( numDatagrams < numFreeSlots ) ? numDatagrams : numFreeSlots;
+	for( int datagramIndex = 0; datagramIndex < numToQueue; ++datagramIndex )
+	{
+		DatagramBuffer& queuedDatagram = m_outgoingQueue->GetWriteSlot( datagramIndex );
+		memcpy( queuedDatagram.m_data, datagramBuffers[ datagramIndex ], datagramNumBytes[ datagramIndex ] );
+		queuedDatagram.m_numBytes = datagramNumBytes[ datagramIndex ];
+	}
+
+	m_outgoingQueue->CommitWrites( numToQueue );
+	m_numOutgoingQueueDrops += numDatagrams - numToQueue;
+	return numToQueue;
+}
+
+
 //-----------------------------------------------------------------------------------------------
 std::string UDPClient::GetServerIPAddress()
 {
@@ -83,14 +507,316 @@ unsigned short UDPClient::GetServerPortNumber()
 
 
 //-----------------------------------------------------------------------------------------------
+// The network thread reads the server address, so it is paused around the change.
 void UDPClient::SetServerIPAddress( const std::string ipAddress )
 {
+	bool wasNetworkThreadRunning = m_isNetworkThreadRunning;
+	StopNetworkThread();
+
 	m_serverAddr.sin_addr.s_addr = inet_addr( ipAddress.c_str() );
+
+	if( wasNetworkThreadRunning )
+		StartNetworkThread();
 }
 
 
 //-----------------------------------------------------------------------------------------------
 void UDPClient::SetServerPortNumber( unsigned short portNumber )
 {
+	bool wasNetworkThreadRunning = m_isNetworkThreadRunning;
+	StopNetworkThread();
+
 	m_serverAddr.sin_port = htons( portNumber );
+
+	if( wasNetworkThreadRunning )
+		StartNetworkThread();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Applies the same conditions to both directions. The network thread runs the conditioners, so it
+// is paused around the change.
+void UDPClient::SetNetworkConditions( const NetworkConditions& conditions )
+{
+	bool wasNetworkThreadRunning = m_isNetworkThreadRunning;
+	StopNetworkThread();
+
+	m_outgoingConditioner.SetConditions( conditions );
+	m_incomingConditioner.SetConditions( conditions );
+
+	if( wasNetworkThreadRunning )
+		StartNetworkThread();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+const NetworkConditions& UDPClient::GetNetworkConditions() const
+{
+	return m_outgoingConditioner.GetConditions();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// While the network thread runs, it updates the conditioners' counts, so a read can be a poll behind.
+const NetworkConditioner& UDPClient::GetOutgoingConditioner() const
+{
+	return m_outgoingConditioner;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+const NetworkConditioner& UDPClient::GetIncomingConditioner() const
+{
+	return m_incomingConditioner;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Records every datagram the game consumes or queues from here on; World adds its frames and input.
+bool UDPClient::StartCapture( const std::string& fileName )
+{
+	StopCapture();
+
+	m_capture = new PacketCaptureWriter();
+	if( m_capture->Open( fileName ) )
+		return true;
+
+	StopCapture();
+	return false;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void UDPClient::StopCapture()
+{
+	delete m_capture;
+	m_capture = nullptr;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+PacketCaptureWriter* UDPClient::GetCapture()
+{
+	return m_capture;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Offline, flushes discard what was queued and receives only return injected datagrams.
+void UDPClient::SetOffline( bool isOffline )
+{
+	m_isOffline = isOffline;
+	m_numInjectedDatagrams = 0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool UDPClient::InjectReceivedDatagram( const char* data, int numBytes )
+{
+	if( m_receiveRing == nullptr || m_receiveRingCount == RECEIVE_RING_SIZE || numBytes > MAX_DATAGRAM_SIZE_BYTES )
+		return false;
+
+	DatagramBuffer& datagram = m_receiveRing[ ( m_receiveRingReadIndex + m_receiveRingCount ) % RECEIVE_RING_SIZE ];
+	memcpy( datagram.m_data, data, numBytes );
+	datagram.m_numBytes = numBytes;
+	datagram.m_arrivalTimeSeconds = GetCurrentTimeSeconds();
+	++m_receiveRingCount;
+	++m_numInjectedDatagrams;
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Hands the socket to a new network thread. Not for offline clients, which have nothing to read.
+bool UDPClient::StartNetworkThread()
+{
+	if( m_isNetworkThreadRunning )
+		return true;
+
+	if( m_isOffline || m_receiveRing == nullptr )
+		return false;
+
+	if( m_incomingQueue == nullptr )
+		m_incomingQueue = new DatagramQueue();
+
+	if( m_outgoingQueue == nullptr )
+		m_outgoingQueue = new DatagramQueue();
+
+	// Anything already queued for a flush goes out ahead of what the thread will send
+	FlushQueuedPacketsToServer();
+
+	AtomicStore( m_isNetworkThreadQuitting, 0 );
+	m_isNetworkThreadRunning = m_networkThread.Start( NetworkThreadEntry, this );
+	return m_isNetworkThreadRunning;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// The thread sends whatever is still queued before it exits; what it had received stays queued
+// and is delivered by the next receive, ahead of the socket.
+void UDPClient::StopNetworkThread()
+{
+	if( !m_isNetworkThreadRunning )
+		return;
+
+	AtomicStore( m_isNetworkThreadQuitting, 1 );
+	m_networkThread.Join();
+	m_isNetworkThreadRunning = false;
+	m_isSocketReadable = false;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool UDPClient::IsNetworkThreadRunning() const
+{
+	return m_isNetworkThreadRunning;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+int UDPClient::GetNumOutgoingQueueDrops() const
+{
+	return m_numOutgoingQueueDrops;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC void UDPClient::NetworkThreadEntry( void* client )
+{
+	static_cast< UDPClient* >( client )->RunNetworkThread();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Wakes as soon as a datagram arrives, or every NETWORK_THREAD_WAIT_MILLISECONDS to send what the
+// game thread has queued and release what the simulated link has delivered, so conditioned traffic
+// moves within a poll of its release time rather than waiting for the next frame. When the game
+// thread falls behind and the incoming queue fills, the thread stops reading and lets the socket's
+// own buffer absorb the backlog.
+void UDPClient::RunNetworkThread()
+{
+	while( AtomicLoad( m_isNetworkThreadQuitting ) == 0 )
+	{
+		if( m_socket.WaitUntilReadable( NETWORK_THREAD_WAIT_MILLISECONDS ) && !ReceiveIntoIncomingQueue() )
+			SleepThread( NETWORK_THREAD_WAIT_MILLISECONDS * 0.001 );
+
+		ReleaseIncomingDatagrams();
+		SendOutgoingQueue();
+	}
+
+	SendOutgoingQueue();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Receives straight into the incoming queue's free slots, stamping each batch as it comes off the
+// socket. Under simulated conditions the slots are only borrowed: each datagram is handed to the
+// conditioner with its arrival time, and the slots are left free for what it releases. Returns
+// false if the queue filled before the socket was drained.
+bool UDPClient::ReceiveIntoIncomingQueue()
+{
+	char* slotBuffers[ MAX_DATAGRAMS_PER_SYSTEM_CALL ];
+	int slotNumBytes[ MAX_DATAGRAMS_PER_SYSTEM_CALL ];
+	bool isConditioned = m_incomingConditioner.IsActive();
+
+	while( true )
+	{
+		int numFreeSlots = (int) m_incomingQueue->GetNumFreeSlots();
+		if( numFreeSlots == 0 )
+			return false;
+
+		int maxDatagrams = ( numFreeSlots < MAX_DATAGRAMS_PER_SYSTEM_CALL ) ? numFreeSlots : MAX_DATAGRAMS_PER_SYSTEM_CALL;
+		for( int slotIndex = 0; slotIndex < maxDatagrams; ++slotIndex )
+		{
+			slotBuffers[ slotIndex ] = m_incomingQueue->GetWriteSlot( slotIndex ).m_data;
+		}
+
+		int numReceived = m_socket.ReceiveBatch( slotBuffers, MAX_DATAGRAM_SIZE_BYTES, slotNumBytes, nullptr, maxDatagrams );
+		double arrivalTime = GetWallClockTimeSeconds();
+		for( int slotIndex = 0; slotIndex < numReceived; ++slotIndex )
+		{
+			DatagramBuffer& datagram = m_incomingQueue->GetWriteSlot( slotIndex );
+			datagram.m_numBytes = slotNumBytes[ slotIndex ];
+			datagram.m_arrivalTimeSeconds = arrivalTime;
+			if( isConditioned )
+				m_incomingConditioner.SubmitDatagram( datagram.m_data, datagram.m_numBytes, arrivalTime );
+		}
+
+		if( !isConditioned )
+			m_incomingQueue->CommitWrites( numReceived );
+
+		if( numReceived < maxDatagrams )
+			return true;
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Moves what the simulated link has delivered by now into the incoming queue, stamped with the time
+// it was delivered. What does not fit stays held for the next poll.
+void UDPClient::ReleaseIncomingDatagrams()
+{
+	double currentTime = GetWallClockTimeSeconds();
+	unsigned int numFreeSlots = m_incomingQueue->GetNumFreeSlots();
+	unsigned int numReleased = 0;
+	while( numReleased < numFreeSlots )
+	{
+		DatagramBuffer& datagram = m_incomingQueue->GetWriteSlot( numReleased );
+		if( !m_incomingConditioner.PopReadyDatagram( currentTime, datagram.m_data, MAX_DATAGRAM_SIZE_BYTES, datagram.m_numBytes, &datagram.m_arrivalTimeSeconds ) )
+			break;
+
+		++numReleased;
+	}
+
+	m_incomingQueue->CommitWrites( numReleased );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Under simulated conditions what the game queued goes to the conditioner instead, and whatever the
+// link has released by now goes out one call each: conditioned traffic is a few datagrams a poll.
+void UDPClient::SendOutgoingQueue()
+{
+	char* datagramBuffers[ MAX_DATAGRAMS_PER_SYSTEM_CALL ];
+	int datagramNumBytes[ MAX_DATAGRAMS_PER_SYSTEM_CALL ];
+	const struct sockaddr_in* datagramAddrs[ MAX_DATAGRAMS_PER_SYSTEM_CALL ];
+	bool isConditioned = m_outgoingConditioner.IsActive();
+	double currentTime = GetWallClockTimeSeconds();
+
+	int numQueued;
+	while( ( numQueued = (int) m_outgoingQueue->GetNumReadableSlots() ) > 0 )
+	{
+		int numInBatch = ( numQueued < MAX_DATAGRAMS_PER_SYSTEM_CALL ) ? numQueued : MAX_DATAGRAMS_PER_SYSTEM_CALL;
+		for( int datagramIndex = 0; datagramIndex < numInBatch; ++datagramIndex )
+		{
+			DatagramBuffer& datagram = m_outgoingQueue->GetReadSlot( datagramIndex );
+			datagramBuffers[ datagramIndex ] = datagram.m_data;
+			datagramNumBytes[ datagramIndex ] = datagram.m_numBytes;
+			datagramAddrs[ datagramIndex ] = &m_serverAddr;
+		}
+
+		if( isConditioned )
+		{
+			for( int datagramIndex = 0; datagramIndex < numInBatch; ++datagramIndex )
+			{
+				m_outgoingConditioner.SubmitDatagram( datagramBuffers[ datagramIndex ], datagramNumBytes[ datagramIndex ], currentTime );
+			}
+		}
+		else
+		{
+			// Datagrams the socket would not take are dropped rather than retried, as on the game thread
+			m_socket.SendBatch( datagramBuffers, datagramNumBytes, datagramAddrs, numInBatch );
+		}
+
+		m_outgoingQueue->CommitReads( numInBatch );
+	}
+
+	if( !isConditioned )
+		return;
+
+	DatagramBuffer releasedDatagram;
+	while( m_outgoingConditioner.PopReadyDatagram( currentTime, releasedDatagram.m_data, MAX_DATAGRAM_SIZE_BYTES, releasedDatagram.m_numBytes ) )
+	{
+		m_socket.SendTo( releasedDatagram.m_data, releasedDatagram.m_numBytes, m_serverAddr );
+	}
 }
\ No newline at end of file
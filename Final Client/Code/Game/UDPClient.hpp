@@ -4,30 +4,134 @@
 
 //-----------------------------------------------------------------------------------------------
 #include <string>
-#include <WinSock2.h>
-#pragma comment(lib,"ws2_32.lib")
+#include "UDPSocket.hpp"
+#include "NetworkConditioner.hpp"
+#include "../Engine/SPSCQueue.hpp"
+#include "../Engine/Threading.hpp"
 
 
 //-----------------------------------------------------------------------------------------------
+class PacketCaptureWriter;
+
+
+//-----------------------------------------------------------------------------------------------
+const int MAX_DATAGRAM_SIZE_BYTES = 1472; // 1500-byte Ethernet MTU minus IP and UDP headers
+static_assert( MAX_DATAGRAM_SIZE_BYTES <= MAX_CONDITIONED_DATAGRAM_BYTES, "Every datagram must fit a conditioner slot" );
+const int RECEIVE_RING_SIZE = 128;
+const int SEND_QUEUE_SIZE = 64;
+const int DEFAULT_MAX_DATAGRAMS_PER_RECEIVE_BATCH = 32;
+const float OUTGOING_BANDWIDTH_SMOOTHING = 0.1f;
+const unsigned int NETWORK_THREAD_QUEUE_SIZE = 256;
+const int NETWORK_THREAD_WAIT_MILLISECONDS = 1;
+
+
+//-----------------------------------------------------------------------------------------------
+// Arrival time is only meaningful for received datagrams.
+struct DatagramBuffer
+{
+	char	m_data[ MAX_DATAGRAM_SIZE_BYTES ];
+	int		m_numBytes;
+	double	m_arrivalTimeSeconds;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+typedef SPSCQueue< DatagramBuffer, NETWORK_THREAD_QUEUE_SIZE > DatagramQueue;
+
+
+//-----------------------------------------------------------------------------------------------
+// Outgoing datagrams are queued and sent in batches on flush; incoming ones are received in batches
+// into a ring. Both directions can be run through a NetworkConditioner to simulate a bad network,
+// and captured to a file. An offline client never touches its socket: replays inject what it receives.
+// With the network thread running, that thread owns the socket: it drains it as datagrams arrive,
+// stamps them, and hands them over through an SPSC queue that the game thread moves into the ring;
+// flushes push onto a second queue that the thread sends from. The thread also runs both
+// conditioners, so simulated delays end by timestamp rather than by frame; capture and stats stay
+// on the game thread, which never touches the socket while the thread runs. Acks are still
+// built by the game once a frame, so the thread sharpens arrival times but a slow frame still
+// delays what the server hears back.
 class UDPClient
 {
 public:
-	UDPClient() {}
+	UDPClient();
 	bool ConnectToServer( const std::string& serverIPAddress, unsigned short serverPortNumber );
 	void DisconnectFromServer();
+	bool WaitForPacketFromServer( int timeoutMilliseconds );
 	bool ReceivePacketFromServer( char* out_packetInfo, int packetLength );
+	int ReceivePacketBatchFromServer();
+	bool PopReceivedPacket( char* out_packetInfo, int packetLength, int& out_numBytes, double* out_arrivalTimeSeconds = nullptr );
+	void SetMaxDatagramsPerReceiveBatch( int maxDatagrams );
+	int GetLastReceiveBatchSize() const;
+	float GetAverageDatagramsPerReceiveBatch() const;
+	int GetLastFlushNumDatagrams() const;
+	int GetLastFlushNumBytes() const;
+	float GetOutgoingBytesPerSecond() const;
 	bool SendPacketToServer( const char* packetInfo, int packetLength );
+	bool QueuePacketToServer( const char* packetInfo, int packetLength );
+	int FlushQueuedPacketsToServer();
 	std::string GetServerIPAddress();
 	unsigned short GetServerPortNumber();
 	void SetServerIPAddress( const std::string ipAddress );
 	void SetServerPortNumber( unsigned short portNumber );
+	void SetNetworkConditions( const NetworkConditions& conditions );
+	const NetworkConditions& GetNetworkConditions() const;
+	const NetworkConditioner& GetOutgoingConditioner() const;
+	const NetworkConditioner& GetIncomingConditioner() const;
+	bool StartCapture( const std::string& fileName );
+	void StopCapture();
+	PacketCaptureWriter* GetCapture();
+	void SetOffline( bool isOffline );
+	bool InjectReceivedDatagram( const char* data, int numBytes );
+	bool StartNetworkThread();
+	void StopNetworkThread();
+	bool IsNetworkThreadRunning() const;
+	int GetNumOutgoingQueueDrops() const;
 
 private:
-	WSADATA					m_wsaData;
-	SOCKET					m_socket;
+	UDPClient( const UDPClient& );
+	UDPClient& operator=( const UDPClient& );
+	int ReceiveDatagramBatch();
+	int ReceiveFromNetworkThread();
+	int ReceiveConditionedDatagrams();
+	int SendConditionedDatagrams();
+	int SendDatagramBatch( char* const* datagramBuffers, const int* datagramNumBytes, int numDatagrams );
+
+	// Called from the network thread
+	static void NetworkThreadEntry( void* client );
+	void RunNetworkThread();
+	bool ReceiveIntoIncomingQueue();
+	void ReleaseIncomingDatagrams();
+	void SendOutgoingQueue();
+
+	UDPSocket				m_socket;
 	struct sockaddr_in		m_serverAddr;
 	std::string				m_serverIPAddress;
 	unsigned short			m_serverPortNumber;
+	bool					m_isSocketReadable;
+	DatagramBuffer*			m_receiveRing;
+	int						m_receiveRingReadIndex;
+	int						m_receiveRingCount;
+	int						m_maxDatagramsPerReceiveBatch;
+	int						m_lastReceiveBatchSize;
+	unsigned int			m_numReceiveBatches;
+	unsigned int			m_numDatagramsReceived;
+	DatagramBuffer*			m_sendQueue;
+	int						m_sendQueueCount;
+	int						m_lastFlushNumDatagrams;
+	int						m_lastFlushNumBytes;
+	double					m_timeOfLastFlush;
+	float					m_outgoingBytesPerSecond;
+	NetworkConditioner		m_outgoingConditioner;
+	NetworkConditioner		m_incomingConditioner;
+	PacketCaptureWriter*	m_capture;
+	bool					m_isOffline;
+	int						m_numInjectedDatagrams;
+	DatagramQueue*			m_incomingQueue;
+	DatagramQueue*			m_outgoingQueue;
+	Thread					m_networkThread;
+	volatile int			m_isNetworkThreadQuitting;
+	bool					m_isNetworkThreadRunning;
+	int						m_numOutgoingQueueDrops;
 };
 
 
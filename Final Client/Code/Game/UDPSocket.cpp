@@ -0,0 +1,387 @@
+#include "UDPSocket.hpp"
+#include <string.h>
+#include "GameCommon.hpp"
+#if !defined( _WIN32 )
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+#include "../Engine/NewMacroDef.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+UDPSocket::UDPSocket()
+	: m_socket( INVALID_SOCKET_HANDLE )
+#if !defined( _WIN32 )
+	, m_epollHandle( -1 )
+	, m_wakeHandle( -1 )
+#endif
+{
+
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC bool UDPSocket::StartupNetworking()
+{
+#if defined( _WIN32 )
+	WSADATA wsaData;
+	if( WSAStartup( 0x202, &wsaData ) != 0 )
+	{
+		return false;
+	}
+#endif
+
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC void UDPSocket::ShutdownNetworking()
+{
+#if defined( _WIN32 )
+	WSACleanup();
+#endif
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool UDPSocket::Open()
+{
+	m_socket = socket( AF_INET, SOCK_DGRAM, IPPROTO_UDP );
+	if( m_socket == INVALID_SOCKET_HANDLE )
+	{
+		return false;
+	}
+
+	if( !SetNonBlocking() )
+	{
+		Close();
+		return false;
+	}
+
+#if !defined( _WIN32 )
+	m_epollHandle = epoll_create1( 0 );
+	if( m_epollHandle < 0 )
+	{
+		Close();
+		return false;
+	}
+
+	struct epoll_event readEvent;
+	readEvent.events = EPOLLIN;
+	readEvent.data.fd = m_socket;
+	if( epoll_ctl( m_epollHandle, EPOLL_CTL_ADD, m_socket, &readEvent ) < 0 )
+	{
+		Close();
+		return false;
+	}
+
+	m_wakeHandle = eventfd( 0, EFD_NONBLOCK );
+	if( m_wakeHandle < 0 )
+	{
+		Close();
+		return false;
+	}
+
+	struct epoll_event wakeEvent;
+	wakeEvent.events = EPOLLIN;
+	wakeEvent.data.fd = m_wakeHandle;
+	if( epoll_ctl( m_epollHandle, EPOLL_CTL_ADD, m_wakeHandle, &wakeEvent ) < 0 )
+	{
+		Close();
+		return false;
+	}
+#endif
+
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Must come before Bind. Every socket bound to the port with this set gets its own receive queue;
+// the kernel hashes each sender's address onto one of them, so a client always lands on the same one.
+bool UDPSocket::EnableReusePort()
+{
+#if defined( SO_REUSEPORT )
+	int isEnabled = 1;
+	if( setsockopt( m_socket, SOL_SOCKET, SO_REUSEPORT, (const char*) &isEnabled, sizeof( isEnabled ) ) < 0 )
+	{
+		return false;
+	}
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Servers bind to a known port on every interface; clients let the first sendto pick one.
+bool UDPSocket::Bind( unsigned short portNumber )
+{
+	struct sockaddr_in bindAddr;
+	memset( &bindAddr, 0, sizeof( bindAddr ) );
+	bindAddr.sin_family = AF_INET;
+	bindAddr.sin_addr.s_addr = htonl( INADDR_ANY );
+	bindAddr.sin_port = htons( portNumber );
+
+	if( bind( m_socket, (const struct sockaddr*) &bindAddr, sizeof( bindAddr ) ) < 0 )
+	{
+		return false;
+	}
+
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Grows the kernel's send and receive queues so a burst from many peers is not dropped between
+// two reads. The kernel may clamp the request (net.core.rmem_max on Linux).
+bool UDPSocket::SetBufferSizes( int numBytes )
+{
+	if( setsockopt( m_socket, SOL_SOCKET, SO_RCVBUF, (const char*) &numBytes, sizeof( numBytes ) ) < 0 )
+	{
+		return false;
+	}
+
+	if( setsockopt( m_socket, SOL_SOCKET, SO_SNDBUF, (const char*) &numBytes, sizeof( numBytes ) ) < 0 )
+	{
+		return false;
+	}
+
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void UDPSocket::Close()
+{
+#if defined( _WIN32 )
+	if( m_socket != INVALID_SOCKET_HANDLE )
+		closesocket( m_socket );
+#else
+	if( m_epollHandle >= 0 )
+		close( m_epollHandle );
+
+	if( m_wakeHandle >= 0 )
+		close( m_wakeHandle );
+
+	if( m_socket != INVALID_SOCKET_HANDLE )
+		close( m_socket );
+
+	m_epollHandle = -1;
+	m_wakeHandle = -1;
+#endif
+
+	m_socket = INVALID_SOCKET_HANDLE;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool UDPSocket::IsOpen() const
+{
+	return m_socket != INVALID_SOCKET_HANDLE;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Blocks for up to timeoutMilliseconds (0 = poll, -1 = forever) until a datagram is waiting or
+// another thread calls Wake.
+bool UDPSocket::WaitUntilReadable( int timeoutMilliseconds )
+{
+	if( !IsOpen() )
+		return false;
+
+#if defined( _WIN32 )
+	fd_set readSet;
+	FD_ZERO( &readSet );
+	FD_SET( m_socket, &readSet );
+
+	struct timeval timeout;
+	timeout.tv_sec = timeoutMilliseconds / 1000;
+	timeout.tv_usec = ( timeoutMilliseconds % 1000 ) * 1000;
+
+	int numReady = select( 0, &readSet, nullptr, nullptr, ( timeoutMilliseconds < 0 ) ? nullptr : &timeout );
+	return numReady > 0;
+#else
+	struct epoll_event readyEvents[ 2 ];
+	int numReady = epoll_wait( m_epollHandle, readyEvents, 2, timeoutMilliseconds );
+	for( int eventIndex = 0; eventIndex < numReady; ++eventIndex )
+	{
+		if( readyEvents[ eventIndex ].data.fd != m_wakeHandle )
+			continue;
+
+		eventfd_t numWakes;
+		eventfd_read( m_wakeHandle, &numWakes );
+	}
+
+	return numReady > 0;
+#endif
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Safe from any thread. Windows builds only run the server single-threaded, so it does nothing there.
+void UDPSocket::Wake()
+{
+#if !defined( _WIN32 )
+	if( m_wakeHandle >= 0 )
+		eventfd_write( m_wakeHandle, 1 );
+#endif
+}
+
+
+//-----------------------------------------------------------------------------------------------
+int UDPSocket::ReceiveFrom( char* out_buffer, int bufferLength, struct sockaddr_in* out_fromAddr )
+{
+	SocketAddressLength fromLength = sizeof( *out_fromAddr );
+	int numBytesReceived = recvfrom( m_socket, out_buffer, bufferLength, 0, (struct sockaddr*) out_fromAddr, &fromLength );
+	if( numBytesReceived < 0 )
+	{
+		return -1;
+	}
+
+	return numBytesReceived;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Drains up to maxDatagrams waiting datagrams in one recvmmsg() call (a recvfrom loop on Windows).
+// Returns the number of buffers filled; out_numBytesReceived holds each datagram's length.
+// out_fromAddrs may be nullptr when the sender does not matter.
+int UDPSocket::ReceiveBatch( char** out_buffers, int bufferLength, int* out_numBytesReceived, struct sockaddr_in* out_fromAddrs, int maxDatagrams )
+{
+	if( maxDatagrams > MAX_DATAGRAMS_PER_SYSTEM_CALL )
+		maxDatagrams = MAX_DATAGRAMS_PER_SYSTEM_CALL;
+
+#if defined( _WIN32 )
+	int numDatagrams = 0;
+	while( numDatagrams < maxDatagrams )
+	{
+		struct sockaddr_in fromAddr;
+		int numBytesReceived = ReceiveFrom( out_buffers[ numDatagrams ], bufferLength, ( out_fromAddrs != nullptr ) ? &out_fromAddrs[ numDatagrams ] : &fromAddr );
+		if( numBytesReceived < 0 )
+			break;
+
+		out_numBytesReceived[ numDatagrams ] = numBytesReceived;
+		++numDatagrams;
+	}
+
+	return numDatagrams;
+#else
+	struct mmsghdr messages[ MAX_DATAGRAMS_PER_SYSTEM_CALL ];
+	struct iovec messageBuffers[ MAX_DATAGRAMS_PER_SYSTEM_CALL ];
+	memset( messages, 0, sizeof( messages[ 0 ] ) * maxDatagrams );
+
+	for( int messageIndex = 0; messageIndex < maxDatagrams; ++messageIndex )
+	{
+		messageBuffers[ messageIndex ].iov_base = out_buffers[ messageIndex ];
+		messageBuffers[ messageIndex ].iov_len = bufferLength;
+		messages[ messageIndex ].msg_hdr.msg_iov = &messageBuffers[ messageIndex ];
+		messages[ messageIndex ].msg_hdr.msg_iovlen = 1;
+
+		if( out_fromAddrs != nullptr )
+		{
+			messages[ messageIndex ].msg_hdr.msg_name = &out_fromAddrs[ messageIndex ];
+			messages[ messageIndex ].msg_hdr.msg_namelen = sizeof( out_fromAddrs[ messageIndex ] );
+		}
+	}
+
+	int numDatagrams = recvmmsg( m_socket, messages, maxDatagrams, MSG_DONTWAIT, nullptr );
+	if( numDatagrams < 0 )
+	{
+		return 0;
+	}
+
+	for( int messageIndex = 0; messageIndex < numDatagrams; ++messageIndex )
+	{
+		out_numBytesReceived[ messageIndex ] = (int) messages[ messageIndex ].msg_len;
+	}
+
+	return numDatagrams;
+#endif
+}
+
+
+//-----------------------------------------------------------------------------------------------
+int UDPSocket::SendTo( const char* buffer, int bufferLength, const struct sockaddr_in& toAddr )
+{
+	int numBytesSent = sendto( m_socket, buffer, bufferLength, 0, (const struct sockaddr*) &toAddr, sizeof( toAddr ) );
+	if( numBytesSent < 0 )
+	{
+		return -1;
+	}
+
+	return numBytesSent;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Sends numDatagrams datagrams with as few sendmmsg() calls as possible, falling back to a sendto
+// loop on Windows or when the kernel rejects sendmmsg. Returns the number of datagrams handed off.
+int UDPSocket::SendBatch( char* const* buffers, const int* numBytesToSend, const struct sockaddr_in* const* toAddrs, int numDatagrams )
+{
+	int numDatagramsSent = 0;
+
+#if !defined( _WIN32 )
+	struct mmsghdr messages[ MAX_DATAGRAMS_PER_SYSTEM_CALL ];
+	struct iovec messageBuffers[ MAX_DATAGRAMS_PER_SYSTEM_CALL ];
+
+	while( numDatagramsSent < numDatagrams )
+	{
+		int numInCall = numDatagrams - numDatagramsSent;
+		if( numInCall > MAX_DATAGRAMS_PER_SYSTEM_CALL )
+			numInCall = MAX_DATAGRAMS_PER_SYSTEM_CALL;
+
+		memset( messages, 0, sizeof( messages[ 0 ] ) * numInCall );
+		for( int messageIndex = 0; messageIndex < numInCall; ++messageIndex )
+		{
+			int datagramIndex = numDatagramsSent + messageIndex;
+			messageBuffers[ messageIndex ].iov_base = buffers[ datagramIndex ];
+			messageBuffers[ messageIndex ].iov_len = numBytesToSend[ datagramIndex ];
+			messages[ messageIndex ].msg_hdr.msg_iov = &messageBuffers[ messageIndex ];
+			messages[ messageIndex ].msg_hdr.msg_iovlen = 1;
+			messages[ messageIndex ].msg_hdr.msg_name = (void*) toAddrs[ datagramIndex ];
+			messages[ messageIndex ].msg_hdr.msg_namelen = sizeof( *toAddrs[ datagramIndex ] );
+		}
+
+		int numSentInCall = sendmmsg( m_socket, messages, numInCall, 0 );
+		if( numSentInCall <= 0 )
+			break;
+
+		numDatagramsSent += numSentInCall;
+	}
+#endif
+
+	for( ; numDatagramsSent < numDatagrams; ++numDatagramsSent )
+	{
+		if( SendTo( buffers[ numDatagramsSent ], numBytesToSend[ numDatagramsSent ], *toAddrs[ numDatagramsSent ] ) < 0 )
+			break;
+	}
+
+	return numDatagramsSent;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool UDPSocket::SetNonBlocking()
+{
+#if defined( _WIN32 )
+	u_long mode = 1;
+	if( ioctlsocket( m_socket, FIONBIO, &mode ) == SOCKET_ERROR )
+	{
+		return false;
+	}
+#else
+	int flags = fcntl( m_socket, F_GETFL, 0 );
+	if( flags < 0 || fcntl( m_socket, F_SETFL, flags | O_NONBLOCK ) < 0 )
+	{
+		return false;
+	}
+#endif
+
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,65 @@
+#ifndef include_UDPSocket
+#define include_UDPSocket
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#if defined( _WIN32 )
+#include <WinSock2.h>
+#pragma comment(lib,"ws2_32.lib")
+#else
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#endif
+
+
+//-----------------------------------------------------------------------------------------------
+#if defined( _WIN32 )
+typedef SOCKET SocketHandle;
+typedef int SocketAddressLength;
+const SocketHandle INVALID_SOCKET_HANDLE = INVALID_SOCKET;
+#else
+typedef int SocketHandle;
+typedef socklen_t SocketAddressLength;
+const SocketHandle INVALID_SOCKET_HANDLE = -1;
+#endif
+
+
+//-----------------------------------------------------------------------------------------------
+const int MAX_DATAGRAMS_PER_SYSTEM_CALL = 64;
+
+
+//-----------------------------------------------------------------------------------------------
+// Thin non-blocking UDP socket. WinSock2 + select() on Windows, BSD sockets + epoll elsewhere.
+class UDPSocket
+{
+public:
+	UDPSocket();
+	static bool StartupNetworking();
+	static void ShutdownNetworking();
+	bool Open();
+	bool EnableReusePort();
+	bool Bind( unsigned short portNumber );
+	bool SetBufferSizes( int numBytes );
+	void Close();
+	bool IsOpen() const;
+	bool WaitUntilReadable( int timeoutMilliseconds );
+	void Wake();
+	int ReceiveFrom( char* out_buffer, int bufferLength, struct sockaddr_in* out_fromAddr );
+	int ReceiveBatch( char** out_buffers, int bufferLength, int* out_numBytesReceived, struct sockaddr_in* out_fromAddrs, int maxDatagrams );
+	int SendTo( const char* buffer, int bufferLength, const struct sockaddr_in& toAddr );
+	int SendBatch( char* const* buffers, const int* numBytesToSend, const struct sockaddr_in* const* toAddrs, int numDatagrams );
+
+private:
+	bool SetNonBlocking();
+
+	SocketHandle	m_socket;
+#if !defined( _WIN32 )
+	int				m_epollHandle;
+	int				m_wakeHandle;
+#endif
+};
+
+
+#endif // include_UDPSocket
\ No newline at end of file
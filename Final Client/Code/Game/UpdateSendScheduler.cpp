@@ -0,0 +1,121 @@
+#include "UpdateSendScheduler.hpp"
+#if defined( _WIN32 )
+#include "../Engine/ProfileSection.hpp"
+#endif
+#include "../Engine/NewMacroDef.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+UpdateSendScheduler::UpdateSendScheduler()
+	: m_budgetBytesPerSecond( DEFAULT_UPDATE_BANDWIDTH_BUDGET_BYTES_PER_SECOND )
+	, m_availableBudgetBytes( DEFAULT_UPDATE_BANDWIDTH_BUDGET_BYTES_PER_SECOND * UPDATE_BANDWIDTH_BURST_SECONDS )
+	, m_timeOfLastBudgetRefill( 0.0 )
+	, m_timeOfLastSend( 0.0 )
+	, m_lastSendIntervalSeconds( 0.0 )
+	, m_hasInputChanged( false )
+	, m_isProfilingEnabled( true )
+{
+
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Turn start/stop, throttle changes and firing all make the next update urgent.
+void UpdateSendScheduler::NotifyInputChanged()
+{
+	m_hasInputChanged = true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool UpdateSendScheduler::ShouldSendUpdate( double currentTimeSeconds, bool isMoving )
+{
+	RefillBudget( currentTimeSeconds );
+
+	double secondsSinceLastSend = currentTimeSeconds - m_timeOfLastSend;
+	if( secondsSinceLastSend < MIN_SECONDS_BETWEEN_UPDATES )
+		return false;
+
+	// The heartbeat keeps the connection alive and goes out even when the budget is spent
+	if( secondsSinceLastSend >= HEARTBEAT_SECONDS_BETWEEN_UPDATES )
+		return true;
+
+	if( m_availableBudgetBytes <= 0.0 )
+		return false;
+
+	if( m_hasInputChanged )
+		return true;
+
+	return isMoving && secondsSinceLastSend >= ACTIVE_SECONDS_BETWEEN_UPDATES;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void UpdateSendScheduler::OnUpdateSent( double currentTimeSeconds, int numBytes )
+{
+	RefillBudget( currentTimeSeconds );
+	m_availableBudgetBytes -= numBytes;
+
+	if( m_timeOfLastSend > 0.0 )
+	{
+		m_lastSendIntervalSeconds = currentTimeSeconds - m_timeOfLastSend;
+#if defined( _WIN32 )
+		if( m_isProfilingEnabled )
+			ProfileSection::RecordSample( UPDATE_SEND_INTERVAL_PROFILE_NAME, m_lastSendIntervalSeconds );
+#endif
+	}
+
+	m_timeOfLastSend = currentTimeSeconds;
+	m_hasInputChanged = false;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Spends budget without counting as an update, so the send interval and urgency are untouched.
+void UpdateSendScheduler::ChargeBudget( double currentTimeSeconds, int numBytes )
+{
+	RefillBudget( currentTimeSeconds );
+	m_availableBudgetBytes -= numBytes;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void UpdateSendScheduler::SetBandwidthBudget( int bytesPerSecond )
+{
+	m_budgetBytesPerSecond = bytesPerSecond;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+int UpdateSendScheduler::GetBandwidthBudget() const
+{
+	return m_budgetBytesPerSecond;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// The profile registry is shared and unsynchronized, so schedulers stepped off the main thread
+// (headless bots) must not record into it.
+void UpdateSendScheduler::SetProfilingEnabled( bool isProfilingEnabled )
+{
+	m_isProfilingEnabled = isProfilingEnabled;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+double UpdateSendScheduler::GetLastSendIntervalSeconds() const
+{
+	return m_lastSendIntervalSeconds;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void UpdateSendScheduler::RefillBudget( double currentTimeSeconds )
+{
+	double maxBudgetBytes = m_budgetBytesPerSecond * UPDATE_BANDWIDTH_BURST_SECONDS;
+	m_availableBudgetBytes += ( currentTimeSeconds - m_timeOfLastBudgetRefill ) * m_budgetBytesPerSecond;
+	if( m_availableBudgetBytes > maxBudgetBytes )
+		m_availableBudgetBytes = maxBudgetBytes;
+
+	m_timeOfLastBudgetRefill = currentTimeSeconds;
+}
\ No newline at end of file
@@ -0,0 +1,49 @@
+#ifndef include_UpdateSendScheduler
+#define include_UpdateSendScheduler
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include <string>
+
+
+//-----------------------------------------------------------------------------------------------
+const double MIN_SECONDS_BETWEEN_UPDATES = 1.0 / 60.0;
+const double ACTIVE_SECONDS_BETWEEN_UPDATES = 0.05;
+const double HEARTBEAT_SECONDS_BETWEEN_UPDATES = 0.25;
+const int DEFAULT_UPDATE_BANDWIDTH_BUDGET_BYTES_PER_SECOND = 2048;
+const double UPDATE_BANDWIDTH_BURST_SECONDS = 0.25;
+const std::string UPDATE_SEND_INTERVAL_PROFILE_NAME = "Update Send Interval";
+
+
+//-----------------------------------------------------------------------------------------------
+// Decides when World sends its next GameUpdate/KeepAlive: right away when the player's input
+// changes, at ACTIVE_SECONDS_BETWEEN_UPDATES while moving, at the heartbeat while idle, and never
+// faster than a token bucket refilled at the bandwidth budget allows. Traffic that is not an update,
+// such as ack-only datagrams, is charged to the same bucket.
+class UpdateSendScheduler
+{
+public:
+	UpdateSendScheduler();
+	void NotifyInputChanged();
+	bool ShouldSendUpdate( double currentTimeSeconds, bool isMoving );
+	void OnUpdateSent( double currentTimeSeconds, int numBytes );
+	void ChargeBudget( double currentTimeSeconds, int numBytes );
+	void SetBandwidthBudget( int bytesPerSecond );
+	int GetBandwidthBudget() const;
+	void SetProfilingEnabled( bool isProfilingEnabled );
+	double GetLastSendIntervalSeconds() const;
+
+private:
+	void RefillBudget( double currentTimeSeconds );
+
+	int		m_budgetBytesPerSecond;
+	double	m_availableBudgetBytes;
+	double	m_timeOfLastBudgetRefill;
+	double	m_timeOfLastSend;
+	double	m_lastSendIntervalSeconds;
+	bool	m_hasInputChanged;
+	bool	m_isProfilingEnabled;
+};
+
+
+#endif // include_UpdateSendScheduler
\ No newline at end of file
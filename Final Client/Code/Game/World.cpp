@@ -1,18 +1,106 @@
 #include "World.hpp"
+#include <string.h>
+#include "PacketCapture.hpp"
 #include "../Engine/Time.hpp"
+#if defined( _WIN32 )
 #include "../Engine/EventSystem.hpp"
+#include "../Engine/ProfileSection.hpp"
 #include "../Engine/DeveloperConsole.hpp"
+#endif
 #include "../Engine/NewMacroDef.hpp"
 
 //-----------------------------------------------------------------------------------------------
-World::World( float worldWidth, float worldHeight )
+WorldTrafficStats::WorldTrafficStats()
+	: m_numGuaranteedPacketsSent( 0 )
+	, m_numRetransmissions( 0 )
+	, m_numEncodedUpdateFallbacks( 0 )
+	, m_numReliabilityWindowOverflows( 0 )
+	, m_numPacketsReceived( 0 )
+	, m_hasReceivedAnyPacket( false )
+	, m_firstReceivedNumber( 0 )
+	, m_newestReceivedNumber( 0 )
+	, m_numCreateRoomRequests( 0 )
+	, m_numJoinRoomRequests( 0 )
+	, m_numGamesEntered( 0 )
+	, m_numShotsFired( 0 )
+	, m_numHitsLanded( 0 )
+	, m_numHitsTaken( 0 )
+	, m_numRespawns( 0 )
+{
+
+}
+
+
+//-----------------------------------------------------------------------------------------------
+PredictionErrorStats::PredictionErrorStats()
+	: m_numSamples( 0 )
+	, m_totalError( 0.0 )
+	, m_maxError( 0.f )
+	, m_newestRecentIndex( PREDICTION_ERROR_HISTORY_SIZE - 1 )
+{
+	memset( m_recentErrors, 0, sizeof( m_recentErrors ) );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void PredictionErrorStats::AddSample( float errorDistance )
+{
+	m_newestRecentIndex = ( m_newestRecentIndex + 1 ) % PREDICTION_ERROR_HISTORY_SIZE;
+	m_recentErrors[ m_newestRecentIndex ] = errorDistance;
+	m_totalError += errorDistance;
+	if( errorDistance > m_maxError )
+		m_maxError = errorDistance;
+
+	++m_numSamples;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+float PredictionErrorStats::GetAverageError() const
+{
+	if( m_numSamples == 0 )
+		return 0.f;
+
+	return (float) ( m_totalError / m_numSamples );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+World::World( float worldWidth, float worldHeight, bool isHeadless )
+#if defined( _WIN32 )
+	: m_wallTexture( nullptr )
+	, m_floorTexture( nullptr )
+	, m_size( worldWidth, worldHeight )
+#else
 	: m_size( worldWidth, worldHeight )
+#endif
 	, m_mainPlayer( nullptr )
 	, m_nextPacketNumber( 0 )
+	, m_isHeadless( isHeadless )
+	, m_isProfilingEnabled( !isHeadless )
+	, m_buttonRequestedRoom( ROOM_None )
+	, m_remoteTankSmoothing( SMOOTHING_DeadReckoning )
+	, m_interpolationDelaySeconds( DEFAULT_INTERPOLATION_DELAY_SECONDS )
+	, m_interpolationRenderTime( 0.0 )
+	, m_convergenceSeconds( DEFAULT_CONVERGENCE_SECONDS )
+	, m_isPredictionErrorGraphVisible( false )
 	, m_isInLobby( false )
 	, m_isInGame( false )
+	, m_useCompactWireFormat( false )
+	, m_isCoalescingNegotiated( false )
+	, m_isSelectiveAckNegotiated( false )
+	, m_isServerMovementNegotiated( false )
+	, m_turnDirection( 0 )
+	, m_throttleSpeed( 0.f )
+	, m_spawnPacketNumber( 0 )
+	, m_reliabilityWindow( isHeadless ? HEADLESS_RELIABILITY_WINDOW_CAPACITY : RELIABILITY_WINDOW_CAPACITY )
+	, m_receivedSnapshots( SNAPSHOT_HISTORY_MAX_SENDERS )
+	, m_deltaBaselineNumber( 0 )
+	, m_hasDeltaBaseline( false )
+	, m_numUpdatesSinceBaselineAck( 0 )
 {
-
+	memset( m_playersPerRoom, 0, sizeof( m_playersPerRoom ) );
+	m_updateScheduler.SetProfilingEnabled( m_isProfilingEnabled );
 }
 
 
@@ -21,13 +109,25 @@ void World::Initialize()
 {
 	InitializeTime();
 	m_client.ConnectToServer( IP_ADDRESS, PORT_NUMBER );
-	m_timeOfLastUpdateSend = GetCurrentTimeSeconds();
 
-	m_hudFont = BitmapFont( HUD_FONT_GLYPH_SHEET_FILE_NAME, HUD_FONT_META_DATA_FILE_NAME );
-	InitializeButtons();
+#if defined( _WIN32 )
+	if( !m_isHeadless )
+	{
+		m_hudFont = BitmapFont( HUD_FONT_GLYPH_SHEET_FILE_NAME, HUD_FONT_META_DATA_FILE_NAME );
+		InitializeButtons();
 
-	m_wallTexture = Texture::CreateOrGetTexture( WALL_TEXTURE_FILE_NAME );
-	m_floorTexture = Texture::CreateOrGetTexture( FLOOR_TEXTURE_FILE_NAME );
+		m_wallTexture = Texture::CreateOrGetTexture( WALL_TEXTURE_FILE_NAME );
+		m_floorTexture = Texture::CreateOrGetTexture( FLOOR_TEXTURE_FILE_NAME );
+	}
+	else
+	{
+		HideButtons();
+	}
+#endif
+
+	// Headless bots run hundreds of clients per process, so only the windowed client gets a thread
+	if( !m_isHeadless )
+		m_client.StartNetworkThread();
 
 	m_mainPlayer = new Tank();
 	m_mainPlayer->m_currentPosition = Vector3( ARENA_FLOOR_SIZE_X * 0.5f, ARENA_FLOOR_SIZE_Y * 0.5f, 1.f );
@@ -51,6 +151,14 @@ void World::Initialize()
 void World::Destruct()
 {
 	m_client.DisconnectFromServer();
+
+	for( unsigned int tankIndex = 0; tankIndex < m_tanks.size(); ++tankIndex )
+	{
+		delete m_tanks[ tankIndex ];
+	}
+
+	m_tanks.clear();
+	m_mainPlayer = nullptr;
 }
 
 
@@ -58,6 +166,8 @@ void World::Destruct()
 void World::ChangeIPAddress( const std::string& ipAddrString )
 {
 	m_client.SetServerIPAddress( ipAddrString );
+	m_clockSynchronizer.Reset();
+	ForgetNegotiatedCapabilities();
 }
 
 
@@ -65,6 +175,172 @@ void World::ChangeIPAddress( const std::string& ipAddrString )
 void World::ChangePortNumber( unsigned short portNumber )
 {
 	m_client.SetServerPortNumber( portNumber );
+	m_clockSynchronizer.Reset();
+	ForgetNegotiatedCapabilities();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// A different server may be an older one: nothing it has not told us itself can be assumed, and
+// whatever was batched for the old one is dropped rather than sent in a format the new one may not read.
+void World::ForgetNegotiatedCapabilities()
+{
+	m_isCoalescingNegotiated = false;
+	m_isSelectiveAckNegotiated = false;
+	m_isServerMovementNegotiated = false;
+	m_coalescer.Reset();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+UDPClient& World::GetClient()
+{
+	return m_client;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+const RoundTripEstimator& World::GetRoundTripEstimator() const
+{
+	return m_roundTripEstimator;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+const ClockSynchronizer& World::GetClockSynchronizer() const
+{
+	return m_clockSynchronizer;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+const TankPredictor& World::GetTankPredictor() const
+{
+	return m_tankPredictor;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool World::IsServerMovementNegotiated() const
+{
+	return m_isServerMovementNegotiated;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void World::SetCompactWireFormat( bool useCompactWireFormat )
+{
+	m_useCompactWireFormat = useCompactWireFormat;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+UpdateSendScheduler& World::GetUpdateScheduler()
+{
+	return m_updateScheduler;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// The profile registry is only safe to touch from the main thread, so headless Worlds start with
+// profiling off; a replay on the main thread turns it back on.
+void World::SetProfilingEnabled( bool isProfilingEnabled )
+{
+	m_isProfilingEnabled = isProfilingEnabled;
+	m_updateScheduler.SetProfilingEnabled( isProfilingEnabled );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void World::SetRemoteTankSmoothing( RemoteTankSmoothing smoothing )
+{
+	m_remoteTankSmoothing = smoothing;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+RemoteTankSmoothing World::GetRemoteTankSmoothing() const
+{
+	return m_remoteTankSmoothing;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Should cover at least one update interval plus jitter, or tanks spend time extrapolated.
+void World::SetInterpolationDelaySeconds( double delaySeconds )
+{
+	m_interpolationDelaySeconds = ( delaySeconds > 0.0 ) ? delaySeconds : 0.0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+double World::GetInterpolationDelaySeconds() const
+{
+	return m_interpolationDelaySeconds;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+const PredictionErrorStats& World::GetPredictionErrorStats() const
+{
+	return m_predictionErrors;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void World::ResetPredictionErrorStats()
+{
+	m_predictionErrors = PredictionErrorStats();
+
+	for( unsigned int tankIndex = 0; tankIndex < m_tanks.size(); ++tankIndex )
+	{
+		m_tanks[ tankIndex ]->m_positionError = TankPositionError();
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void World::SetPredictionErrorGraphVisible( bool isVisible )
+{
+	m_isPredictionErrorGraphVisible = isVisible;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Zero snaps dead-reckoned tanks straight onto each correction, as before convergence existed.
+void World::SetConvergenceSeconds( double convergenceSeconds )
+{
+	m_convergenceSeconds = ( convergenceSeconds > 0.0 ) ? convergenceSeconds : 0.0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+double World::GetConvergenceSeconds() const
+{
+	return m_convergenceSeconds;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void World::GetTankPositionErrors( std::vector< TankPositionError >& out_errors ) const
+{
+	out_errors.clear();
+	for( unsigned int tankIndex = 0; tankIndex < m_tanks.size(); ++tankIndex )
+	{
+		const Tank* tank = m_tanks[ tankIndex ];
+		if( tank == m_mainPlayer )
+			continue;
+
+		out_errors.push_back( tank->m_positionError );
+		out_errors.back().m_playerID = tank->m_playerID;
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+const WorldTrafficStats& World::GetTrafficStats() const
+{
+	return m_trafficStats;
 }
 
 
@@ -82,17 +358,26 @@ Camera World::GetFirstPersonCamera()
 }
 
 
+//-----------------------------------------------------------------------------------------------
+// Headless update: no widgets, and rooms are requested by the input source instead of buttons.
+void World::Update( float deltaSeconds, TankInputSource& inputSource )
+{
+	UpdateNetworkAndSimulation( deltaSeconds, inputSource );
+	FlushOutgoingPackets();
+}
+
+
+#if defined( _WIN32 )
 //-----------------------------------------------------------------------------------------------
 void World::Update( float deltaSeconds, const Keyboard& keyboard, const Mouse& mouse )
 {
-	ReceivePackets();
-	RemoveTimedOutPlayers();
-	UpdateFromInput( keyboard, mouse, deltaSeconds );
-	ApplyDeadReckoning();
-	SendUpdate();
-	ResendGuaranteedPackets();
+	KeyboardTankInput keyboardInput( keyboard );
+	UpdateNetworkAndSimulation( deltaSeconds, keyboardInput );
 
+	// A lobby button press becomes part of next frame's input, so captures replay it too
 	Widget::UpdateAllWidgets( deltaSeconds, mouse, keyboard );
+
+	FlushOutgoingPackets();
 }
 
 
@@ -122,6 +407,8 @@ void World::RenderObjects2D()
 	if( m_isInGame )
 	{
 		OpenGLRenderer::RenderText( "Score: " + ConvertNumberToString( m_mainPlayer->m_score ), m_hudFont, HUD_FONT_CELL_HEIGHT, Vector2( 50.f, 800.f ) );
+		if( m_isPredictionErrorGraphVisible )
+			RenderPredictionErrorGraph();
 	}
 
 	Widget::RenderAllWidgets();
@@ -144,6 +431,16 @@ void World::InitializeButtons()
 }
 
 
+//-----------------------------------------------------------------------------------------------
+void World::JoinOrCreateRoom( const NamedProperties& params )
+{
+	unsigned char roomNumber;
+	params.GetProperty( "roomNumber", roomNumber );
+	m_buttonRequestedRoom = roomNumber;
+}
+#endif
+
+
 //-----------------------------------------------------------------------------------------------
 Color World::GetIndividualTankColor( unsigned char playerID )
 {
@@ -155,13 +452,12 @@ Color World::GetIndividualTankColor( unsigned char playerID )
 
 
 //-----------------------------------------------------------------------------------------------
-void World::JoinOrCreateRoom( const NamedProperties& params )
+void World::RequestRoom( RoomID roomNumber )
 {
-	unsigned char roomNumber;
-	unsigned char numPlayersInRoom;
-	params.GetProperty( "roomNumber", roomNumber );
+	if( roomNumber == ROOM_Lobby || roomNumber > MAX_NUMBER_OF_ROOMS )
+		return;
 
-	numPlayersInRoom = m_playersPerRoom[ roomNumber - 1 ];
+	unsigned char numPlayersInRoom = m_playersPerRoom[ roomNumber - 1 ];
 	if( numPlayersInRoom == MAX_NUMBER_OF_PLAYERS_PER_ROOM )
 		return;
 
@@ -173,15 +469,102 @@ void World::JoinOrCreateRoom( const NamedProperties& params )
 
 
 //-----------------------------------------------------------------------------------------------
-void World::SendPacket( const FinalPacket& packet )
+int World::SendPacket( const FinalPacket& packet )
 {
-	m_client.SendPacketToServer( (const char*) &packet, sizeof( packet ) );
+	int numBytesSent = TransmitPacket( packet );
 	++m_nextPacketNumber;
 
 	if( packet.IsGuaranteed() )
 	{
-		m_sentPackets.push_back( packet );
+		++m_trafficStats.m_numGuaranteedPacketsSent;
+		double currentTime = GetCurrentTimeSeconds();
+		if( !m_reliabilityWindow.AddPacket( packet, currentTime, currentTime + m_roundTripEstimator.GetRetransmissionTimeoutSeconds() ) )
+			++m_trafficStats.m_numReliabilityWindowOverflows;
 	}
+
+	return numBytesSent;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Puts the packet on the wire as-is; retransmits come through here so they keep their number.
+// Returns the payload bytes the packet takes up (datagram headers are not counted).
+int World::TransmitPacket( const FinalPacket& packet )
+{
+	if( m_isCoalescingNegotiated )
+	{
+		int sizeBeforeAdd = m_coalescer.GetDatagramSize();
+		if( !m_coalescer.AddPacket( packet ) )
+		{
+			FlushCoalescedPackets();
+			sizeBeforeAdd = m_coalescer.GetDatagramSize();
+			if( !m_coalescer.AddPacket( packet ) )
+				return TransmitStandalonePacket( packet );
+		}
+
+		return m_coalescer.GetDatagramSize() - sizeBeforeAdd;
+	}
+
+	return TransmitStandalonePacket( packet );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// One packet per datagram, for servers that do not coalesce and for packets too big to coalesce.
+int World::TransmitStandalonePacket( const FinalPacket& packet )
+{
+	if( m_useCompactWireFormat )
+	{
+		// Anything too big to encode goes out raw; the server takes either format in any datagram
+		unsigned char datagram[ MAX_COMPACT_PACKET_SIZE_BYTES ];
+		int numBytes = SerializeFinalPacket( packet, datagram, sizeof( datagram ) );
+		if( numBytes > 0 )
+		{
+			m_client.QueuePacketToServer( (const char*) datagram, numBytes );
+			return numBytes;
+		}
+	}
+
+	m_client.QueuePacketToServer( (const char*) &packet, sizeof( packet ) );
+	return sizeof( packet );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void World::FlushCoalescedPackets()
+{
+	if( m_isSelectiveAckNegotiated && m_receivedPackets.HasReceivedAnyPacket() && ( !m_coalescer.IsEmpty() || m_receivedPackets.IsAckPending() ) )
+		m_coalescer.SetAckBlock( m_receivedPackets.BuildAckBlock() );
+
+	if( m_coalescer.IsEmpty() )
+		return;
+
+	// Updates are charged as they are sent; an ack-only datagram carries none, so it is charged here
+	if( m_coalescer.GetNumPackets() == 0 )
+		m_updateScheduler.ChargeBudget( GetCurrentTimeSeconds(), m_coalescer.GetDatagramSize() );
+
+	m_client.QueuePacketToServer( (const char*) m_coalescer.GetDatagram(), m_coalescer.GetDatagramSize() );
+	m_coalescer.Reset();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Once the server sends ack blocks, recent guaranteed packets are acked in our next datagram header
+// instead of with a standalone Ack; anything already outside the bitfield still gets one.
+void World::AcknowledgePacket( const FinalPacket& packet )
+{
+	if( m_isSelectiveAckNegotiated && m_receivedPackets.IsCoveredByAckBlock( packet.number ) )
+		return;
+
+	FinalPacket ackPacket;
+	ackPacket.type = TYPE_Ack;
+	ackPacket.number = m_nextPacketNumber;
+	ackPacket.clientID = m_mainPlayer->m_playerID;
+	ackPacket.timestamp = GetServerTimeSeconds();
+	ackPacket.data.acknowledged.type = packet.type;
+	ackPacket.data.acknowledged.number = packet.number;
+
+	SendPacket( ackPacket );
 }
 
 
@@ -191,22 +574,24 @@ void World::SendJoinLobbyPacket()
 	FinalPacket joinLobbyPacket;
 	joinLobbyPacket.type = TYPE_JoinRoom;
 	joinLobbyPacket.number = m_nextPacketNumber;
-	joinLobbyPacket.timestamp = GetCurrentTimeSeconds();
+	joinLobbyPacket.timestamp = GetServerTimeSeconds();
 	joinLobbyPacket.data.joining.room = ROOM_Lobby;
+	joinLobbyPacket.data.joining.capabilities = CAPABILITY_CoalescedPackets | CAPABILITY_SelectiveAcks | CAPABILITY_ServerMovement;
 
+	ResetSnapshotBaselines();
 	SendPacket( joinLobbyPacket );
 }
 
 
 //-----------------------------------------------------------------------------------------------
-void World::SendKeepAlivePacket()
+int World::SendKeepAlivePacket()
 {
 	FinalPacket keepAlivePacket;
 	keepAlivePacket.type = TYPE_KeepAlive;
 	keepAlivePacket.number = m_nextPacketNumber;
-	keepAlivePacket.timestamp = GetCurrentTimeSeconds();
+	keepAlivePacket.timestamp = GetServerTimeSeconds();
 	
-	SendPacket( keepAlivePacket );
+	return SendPacket( keepAlivePacket );
 }
 
 
@@ -216,10 +601,11 @@ void World::SendCreateGamePacket( unsigned char roomNumber )
 	FinalPacket createPacket;
 	createPacket.type = TYPE_CreateRoom;
 	createPacket.number = m_nextPacketNumber;
-	createPacket.timestamp = GetCurrentTimeSeconds();
+	createPacket.timestamp = GetServerTimeSeconds();
 	createPacket.data.creating.room = roomNumber;
 
 	SendPacket( createPacket );
+	++m_trafficStats.m_numCreateRoomRequests;
 }
 
 
@@ -229,36 +615,46 @@ void World::SendJoinGamePacket( unsigned char roomNumber )
 	FinalPacket joinPacket;
 	joinPacket.type = TYPE_JoinRoom;
 	joinPacket.number = m_nextPacketNumber;
-	joinPacket.timestamp = GetCurrentTimeSeconds();
+	joinPacket.timestamp = GetServerTimeSeconds();
 	joinPacket.data.joining.room = roomNumber;
+	joinPacket.data.joining.capabilities = CAPABILITY_CoalescedPackets | CAPABILITY_SelectiveAcks | CAPABILITY_ServerMovement;
 
+	ResetSnapshotBaselines();
 	SendPacket( joinPacket );
+	++m_trafficStats.m_numJoinRoomRequests;
 }
 
 
 //-----------------------------------------------------------------------------------------------
 void World::SendUpdate()
 {
-	if( ( GetCurrentTimeSeconds() - m_timeOfLastUpdateSend ) < SECONDS_BEFORE_SEND_UPDATE_PACKET )
+	double currentTime = GetCurrentTimeSeconds();
+	bool isMoving = m_isInGame && ( m_mainPlayerVelocity.x != 0.f || m_mainPlayerVelocity.y != 0.f || m_turnDirection != 0 );
+
+	// Pending acks do not need an update to ride on; FlushCoalescedPackets sends them on their own
+	if( !m_updateScheduler.ShouldSendUpdate( currentTime, isMoving ) )
 		return;
 
+	int numBytesSent = 0;
 	if( m_isInLobby )
-		SendKeepAlivePacket();
+		numBytesSent = SendKeepAlivePacket();
+	else if( m_isInGame && m_isServerMovementNegotiated )
+		numBytesSent = SendTankInputs();
 	else if( m_isInGame )
-		SendGameUpdate();
+		numBytesSent = SendGameUpdate();
 
-	m_timeOfLastUpdateSend = GetCurrentTimeSeconds();
+	m_updateScheduler.OnUpdateSent( currentTime, numBytesSent );
 }
 
 
 //-----------------------------------------------------------------------------------------------
-void World::SendGameUpdate()
+int World::SendGameUpdate()
 {
 	FinalPacket updatePacket;
 	updatePacket.type = TYPE_GameUpdate;
 	updatePacket.number = m_nextPacketNumber;
 	updatePacket.clientID = m_mainPlayer->m_playerID;
-	updatePacket.timestamp = GetCurrentTimeSeconds();
+	updatePacket.timestamp = GetServerTimeSeconds();
 	updatePacket.data.updatedGame.health = 1;
 	updatePacket.data.updatedGame.orientationDegrees = m_mainPlayerOrientation;
 	updatePacket.data.updatedGame.score = 0;
@@ -266,40 +662,169 @@ void World::SendGameUpdate()
 	updatePacket.data.updatedGame.yAcceleration = m_mainPlayer->m_acceleration.y;
 	updatePacket.data.updatedGame.xVelocity = m_mainPlayerVelocity.x;
 	updatePacket.data.updatedGame.yVelocity = m_mainPlayerVelocity.y;
-	updatePacket.data.updatedGame.xPosition = m_mainPlayer->m_currentPosition.x;
-	updatePacket.data.updatedGame.yPosition = m_mainPlayer->m_currentPosition.y;
+	updatePacket.data.updatedGame.xPosition = m_tankPredictor.GetState().m_position.x;
+	updatePacket.data.updatedGame.yPosition = m_tankPredictor.GetState().m_position.y;
+
+	if( m_isSelectiveAckNegotiated )
+		return SendEncodedGameUpdate( updatePacket );
+
+	return SendPacket( updatePacket );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Deltas need the server's ack blocks to pick a baseline, so they only go to servers that send
+// them. Falls back to full state with no baseline, a stale one, or when deltas stop being acked.
+int World::SendEncodedGameUpdate( const FinalPacket& updatePacket )
+{
+	unsigned char encodedPacket[ MAX_COMPACT_PACKET_SIZE_BYTES ];
+	BitWriter writer( encodedPacket, sizeof( encodedPacket ) );
+
+	bool isBaselineUsable = m_hasDeltaBaseline
+		&& ( updatePacket.number - m_deltaBaselineNumber ) < (PacketNumber) MAX_DELTA_BASELINE_AGE
+		&& m_numUpdatesSinceBaselineAck < MAX_UPDATES_WITHOUT_BASELINE_ACK;
+
+	if( isBaselineUsable )
+		WriteDeltaGameUpdate( writer, updatePacket, m_deltaBaselineNumber, m_deltaBaseline );
+	else
+		WriteCompactFinalPacket( writer, updatePacket );
+
+	++m_numUpdatesSinceBaselineAck;
+
+	QuantizedTankState sentState;
+	QuantizeGameUpdate( updatePacket, sentState );
+	m_sentSnapshots.StoreSnapshot( updatePacket.number, updatePacket.clientID, sentState );
+
+	int numBytesSent = writer.GetNumBytesWritten();
+	if( !m_coalescer.AddEncodedPacket( encodedPacket, numBytesSent ) )
+	{
+		FlushCoalescedPackets();
+		if( !m_coalescer.AddEncodedPacket( encodedPacket, numBytesSent ) )
+		{
+			// Still no room: send the full state on its own rather than lose the update
+			++m_trafficStats.m_numEncodedUpdateFallbacks;
+			numBytesSent = TransmitStandalonePacket( updatePacket );
+		}
+	}
+
+	++m_nextPacketNumber;
+	return numBytesSent;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Every step the server has not yet confirmed, one packet per run of unchanged input, resent with
+// each update until a TankCorrection covers it. The server skips steps it has already run, and
+// coalescing puts the runs in one datagram, so the repeats cost a few bytes each.
+int World::SendTankInputs()
+{
+	TankInputRun inputRuns[ MAX_INPUT_RUNS_PER_SEND ];
+	int numInputRuns = m_tankPredictor.GetUnacknowledgedInputRuns( inputRuns, MAX_INPUT_RUNS_PER_SEND );
+
+	int numBytesSent = 0;
+	for( int runIndex = 0; runIndex < numInputRuns; ++runIndex )
+	{
+		const TankInputRun& inputRun = inputRuns[ runIndex ];
+		FinalPacket inputPacket;
+		inputPacket.type = TYPE_TankInput;
+		inputPacket.number = m_nextPacketNumber;
+		inputPacket.clientID = m_mainPlayer->m_playerID;
+		inputPacket.timestamp = GetServerTimeSeconds();
+		inputPacket.data.tankInput.firstStep = inputRun.m_firstStep;
+		inputPacket.data.tankInput.numSteps = (unsigned char) inputRun.m_numSteps;
+		inputPacket.data.tankInput.turnDirection = inputRun.m_input.m_turnDirection;
+		inputPacket.data.tankInput.throttle = inputRun.m_input.m_throttle;
+		inputPacket.data.tankInput.spawnPacketNumber = m_spawnPacketNumber;
+
+		numBytesSent += SendPacket( inputPacket );
+	}
 
-	SendPacket( updatePacket );
+	return numBytesSent;
 }
 
 
 //-----------------------------------------------------------------------------------------------
+void World::ResetSnapshotBaselines()
+{
+	m_sentSnapshots.Reset();
+	m_receivedSnapshots.Reset();
+	m_hasDeltaBaseline = false;
+	m_numUpdatesSinceBaselineAck = 0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Stamped with the server time of the remote tanks on screen, so the server can judge the shot
+// against where they were then. Interpolated tanks are drawn the interpolation delay in the past;
+// dead-reckoned ones are extrapolated to the present. A server moving our tank aims from where it
+// has it, so every step we have predicted goes out just ahead of the Fire, in the same datagram.
 void World::SendFire()
 {
 	m_mainPlayer->FireLaser();
+	m_updateScheduler.NotifyInputChanged();
+
+	if( m_isServerMovementNegotiated )
+		m_updateScheduler.ChargeBudget( GetCurrentTimeSeconds(), SendTankInputs() );
+
+	double viewTimeSeconds = GetServerTimeSeconds();
+	if( m_remoteTankSmoothing == SMOOTHING_Interpolation )
+		viewTimeSeconds -= m_interpolationDelaySeconds;
 
 	FinalPacket firePacket;
 	firePacket.type = TYPE_Fire;
 	firePacket.number = m_nextPacketNumber;
 	firePacket.clientID = m_mainPlayer->m_playerID;
-	firePacket.timestamp = GetCurrentTimeSeconds();
+	firePacket.timestamp = ( viewTimeSeconds > 0.0 ) ? viewTimeSeconds : 0.0;
 	firePacket.data.gunfire.instigatorID = m_mainPlayer->m_playerID;
 
 	SendPacket( firePacket );
+	++m_trafficStats.m_numShotsFired;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Outgoing packets are stamped on the server's clock, so GameUpdates relayed to other clients
+// carry a sample time they can convert with their own offset. Before the first ack this is just
+// the local clock, which receivers reject as implausible and replace with the arrival time.
+double World::GetServerTimeSeconds() const
+{
+	double serverTimeSeconds = m_clockSynchronizer.ConvertLocalToRemoteTime( GetCurrentTimeSeconds() );
+	if( serverTimeSeconds < 0.0 )
+		return 0.0;
+
+	return serverTimeSeconds;
 }
 
 
 //-----------------------------------------------------------------------------------------------
+// When a relayed GameUpdate was sampled by its sender, on the local clock. Falls back to now if
+// the clock is not synchronized yet or the stamp is not plausible (from the future, or older
+// than anything still worth extrapolating from), as it is from senders that are not synchronized.
+double World::GetRemoteSampleTimeSeconds( const FinalPacket& packet ) const
+{
+	double currentTime = GetCurrentTimeSeconds();
+	if( !m_clockSynchronizer.IsSynchronized() )
+		return currentTime;
+
+	double sampleTimeSeconds = m_clockSynchronizer.ConvertRemoteToLocalTime( packet.timestamp );
+	if( sampleTimeSeconds > currentTime || ( currentTime - sampleTimeSeconds ) > MAX_REMOTE_SAMPLE_AGE_SECONDS )
+		return currentTime;
+
+	return sampleTimeSeconds;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// The server stamps its ack when it builds it, so each ack of a packet sent once is also a clock
+// synchronization exchange.
 void World::ProcessAckPackets( const FinalPacket& ackPacket )
 {
-	for( unsigned int packetIndex = 0; packetIndex < m_sentPackets.size(); ++packetIndex )
+	double currentTime = GetCurrentTimeSeconds();
+	double sendTimeSeconds = -1.0;
+	if( m_reliabilityWindow.RemovePacket( ackPacket.data.acknowledged.number, &sendTimeSeconds ) && sendTimeSeconds >= 0.0 )
 	{
-		FinalPacket packet = m_sentPackets[ packetIndex ];
-		if( packet.number == ackPacket.data.acknowledged.number )
-		{
-			m_sentPackets.erase( m_sentPackets.begin() + packetIndex );
-			break;
-		}
+		m_roundTripEstimator.AddSample( currentTime - sendTimeSeconds );
+		m_clockSynchronizer.AddSample( sendTimeSeconds, ackPacket.timestamp, currentTime );
 	}
 }
 
@@ -307,15 +832,7 @@ void World::ProcessAckPackets( const FinalPacket& ackPacket )
 //-----------------------------------------------------------------------------------------------
 void World::ProcessNakPackets( const FinalPacket& nakPacket )
 {
-	for( unsigned int packetIndex = 0; packetIndex < m_sentPackets.size(); ++packetIndex )
-	{
-		FinalPacket packet = m_sentPackets[ packetIndex ];
-		if( packet.number == nakPacket.data.refused.number )
-		{
-			m_sentPackets.erase( m_sentPackets.begin() + packetIndex );
-			break;
-		}
-	}
+	m_reliabilityWindow.RemovePacket( nakPacket.data.refused.number );
 }
 
 
@@ -362,41 +879,136 @@ void World::UpdateTank( const FinalPacket& updatePacket )
 		tank->SetColor();
 	}
 
+	// The local tank moves by prediction; only the server's corrections may move it
+	if( tank == m_mainPlayer )
+	{
+		tank->m_score = updatePacket.data.updatedGame.score;
+		tank->m_health = updatePacket.data.updatedGame.health;
+		return;
+	}
+
 	Vector2 prevPosition = tank->m_lastUpdatePosition;
 	Vector2 prevVelocity = tank->m_velocity;
 	Vector2 prevAcceleration = tank->m_acceleration;
 
-	tank->m_currentPosition.x = updatePacket.data.updatedGame.xPosition;
-	tank->m_currentPosition.y = updatePacket.data.updatedGame.yPosition;
-	tank->m_lastUpdatePosition.x = tank->m_currentPosition.x;
-	tank->m_lastUpdatePosition.y = tank->m_currentPosition.y;
+	tank->m_lastUpdatePosition.x = updatePacket.data.updatedGame.xPosition;
+	tank->m_lastUpdatePosition.y = updatePacket.data.updatedGame.yPosition;
 	tank->m_velocity.x = updatePacket.data.updatedGame.xVelocity;
 	tank->m_velocity.y = updatePacket.data.updatedGame.yVelocity;
 	tank->m_acceleration.x = updatePacket.data.updatedGame.xAcceleration;
 	tank->m_acceleration.y = updatePacket.data.updatedGame.yAcceleration;
-	tank->m_yawOrientationDeg = updatePacket.data.updatedGame.orientationDegrees;
 	tank->m_score = updatePacket.data.updatedGame.score;
 	tank->m_health = updatePacket.data.updatedGame.health;
 
-	if( prevPosition != tank->m_lastUpdatePosition || prevVelocity != tank->m_velocity || prevAcceleration != tank->m_acceleration )
+	// Extrapolation runs from when the sender sampled this state, not from when it got here
+	double sampleTimeSeconds = GetRemoteSampleTimeSeconds( updatePacket );
+	bool isStateChanged = prevPosition != tank->m_lastUpdatePosition || prevVelocity != tank->m_velocity || prevAcceleration != tank->m_acceleration;
+	if( isStateChanged )
 	{
-		tank->m_timeOfLastUpdate = GetCurrentTimeSeconds();
+		tank->m_timeOfLastUpdate = sampleTimeSeconds;
+	}
+
+	// The buffer fills in both modes so switching smoothing takes effect immediately
+	bool hasDrawnState = tank->m_stateBuffer.GetNumSamples() > 0;
+	RecordTankState( tank, updatePacket.data.updatedGame.orientationDegrees, sampleTimeSeconds );
+
+	if( m_remoteTankSmoothing == SMOOTHING_DeadReckoning )
+	{
+		tank->m_yawOrientationDeg = updatePacket.data.updatedGame.orientationDegrees;
+		if( isStateChanged )
+			BeginConvergence( tank, hasDrawnState );
 	}
 }
 
 
+//-----------------------------------------------------------------------------------------------
+// Projective velocity blending: rather than snapping to the corrected path, ApplyDeadReckoning
+// projects from where the tank was drawn with a velocity blended from the drawn one to the
+// reported one, and blends that projection onto the corrected path over m_convergenceSeconds.
+// The blend is timed from arrival; the corrected path itself starts at the sample time.
+void World::BeginConvergence( Tank* tank, bool hasDrawnState )
+{
+	double currentTime = GetCurrentTimeSeconds();
+	Vector2 drawnPosition( tank->m_currentPosition.x, tank->m_currentPosition.y );
+	Vector2 correctedPosition = tank->GetExtrapolatedPosition( currentTime );
+	float correctionDistance = ( correctedPosition - drawnPosition ).GetLength();
+	bool isTrackedCorrection = hasDrawnState && correctionDistance <= TANK_STATE_TELEPORT_DISTANCE;
+	if( isTrackedCorrection )
+	{
+		++tank->m_positionError.m_numCorrections;
+		tank->m_positionError.m_totalCorrectionDistance += correctionDistance;
+	}
+
+	tank->m_isConverging = isTrackedCorrection && m_convergenceSeconds > 0.0;
+	if( tank->m_isConverging )
+	{
+		tank->m_convergenceStartTime = currentTime;
+		tank->m_convergenceStartPosition = drawnPosition;
+		tank->m_convergenceStartVelocity = tank->m_drawnVelocity;
+		return;
+	}
+
+	tank->m_currentPosition.x = correctedPosition.x;
+	tank->m_currentPosition.y = correctedPosition.y;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Buffers the state UpdateTank just stored and measures how far it moves the tank from where it
+// was drawn. It also scores the tank's accumulated error: the state is where the server had the
+// tank at its sample time, so it is compared with where the tank was drawn then, in any smoothing
+// mode. Respawns clear the buffer and count as neither.
+void World::RecordTankState( Tank* tank, float yawOrientationDeg, double sampleTimeSeconds )
+{
+	TankStateSample sample;
+	sample.m_timeSeconds = sampleTimeSeconds;
+	sample.m_position = tank->m_lastUpdatePosition;
+	sample.m_velocity = tank->m_velocity;
+	sample.m_yawOrientationDeg = yawOrientationDeg;
+
+	bool isPredicted = tank->m_stateBuffer.GetNumSamples() > 0
+		&& ( sample.m_position - tank->m_stateBuffer.GetNewestSample().m_position ).GetLength() <= TANK_STATE_TELEPORT_DISTANCE;
+
+	tank->m_stateBuffer.AddSample( sample );
+
+	// Older states arriving out of order were already covered by the newer one's interval
+	double secondsSinceLastErrorSample = sampleTimeSeconds - tank->m_timeOfLastErrorSample;
+	if( secondsSinceLastErrorSample > 0.0 )
+	{
+		tank->m_timeOfLastErrorSample = sampleTimeSeconds;
+
+		Vector2 drawnAtSampleTime;
+		if( isPredicted && tank->m_drawnPositions.GetPositionAt( sampleTimeSeconds, drawnAtSampleTime ) )
+		{
+			tank->m_positionError.m_accumulatedErrorUnitSeconds += ( sample.m_position - drawnAtSampleTime ).GetLength() * (float) secondsSinceLastErrorSample;
+			tank->m_positionError.m_trackedSeconds += (float) secondsSinceLastErrorSample;
+		}
+	}
+
+	if( !isPredicted )
+		return;
+
+	Vector2 drawnPosition( tank->m_currentPosition.x, tank->m_currentPosition.y );
+	Vector2 correctedPosition = tank->GetExtrapolatedPosition( GetCurrentTimeSeconds() );
+	if( m_remoteTankSmoothing == SMOOTHING_Interpolation )
+	{
+		float correctedYawDeg;
+		tank->m_stateBuffer.Sample( m_interpolationRenderTime, correctedPosition, correctedYawDeg );
+	}
+
+	m_predictionErrors.AddSample( ( correctedPosition - drawnPosition ).GetLength() );
+}
+
+
 //-----------------------------------------------------------------------------------------------
 void World::UpdateTankHit( const FinalPacket& hitPacket )
 {
-	FinalPacket ackPacket;
-	ackPacket.type = TYPE_Ack;
-	ackPacket.number = m_nextPacketNumber;
-	ackPacket.clientID = m_mainPlayer->m_playerID;
-	ackPacket.timestamp = GetCurrentTimeSeconds();
-	ackPacket.data.acknowledged.type = TYPE_Hit;
-	ackPacket.data.acknowledged.number = hitPacket.number;
+	AcknowledgePacket( hitPacket );
 
-	SendPacket( ackPacket );
+	if( hitPacket.data.hit.instigatorID == m_mainPlayer->m_playerID )
+		++m_trafficStats.m_numHitsLanded;
+	if( hitPacket.data.hit.targetID == m_mainPlayer->m_playerID )
+		++m_trafficStats.m_numHitsTaken;
 
 	for( unsigned int tankIndex = 0; tankIndex < m_tanks.size(); ++tankIndex )
 	{
@@ -413,15 +1025,7 @@ void World::UpdateTankHit( const FinalPacket& hitPacket )
 //-----------------------------------------------------------------------------------------------
 void World::UpdateTankFire( const FinalPacket& firePacket )
 {
-	FinalPacket ackPacket;
-	ackPacket.type = TYPE_Ack;
-	ackPacket.number = m_nextPacketNumber;
-	ackPacket.clientID = m_mainPlayer->m_playerID;
-	ackPacket.timestamp = GetCurrentTimeSeconds();
-	ackPacket.data.acknowledged.type = TYPE_Fire;
-	ackPacket.data.acknowledged.number = firePacket.number;
-
-	SendPacket( ackPacket );
+	AcknowledgePacket( firePacket );
 
 	for( unsigned int tankIndex = 0; tankIndex < m_tanks.size(); ++tankIndex )
 	{
@@ -438,38 +1042,31 @@ void World::UpdateTankFire( const FinalPacket& firePacket )
 //-----------------------------------------------------------------------------------------------
 void World::RespawnTank( const FinalPacket& respawnPacket )
 {
-	FinalPacket ackPacket;
-	ackPacket.type = TYPE_Ack;
-	ackPacket.number = m_nextPacketNumber;
-	ackPacket.clientID = m_mainPlayer->m_playerID;
-	ackPacket.timestamp = GetCurrentTimeSeconds();
-	ackPacket.data.acknowledged.type = TYPE_Respawn;
-	ackPacket.data.acknowledged.number = respawnPacket.number;
+	AcknowledgePacket( respawnPacket );
+	++m_trafficStats.m_numRespawns;
+	m_spawnPacketNumber = respawnPacket.number;
+	ResetLocalTank( respawnPacket.data.respawn.xPosition, respawnPacket.data.respawn.yPosition, respawnPacket.data.respawn.orientationDegrees );
+}
 
-	SendPacket( ackPacket );
 
-	m_mainPlayer->m_currentPosition.x = respawnPacket.data.respawn.xPosition;
-	m_mainPlayer->m_currentPosition.y = respawnPacket.data.respawn.yPosition;
-	m_mainPlayer->m_lastUpdatePosition.x = m_mainPlayer->m_currentPosition.x;
-	m_mainPlayer->m_lastUpdatePosition.y = m_mainPlayer->m_currentPosition.y;
-	m_mainPlayer->m_yawOrientationDeg = respawnPacket.data.respawn.orientationDegrees;
-	m_mainPlayerOrientation = m_mainPlayer->m_yawOrientationDeg;
-	m_mainPlayer->m_timeOfLastUpdate = GetCurrentTimeSeconds();
+//-----------------------------------------------------------------------------------------------
+// Corrections only count once GameReset has confirmed the server simulates our inputs.
+void World::ReconcileLocalTank( const FinalPacket& correctionPacket )
+{
+	if( !m_isInGame || !m_isServerMovementNegotiated )
+		return;
+
+	const TankCorrectionPacket& correction = correctionPacket.data.tankCorrection;
+	TankMovementState serverState( Vector2( correction.xPosition, correction.yPosition ), correction.orientationDegrees );
+	if( m_tankPredictor.Reconcile( correction.nextStep, serverState ) )
+		m_mainPlayerOrientation = m_tankPredictor.GetState().m_orientationDegrees;
 }
 
 
 //-----------------------------------------------------------------------------------------------
 void World::ReturnToLobby( const FinalPacket& lobbyReturnPacket )
 {
-	FinalPacket ackPacket;
-	ackPacket.type = TYPE_Ack;
-	ackPacket.number = m_nextPacketNumber;
-	ackPacket.clientID = m_mainPlayer->m_playerID;
-	ackPacket.timestamp = GetCurrentTimeSeconds();
-	ackPacket.data.acknowledged.type = TYPE_ReturnToLobby;
-	ackPacket.data.acknowledged.number = lobbyReturnPacket.number;
-
-	SendPacket( ackPacket );
+	AcknowledgePacket( lobbyReturnPacket );
 
 	while( m_tanks.size() > 0 )
 	{
@@ -489,48 +1086,102 @@ void World::ReturnToLobby( const FinalPacket& lobbyReturnPacket )
 
 
 //-----------------------------------------------------------------------------------------------
-void World::UpdateFromInput( const Keyboard& keyboard, const Mouse&, float deltaSeconds )
+void World::UpdateNetworkAndSimulation( float deltaSeconds, TankInputSource& inputSource )
+{
+	PacketCaptureWriter* capture = m_client.GetCapture();
+	if( capture != nullptr )
+		capture->WriteFrame( deltaSeconds );
+
+	double phaseStartTime = GetWallClockTimeSeconds();
+	ReceivePackets();
+	RecordPhaseTime( RECEIVE_PACKETS_PROFILE_NAME, phaseStartTime );
+
+	RemoveTimedOutPlayers();
+
+	TankInput input;
+	inputSource.GetTankInput( m_isInGame, m_playersPerRoom, deltaSeconds, input );
+	if( input.m_requestedRoom == ROOM_None )
+		input.m_requestedRoom = m_buttonRequestedRoom;
+
+	m_buttonRequestedRoom = ROOM_None;
+	if( capture != nullptr )
+		capture->WriteInput( input );
+
+	UpdateFromInput( input, deltaSeconds );
+
+	phaseStartTime = GetWallClockTimeSeconds();
+	ApplyDeadReckoning();
+	ApplySnapshotInterpolation();
+	RecordDrawnPositions();
+	RecordPhaseTime( DEAD_RECKONING_PROFILE_NAME, phaseStartTime );
+
+	SendUpdate();
+	ResendGuaranteedPackets();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void World::RecordPhaseTime( const std::string& profileName, double phaseStartTime )
 {
+#if defined( _WIN32 )
+	if( m_isProfilingEnabled )
+		ProfileSection::RecordSample( profileName, GetWallClockTimeSeconds() - phaseStartTime );
+#endif
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void World::FlushOutgoingPackets()
+{
+	FlushCoalescedPackets();
+	m_client.FlushQueuedPacketsToServer();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void World::UpdateFromInput( const TankInput& input, float deltaSeconds )
+{
+	if( m_isInLobby && input.m_requestedRoom != ROOM_None )
+		RequestRoom( input.m_requestedRoom );
+
 	if( !m_isInGame )
 		return;
 
-	if( keyboard.IsKeyPressedDownAndWasNotBefore( KEY_SPACE ) )
+	if( input.m_isFiring )
 	{
 		SendFire();
 	}
 
-	if( keyboard.IsKeyPressedDown( KEY_A ) )
-	{
-		m_mainPlayerOrientation += TANK_ROTATION_DEGREES_PER_SECOND * deltaSeconds;
-	}
-	else if( keyboard.IsKeyPressedDown( KEY_D ) )
-	{
-		m_mainPlayerOrientation -= TANK_ROTATION_DEGREES_PER_SECOND * deltaSeconds;
-	}
+	int turnDirection = input.m_turnDirection;
+	float speed = input.m_throttle * TANK_SPEED_UNITS_PER_SECOND;
 
-	if( m_mainPlayerOrientation < -180.f )
-	{
-		m_mainPlayerOrientation += 360.f;
-	}
-	else if( m_mainPlayerOrientation >= 180.f )
-	{
-		m_mainPlayerOrientation -= 360.f;
-	}
+	// Starting or stopping a turn or a drive is what remote players most need to hear about promptly
+	if( turnDirection != m_turnDirection || speed != m_throttleSpeed )
+		m_updateScheduler.NotifyInputChanged();
 
-	float speed = 0.f;
-	if( keyboard.IsKeyPressedDown( KEY_W ) )
-	{
-		speed = TANK_SPEED_UNITS_PER_SECOND;
-	}
-	else if( keyboard.IsKeyPressedDown( KEY_S ) )
-	{
-		speed = -TANK_SPEED_UNITS_PER_SECOND;
-	}
+	m_turnDirection = turnDirection;
+	m_throttleSpeed = speed;
+
+	UpdateLocalTank( TankMovementInput( turnDirection, input.m_throttle ), deltaSeconds );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// The local tank answers input the same frame. It is drawn between its last two fixed steps,
+// while updates and velocity come from the newest one.
+void World::UpdateLocalTank( const TankMovementInput& movementInput, float deltaSeconds )
+{
+	m_tankPredictor.Advance( deltaSeconds, movementInput );
+
+	const TankMovementState& predictedState = m_tankPredictor.GetState();
+	m_mainPlayerOrientation = predictedState.m_orientationDegrees;
+	m_mainPlayerVelocity = GetTankMovementVelocity( predictedState, movementInput );
 
-	m_mainPlayerVelocity.x = cos( ConvertDegreesToRadians( m_mainPlayerOrientation ) );
-	m_mainPlayerVelocity.y = sin( ConvertDegreesToRadians( m_mainPlayerOrientation ) );
-	m_mainPlayerVelocity.Normalize();
-	m_mainPlayerVelocity *= speed;
+	TankMovementState renderState = m_tankPredictor.GetRenderState();
+	m_mainPlayer->m_currentPosition.x = renderState.m_position.x;
+	m_mainPlayer->m_currentPosition.y = renderState.m_position.y;
+	m_mainPlayer->m_yawOrientationDeg = renderState.m_orientationDegrees;
+	m_mainPlayer->Update( deltaSeconds );
 }
 
 
@@ -565,19 +1216,88 @@ void World::ApplyDeadReckoning()
 	for( unsigned int tankIndex = 0; tankIndex < m_tanks.size(); ++tankIndex )
 	{
 		Tank* tank = m_tanks[ tankIndex ];
+		if( tank == m_mainPlayer || m_remoteTankSmoothing == SMOOTHING_Interpolation )
+			continue;
 
-		float deltaSeconds = (float) ( GetCurrentTimeSeconds() - tank->m_timeOfLastUpdate );
-		tank->m_currentPosition.x = tank->m_lastUpdatePosition.x + ( tank->m_velocity.x * deltaSeconds ) + ( 0.5f * tank->m_acceleration.x * deltaSeconds * deltaSeconds );
-		tank->m_currentPosition.y = tank->m_lastUpdatePosition.y + ( tank->m_velocity.y * deltaSeconds ) + ( 0.5f * tank->m_acceleration.y * deltaSeconds * deltaSeconds );
-		
-		tank->m_currentPosition.x = ClampFloat( tank->m_currentPosition.x, 0.f, ARENA_FLOOR_SIZE_X );
-		tank->m_currentPosition.y = ClampFloat( tank->m_currentPosition.y, 0.f, ARENA_FLOOR_SIZE_Y );
+		double currentTime = GetCurrentTimeSeconds();
+		float deltaSeconds = (float) ( currentTime - tank->m_timeOfLastUpdate );
+		Vector2 extrapolatedPosition = tank->GetExtrapolatedPosition( currentTime );
+		Vector2 drawnPosition = extrapolatedPosition;
+		tank->m_drawnVelocity = tank->m_velocity + ( tank->m_acceleration * deltaSeconds );
+
+		if( tank->m_isConverging )
+		{
+			float blendSeconds = (float) ( currentTime - tank->m_convergenceStartTime );
+			float blendFraction = blendSeconds / (float) m_convergenceSeconds;
+			if( blendFraction >= 1.f || m_convergenceSeconds <= 0.0 )
+			{
+				tank->m_isConverging = false;
+			}
+			else
+			{
+				Vector2 blendedVelocity = tank->m_convergenceStartVelocity + ( tank->m_velocity - tank->m_convergenceStartVelocity ) * blendFraction;
+				Vector2 accelerationOffset = tank->m_acceleration * ( 0.5f * blendSeconds * blendSeconds );
+				Vector2 projectedPosition = tank->m_convergenceStartPosition + ( blendedVelocity * blendSeconds ) + accelerationOffset;
+				drawnPosition = projectedPosition + ( extrapolatedPosition - projectedPosition ) * blendFraction;
+				tank->m_drawnVelocity = blendedVelocity + ( tank->m_acceleration * blendSeconds );
+			}
+		}
+
+		tank->m_currentPosition.x = ClampFloat( drawnPosition.x, 0.f, ARENA_FLOOR_SIZE_X );
+		tank->m_currentPosition.y = ClampFloat( drawnPosition.y, 0.f, ARENA_FLOOR_SIZE_Y );
 
 		tank->Update( deltaSeconds );
 	}
 }
 
 
+//-----------------------------------------------------------------------------------------------
+void World::ApplySnapshotInterpolation()
+{
+	if( !m_isInGame || m_remoteTankSmoothing != SMOOTHING_Interpolation )
+		return;
+
+	m_interpolationRenderTime = GetCurrentTimeSeconds() - m_interpolationDelaySeconds;
+
+	for( unsigned int tankIndex = 0; tankIndex < m_tanks.size(); ++tankIndex )
+	{
+		Tank* tank = m_tanks[ tankIndex ];
+		if( tank == m_mainPlayer )
+			continue;
+
+		Vector2 position;
+		float yawOrientationDeg;
+		if( !tank->m_stateBuffer.Sample( m_interpolationRenderTime, position, yawOrientationDeg ) )
+			continue;
+
+		tank->m_currentPosition.x = ClampFloat( position.x, 0.f, ARENA_FLOOR_SIZE_X );
+		tank->m_currentPosition.y = ClampFloat( position.y, 0.f, ARENA_FLOOR_SIZE_Y );
+		tank->m_yawOrientationDeg = yawOrientationDeg;
+
+		tank->Update( (float) ( GetCurrentTimeSeconds() - tank->m_timeOfLastUpdate ) );
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Runs after whichever smoothing mode placed the remote tanks, so the history is what was on screen.
+void World::RecordDrawnPositions()
+{
+	if( !m_isInGame )
+		return;
+
+	double currentTime = GetCurrentTimeSeconds();
+	for( unsigned int tankIndex = 0; tankIndex < m_tanks.size(); ++tankIndex )
+	{
+		Tank* tank = m_tanks[ tankIndex ];
+		if( tank == m_mainPlayer )
+			continue;
+
+		tank->m_drawnPositions.AddPosition( currentTime, Vector2( tank->m_currentPosition.x, tank->m_currentPosition.y ) );
+	}
+}
+
+
 //-----------------------------------------------------------------------------------------------
 void World::ResetGame( const FinalPacket& resetPacket )
 {
@@ -586,25 +1306,31 @@ void World::ResetGame( const FinalPacket& resetPacket )
 
 	m_isInLobby = false;
 	m_isInGame = true;
+	++m_trafficStats.m_numGamesEntered;
 
-	FinalPacket ackPacket;
-	ackPacket.type = TYPE_Ack;
-	ackPacket.number = m_nextPacketNumber;
-	ackPacket.clientID = resetPacket.data.reset.id;
-	ackPacket.timestamp = GetCurrentTimeSeconds();
-	ackPacket.data.acknowledged.type = TYPE_GameReset;
-	ackPacket.data.acknowledged.number = resetPacket.number;
+	m_mainPlayer->m_playerID = resetPacket.data.reset.id;
+	AcknowledgePacket( resetPacket );
 
-	SendPacket( ackPacket );
+	// Only a server that coalesces fills in the capabilities byte; older ones may leave it garbage
+	m_isServerMovementNegotiated = m_isCoalescingNegotiated && ( resetPacket.data.reset.capabilities & CAPABILITY_ServerMovement ) != 0;
 
-	m_mainPlayer->m_playerID = resetPacket.data.reset.id;
-	m_mainPlayer->m_currentPosition.x = resetPacket.data.reset.xPosition;
-	m_mainPlayer->m_currentPosition.y = resetPacket.data.reset.yPosition;
-	m_mainPlayer->m_lastUpdatePosition.x = m_mainPlayer->m_currentPosition.x;
-	m_mainPlayer->m_lastUpdatePosition.y = m_mainPlayer->m_currentPosition.y;
 	m_mainPlayer->m_velocity = Vector2( 0.f, 0.f );
-	m_mainPlayer->m_yawOrientationDeg = resetPacket.data.reset.orientationDegrees;
-	m_mainPlayerOrientation = m_mainPlayer->m_yawOrientationDeg;
+	m_spawnPacketNumber = resetPacket.number;
+	ResetLocalTank( resetPacket.data.reset.xPosition, resetPacket.data.reset.yPosition, resetPacket.data.reset.orientationDegrees );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void World::ResetLocalTank( float xPosition, float yPosition, float orientationDegrees )
+{
+	m_tankPredictor.Reset( TankMovementState( Vector2( xPosition, yPosition ), orientationDegrees ) );
+
+	m_mainPlayer->m_currentPosition.x = xPosition;
+	m_mainPlayer->m_currentPosition.y = yPosition;
+	m_mainPlayer->m_lastUpdatePosition.x = xPosition;
+	m_mainPlayer->m_lastUpdatePosition.y = yPosition;
+	m_mainPlayer->m_yawOrientationDeg = orientationDegrees;
+	m_mainPlayerOrientation = m_tankPredictor.GetState().m_orientationDegrees;
 	m_mainPlayer->m_timeOfLastUpdate = GetCurrentTimeSeconds();
 }
 
@@ -612,38 +1338,130 @@ void World::ResetGame( const FinalPacket& resetPacket )
 //-----------------------------------------------------------------------------------------------
 void World::ShowButtons()
 {
+#if defined( _WIN32 )
+	// Headless buttons stay hidden so the main thread's widget pass never touches them
+	if( m_isHeadless )
+		return;
+
 	for( unsigned int buttonIndex = 0; buttonIndex < MAX_NUMBER_OF_ROOMS; ++buttonIndex )
 	{
 		m_roomButtons[ buttonIndex ].SetHidden( false );
 	}
+#endif
 }
 
 
 //-----------------------------------------------------------------------------------------------
 void World::HideButtons()
 {
+#if defined( _WIN32 )
 	for( unsigned int buttonIndex = 0; buttonIndex < MAX_NUMBER_OF_ROOMS; ++buttonIndex )
 	{
 		m_roomButtons[ buttonIndex ].SetHidden( true );
 	}
+#endif
 }
 
 
 //-----------------------------------------------------------------------------------------------
 void World::ReceivePackets()
 {
-	FinalPacket packet;
-	std::set< FinalPacket > recvPackets;
+	FinalPacket unpackedPackets[ MAX_PACKETS_PER_DATAGRAM ];
+	unsigned char datagram[ MAX_DATAGRAM_SIZE_BYTES ];
+	int numBytes;
+	double arrivalTimeSeconds;
+
+	while( m_client.ReceivePacketBatchFromServer() > 0 )
+	{
+		while( m_client.PopReceivedPacket( (char*) datagram, sizeof( datagram ), numBytes, &arrivalTimeSeconds ) )
+		{
+			// The server only coalesces once it has seen our capabilities in Join, so the first
+			// coalesced datagram completes the negotiation for our outgoing traffic as well.
+			if( IsCoalescedDatagram( datagram, numBytes ) )
+				m_isCoalescingNegotiated = true;
+
+			double newestSendTimeSeconds = -1.0;
+			AckBlock ackBlock;
+			if( ReadDatagramAckBlock( datagram, numBytes, ackBlock ) )
+			{
+				m_isSelectiveAckNegotiated = true;
+
+				if( m_reliabilityWindow.RemoveAckedPackets( ackBlock, &newestSendTimeSeconds ) > 0 && newestSendTimeSeconds >= 0.0 )
+					m_roundTripEstimator.AddSample( arrivalTimeSeconds - newestSendTimeSeconds );
+
+				PacketNumber ackedSnapshotNumber;
+				QuantizedTankState ackedSnapshot;
+				if( m_sentSnapshots.FindNewestAckedSnapshot( ackBlock, m_mainPlayer->m_playerID, ackedSnapshotNumber, ackedSnapshot ) && ( !m_hasDeltaBaseline || IsPacketNumberNewer( ackedSnapshotNumber, m_deltaBaselineNumber ) ) )
+				{
+					m_deltaBaseline = ackedSnapshot;
+					m_deltaBaselineNumber = ackedSnapshotNumber;
+					m_hasDeltaBaseline = true;
+					m_numUpdatesSinceBaselineAck = 0;
+				}
+			}
+
+			int numPackets = UnpackDatagram( datagram, numBytes, unpackedPackets, MAX_PACKETS_PER_DATAGRAM, &m_receivedSnapshots );
+
+			// Relayed GameUpdates keep their sender's stamp; anything else the server stamped while
+			// building this datagram, which makes an ack of a packet sent once a clock sync exchange
+			for( int packetIndex = 0; packetIndex < numPackets && newestSendTimeSeconds >= 0.0; ++packetIndex )
+			{
+				if( unpackedPackets[ packetIndex ].type != TYPE_GameUpdate )
+				{
+					m_clockSynchronizer.AddSample( newestSendTimeSeconds, unpackedPackets[ packetIndex ].timestamp, arrivalTimeSeconds );
+					break;
+				}
+			}
+
+			for( int packetIndex = 0; packetIndex < numPackets; ++packetIndex )
+			{
+				const FinalPacket& packet = unpackedPackets[ packetIndex ];
+				if( !m_receivedPackets.RecordReceivedPacket( packet.number, packet.IsGuaranteed() ) )
+				{
+					// A retransmit of something already applied: our ack went missing, so ack again
+					if( packet.IsGuaranteed() )
+						AcknowledgePacket( packet );
+
+					continue;
+				}
+
+				RecordReceivedTraffic( packet.number );
+
+				if( m_reorderBuffer.IsFull() )
+					DispatchReceivedPackets();
+
+				m_reorderBuffer.AddPacket( packet );
+			}
+		}
+	}
+
+	DispatchReceivedPackets();
+}
+
 
-	while( m_client.ReceivePacketFromServer( (char*) &packet, sizeof( packet ) ) )
+//-----------------------------------------------------------------------------------------------
+void World::RecordReceivedTraffic( PacketNumber number )
+{
+	++m_trafficStats.m_numPacketsReceived;
+	if( !m_trafficStats.m_hasReceivedAnyPacket )
 	{
-		recvPackets.insert( packet );
+		m_trafficStats.m_hasReceivedAnyPacket = true;
+		m_trafficStats.m_firstReceivedNumber = number;
+		m_trafficStats.m_newestReceivedNumber = number;
 	}
+	else if( IsPacketNumberNewer( number, m_trafficStats.m_newestReceivedNumber ) )
+	{
+		m_trafficStats.m_newestReceivedNumber = number;
+	}
+}
 
-	std::set< FinalPacket >::iterator setIter;
-	for( setIter = recvPackets.begin(); setIter != recvPackets.end(); ++setIter )
+
+//-----------------------------------------------------------------------------------------------
+void World::DispatchReceivedPackets()
+{
+	for( int packetIndex = 0; packetIndex < m_reorderBuffer.GetNumPackets(); ++packetIndex )
 	{
-		FinalPacket orderedPacket = *setIter;
+		const FinalPacket& orderedPacket = m_reorderBuffer.GetPacket( packetIndex );
 
 		if( orderedPacket.type == TYPE_Ack )
 		{
@@ -677,39 +1495,44 @@ void World::ReceivePackets()
 		{
 			RespawnTank( orderedPacket );
 		}
+		else if( orderedPacket.type == TYPE_TankCorrection )
+		{
+			ReconcileLocalTank( orderedPacket );
+		}
 		else if( orderedPacket.type == TYPE_ReturnToLobby )
 		{
 			ReturnToLobby( orderedPacket );
 		}
 	}
+
+	m_reorderBuffer.Clear();
 }
 
 
 //-----------------------------------------------------------------------------------------------
 void World::ResendGuaranteedPackets()
 {
-	std::vector< FinalPacket > resendPackets;
+	double currentTime = GetCurrentTimeSeconds();
 
-	for( unsigned int packetIndex = 0; packetIndex < m_sentPackets.size(); ++packetIndex )
-	{
-		FinalPacket packet = m_sentPackets[ packetIndex ];
-		if( ( GetCurrentTimeSeconds() - packet.timestamp ) > SECONDS_BEFORE_RESEND_GUARANTEED_PACKET )
-		{
-			packet.number = m_nextPacketNumber;
-			packet.timestamp = GetCurrentTimeSeconds();
-			resendPackets.push_back( packet );
-			m_sentPackets.erase( m_sentPackets.begin() + packetIndex );
-			--packetIndex;
-		}
-	}
+	m_expiredPackets.clear();
+	m_reliabilityWindow.CollectExpiredPackets( currentTime, m_expiredPackets );
+	if( m_expiredPackets.empty() )
+		return;
+
+	m_roundTripEstimator.BackOff();
+	double resendTime = currentTime + m_roundTripEstimator.GetRetransmissionTimeoutSeconds();
 
-	for( unsigned int packetIndex = 0; packetIndex < resendPackets.size(); ++packetIndex )
+	for( unsigned int packetIndex = 0; packetIndex < m_expiredPackets.size(); ++packetIndex )
 	{
-		SendPacket( resendPackets[ packetIndex ] );
+		const FinalPacket& packet = m_expiredPackets[ packetIndex ];
+		TransmitPacket( packet );
+		m_reliabilityWindow.MarkRetransmitted( packet.number, currentTime, resendTime );
+		++m_trafficStats.m_numRetransmissions;
 	}
 }
 
 
+#if defined( _WIN32 )
 //-----------------------------------------------------------------------------------------------
 void World::RenderLobby()
 {
@@ -844,4 +1667,54 @@ void World::RenderTanks()
 		Tank* tank = m_tanks[ tankIndex ];
 		tank->Render();
 	}
-}
\ No newline at end of file
+}
+
+//-----------------------------------------------------------------------------------------------
+// Newest error on the right; the vertical scale tops out at PREDICTION_ERROR_GRAPH_MAX_UNITS.
+void World::RenderPredictionErrorGraph()
+{
+	Vector2 graphBottomLeft( m_size.x - PREDICTION_ERROR_GRAPH_WIDTH - 50.f, 50.f );
+	float unitsToPixels = PREDICTION_ERROR_GRAPH_HEIGHT / PREDICTION_ERROR_GRAPH_MAX_UNITS;
+	float pixelsPerSample = PREDICTION_ERROR_GRAPH_WIDTH / (float) ( PREDICTION_ERROR_HISTORY_SIZE - 1 );
+
+	OpenGLRenderer::DisableTexture2D();
+	OpenGLRenderer::SetLineWidth( 1.f );
+	OpenGLRenderer::SetColor4f( 0.5f, 0.5f, 0.5f, 1.f );
+	OpenGLRenderer::BeginRender( LINES );
+	{
+		OpenGLRenderer::SetVertex2f( graphBottomLeft.x, graphBottomLeft.y );
+		OpenGLRenderer::SetVertex2f( graphBottomLeft.x + PREDICTION_ERROR_GRAPH_WIDTH, graphBottomLeft.y );
+		OpenGLRenderer::SetVertex2f( graphBottomLeft.x, graphBottomLeft.y );
+		OpenGLRenderer::SetVertex2f( graphBottomLeft.x, graphBottomLeft.y + PREDICTION_ERROR_GRAPH_HEIGHT );
+	}
+	OpenGLRenderer::EndRender();
+
+	int numPoints = ( m_predictionErrors.m_numSamples < PREDICTION_ERROR_HISTORY_SIZE ) ? m_predictionErrors.m_numSamples : PREDICTION_ERROR_HISTORY_SIZE;
+	OpenGLRenderer::SetColor4f( 1.f, 0.25f, 0.25f, 1.f );
+	OpenGLRenderer::BeginRender( LINES );
+	{
+		Vector2 previousPoint;
+		for( int ageIndex = numPoints - 1; ageIndex >= 0; --ageIndex )
+		{
+			float errorDistance = m_predictionErrors.m_recentErrors[ ( m_predictionErrors.m_newestRecentIndex - ageIndex + PREDICTION_ERROR_HISTORY_SIZE ) % PREDICTION_ERROR_HISTORY_SIZE ];
+			if( errorDistance > PREDICTION_ERROR_GRAPH_MAX_UNITS )
+				errorDistance = PREDICTION_ERROR_GRAPH_MAX_UNITS;
+
+			Vector2 point( graphBottomLeft.x + PREDICTION_ERROR_GRAPH_WIDTH - ( ageIndex * pixelsPerSample ), graphBottomLeft.y + ( errorDistance * unitsToPixels ) );
+			if( ageIndex < numPoints - 1 )
+			{
+				OpenGLRenderer::SetVertex2f( previousPoint.x, previousPoint.y );
+				OpenGLRenderer::SetVertex2f( point.x, point.y );
+			}
+
+			previousPoint = point;
+		}
+	}
+	OpenGLRenderer::EndRender();
+	OpenGLRenderer::SetColor4f( 1.f, 1.f, 1.f, 1.f );
+
+	std::string smoothingName = ( m_remoteTankSmoothing == SMOOTHING_Interpolation ) ? "Interpolation" : "Dead reckoning";
+	OpenGLRenderer::RenderText( smoothingName + " error avg " + ConvertNumberToString( m_predictionErrors.GetAverageError() ) + " max " + ConvertNumberToString( m_predictionErrors.m_maxError ),
+		m_hudFont, HUD_FONT_CELL_HEIGHT * 0.5f, Vector2( graphBottomLeft.x, graphBottomLeft.y + PREDICTION_ERROR_GRAPH_HEIGHT + 10.f ) );
+}
+#endif
\ No newline at end of file
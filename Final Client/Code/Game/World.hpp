@@ -3,7 +3,6 @@
 #pragma once
 
 //-----------------------------------------------------------------------------------------------
-#include <set>
 #include <string>
 #include <vector>
 #include "Tank.hpp"
@@ -11,24 +10,36 @@
 #include "GameInfo.hpp"
 #include "UDPClient.hpp"
 #include "GameCommon.hpp"
+#include "TankInput.hpp"
 #include "FinalPacket.hpp"
+#include "PacketFraming.hpp"
+#include "ReorderBuffer.hpp"
+#include "TankPredictor.hpp"
+#include "SnapshotDelta.hpp"
+#include "ReliabilityWindow.hpp"
+#include "ClockSynchronizer.hpp"
+#include "RoundTripEstimator.hpp"
+#include "UpdateSendScheduler.hpp"
+#include "FinalPacketSerializer.hpp"
 #include "../Engine/Clock.hpp"
-#include "../Engine/Mouse.hpp"
-#include "../Engine/Button.hpp"
 #include "../Engine/Camera.hpp"
 #include "../Engine/Vertex.hpp"
 #include "../Engine/pugixml.hpp"
 #include "../Engine/Texture.hpp"
 #include "../Engine/Vector2.hpp"
+#include "../Engine/NamedProperties.hpp"
+#include "../Engine/ConsoleCommandArgs.hpp"
+#if defined( _WIN32 )
+#include "../Engine/Mouse.hpp"
+#include "../Engine/Button.hpp"
 #include "../Engine/Keyboard.hpp"
 #include "../Engine/Material.hpp"
 #include "../Engine/BitmapFont.hpp"
 #include "../Engine/DebugGraphics.hpp"
 #include "../Engine/OpenGLRenderer.hpp"
-#include "../Engine/NamedProperties.hpp"
-#include "../Engine/ConsoleCommandArgs.hpp"
 #include "../Engine/XMLParsingFunctions.hpp"
 #include "../Engine/ErrorWarningAssertions.hpp"
+#endif
 
 
 //-----------------------------------------------------------------------------------------------
@@ -40,10 +51,6 @@ const float ARENA_WALL_WIDTH = 20.f;
 const float ARENA_WALL_HEIGHT = 100.f;
 const float ARENA_SCALE = 1.f;
 const float HUD_FONT_CELL_HEIGHT = 50.f;
-const float TANK_SPEED_UNITS_PER_SECOND = 100.f;
-const float TANK_ROTATION_DEGREES_PER_SECOND = 90.f;
-const double SECONDS_BEFORE_RESEND_GUARANTEED_PACKET = 0.25;
-const double SECONDS_BEFORE_SEND_UPDATE_PACKET = 0.05;
 const double SECONDS_BEFORE_TIMEOUT_REMOVE = 5.0;
 const unsigned short PORT_NUMBER = 5000;
 //const std::string IP_ADDRESS = "129.119.247.159";
@@ -55,75 +62,221 @@ const std::string WALL_TEXTURE_FILE_NAME = "Data/Images/Wall.png";
 const std::string FLOOR_TEXTURE_FILE_NAME = "Data/Images/Floor.png";
 const std::string HUD_FONT_GLYPH_SHEET_FILE_NAME = "Data/Fonts/MainFont_EN_00.png";
 const std::string HUD_FONT_META_DATA_FILE_NAME = "Data/Fonts/MainFont_EN.FontDef.xml";
+const std::string RECEIVE_PACKETS_PROFILE_NAME = "Receive Packets";
+const std::string DEAD_RECKONING_PROFILE_NAME = "Dead Reckoning";
+const double DEFAULT_INTERPOLATION_DELAY_SECONDS = 0.1;
+const double DEFAULT_CONVERGENCE_SECONDS = 0.2;
+const double MAX_REMOTE_SAMPLE_AGE_SECONDS = 1.0;
+const int PREDICTION_ERROR_HISTORY_SIZE = 240;
+const float PREDICTION_ERROR_GRAPH_MAX_UNITS = 20.f;
+const float PREDICTION_ERROR_GRAPH_WIDTH = 480.f;
+const float PREDICTION_ERROR_GRAPH_HEIGHT = 120.f;
+
+
+//-----------------------------------------------------------------------------------------------
+// How remote tanks are placed between GameUpdates. Dead reckoning extrapolates from the newest
+// update and snaps when the next one lands; interpolation draws them a fixed delay in the past,
+// between two states they really had.
+enum RemoteTankSmoothing
+{
+	SMOOTHING_DeadReckoning,
+	SMOOTHING_Interpolation,
+};
+
+
+//-----------------------------------------------------------------------------------------------
+// Traffic counters for load-test reports. Server packet numbers are consecutive per connection, so
+// the span between the first and newest received number is what the server sent us. The game
+// counters show a bot went through a whole round: room requested, game entered, shots, hits, respawns.
+struct WorldTrafficStats
+{
+	WorldTrafficStats();
+
+	int				m_numGuaranteedPacketsSent;
+	int				m_numRetransmissions;
+	int				m_numEncodedUpdateFallbacks;
+	int				m_numReliabilityWindowOverflows; // guaranteed packets sent without a resend guarantee
+	int				m_numPacketsReceived;
+	bool			m_hasReceivedAnyPacket;
+	PacketNumber	m_firstReceivedNumber;
+	PacketNumber	m_newestReceivedNumber;
+	int				m_numCreateRoomRequests;
+	int				m_numJoinRoomRequests;
+	int				m_numGamesEntered;
+	int				m_numShotsFired;
+	int				m_numHitsLanded;
+	int				m_numHitsTaken;
+	int				m_numRespawns;
+};
 
 
 //-----------------------------------------------------------------------------------------------
+// How far each GameUpdate moved a remote tank from where it was being drawn, in world units. Dead
+// reckoning, that is the snap; interpolating, it is only non-zero when the tank had already been
+// extrapolated past its newest state and the late update corrected it.
+struct PredictionErrorStats
+{
+	PredictionErrorStats();
+	void AddSample( float errorDistance );
+	float GetAverageError() const;
+
+	int		m_numSamples;
+	double	m_totalError;
+	float	m_maxError;
+	float	m_recentErrors[ PREDICTION_ERROR_HISTORY_SIZE ];
+	int		m_newestRecentIndex;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+// A headless World runs the full client protocol without loading fonts or textures, creating lobby
+// buttons, or registering events, and must be driven through Update( deltaSeconds, inputSource ).
+// Buttons still register as widgets, so Worlds are constructed and destroyed on the main thread.
+// Rendering, the lobby buttons and keyboard input are Windows-only; elsewhere every World is headless.
 class World
 {
 public:
-	World( float worldWidth, float worldHeight );
+	World( float worldWidth, float worldHeight, bool isHeadless = false );
 	void Initialize();
 	void Destruct();
 	void ChangeIPAddress( const std::string& ipAddrString );
 	void ChangePortNumber( unsigned short portNumber );
+	UDPClient& GetClient();
+	const RoundTripEstimator& GetRoundTripEstimator() const;
+	const ClockSynchronizer& GetClockSynchronizer() const;
+	const TankPredictor& GetTankPredictor() const;
+	bool IsServerMovementNegotiated() const;
+	void SetCompactWireFormat( bool useCompactWireFormat );
+	UpdateSendScheduler& GetUpdateScheduler();
+	void SetProfilingEnabled( bool isProfilingEnabled );
+	void SetRemoteTankSmoothing( RemoteTankSmoothing smoothing );
+	RemoteTankSmoothing GetRemoteTankSmoothing() const;
+	void SetInterpolationDelaySeconds( double delaySeconds );
+	double GetInterpolationDelaySeconds() const;
+	const PredictionErrorStats& GetPredictionErrorStats() const;
+	void ResetPredictionErrorStats();
+	void SetPredictionErrorGraphVisible( bool isVisible );
+	void SetConvergenceSeconds( double convergenceSeconds );
+	double GetConvergenceSeconds() const;
+	void GetTankPositionErrors( std::vector< TankPositionError >& out_errors ) const;
+	const WorldTrafficStats& GetTrafficStats() const;
 	bool IsInGame();
 	Camera GetFirstPersonCamera();
+	void Update( float deltaSeconds, TankInputSource& inputSource );
+#if defined( _WIN32 )
 	void Update( float deltaSeconds, const Keyboard& keyboard, const Mouse& mouse );
 	void RenderObjects3D();
 	void RenderObjects2D();
+#endif
 
 private:
-	void InitializeButtons();
 	Color GetIndividualTankColor( unsigned char playerID );
-	void JoinOrCreateRoom( const NamedProperties& params );
-	void SendPacket( const FinalPacket& packet );
+	void RequestRoom( RoomID roomNumber );
+	int SendPacket( const FinalPacket& packet );
+	int TransmitPacket( const FinalPacket& packet );
+	int TransmitStandalonePacket( const FinalPacket& packet );
+	void FlushCoalescedPackets();
+	void ForgetNegotiatedCapabilities();
+	void AcknowledgePacket( const FinalPacket& packet );
 	void SendJoinLobbyPacket();
-	void SendKeepAlivePacket();
+	int SendKeepAlivePacket();
 	void SendCreateGamePacket( unsigned char roomNumber );
 	void SendJoinGamePacket( unsigned char roomNumber );
 	void SendUpdate();
-	void SendGameUpdate();
+	int SendGameUpdate();
+	int SendEncodedGameUpdate( const FinalPacket& updatePacket );
+	int SendTankInputs();
+	void ResetSnapshotBaselines();
 	void SendFire();
+	double GetServerTimeSeconds() const;
+	double GetRemoteSampleTimeSeconds( const FinalPacket& packet ) const;
 	void ProcessAckPackets( const FinalPacket& ackPacket );
 	void ProcessNakPackets( const FinalPacket& nakPacket );
 	void UpdateLobby( const FinalPacket& lobbyUpdatePacket );
 	void UpdateTank( const FinalPacket& updatePacket );
+	void ReconcileLocalTank( const FinalPacket& correctionPacket );
 	void UpdateTankHit( const FinalPacket& hitPacket );
 	void UpdateTankFire( const FinalPacket& firePacket );
 	void RespawnTank( const FinalPacket& respawnPacket );
 	void ReturnToLobby( const FinalPacket& lobbyReturnPacket );
-	void UpdateFromInput( const Keyboard& keyboard, const Mouse& mouse, float deltaSeconds );
+	void UpdateNetworkAndSimulation( float deltaSeconds, TankInputSource& inputSource );
+	void FlushOutgoingPackets();
+	void RecordPhaseTime( const std::string& profileName, double phaseStartTime );
+	void UpdateFromInput( const TankInput& input, float deltaSeconds );
+	void UpdateLocalTank( const TankMovementInput& movementInput, float deltaSeconds );
+	void ResetLocalTank( float xPosition, float yPosition, float orientationDegrees );
 	void RemoveTimedOutPlayers();
+	void BeginConvergence( Tank* tank, bool hasDrawnState );
 	void ApplyDeadReckoning();
+	void ApplySnapshotInterpolation();
+	void RecordDrawnPositions();
+	void RecordTankState( Tank* tank, float yawOrientationDeg, double sampleTimeSeconds );
 	void ResetGame( const FinalPacket& resetPacket );
 	void ShowButtons();
 	void HideButtons();
 	void ReceivePackets();
+	void RecordReceivedTraffic( PacketNumber number );
+	void DispatchReceivedPackets();
 	void ResendGuaranteedPackets();
+#if defined( _WIN32 )
+	void InitializeButtons();
+	void JoinOrCreateRoom( const NamedProperties& params );
 	void RenderLobby();
 	void RenderWorld();
 	void RenderFloor();
 	void RenderWalls();
 	void RenderTanks();
+	void RenderPredictionErrorGraph();
 
-	Camera						m_camera;
-	Vector2						m_size;
 	Texture*					m_wallTexture;
 	Texture*					m_floorTexture;
-	UDPClient					m_client;
 	BitmapFont					m_hudFont;
-	Tank*						m_mainPlayer;
 	Button						m_roomButtons[ MAX_NUMBER_OF_ROOMS ];
+#endif
+	Camera						m_camera;
+	Vector2						m_size;
+	UDPClient					m_client;
+	Tank*						m_mainPlayer;
 	unsigned int				m_nextPacketNumber;
+	bool						m_isHeadless;
+	bool						m_isProfilingEnabled;
+	RoomID						m_buttonRequestedRoom;
+	RemoteTankSmoothing			m_remoteTankSmoothing;
+	double						m_interpolationDelaySeconds;
+	double						m_interpolationRenderTime;
+	double						m_convergenceSeconds;
+	bool						m_isPredictionErrorGraphVisible;
 	bool						m_isInLobby;
 	bool						m_isInGame;
-	double						m_timeOfLastUpdateSend;
+	bool						m_useCompactWireFormat;
+	bool						m_isCoalescingNegotiated;
+	bool						m_isSelectiveAckNegotiated;
+	bool						m_isServerMovementNegotiated;
+	PacketCoalescer				m_coalescer;
+	UpdateSendScheduler			m_updateScheduler;
 	char						m_playersPerRoom[ MAX_NUMBER_OF_ROOMS ];
 	Vector2						m_mainPlayerVelocity;
 	float						m_mainPlayerOrientation;
+	int							m_turnDirection;
+	float						m_throttleSpeed;
+	PacketNumber				m_spawnPacketNumber; // of the GameReset or Respawn that placed our tank
 	std::vector< Tank* >		m_tanks;
 	std::vector< Color >		m_tankColors;
-	std::vector< FinalPacket >	m_sentPackets;
+	ReliabilityWindow			m_reliabilityWindow;
+	ReceivedPacketTracker		m_receivedPackets;
+	ReorderBuffer				m_reorderBuffer;
+	RoundTripEstimator			m_roundTripEstimator;
+	ClockSynchronizer			m_clockSynchronizer;
+	TankPredictor				m_tankPredictor;
+	SnapshotHistory				m_sentSnapshots;
+	SnapshotHistory				m_receivedSnapshots;
+	QuantizedTankState			m_deltaBaseline;
+	PacketNumber				m_deltaBaselineNumber;
+	bool						m_hasDeltaBaseline;
+	int							m_numUpdatesSinceBaselineAck;
+	std::vector< FinalPacket >	m_expiredPackets;
+	WorldTrafficStats			m_trafficStats;
+	PredictionErrorStats		m_predictionErrors;
 };
 
 